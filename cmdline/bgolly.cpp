@@ -36,6 +36,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <cstdio>
 #include <string.h>
 #include <cstdlib>
+#include <chrono>
 #ifdef TIMING
 #include <sys/time.h>
 #endif
@@ -134,32 +135,39 @@ struct options {
 } ;
 bigint maxgen = -1, inc = 0 ;
 int maxmem = 256 ;
+int maxthreads = 1 ;
 int hyper, render, autofit, quiet, popcount, progress ;
 int hashlife ;
 char *algoName = 0 ;
 int verbose ;
 int timeline ;
+int timelinemem ;
 int stepthresh, stepfactor ;
 char *liferule = 0 ;
 char *outfilename = 0 ;
 char *renderscale = (char *)"1" ;
 char *testscript = 0 ;
-int outputgzip, outputismc ;
+char *memofile = 0 ;
+int bigintbench ;
+int outputgzip, outputismc ; // outputismc is 2 for binary macrocell
 int numberoffset ; // where to insert file name numbers
 options options[] = {
   { "-m", "--generation", "How far to run", 'I', &maxgen },
   { "-i", "--stepsize", "Step size", 'I', &inc },
   { "-M", "--maxmemory", "Max memory to use in megabytes", 'i', &maxmem },
+  { "-T", "--threads", "Max threads to use when stepping", 'i', &maxthreads },
   { "-2", "--exponential", "Use exponentially increasing steps", 'b', &hyper },
   { "-q", "--quiet", "Don't show population; twice, don't show anything", 'b', &quiet },
   { "-r", "--rule", "Life rule to use", 's', &liferule },
   { "-s", "--search", "Search directory for .rule files", 's', &user_rules },
   { "-h", "--hashlife", "Use Hashlife algorithm", 'b', &hashlife },
   { "-a", "--algorithm", "Select algorithm by name", 's', &algoName },
-  { "-o", "--output", "Output file (*.rle, *.mc, *.rle.gz, *.mc.gz)", 's',
+  { "-o", "--output", "Output file (*.rle, *.mc, *.mcb, or any .gz)", 's',
                                                                &outfilename },
   { "-v", "--verbose", "Verbose", 'b', &verbose },
   { "-t", "--timeline", "Use timeline", 'b', &timeline },
+  { "",   "--timelinemem", "Memory for timeline frames in megabytes", 'i',
+                                                              &timelinemem },
   { "",   "--render", "Render (benchmarking)", 'b', &render },
   { "",   "--progress", "Render during progress dialog (debugging)", 'b', &progress },
   { "",   "--popcount", "Popcount (benchmarking)", 'b', &popcount },
@@ -170,6 +178,10 @@ options options[] = {
 //                                                        'i', &stepfactor },
   { "",   "--autofit", "Autofit before each render", 'b', &autofit },
   { "",   "--exec", "Run testing script", 's', &testscript },
+  { "",   "--bigintbench", "Benchmark bigint with this many rounds", 'i',
+                                                              &bigintbench },
+  { "",   "--memo", "Load results from and save them to this file", 's',
+                                                                 &memofile },
   { 0, 0, 0, 0, 0 }
 } ;
 
@@ -216,6 +228,7 @@ void writepat(int fc) {
    if (!outputismc && (t < -MAXRLE || l < -MAXRLE || b > MAXRLE || r > MAXRLE))
       lifefatal("Pattern too large to write in RLE format") ;
    const char *err = writepattern(thisfilename, *imp,
+                                  outputismc == 2 ? MCB_format :
                                   outputismc ? MC_format : RLE_format,
                                   outputgzip ? gzip_compression : no_compression,
                                   t.toint(), l.toint(), b.toint(), r.toint()) ;
@@ -334,8 +347,8 @@ struct loadcmd : public cmdbase {
 struct stepcmd : public cmdbase {
    stepcmd() : cmdbase("step", "b") {}
    virtual void doit() {
-      if (imp->gridwd > 0 || imp->gridht > 0) {
-         // bounded grid, so must step by 1
+      if ((imp->gridwd > 0 || imp->gridht > 0) && !imp->gridCapable()) {
+         // bounded grid the algorithm can't step itself, so must step by 1
          imp->setIncrement(1) ;
          if (!imp->CreateBorderCells()) exit(10) ;
          imp->step() ;
@@ -456,6 +469,7 @@ lifealgo *createUniverse() {
    if (imp == 0)
       lifefatal("Could not create universe") ;
    imp->setMaxMemory(maxmem) ;
+   imp->setMaxThreads(maxthreads) ;
    return imp ;
 }
 
@@ -519,6 +533,96 @@ void runtestscript(const char *testscript) {
    exit(0) ;
 }
 
+/*
+ *   Time the bigint work that every generation does:  summing
+ *   populations four at a time the way the hashing algos do, and the
+ *   viewport's coordinate arithmetic and formatting.  Values range from
+ *   small through 2^62 and beyond so both the direct and the array
+ *   forms get used.  With -T each thread runs its own share of the
+ *   rounds with its own bigints, which also checks that bigint is
+ *   safe to use from several threads at once; the checksum must not
+ *   depend on the thread count.
+ */
+static void sum4(bigint &dest, const bigint &a, const bigint &b,
+                 const bigint &c, const bigint &d) {
+   dest = a ;
+   dest += b ;
+   dest += c ;
+   dest += d ;
+}
+struct bigintbenchslice {
+   void operator()(int i, size_t lo, size_t hi) {
+      const int leaves = 4096 ;
+      std::vector<bigint> pops(leaves) ;
+      bigint total ;
+      for (size_t r=lo; r<hi; r++) {
+         // fill the leaves, then sum them up a level at a time
+         int sh = 30 * (int)(r % 3) ;
+         for (int j=0; j<leaves; j++) {
+            pops[j] = (int)((j * 2654435761u + r) % 17) ;
+            pops[j] <<= sh ;
+         }
+         for (int n=leaves; n>1; n>>=2)
+            for (int j=0; j<n; j+=4)
+               sum4(pops[j>>2], pops[j], pops[j+1], pops[j+2], pops[j+3]) ;
+         total += pops[0] ;
+      }
+      popsum[i] = total ;
+   }
+   bigint *popsum ;
+} ;
+struct viewportbenchslice {
+   void operator()(int i, size_t lo, size_t hi) {
+      bigint total ;
+      for (size_t r=lo; r<hi; r++) {
+         class viewport v(1000, 1000) ;
+         bigint x = (int)r ;
+         x <<= 31 * (int)(r % 3) ;
+         bigint y = x ;
+         y.mul_smallint(3) ;
+         v.setpositionmag(x, y, (int)(r % 5)) ;
+         for (int j=0; j<256; j++) {
+            v.move(7, -5) ;
+            pair<bigint, bigint> cell = v.at(j, 999 - j) ;
+            pair<int, int> pos = v.screenPosOf(cell.first, cell.second,
+                                               imp) ;
+            total += pos.first - pos.second ;
+            total += (int)strlen(cell.first.tostring()) ;
+         }
+      }
+      sums[i] = total ;
+   }
+   bigint *sums ;
+} ;
+void runbigintbench(int rounds) {
+   lifethreads threads ;
+   threads.setthreads(maxthreads) ;
+   std::vector<bigint> sums(maxthreads > 1 ? maxthreads : 1) ;
+   bigint checksum ;
+   std::chrono::steady_clock::time_point t0 =
+                                          std::chrono::steady_clock::now() ;
+   bigintbenchslice pops ;
+   pops.popsum = &sums[0] ;
+   threads.runslices(rounds, pops) ;
+   for (unsigned int i=0; i<sums.size(); i++)
+      checksum += sums[i] ;
+   std::chrono::steady_clock::time_point t1 =
+                                          std::chrono::steady_clock::now() ;
+   cout << "sum4 populations: " << checksum.tostring() << " in "
+        << std::chrono::duration<double>(t1 - t0).count() << "s" << endl ;
+   viewportbenchslice views ;
+   views.sums = &sums[0] ;
+   threads.runslices(rounds, views) ;
+   checksum = 0 ;
+   for (unsigned int i=0; i<sums.size(); i++)
+      checksum += sums[i] ;
+   std::chrono::steady_clock::time_point t2 =
+                                          std::chrono::steady_clock::now() ;
+   cout << "viewport: " << checksum.tostring() << " in "
+        << std::chrono::duration<double>(t2 - t1).count() << "s" << endl ;
+   exit(0) ;
+}
+
 int main(int argc, char *argv[]) {
    cout << "This is bgolly " STRINGIFY(VERSION) " Copyright 2016 The Golly Gang."
         << endl << flush ;
@@ -568,6 +672,10 @@ case 's':
       if (!hit)
          usage("Bad option given") ;
    }
+   if (bigintbench) {
+      imp = createUniverse() ;
+      runbigintbench(bigintbench) ;
+   }
    if (argc < 2 && !testscript)
       usage("No pattern argument given") ;
    if (argc > 2)
@@ -576,15 +684,20 @@ case 's':
       if (endswith(outfilename, ".rle")) {
       } else if (endswith(outfilename, ".mc")) {
          outputismc = 1 ;
+      } else if (endswith(outfilename, ".mcb")) {
+         outputismc = 2 ;
 #ifdef ZLIB
       } else if (endswith(outfilename, ".rle.gz")) {
          outputgzip = 1 ;
       } else if (endswith(outfilename, ".mc.gz")) {
          outputismc = 1 ;
          outputgzip = 1 ;
+      } else if (endswith(outfilename, ".mcb.gz")) {
+         outputismc = 2 ;
+         outputgzip = 1 ;
 #endif
       } else {
-         lifefatal("Output filename must end with .rle or .mc.") ;
+         lifefatal("Output filename must end with .rle, .mc or .mcb.") ;
       }
       if (strlen(outfilename) > 200)
          lifefatal("Output filename too long") ;
@@ -600,6 +713,7 @@ case 's':
       hlifealgo::setVerbose(1) ;
    }
    imp->setMaxMemory(maxmem) ;
+   imp->setMaxThreads(maxthreads) ;
 #ifdef TIMING
    timestamp() ;
 #endif
@@ -618,13 +732,29 @@ case 's':
       err = imp->setrule(liferule) ;
       if (err) lifefatal(err) ;
    }
-   bool boundedgrid = (imp->gridwd > 0 || imp->gridht > 0) ;
+   // a bounded grid the algorithm can't step itself goes by 1
+   bool boundedgrid = (imp->gridwd > 0 || imp->gridht > 0) &&
+                      !imp->gridCapable() ;
    if (boundedgrid) {
       hyper = 0 ;
       inc = 1 ;     // only step by 1
    }
    if (inc != 0)
       imp->setIncrement(inc) ;
+   bool savememo = (memofile != 0) ;
+   if (memofile) {
+      FILE *mf = fopen(memofile, "rb") ;
+      if (mf) {
+         fclose(mf) ;
+         err = imp->readmemo(memofile) ;
+         if (err) {
+            // don't clobber a memo we could not use (another rule, say)
+            lifewarning(err) ;
+            lifewarning("Results file left unchanged") ;
+            savememo = false ;
+         }
+      }
+   }
    if (timeline) {
       int lowbit = inc.lowbitset() ;
       bigint t = 1 ;
@@ -633,6 +763,8 @@ case 's':
       if (t != inc)
          lifefatal("Bad increment for timeline") ;
       imp->startrecording(2, lowbit) ;
+      if (timelinemem > 0)
+         imp->settimelinebudget((g_uintptr_t)timelinemem << 20) ;
    }
    int fc = 0 ;
    for (;;) {
@@ -672,5 +804,9 @@ case 's':
    }
    if (maxgen >= 0 && outfilename != 0)
       writepat(-1) ;
+   if (savememo) {
+      err = imp->writememo(memofile) ;
+      if (err) lifewarning(err) ;
+   }
    exit(0) ;
 }
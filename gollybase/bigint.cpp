@@ -27,18 +27,17 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <iostream>
 #include <cmath>
 #include <limits.h>
+#include <vector>
 #include "util.h"
 #undef SLOWCHECK
 using namespace std ;
 /**
  *   Static data.
  */
-static const int MAX_SIMPLE = 0x3fffffff ;
-static const int MIN_SIMPLE = -0x40000000 ;
-char *bigint::printbuf ;
-int *bigint::work ;
-int bigint::printbuflen ;
-int bigint::workarrlen ;
+static const int SMALLBITS = 8 * sizeof(G_SMALLINT) ;
+static const G_SMALLINT MAX_SIMPLE =
+   (G_SMALLINT)((((unsigned G_INT64)1) << (SMALLBITS - 2)) - 1) ;
+static const G_SMALLINT MIN_SIMPLE = -MAX_SIMPLE - 1 ;
 char bigint::sepchar = ',' ;
 int bigint::sepcount = 3 ;
 /**
@@ -51,17 +50,7 @@ bigint::bigint(int i) {
    fromint(i) ;
 }
 bigint::bigint(G_INT64 i) {
-   if (i <= INT_MAX && i >= INT_MIN)
-      fromint((int)i) ;
-   else {
-      v.i = 0 ;
-      vectorize(0) ;
-      v.p[0] = 3 ;
-      v.p[1] = (int)(i & 0x7fffffff) ;
-      v.p[2] = (int)((i >> 31) & 0x7fffffff) ;
-      v.p[3] = 0 ;
-      ripple((int)(i >> 62), 3) ;
-   }
+   fromsmall(i) ;
 }
 // we can parse ####, 2^###, -#####
 // AKT: we ignore all non-digits (except for leading '-')
@@ -70,8 +59,8 @@ bigint::bigint(G_INT64 i) {
 bigint::bigint(const char *s) {
    if (*s == '2' && s[1] == '^') {
       long x = atol(s+2) ;
-      if (x < 31)
-         fromint(1 << x) ;
+      if (x < 62)
+         fromsmall(G_MAKEINT64(1) << x) ;
       else {
          int sz = 2 + (x + 1) / 31 ;
          int asz = sz ;
@@ -144,26 +133,27 @@ bigint::~bigint() {
       delete [] v.p ;
 }
 const char *bigint::tostring(char sep) const {
+   // each thread gets its own buffer so we can format concurrently
+   static thread_local std::vector<char> printbuf ;
    int lenreq = 32 ;
    if ((v.i & 1) == 0)
       lenreq = size() * 32 ;
-   if (lenreq > printbuflen) {
-     if (printbuf)
-         delete [] printbuf ;
-      printbuf = new char[2 * lenreq] ;
-      printbuflen = 2 * lenreq ;
-   }
-   int sz = 1 ;
-   if (0 == (v.i & 1))
-      sz = size() ;
-   ensurework(sz) ;
+   if ((int)printbuf.size() < 2 * lenreq)
+      printbuf.resize(2 * lenreq) ;
    int neg = sign() < 0 ;
+   char *p = &printbuf[0] ;
    if (v.i & 1) {
+      // at most 63 bits, so no need for the radix conversion below
+      unsigned G_INT64 u = (G_INT64)(v.i >> 1) ;
       if (neg)
-         work[0] = -(v.i >> 1) ;
-      else
-         work[0] = v.i >> 1 ;
+         u = 0 - u ;
+      do {
+         *p++ = (char)(u % 10 + '0') ;
+         u /= 10 ;
+      } while (u) ;
    } else {
+      int sz = size() ;
+      std::vector<int> work(sz) ;
       if (neg) {
          int carry = 1 ;
          for (int i=0; i+1<sz; i++) {
@@ -176,32 +166,31 @@ const char *bigint::tostring(char sep) const {
          for (int i=0; i<sz; i++)
             work[i] = v.p[i+1] ;
       }
-   }
-   char *p = printbuf ;
-   const int bigradix = 1000000000 ; // 9 digits at a time
-   for (;;) {
-      int allbits = 0 ;
-      int carry = 0 ;
-      int i;
-      for (i=sz-1; i>=0; i--) {
-         G_INT64 c = carry * G_MAKEINT64(0x80000000) + work[i] ;
-         carry = (int)(c % bigradix) ;
-         work[i] = (int)(c / bigradix) ;
-         allbits |= work[i] ;
-      }
-      for (i=0; i<9; i++) { // put the nine digits in
-         *p++ = (char)(carry % 10 + '0') ;
-         carry /= 10 ;
+      const int bigradix = 1000000000 ; // 9 digits at a time
+      for (;;) {
+         int allbits = 0 ;
+         int carry = 0 ;
+         int i;
+         for (i=sz-1; i>=0; i--) {
+            G_INT64 c = carry * G_MAKEINT64(0x80000000) + work[i] ;
+            carry = (int)(c % bigradix) ;
+            work[i] = (int)(c / bigradix) ;
+            allbits |= work[i] ;
+         }
+         for (i=0; i<9; i++) { // put the nine digits in
+            *p++ = (char)(carry % 10 + '0') ;
+            carry /= 10 ;
+         }
+         if (allbits == 0)
+            break ;
       }
-      if (allbits == 0)
-         break ;
+      while (p > &printbuf[0] + 1 && *(p-1) == '0')
+         p-- ;
    }
-   while (p > printbuf + 1 && *(p-1) == '0')
-      p-- ;
    char *r = p ;
    if (neg)
       *r++ = '-' ;
-   for (int i=(int)(p-printbuf-1); i>=0; i--) {
+   for (int i=(int)(p-&printbuf[0]-1); i>=0; i--) {
       *r++ = printbuf[i] ;
       if (i && sep && (i % sepcount == 0))
          *r++ = sep ;
@@ -232,28 +221,46 @@ void bigint::grow(int osz, int nsz) {
    v.p[nsz] = av ;
    v.p[0] = nsz ;
 }
+/*
+ *   Spread a direct value out into a (not necessarily canonical) array.
+ */
+static void smallarr(G_SMALLINT i, int *a) {
+   a[0] = 3 ;
+   a[1] = (int)(i & 0x7fffffff) ;
+   a[2] = (int)((i >> 31) & 0x7fffffff) ;
+   a[3] = i < 0 ? -1 : 0 ;
+}
 bigint& bigint::operator+=(const bigint &a) {
-   if (a.v.i & 1)
-      add_smallint(a.v.i >> 1) ;
-   else {
+   if (v.i & a.v.i & 1) {
+      // two direct values can't overflow a 64-bit sum
+      fromsmall((G_INT64)(v.i >> 1) + (a.v.i >> 1)) ;
+   } else if (a.v.i & 1) {
+      int t[4] ;
+      smallarr(a.v.i >> 1, t) ;
+      ripple(t, 0) ;
+   } else {
       if (v.i & 1)
          vectorize(v.i >> 1) ;
-      ripple(a, 0) ;
+      ripple(a.v.p, 0) ;
    }
    return *this ;
 }
 bigint& bigint::operator-=(const bigint &a) {
-   if (a.v.i & 1)
-      add_smallint(-(a.v.i >> 1)) ;
-   else {
+   if (v.i & a.v.i & 1) {
+      fromsmall((G_INT64)(v.i >> 1) - (a.v.i >> 1)) ;
+   } else if (a.v.i & 1) {
+      int t[4] ;
+      smallarr(a.v.i >> 1, t) ;
+      ripplesub(t, 1) ;
+   } else {
       if (v.i & 1)
          vectorize(v.i >> 1) ;
-      ripplesub(a, 1) ;
+      ripplesub(a.v.p, 1) ;
    }
    return *this ;
 }
 int bigint::sign() const {
-   int si = v.i ;
+   G_SMALLINT si = v.i ;
    if (0 == (si & 1))
       si = v.p[size()] ;
    if (si > 0)
@@ -267,7 +274,7 @@ int bigint::size() const {
 }
 void bigint::add_smallint(int a) {
    if (v.i & 1)
-      fromint((v.i >> 1) + a) ;
+      fromsmall((G_INT64)(v.i >> 1) + a) ;
    else
       ripple(a, 1) ;
 }
@@ -278,14 +285,15 @@ void bigint::shrink(int pos) {
       v.p[pos] = v.p[pos+1] ;
       v.p[0] = pos ;
    }
-   if (pos == 1) {
-      int c = v.p[1] ;
-      delete [] v.p ;
-      v.i = 1 | (c << 1) ;
-   } else if (pos == 2 && ((v.p[2] ^ v.p[1]) & 0x40000000) == 0) {
-      int c = v.p[1] + (v.p[2] << 31) ;
-      delete [] v.p ;
-      v.i = 1 | (c << 1) ;
+   // at most two 31-bit words and the sign might fit directly
+   if (pos <= 3) {
+      G_INT64 c = v.p[pos] ;
+      for (int i=pos-1; i>0; i--)
+         c = c * G_MAKEINT64(0x80000000) + v.p[i] ;
+      if (c <= MAX_SIMPLE && c >= MIN_SIMPLE) {
+         delete [] v.p ;
+         v.i = 1 | ((G_SMALLINT)c << 1) ;
+      }
    }
 }
 void grow(int osz, int nsz) ;
@@ -312,8 +320,8 @@ void bigint::ripple(int carry, int pos) {
       v.p[pos+1] = -((c >> 31) & 1) ;
    }
 }
-void bigint::ripple(const bigint &a, int carry) {
-   int asz = a.size() ;
+void bigint::ripple(const int *a, int carry) {
+   int asz = a[0] ;
    int tsz = size() ;
    int pos = 1 ;
    if (tsz < asz) { // gotta resize
@@ -321,14 +329,14 @@ void bigint::ripple(const bigint &a, int carry) {
       tsz = asz ;
    }
    while (pos < asz) {
-      int c = v.p[pos] + a.v.p[pos] + carry ;
+      int c = v.p[pos] + a[pos] + carry ;
       carry = (c >> 31) & 1 ;
       v.p[pos++] = c & 0x7fffffff;
    }
-   ripple(carry + a.v.p[pos], pos) ;
+   ripple(carry + a[pos], pos) ;
 }
-void bigint::ripplesub(const bigint &a, int carry) {
-   int asz = a.size() ;
+void bigint::ripplesub(const int *a, int carry) {
+   int asz = a[0] ;
    int tsz = size() ;
    int pos = 1 ;
    if (tsz < asz) { // gotta resize
@@ -336,38 +344,33 @@ void bigint::ripplesub(const bigint &a, int carry) {
       tsz = asz ;
    }
    while (pos < asz) {
-      int c = v.p[pos] + (0x7fffffff ^ a.v.p[pos]) + carry ;
+      int c = v.p[pos] + (0x7fffffff ^ a[pos]) + carry ;
       carry = (c >> 31) & 1 ;
       v.p[pos++] = c & 0x7fffffff;
    }
-   ripple(carry + ~a.v.p[pos], pos) ;
+   ripple(carry + ~a[pos], pos) ;
 }
 // make sure it's in vector form; may leave it not canonical!
-void bigint::vectorize(int i) {
+void bigint::vectorize(G_SMALLINT i) {
    v.p = new int[4] ;
-   v.p[0] = 2 ;
-   v.p[1] = i & 0x7fffffff ;
-   if (i < 0)
-      v.p[2] = -1 ;
-   else
-      v.p[2] = 0 ;
-#ifdef SLOWCHECK
-   v.p[3] = 0xdeadbeef ;
-#endif
+   smallarr(i, v.p) ;
 }
 void bigint::fromint(int i) {
    if (i <= MAX_SIMPLE && i >= MIN_SIMPLE)
-      v.i = (i << 1) | 1 ;
+      v.i = ((G_SMALLINT)i << 1) | 1 ;
    else
-      vectorize(i) ;
+      fromsmall(i) ;
 }
-void bigint::ensurework(int sz) const {
-   sz += 3 ;
-   if (sz > workarrlen) {
-      if (work)
-         delete [] work ;
-      work = new int[sz * 2] ;
-      workarrlen = sz * 2 ;
+void bigint::fromsmall(G_INT64 i) {
+   if (i <= MAX_SIMPLE && i >= MIN_SIMPLE)
+      v.i = ((G_SMALLINT)i << 1) | 1 ;
+   else {
+      v.p = new int[4] ;
+      v.p[0] = 3 ;
+      v.p[1] = (int)(i & 0x7fffffff) ;
+      v.p[2] = (int)((i >> 31) & 0x7fffffff) ;
+      v.p[3] = 0 ;
+      ripple((int)(i >> 62), 3) ;
    }
 }
 void bigint::mul_smallint(int a) {
@@ -377,12 +380,12 @@ void bigint::mul_smallint(int a) {
       return ;
    }
    if (v.i & 1) {
-      if ((v.i >> 1) <= MAX_SIMPLE / a) {
-         c = (v.i >> 1) * a ;
-         fromint((v.i >> 1) * a) ;
+      G_SMALLINT x = v.i >> 1 ;
+      if (x <= MAX_SIMPLE / a && x >= MIN_SIMPLE / a) {
+         v.i = ((x * a) << 1) | 1 ;
          return ;
       }
-      vectorize(v.i >> 1) ;
+      vectorize(x) ;
    }
    int sz = size() ;
    int carry = 0 ;
@@ -408,8 +411,7 @@ void bigint::mul_smallint(int a) {
 }
 void bigint::div_smallint(int a) {
    if (v.i & 1) {
-      int r = (v.i >> 1) / a ;
-      fromint(r) ;
+      fromsmall((v.i >> 1) / a) ;
       return ;
    }
    if (v.p[v.p[0]] < 0)
@@ -426,15 +428,15 @@ void bigint::div_smallint(int a) {
 }
 int bigint::mod_smallint(int a) {
    if (v.i & 1)
-      return (((v.i >> 1) % a) + a) % a ;
+      return (int)((((v.i >> 1) % a) + a) % a) ;
    int pos = v.p[0] ;
-   int mm = (2 * ((1 << 30) % a) % a) ;
-   int r = 0 ;
+   G_INT64 mm = (2 * ((1 << 30) % a) % a) ;
+   G_INT64 r = 0 ;
    while (pos > 0) {
       r = (mm * r + v.p[pos]) % a ;
       pos-- ;
    }
-   return (r + a) % a ;
+   return (int)((r + a) % a) ;
 }
 void bigint::div2() {
    if (v.i & 1) {
@@ -452,10 +454,9 @@ void bigint::div2() {
 }
 bigint& bigint::operator>>=(int i) {
    if (v.i & 1) {
-      if (i > 31)
-         v.i = ((v.i >> 31) | 1) ;
-      else
-         v.i = ((v.i >> i) | 1) ;
+      if (i > SMALLBITS - 1)
+         i = SMALLBITS - 1 ;
+      v.i = ((v.i >> i) | 1) ;
       return *this ;
    }
    int bigsh = i / 31 ;
@@ -485,7 +486,8 @@ bigint& bigint::operator<<=(int i) {
    if (v.i & 1) {
       if (v.i == 1)
          return *this ;
-      if (i < 30 && (v.i >> 31) == (v.i >> (31 - i))) {
+      if (i < SMALLBITS - 2 &&
+          (v.i >> (SMALLBITS - 1)) == (v.i >> (SMALLBITS - 1 - i))) {
          v.i = ((v.i & ~1) << i) | 1 ;
          return *this ;
       }
@@ -521,19 +523,19 @@ void bigint::mulpow2(int p) {
 }
 int bigint::even() const {
    if (v.i & 1)
-      return 1-((v.i >> 1) & 1) ;
+      return 1-(int)((v.i >> 1) & 1) ;
    else
       return 1-(v.p[1] & 1) ;
 }
 int bigint::odd() const {
    if (v.i & 1)
-      return ((v.i >> 1) & 1) ;
+      return (int)((v.i >> 1) & 1) ;
    else
       return (v.p[1] & 1) ;
 }
 int bigint::low31() const {
    if (v.i & 1)
-      return ((v.i >> 1) & 0x7fffffff) ;
+      return (int)((v.i >> 1) & 0x7fffffff) ;
    else
       return v.p[1] ;
 }
@@ -699,8 +701,9 @@ double bigint::toscinot() const
  *   Return an int.
  */
 int bigint::toint() const {
+   // out of range values give the low 31 bits and the sign, as below
    if (v.i & 1)
-      return (v.i >> 1) ;
+      return ((int)(v.i >> 1) & 0x7fffffff) | (v.i < 0 ? INT_MIN : 0) ;
    return (v.p[v.p[0]] << 31) | v.p[1] ;
 }
 /**
@@ -709,7 +712,7 @@ int bigint::toint() const {
  */
 int bigint::bitsreq() const {
    if (v.i & 1)
-      return 31 ;
+      return SMALLBITS - 1 ;
    return v.p[0] * 31 ;
 }
 /**
@@ -720,7 +723,7 @@ int bigint::lowbitset() const {
    if (v.i & 1) {
       if (v.i == 1)
          return -1 ;
-      for (int i=1; i<32; i++)
+      for (int i=1; i<SMALLBITS; i++)
          if ((v.i >> i) & 1)
             return i-1 ;
    }
@@ -743,10 +746,10 @@ void bigint::tochararr(char *fillme, int n) const {
    while (n > 0) {
       int w = 0 ;
       if (v.i & 1) {
-         if (at == 0)
-            w = v.i >> 1 ;
-         else
-            w = v.i >> 31 ;
+         int sh = 1 + 31 * at ;
+         if (sh > SMALLBITS - 1)
+            sh = SMALLBITS - 1 ;
+         w = (int)(v.i >> sh) ;
       } else {
          if (at < v.p[0])
             w = v.p[at+1] ;
@@ -23,9 +23,13 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
                         / ***/
 /**
  *   Class bigint manages signed bigints using a very Lisp-ish approach.
- *   Integers from -0x40000000 through 0x3fffffff are represented
- *   by a direct instance of this four-byte class, with the lowest
- *   bit set.  Integers outside that range use a pointer to an
+ *   Integers that fit in two bits less than a pointer (-2^62 through
+ *   2^62-1 on 64-bit platforms, -0x40000000 through 0x3fffffff on
+ *   32-bit ones) are represented by a direct instance of this
+ *   pointer-sized class, shifted left one with the lowest bit set.
+ *   That covers nearly every population, generation count and
+ *   coordinate we ever see, and arithmetic on them never touches
+ *   the heap.  Integers outside that range use a pointer to an
  *   integer array; the first element is how many elements of
  *   that array are used.  The array itself is always a power of
  *   two in size, the smallest power of two greater than
@@ -63,7 +67,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  *
  *   We never use an array size smaller than 4.
  *
- *   Nonnegative numbers are represented as follows:
+ *   Nonnegative numbers are represented as follows (on 32-bit
+ *   platforms; on 64-bit ones everything below 2^62 is direct):
  *
  *   0..2^30-1     Directly, shifted left one with the low bit set
  *   2^30..2^31-1  siz=2, low 31 bits then 0; array size is 4
@@ -85,6 +90,11 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  *
  *   The only upper bound on the size of these numbers is memory.
  *
+ *   Nothing here is shared between instances, so different threads
+ *   may freely use different bigints.  The string tostring returns
+ *   lives in a buffer private to the calling thread, and is good
+ *   until that thread's next call.
+ *
  *   We only provide a limited number of arithmetic operations for the
  *   moment.  (Addition, subtraction, comparison, bit extraction,
  *   radix conversion, parsing, copying, assignment, to float, to double,
@@ -107,6 +117,13 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #define G_INT64_FMT      "lld"
 #endif
 
+// the direct (unallocated) form uses a pointer-sized int
+#if defined(_WIN64) || defined(__LP64__) || defined(__amd64__)
+#define G_SMALLINT       G_INT64
+#else
+#define G_SMALLINT       int
+#endif
+
 class bigint {
 public:
    bigint() ;
@@ -164,20 +181,17 @@ private:
    // note:  carry may be any legal 31-bit int
    // note:  may only be called on arrayed bigints
    void ripple(int carry, int pos) ;
-   void ripple(const bigint &a, int carry) ;
-   void ripplesub(const bigint &a, int carry) ;
+   // a is an array in the same form as v.p, not necessarily canonical
+   void ripple(const int *a, int carry) ;
+   void ripplesub(const int *a, int carry) ;
    // make sure it's in vector form; may leave it not canonical!
-   void vectorize(int i) ;
+   void vectorize(G_SMALLINT i) ;
    void fromint(int i) ;
-   void ensurework(int sz) const ;
+   void fromsmall(G_INT64 i) ;
    union {
-      int i ;
+      G_SMALLINT i ;
       int *p ;
    } v ;
-   static char *printbuf ;
-   static int *work ;
-   static int printbuflen ;
-   static int workarrlen ;
    static char sepchar ;
    static int sepcount ;
 } ;
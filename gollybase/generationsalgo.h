@@ -27,7 +27,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 /**
  *   Our Generations algo class.
  */
-class generationsalgo : public ghashbase {
+class generationsalgo : public ghashcalc<generationsalgo> {
 public:
    generationsalgo() ;
    virtual ~generationsalgo() ;
@@ -56,7 +56,7 @@ static g_uintptr_t nextprime(g_uintptr_t i) {
  *   We do now support garbage collection, but there are some routines we
  *   call frequently to help us.
  */
-#define ghnode_hash(a,b,c,d) (65537*(g_uintptr_t)(d)+257*(g_uintptr_t)(c)+17*(g_uintptr_t)(b)+5*(g_uintptr_t)(a))
+#define ghnode_hash(a,b,c,d) (65537*(g_uintptr_t)(ghnode *)(d)+257*(g_uintptr_t)(ghnode *)(c)+17*(g_uintptr_t)(ghnode *)(b)+5*(g_uintptr_t)(ghnode *)(a))
 #define ghleaf_hash(a,b,c,d) (65537*(d)+257*(c)+17*(b)+5*(a))
 /*
  *   Resize the hash.
@@ -207,6 +207,35 @@ ghleaf *ghashbase::find_ghleaf(state nw, state ne, state sw, state se) {
       resize() ;
    return (ghleaf *)save((ghnode *)p) ;
 }
+/*
+ *   A ghleaf is only 2x2, so the tree is deep and most of the nodes near
+ *   the bottom are only there to hold intermediate results.  Instead,
+ *   once we get down to a 2^(SQUAREDEPTH+2)-square, we copy its states
+ *   into a flat array and run the whole thing forward a generation at a
+ *   time with slowcalcs(), shrinking by a cell on each side each time,
+ *   and hash just the center that is left.  This does the same number
+ *   of cell calculations as the recursion when nothing is cached, but
+ *   none of the building and hashing of all the little squares in
+ *   between, and they no longer fill up memory.
+ *
+ *   But those little squares are also what make hashing pay off for
+ *   regular patterns; losing them costs JvN and WireWorld patterns a
+ *   factor of three or more.  So we watch how often the results at this
+ *   depth are found in the cache (which works the same either way), and
+ *   only go flat when fewer than two lookups in three hit; that is, when
+ *   the pattern is chaotic enough that the small results would mostly
+ *   be computed once and thrown away.
+ */
+static const int SQUAREDEPTH = 2 ;
+static const int SQUARESIZE = 4 << SQUAREDEPTH ;
+static const int SQUARESAMPLE = 1024 ;
+int ghashbase::usesquares() {
+   if (++squaremisses >= SQUARESAMPLE) {
+     squareflat = (squarehits < 2 * squaremisses) ;
+     squarehits = squaremisses = 0 ;
+   }
+   return squareflat ;
+}
 /*
  *   The following routine does the same, but first it checks to see if
  *   the cached result is any good.  If it is, it directly returns that.
@@ -216,8 +245,11 @@ ghleaf *ghashbase::find_ghleaf(state nw, state ne, state sw, state se) {
  *   stack pointer and garbage collection stuff.
  */
 ghnode *ghashbase::getres(ghnode *n, int depth) {
-   if (n->res)
+   if (n->res) {
+     if (depth == SQUAREDEPTH + 1)
+       squarehits++ ;
      return n->res ;
+   }
    ghnode *res = 0 ;
    /**
     *   This routine be the only place we assign to res.  We use
@@ -234,7 +266,9 @@ ghnode *ghashbase::getres(ghnode *n, int depth) {
      return zeroghnode(depth-1) ;
    int sp = gsp ;
    depth-- ;
-   if (ngens >= depth) {
+   if (depth == SQUAREDEPTH && usesquares()) {
+     res = dorecurs_square(n, ngens >= depth ? 1 << depth : 1 << ngens) ;
+   } else if (ngens >= depth) {
      if (is_ghnode(n->nw)) {
        res = dorecurs(n->nw, n->ne, n->sw, n->se, depth) ;
      } else {
@@ -350,19 +384,65 @@ ghnode *ghashbase::dorecurs_half(ghnode *n, ghnode *ne, ghnode *t,
  */
 ghleaf *ghashbase::dorecurs_ghleaf(ghleaf *nw, ghleaf *ne, ghleaf *sw,
                                    ghleaf *se) {
-   return find_ghleaf(
-             slowcalc(nw->nw, nw->ne, ne->nw,
-                      nw->sw, nw->se, ne->sw,
-                      sw->nw, sw->ne, se->nw),
-             slowcalc(nw->ne, ne->nw, ne->ne,
-                      nw->se, ne->sw, ne->se,
-                      sw->ne, se->nw, se->ne),
-             slowcalc(nw->sw, nw->se, ne->sw,
-                      sw->nw, sw->ne, se->nw,
-                      sw->sw, sw->se, se->sw),
-             slowcalc(nw->se, ne->sw, ne->se,
-                      sw->ne, se->nw, se->ne,
-                      sw->se, se->sw, se->se)) ;
+   state g[16], r[6] ;
+   g[0] = nw->nw ; g[1] = nw->ne ; g[2] = ne->nw ; g[3] = ne->ne ;
+   g[4] = nw->sw ; g[5] = nw->se ; g[6] = ne->sw ; g[7] = ne->se ;
+   g[8] = sw->nw ; g[9] = sw->ne ; g[10] = se->nw ; g[11] = se->ne ;
+   g[12] = sw->sw ; g[13] = sw->se ; g[14] = se->sw ; g[15] = se->se ;
+   slowcalcs(g, r, 4, 2, 2) ;
+   return find_ghleaf(r[0], r[1], r[4], r[5]) ;
+}
+void ghashbase::slowcalcs(const state *in, state *out, int stride,
+                          int wd, int ht) {
+   for (int y=0; y<ht; y++) {
+      const state *a = in + y * stride, *b = a + stride, *c = b + stride ;
+      state *r = out + y * stride ;
+      for (int x=0; x<wd; x++)
+         r[x] = slowcalc(a[x], a[x+1], a[x+2], b[x], b[x+1], b[x+2],
+                         c[x], c[x+1], c[x+2]) ;
+   }
+}
+void ghashbase::getsquare(ghnode *n, int size, state *g, int stride) {
+   if (size == 2) {
+      ghleaf *l = (ghleaf *)n ;
+      g[0] = l->nw ;
+      g[1] = l->ne ;
+      g[stride] = l->sw ;
+      g[stride+1] = l->se ;
+   } else {
+      int h = size >> 1 ;
+      getsquare(n->nw, h, g, stride) ;
+      getsquare(n->ne, h, g + h, stride) ;
+      getsquare(n->sw, h, g + h * stride, stride) ;
+      getsquare(n->se, h, g + h * stride + h, stride) ;
+   }
+}
+ghnode *ghashbase::makesquare(const state *g, int size, int stride) {
+   if (size == 2)
+      return (ghnode *)find_ghleaf(g[0], g[1], g[stride], g[stride+1]) ;
+   int h = size >> 1 ;
+   int sp = gsp ;
+   ghnode *nw = makesquare(g, h, stride) ;
+   ghnode *ne = makesquare(g + h, h, stride) ;
+   ghnode *sw = makesquare(g + h * stride, h, stride) ;
+   ghnode *se = makesquare(g + h * stride + h, h, stride) ;
+   ghnode *r = find_ghnode(nw, ne, sw, se) ;
+   pop(sp) ;
+   return save(r) ;
+}
+ghnode *ghashbase::dorecurs_square(ghnode *n, int gens) {
+   const int S = SQUARESIZE ;
+   state a[S*S], b[S*S] ;
+   state *from = a, *to = b ;
+   getsquare(n, S, a, S) ;
+   for (int g=1; g<=gens; g++) {
+      slowcalcs(from + (g - 1) * (S + 1), to + g * (S + 1), S,
+                S - 2 * g, S - 2 * g) ;
+      state *t = from ;
+      from = to ;
+      to = t ;
+   }
+   return makesquare(from + (S / 4) * (S + 1), S / 2, S) ;
 }
 /*
  *   We keep free ghnodes in a linked list for allocation, and we allocate
@@ -372,17 +452,31 @@ ghnode *ghashbase::newghnode() {
    ghnode *r ;
    if (freeghnodes == 0) {
       int i ;
-      freeghnodes = (ghnode *)calloc(1001, sizeof(ghnode)) ;
-      if (freeghnodes == 0)
-         lifefatal("Out of memory; try reducing the hash memory limit.") ;
-      alloced += 1001 * sizeof(ghnode) ;
-      freeghnodes->next = ghnodeblocks ;
-      ghnodeblocks = freeghnodes++ ;
-      for (i=0; i<999; i++) {
-         freeghnodes[1].next = freeghnodes ;
-         freeghnodes++ ;
+      freeghnodes = (ghnode *)nodearena::alloc(1001 * sizeof(ghnode)) ;
+      if (freeghnodes == 0) {
+         /*
+          *   The node arena is shared by every universe, so it can be
+          *   used up before we reach our own limit.  Then we lower the
+          *   limit to what we have and carry on collecting at it.
+          */
+         if (!okaytogc || alloced >= maxmem)
+            lifefatal("Out of memory; try reducing the hash memory limit.") ;
+         maxmem = alloced ;
+         lifewarning("Out of node memory; running in a somewhat slower mode; "
+                "try reducing the hash memory limit or closing other layers.") ;
+         do_gc(0) ;
+         if (freeghnodes == 0)
+            lifefatal("Out of memory; try reducing the hash memory limit.") ;
+      } else {
+         alloced += 1001 * sizeof(ghnode) ;
+         freeghnodes->next = ghnodeblocks ;
+         ghnodeblocks = freeghnodes++ ;
+         for (i=0; i<999; i++) {
+            freeghnodes[1].next = freeghnodes ;
+            freeghnodes++ ;
+         }
+         totalthings += 1000 ;
       }
-      totalthings += 1000 ;
    }
    if (freeghnodes->next == 0 && alloced + 1000 * sizeof(ghnode) > maxmem &&
        okaytogc) {
@@ -417,9 +511,11 @@ ghashbase::ghashbase() {
      lifefatal("Out of memory (1).") ;
    alloced += hashprime * sizeof(ghnode *) ;
    ngens = 0 ;
+   squarehits = squaremisses = squareflat = 0 ;
    stacksize = 0 ;
    halvesdone = 0 ;
    nzeros = 0 ;
+   mcbinary = 0 ;
    stack = 0 ;
    gsp = 0 ;
    alloced = 0 ;
@@ -449,6 +545,8 @@ ghashbase::ghashbase() {
    cacheinvalid = 0 ;
    gccount = 0 ;
    gcstep = 0 ;
+   drawpopcount = 0 ;
+   drawpopgc = -1 ;
 }
 /**
  *   Destructor frees memory.
@@ -458,7 +556,7 @@ ghashbase::~ghashbase() {
    while (ghnodeblocks) {
       ghnode *r = ghnodeblocks ;
       ghnodeblocks = ghnodeblocks->next ;
-      free(r) ;
+      nodearena::release(r, 1001 * sizeof(ghnode)) ;
    }
    if (zeroghnodea)
       free(zeroghnodea) ;
@@ -536,6 +634,7 @@ void ghashbase::setMaxMemory(int newmemlimit) {
    else if (newmemlimit > 4000)
      newmemlimit = 4000 ;
 #endif
+   newmemlimit = nodearena::clamplimit(newmemlimit) ;
    g_uintptr_t newlimit = ((g_uintptr_t)newmemlimit) << 20 ;
    if (alloced > newlimit) {
       lifewarning("Sorry, more memory currently used than allowed.") ;
@@ -671,7 +770,7 @@ ghnode *ghashbase::setbit(ghnode *n, int x, int y, int newstate, int depth) {
       if (depth > 31)
          w = 0 ;
       depth-- ;
-      ghnode **nptr ;
+      NODEREF(ghnode) *nptr ;
       if (x < 0) {
          if (y < 0)
             nptr = &(n->sw) ;
@@ -919,6 +1018,153 @@ int ghashbase::nextcell(int x, int y, int &v) {
    }
    return nextbit(root, x, y, depth, v) ;
 }
+/*
+ *   The strip routines walk just the part of the tree that covers the
+ *   rectangle, as in hlifealgo.  The box is left, bottom, right, top
+ *   (inclusive) in tree coordinates, and the first row of states is
+ *   its top; every int coordinate is inside the ghnode of this depth
+ *   centered on the origin.
+ */
+static const int STRIPDEPTH = 31 ;
+static void stripbox(int x, int y, int wd, int ht, G_INT64 *box) {
+   box[0] = x ;
+   box[1] = - (G_INT64)y - ht + 1 ;
+   box[2] = (G_INT64)x + wd - 1 ;
+   box[3] = - (G_INT64)y ;
+}
+void ghashbase::getstrip(int x, int y, int wd, int ht,
+                         unsigned char *states) {
+   if (wd <= 0 || ht <= 0)
+      return ;
+   memset(states, 0, (size_t)wd * ht) ;
+   G_INT64 box[4] ;
+   stripbox(x, y, wd, ht, box) ;
+   struct ghnode tghnode = *root ;
+   int d = depth ;
+   while (d > STRIPDEPTH) {
+      tghnode.nw = tghnode.nw->se ;
+      tghnode.ne = tghnode.ne->sw ;
+      tghnode.sw = tghnode.sw->ne ;
+      tghnode.se = tghnode.se->nw ;
+      d-- ;
+   }
+   G_INT64 half = (G_INT64)1 << d ;
+   stripget(d < depth ? &tghnode : root, d, -half, -half, box, states) ;
+}
+int ghashbase::putstrip(int x, int y, int wd, int ht,
+                        const unsigned char *states) {
+   if (wd <= 0 || ht <= 0)
+      return 0 ;
+   for (size_t i=0; i<(size_t)wd * ht; i++)
+      if (states[i] >= maxCellStates)
+         return -1 ;
+   stripwrite(x, y, wd, ht, states) ;
+   return 0 ;
+}
+void ghashbase::clearstrip(int x, int y, int wd, int ht) {
+   if (wd > 0 && ht > 0)
+      stripwrite(x, y, wd, ht, 0) ;
+}
+/*
+ *   Grow the root to hold the rectangle, just as setcell() would, and
+ *   put the states in (or clear it, if states is null).
+ */
+void ghashbase::stripwrite(int x, int y, int wd, int ht,
+                           const unsigned char *states) {
+   ensure_hashed() ;
+   G_INT64 box[4] ;
+   stripbox(x, y, wd, ht, box) ;
+   while (states && depth < STRIPDEPTH) {
+      G_INT64 half = (G_INT64)1 << depth ;
+      if (box[0] >= -half && box[1] >= -half && box[2] < half &&
+          box[3] < half)
+         break ;
+      root = pushroot(root) ;
+      depth++ ;
+   }
+   root = stripcenter(root, depth, box, states) ;
+   clearstack() ;
+   popValid = 0 ;
+}
+/*
+ *   Copy the cells of n (of depth d, lower left corner at x, y) that
+ *   are in the box into states.
+ */
+void ghashbase::stripget(ghnode *n, int d, G_INT64 x, G_INT64 y,
+                         const G_INT64 *box, unsigned char *states) {
+   G_INT64 size = (G_INT64)2 << d ;
+   if (n == 0 || n == zeroghnode(d) || x > box[2] || x + size <= box[0] ||
+       y > box[3] || y + size <= box[1])
+      return ;
+   G_INT64 wd = box[2] - box[0] + 1 ;
+   if (d == 0) {
+      ghleaf *l = (ghleaf *)n ;
+      state s[4] = { l->nw, l->ne, l->sw, l->se } ;
+      for (int i=0; i<4; i++) {
+         G_INT64 xx = x + (i & 1), yy = y + 1 - (i >> 1) ;
+         if (s[i] && xx >= box[0] && xx <= box[2] && yy >= box[1] &&
+             yy <= box[3])
+            states[(box[3] - yy) * wd + xx - box[0]] = s[i] ;
+      }
+      return ;
+   }
+   G_INT64 half = size >> 1 ;
+   stripget(n->nw, d-1, x, y + half, box, states) ;
+   stripget(n->ne, d-1, x + half, y + half, box, states) ;
+   stripget(n->sw, d-1, x, y, box, states) ;
+   stripget(n->se, d-1, x + half, y, box, states) ;
+}
+/*
+ *   n (of depth d, lower left corner at x, y) with the cells in the box
+ *   set where states is nonzero, or all cleared if states is null.
+ */
+ghnode *ghashbase::stripput(ghnode *n, int d, G_INT64 x, G_INT64 y,
+                            const G_INT64 *box, const unsigned char *states) {
+   G_INT64 size = (G_INT64)2 << d ;
+   if (x > box[2] || x + size <= box[0] || y > box[3] || y + size <= box[1])
+      return n ;
+   if (states == 0 && (n == zeroghnode(d) ||
+                       (x >= box[0] && x + size - 1 <= box[2] &&
+                        y >= box[1] && y + size - 1 <= box[3])))
+      return zeroghnode(d) ;
+   G_INT64 wd = box[2] - box[0] + 1 ;
+   if (d == 0) {
+      ghleaf *l = (ghleaf *)n ;
+      state s[4] = { l->nw, l->ne, l->sw, l->se } ;
+      for (int i=0; i<4; i++) {
+         G_INT64 xx = x + (i & 1), yy = y + 1 - (i >> 1) ;
+         if (xx < box[0] || xx > box[2] || yy < box[1] || yy > box[3])
+            continue ;
+         if (states == 0)
+            s[i] = 0 ;
+         else if (states[(box[3] - yy) * wd + xx - box[0]])
+            s[i] = states[(box[3] - yy) * wd + xx - box[0]] ;
+      }
+      return (ghnode *)find_ghleaf(s[0], s[1], s[2], s[3]) ;
+   }
+   G_INT64 half = size >> 1 ;
+   ghnode *nw = stripput(n->nw, d-1, x, y + half, box, states) ;
+   ghnode *ne = stripput(n->ne, d-1, x + half, y + half, box, states) ;
+   ghnode *sw = stripput(n->sw, d-1, x, y, box, states) ;
+   ghnode *se = stripput(n->se, d-1, x + half, y, box, states) ;
+   return find_ghnode(nw, ne, sw, se) ;
+}
+/*
+ *   A root deeper than STRIPDEPTH only changes in the middle.
+ */
+ghnode *ghashbase::stripcenter(ghnode *n, int d, const G_INT64 *box,
+                               const unsigned char *states) {
+   if (d <= STRIPDEPTH) {
+      G_INT64 half = (G_INT64)1 << d ;
+      return stripput(n, d, -half, -half, box, states) ;
+   }
+   ghnode *c = stripcenter(find_ghnode(n->nw->se, n->ne->sw, n->sw->ne,
+                                       n->se->nw), d-1, box, states) ;
+   return find_ghnode(find_ghnode(n->nw->nw, n->nw->ne, n->nw->sw, c->nw),
+                      find_ghnode(n->ne->nw, n->ne->ne, c->ne, n->ne->se),
+                      find_ghnode(n->sw->nw, c->sw, n->sw->sw, n->sw->se),
+                      find_ghnode(c->se, n->se->ne, n->se->sw, n->se->se)) ;
+}
 /*
  *   Canonicalize a universe by filling in the null pointers and then
  *   invoking find_ghnode on each ghnode.  Drops the original universe on
@@ -983,17 +1229,34 @@ ghnode *ghashbase::popzeros(ghnode *n) {
  *   (or abusing) the cache (res) field, and the least significant bit of
  *   the hash next field (as a visited bit).
  */
-#define marked(n) (1 & (g_uintptr_t)(n)->next)
-#define mark(n) ((n)->next = (ghnode *)(1 | (g_uintptr_t)(n)->next))
-#define clearmark(n) ((n)->next = (ghnode *)(~1 & (g_uintptr_t)(n)->next))
-#define clearmarkbit(p) ((ghnode *)(~1 & (g_uintptr_t)(p)))
+#define marked(n) (1 & HRAW((n)->next))
+#define mark(n) SETHRAW((n)->next, ghnode, 1 | HRAW((n)->next))
+#define clearmark(n) SETHRAW((n)->next, ghnode, ~(g_uintptr_t)1 & HRAW((n)->next))
+static inline ghnode *clearmarkbit(NODEREF(ghnode) p) {
+   SETHRAW(p, ghnode, ~(g_uintptr_t)1 & HRAW(p)) ;
+   return p ;
+}
 /*
  *   Sometimes we want to use *res* instead of next to mark.  You cannot
  *   do this to leaves, though.
  */
-#define marked2(n) (1 & (g_uintptr_t)(n)->res)
-#define mark2(n) ((n)->res = (ghnode *)(1 | (g_uintptr_t)(n)->res))
-#define clearmark2(n) ((n)->res = (ghnode *)(~1 & (g_uintptr_t)(n)->res))
+#define marked2(n) (1 & HRAW((n)->res))
+#define mark2(n) SETHRAW((n)->res, ghnode, 1 | HRAW((n)->res))
+#define clearmark2(n) SETHRAW((n)->res, ghnode, ~(g_uintptr_t)1 & HRAW((n)->res))
+/*
+ *   The populations of leaves are small, so we keep them all as bigints
+ *   here rather than hanging them off the leaves.
+ */
+static bigint *makeleafpops() {
+   bigint *pops = new bigint[5] ;
+   for (int i=0; i<=4; i++)
+      pops[i] = i ;
+   return pops ;
+}
+static const bigint &leafpopulation(int pop) {
+   static bigint *pops = makeleafpops() ;
+   return pops[pop] ;
+}
 static void sum4(bigint &dest, const bigint &a, const bigint &b,
                  const bigint &c, const bigint &d) {
    dest = a ;
@@ -1009,49 +1272,41 @@ const bigint &ghashbase::calcpop(ghnode *root, int depth) {
    if (root == zeroghnode(depth))
       return bigint::zero ;
    if (depth == 0) {
-      root->nw = 0 ;
-      bigint &r = *(bigint *)&(root->nw) ;
-      ghleaf *n = (ghleaf *)root ;
-      r = n->leafpop ;
-      return r ;
+      return leafpopulation(((ghleaf *)root)->leafpop) ;
    } else if (marked2(root)) {
-      return *(bigint*)&(root->next) ;
+      return popcounts[HRAW(root->next)] ;
    } else {
       depth-- ;
       unhash_ghnode(root) ;
-/**
- *   We use the memory in root->next as a value bigint.  But we want to
- *   make sure the copy constructor doesn't "clean up" something that
- *   doesn't exist.  So we clear it to zero here.
- */
-      root->next = (ghnode *)0 ; // I wish I could come up with a cleaner way
-      sum4(*(bigint *)&(root->next),
-           calcpop(root->nw, depth), calcpop(root->ne, depth),
-           calcpop(root->sw, depth), calcpop(root->se, depth)) ;
+      // the unhashed node's next field holds the index of its count
+      // (in a deque, so the children's counts stay put as it grows)
+      bigint sum ;
+      sum4(sum, calcpop(root->nw, depth), calcpop(root->ne, depth),
+                calcpop(root->sw, depth), calcpop(root->se, depth)) ;
+      SETHRAW(root->next, ghnode, popcounts.size()) ;
+      popcounts.push_back(sum) ;
       mark2(root) ;
-      return *(bigint *)&(root->next) ;
+      return popcounts.back() ;
    }
 }
 /*
  *   Call this after doing something that unhashes ghnodes in order to
  *   use the next field as a temp pointer.
  */
-void ghashbase::aftercalcpop2(ghnode *root, int depth, int cleanbigints) {
+void ghashbase::aftercalcpop2(ghnode *root, int depth) {
    if (root == zeroghnode(depth))
       return ;
    if (depth == 0) {
-      root->nw = 0 ; // all these bigints are guaranteed to be small
+      root->nw = 0 ;
       return ;
    }
    if (marked2(root)) {
       clearmark2(root) ;
       depth-- ;
-      aftercalcpop2(root->nw, depth, cleanbigints) ;
-      aftercalcpop2(root->ne, depth, cleanbigints) ;
-      aftercalcpop2(root->sw, depth, cleanbigints) ;
-      aftercalcpop2(root->se, depth, cleanbigints) ;
-      if (cleanbigints)
-         *(bigint *)&(root->next) = bigint::zero ; // clean up; yuck!
+      aftercalcpop2(root->nw, depth) ;
+      aftercalcpop2(root->ne, depth) ;
+      aftercalcpop2(root->sw, depth) ;
+      aftercalcpop2(root->se, depth) ;
       rehash_ghnode(root) ;
    }
 }
@@ -1063,7 +1318,8 @@ void ghashbase::calcPopulation(ghnode *root) {
    ensure_hashed() ;
    depth = ghnode_depth(root) ;
    population = calcpop(root, depth) ;
-   aftercalcpop2(root, depth, 1) ;
+   aftercalcpop2(root, depth) ;
+   popcounts.clear() ;
 }
 /*
  *   Is the universe empty?
@@ -1337,13 +1593,86 @@ ghnode *ghashbase::runpattern() {
    generation += pow2step ;
    return n ;
 }
-const char *ghashbase::readmacrocell(char *line) {
-   int n=0 ;
-   g_uintptr_t i=1, nw=0, ne=0, sw=0, se=0, indlen=0 ;
-   int r, d ;
-   ghnode **ind = 0 ;
-   root = 0 ;
-   while (getline(line, 10000)) {
+/*
+ *   As in hlifealgo, we parse and format macrocell lines in batches
+ *   shared among the threads, and hash or write them in order.
+ */
+static const size_t MCBATCH = 65536 ;
+class ghmcparser {
+public:
+   void operator()(int, size_t lo, size_t hi) { gh->parsemc(lo, hi) ; }
+   ghashbase *gh ;
+} ;
+class ghmcformatter {
+public:
+   void operator()(int t, size_t lo, size_t hi) { gh->formatmc(t, lo, hi) ; }
+   ghashbase *gh ;
+} ;
+/*
+ *   Scan up to max unsigned numbers separated by blanks, as sscanf
+ *   would:  we return how many we got, or -1 for a blank line.
+ */
+static int scannumbers(const char *p, g_uintptr_t *v, int max) {
+   int n ;
+   for (n=0; n<max; n++) {
+      while (*p && *p <= ' ')
+         p++ ;
+      if (*p == 0)
+         return n ? n : -1 ;
+      if (*p < '0' || *p > '9')
+         return n ;
+      g_uintptr_t x = 0 ;
+      while ('0' <= *p && *p <= '9')
+         x = 10 * x + *p++ - '0' ;
+      v[n] = x ;
+   }
+   return n ;
+}
+void ghashbase::parsemc(size_t lo, size_t hi) {
+   for (size_t j=lo; j<hi; j++) {
+      mcline &m = mcbatch[j] ;
+      g_uintptr_t v[5] ;
+      int n = scannumbers(&mctext[mcstart[j]], v, 5) ;
+      m.d = 0 ;
+      m.err = 0 ;
+      if (n < 0) // blank line; permit
+         continue ;
+      if (n == 0)
+         m.err = "Parse error in macrocell format." ;
+      else if (n < 5)
+         // best not to use lifefatal here because user won't see any
+         // error message when reading clipboard data starting with "[..."
+         m.err = "Parse error in readmacrocell." ;
+      else if (v[0] < 1)
+         m.err = "Oops; bad depth in readmacrocell." ;
+      else {
+         m.d = (int)v[0] ;
+         for (int k=0; k<4; k++)
+            m.k[k] = v[k+1] ;
+      }
+   }
+}
+/*
+ *   Parse the lines we have gathered and build their nodes.
+ */
+const char *ghashbase::mcflush(ghnode **&ind, g_uintptr_t &i,
+                               g_uintptr_t &indlen) {
+   mcbatch.resize(mcstart.size()) ;
+   ghmcparser parser ;
+   parser.gh = this ;
+   threads.runslices(mcstart.size(), parser) ;
+   return mchash(ind, i, indlen) ;
+}
+/*
+ *   Build the nodes of a parsed batch, in order.
+ */
+const char *ghashbase::mchash(ghnode **&ind, g_uintptr_t &i,
+                              g_uintptr_t &indlen) {
+   const char *err = 0 ;
+   for (size_t j=0; err == 0 && j<mcbatch.size(); j++) {
+      mcline &m = mcbatch[j] ;
+      if ((err = m.err) != 0 || m.d == 0)
+         continue ;
       if (i >= indlen) {
          g_uintptr_t nlen = i + indlen + 10 ;
          ind = (ghnode **)realloc(ind, sizeof(ghnode*) * nlen) ;
@@ -1352,9 +1681,148 @@ const char *ghashbase::readmacrocell(char *line) {
          while (indlen < nlen)
             ind[indlen++] = 0 ;
       }
-      if (line[0] == '#') {
+      g_uintptr_t nw = m.k[0], ne = m.k[1], sw = m.k[2], se = m.k[3] ;
+      if (m.d == 1) {
+         if (nw >= (g_uintptr_t)maxCellStates ||
+             ne >= (g_uintptr_t)maxCellStates ||
+             sw >= (g_uintptr_t)maxCellStates ||
+             se >= (g_uintptr_t)maxCellStates)
+            err = "Cell state values too high for this algorithm." ;
+         else
+            root = ind[i++] = (ghnode *)find_ghleaf((state)nw, (state)ne,
+                                                    (state)sw, (state)se) ;
+      } else {
+         ind[0] = zeroghnode(m.d-2) ; /* allow zeros to work right */
+         if (nw >= i || ind[nw] == 0 || ne >= i || ind[ne] == 0 ||
+             sw >= i || ind[sw] == 0 || se >= i || ind[se] == 0) {
+            err = "Node out of range in readmacrocell." ;
+            continue ;
+         }
+         clearstack() ;
+         root = ind[i++] = find_ghnode(ind[nw], ind[ne], ind[sw], ind[se]) ;
+      }
+      depth = m.d - 1 ;
+   }
+   mctext.clear() ;
+   mcstart.clear() ;
+   mcbatch.clear() ;
+   return err ;
+}
+/*
+ *   The binary macrocell format is laid out just as in hlifealgo,
+ *   except that a leaf is its four states, one byte each.
+ */
+static void putvarint(std::string &s, g_uintptr_t v) {
+   while (v >= 128) {
+      s += (char)(128 | (v & 127)) ;
+      v >>= 7 ;
+   }
+   s += (char)v ;
+}
+static const char *getvarint(const unsigned char *&p, const unsigned char *e,
+                             g_uintptr_t &v) {
+   v = 0 ;
+   for (int sh=0; p<e && sh<64; sh += 7) {
+      v |= (g_uintptr_t)(*p & 127) << sh ;
+      if ((*p++ & 128) == 0)
+         return 0 ;
+   }
+   return "Truncated binary macrocell file." ;
+}
+static const char *readvarint(patternreader &reader, g_uintptr_t &v) {
+   unsigned char buf[10] ;
+   int n = 0 ;
+   while (n < 10 && reader.getbytes((char *)buf + n, 1) == 1)
+      if ((buf[n++] & 128) == 0)
+         break ;
+   const unsigned char *p = buf ;
+   return getvarint(p, buf + n, v) ;
+}
+const char *ghashbase::readmcblocks(patternreader &reader, ghnode **&ind,
+                                    g_uintptr_t &i, g_uintptr_t &indlen) {
+   const char *err = 0 ;
+   g_uintptr_t nrec, nbytes, v ;
+   for (;;) {
+      if ((err = readvarint(reader, nrec)) != 0)
+         return err ;
+      if (nrec == 0)
+         break ;
+      if ((err = readvarint(reader, nbytes)) != 0)
+         return err ;
+      if (nbytes > 64 * nrec)
+         return "Bad block in binary macrocell file." ;
+      mctext.resize(nbytes) ;
+      if (reader.getbytes(&mctext[0], (int)nbytes) != (int)nbytes)
+         return "Truncated binary macrocell file." ;
+      const unsigned char *p = (const unsigned char *)&mctext[0] ;
+      const unsigned char *e = p + nbytes ;
+      mcbatch.resize(nrec) ;
+      for (g_uintptr_t j=0; err == 0 && j<nrec; j++) {
+         mcline &m = mcbatch[j] ;
+         m.err = 0 ;
+         if ((err = getvarint(p, e, v)) != 0)
+            break ;
+         m.d = (int)v ;
+         if (v == 1) {
+            if (e - p < 4)
+               return "Truncated binary macrocell file." ;
+            for (int k=0; k<4; k++)
+               m.k[k] = *p++ ;
+         } else if (v < 1) {
+            err = "Oops; bad depth in readmacrocell." ;
+         } else {
+            for (int k=0; err == 0 && k<4; k++) {
+               err = getvarint(p, e, v) ;
+               if (v > i + j)
+                  err = "Node out of range in readmacrocell." ;
+               m.k[k] = v ? i + j - v : 0 ;
+            }
+         }
+      }
+      if (err == 0)
+         err = mchash(ind, i, indlen) ;
+      if (err)
+         return err ;
+   }
+   if ((err = readvarint(reader, v)) != 0)
+      return err ;
+   if (v >= i)
+      return "Node out of range in readmacrocell." ;
+   root = v ? ind[v] : 0 ;
+   if (root)
+      depth = ghnode_depth(root) ;
+   g_uintptr_t nframes ;
+   if ((err = readvarint(reader, nframes)) != 0)
+      return err ;
+   if (nframes > MAX_FRAME_COUNT)
+      return "Bad FRAME line" ;
+   for (g_uintptr_t f=0; f<nframes; f++) {
+      if ((err = readvarint(reader, v)) != 0)
+         return err ;
+      if (v == 0 || v >= i)
+         return "Bad FRAME line" ;
+      timeline.frames.push_back(ind[v]) ;
+      timeline.framecount++ ;
+      timeline.end = timeline.next ;
+      timeline.next += timeline.inc ;
+   }
+   return 0 ;
+}
+const char *ghashbase::readmacrocell(patternreader &reader, char *line) {
+   int n=0 ;
+   g_uintptr_t i=1, indlen=0 ;
+   ghnode **ind = 0 ;
+   const char *err = 0 ;
+   int binary = 0 ;
+   root = 0 ;
+   while (err == 0 && !binary && reader.getline(line, 10000)) {
+      if (line[0] != '#') {
+         mcstart.push_back(mctext.size()) ;
+         mctext.insert(mctext.end(), line, line + strlen(line) + 1) ;
+         if (mcstart.size() >= MCBATCH)
+            err = mcflush(ind, i, indlen) ;
+      } else if ((err = mcflush(ind, i, indlen)) == 0) {
          char *p, *pp ;
-         const char *err ;
          switch (line[1]) {
          case 'R':
             p = line + 2 ;
@@ -1366,6 +1834,14 @@ const char *ghashbase::readmacrocell(char *line) {
             if (err) return err;
             break ;
 
+         case 'B':
+            if (line[2] != 0)
+               break ;
+            // the rest is binary
+            err = readmcblocks(reader, ind, i, indlen) ;
+            binary = 1 ;
+            break ;
+
          case 'G':
             p = line + 2 ;
             while (*p && *p <= ' ') p++ ;
@@ -1434,7 +1910,7 @@ const char *ghashbase::readmacrocell(char *line) {
 	       g_uintptr_t nodeind = 0 ;
 	       n = sscanf(line+7, "%d %" PRIuPTR, &frameind, &nodeind) ;
 	       if (n != 2 || frameind > MAX_FRAME_COUNT || frameind < 0 ||
-		   nodeind > i || timeline.framecount != frameind)
+		   ind == 0 || nodeind >= i || timeline.framecount != frameind)
 		  return "Bad FRAME line" ;
 	       timeline.frames.push_back(ind[nodeind]) ;
 	       timeline.framecount++ ;
@@ -1443,47 +1919,17 @@ const char *ghashbase::readmacrocell(char *line) {
 	    }
 	    break ;
          }
-      } else {
-         n = sscanf(line, "%d %" PRIuPTR " %" PRIuPTR " %" PRIuPTR " %" PRIuPTR " %d", &d, &nw, &ne, &sw, &se, &r) ;
-         if (n < 0) // blank line; permit
-            continue ;
-         if (n == 0) {
-            // conversion error in first argument; we allow only if the only
-            // content on the line is whitespace.
-            char *ws = line ;
-            while (*ws && *ws <= ' ')
-               ws++ ;
-            if (*ws > 0)
-               return "Parse error in macrocell format." ;
-            continue ;
-         }
-         if (n < 5)
-            // best not to use lifefatal here because user won't see any
-            // error message when reading clipboard data starting with "[..."
-            return "Parse error in readmacrocell." ;
-         if (d < 1)
-            return "Oops; bad depth in readmacrocell." ;
-         if (d == 1) {
-           if (nw >= (g_uintptr_t)maxCellStates || ne >= (g_uintptr_t)maxCellStates ||
-               sw >= (g_uintptr_t)maxCellStates || se >= (g_uintptr_t)maxCellStates)
-              return "Cell state values too high for this algorithm." ;
-           root = ind[i++] = (ghnode *)find_ghleaf((state)nw, (state)ne,
-                                                   (state)sw, (state)se) ;
-           depth = d - 1 ;
-         } else {
-           ind[0] = zeroghnode(d-2) ; /* allow zeros to work right */
-           if (nw >= i || ind[nw] == 0 || ne >= i || ind[ne] == 0 ||
-               sw >= i || ind[sw] == 0 || se >= i || ind[se] == 0) {
-             return "Node out of range in readmacrocell." ;
-           }
-           clearstack() ;
-           root = ind[i++] = find_ghnode(ind[nw], ind[ne], ind[sw], ind[se]) ;
-           depth = d - 1 ;
-         }
       }
    }
+   if (err == 0)
+      err = mcflush(ind, i, indlen) ;
+   std::vector<char>().swap(mctext) ;
+   std::vector<size_t>().swap(mcstart) ;
+   std::vector<mcline>().swap(mcbatch) ;
    if (ind)
       free(ind) ;
+   if (err)
+      return err ;
    if (root == 0) {
       // allow empty macrocell pattern; note that endofpattern()
       // will be called soon so don't set hashed here
@@ -1508,17 +1954,17 @@ g_uintptr_t ghashbase::writecell(std::ostream &os, ghnode *root, int depth) {
       return 0 ;
    if (depth == 0) {
       if (root->nw != 0)
-         return (g_uintptr_t)(root->nw) ;
+         return HRAW(root->nw) ;
    } else {
       if (marked2(root))
-         return (g_uintptr_t)(root->next) ;
+         return HRAW(root->next) ;
       unhash_ghnode(root) ;
       mark2(root) ;
    }
    thiscell = ++cellcounter ;
    if (depth == 0) {
       ghleaf *n = (ghleaf *)root ;
-      root->nw = (ghnode *)thiscell ;
+      SETHRAW(root->nw, ghnode, thiscell) ;
       os << 1 << ' ' << int(n->nw) << ' ' << int(n->ne)
               << ' ' << int(n->sw) << ' ' << int(n->se) << '\n' ;
    } else {
@@ -1526,7 +1972,7 @@ g_uintptr_t ghashbase::writecell(std::ostream &os, ghnode *root, int depth) {
       g_uintptr_t ne = writecell(os, root->ne, depth-1) ;
       g_uintptr_t sw = writecell(os, root->sw, depth-1) ;
       g_uintptr_t se = writecell(os, root->se, depth-1) ;
-      root->next = (ghnode *)thiscell ;
+      SETHRAW(root->next, ghnode, thiscell) ;
       os << depth+1 << ' ' << nw << ' ' << ne
                     << ' ' << sw << ' ' << se << '\n' ;
    }
@@ -1543,10 +1989,10 @@ g_uintptr_t ghashbase::writecell_2p1(ghnode *root, int depth) {
       return 0 ;
    if (depth == 0) {
       if (root->nw != 0)
-         return (g_uintptr_t)(root->nw) ;
+         return HRAW(root->nw) ;
    } else {
       if (marked2(root))
-         return (g_uintptr_t)(root->next) ;
+         return HRAW(root->next) ;
       unhash_ghnode(root) ;
       mark2(root) ;
    }
@@ -1555,7 +2001,7 @@ g_uintptr_t ghashbase::writecell_2p1(ghnode *root, int depth) {
       // note:  we *must* not abort this prescan
       if ((cellcounter & 4095) == 0)
          lifeabortprogress(0, "Scanning tree") ;
-      root->nw = (ghnode *)thiscell ;
+      SETHRAW(root->nw, ghnode, thiscell) ;
    } else {
       writecell_2p1(root->nw, depth-1) ;
       writecell_2p1(root->ne, depth-1) ;
@@ -1565,7 +2011,7 @@ g_uintptr_t ghashbase::writecell_2p1(ghnode *root, int depth) {
       // note:  we *must* not abort this prescan
       if ((cellcounter & 4095) == 0)
          lifeabortprogress(0, "Scanning tree") ;
-      root->next = (ghnode *)thiscell ;
+      SETHRAW(root->next, ghnode, thiscell) ;
    }
    return thiscell ;
 }
@@ -1579,8 +2025,8 @@ g_uintptr_t ghashbase::writecell_2p2(std::ostream &os, ghnode *root, int depth)
    if (root == zeroghnode(depth))
       return 0 ;
    if (depth == 0) {
-      if (cellcounter + 1 != (g_uintptr_t)(root->nw))
-         return (g_uintptr_t)(root->nw) ;
+      if (cellcounter + 1 != HRAW(root->nw))
+         return HRAW(root->nw) ;
       thiscell = ++cellcounter ;
       if ((cellcounter & 4095) == 0) {
          std::streampos siz = os.tellp() ;
@@ -1588,20 +2034,19 @@ g_uintptr_t ghashbase::writecell_2p2(std::ostream &os, ghnode *root, int depth)
          lifeabortprogress(thiscell/(double)writecells, progressmsg) ;
       }
       ghleaf *n = (ghleaf *)root ;
-      root->nw = (ghnode *)thiscell ;
-      os << 1 << ' ' << int(n->nw) << ' ' << int(n->ne)
-              << ' ' << int(n->sw) << ' ' << int(n->se) << '\n';
+      SETHRAW(root->nw, ghnode, thiscell) ;
+      queuemc(os, 1, n->nw, n->ne, n->sw, n->se) ;
    } else {
-      if (cellcounter + 1 > (g_uintptr_t)(root->next) || isaborted())
-         return (g_uintptr_t)(root->next) ;
+      if (cellcounter + 1 > HRAW(root->next) || isaborted())
+         return HRAW(root->next) ;
       g_uintptr_t nw = writecell_2p2(os, root->nw, depth-1) ;
       g_uintptr_t ne = writecell_2p2(os, root->ne, depth-1) ;
       g_uintptr_t sw = writecell_2p2(os, root->sw, depth-1) ;
       g_uintptr_t se = writecell_2p2(os, root->se, depth-1) ;
       if (!isaborted() &&
-          cellcounter + 1 != (g_uintptr_t)(root->next)) { // this should never happen
+          cellcounter + 1 != HRAW(root->next)) { // this should never happen
          lifefatal("Internal in writecell_2p2") ;
-         return (g_uintptr_t)(root->next) ;
+         return HRAW(root->next) ;
       }
       thiscell = ++cellcounter ;
       if ((cellcounter & 4095) == 0) {
@@ -1609,17 +2054,96 @@ g_uintptr_t ghashbase::writecell_2p2(std::ostream &os, ghnode *root, int depth)
          sprintf(progressmsg, "File size: %.2f MB", double(siz) / 1048576.0) ;
          lifeabortprogress(thiscell/(double)writecells, progressmsg) ;
       }
-      root->next = (ghnode *)thiscell ;
-      os << depth+1 << ' ' << nw << ' ' << ne
-                    << ' ' << sw << ' ' << se << '\n' ;
+      SETHRAW(root->next, ghnode, thiscell) ;
+      queuemc(os, depth+1, nw, ne, sw, se) ;
    }
    return thiscell ;
 }
+void ghashbase::queuemc(std::ostream &os, int d, g_uintptr_t nw,
+                        g_uintptr_t ne, g_uintptr_t sw, g_uintptr_t se) {
+   mcline m ;
+   m.d = d ;
+   m.k[0] = nw ;
+   m.k[1] = ne ;
+   m.k[2] = sw ;
+   m.k[3] = se ;
+   mcbatch.push_back(m) ;
+   if (mcbatch.size() >= MCBATCH)
+      writemc(os) ;
+}
+static char *putnumber(char *p, g_uintptr_t v) {
+   char buf[24] ;
+   int n = 0 ;
+   do {
+      buf[n++] = (char)('0' + v % 10) ;
+      v /= 10 ;
+   } while (v) ;
+   while (n > 0)
+      *p++ = buf[--n] ;
+   return p ;
+}
+void ghashbase::formatmc(int t, size_t lo, size_t hi) {
+   std::string &out = mcout[t] ;
+   out.clear() ;
+   char line[128] ;
+   for (size_t j=lo; j<hi; j++) {
+      mcline &m = mcbatch[j] ;
+      if (mcbinary) {
+         putvarint(out, m.d) ;
+         for (int k=0; k<4; k++)
+            if (m.d == 1)
+               out += (char)m.k[k] ;
+            else
+               putvarint(out, m.k[k] ? mcbase + j - m.k[k] : 0) ;
+         continue ;
+      }
+      char *p = putnumber(line, m.d) ;
+      for (int k=0; k<4; k++) {
+         *p++ = ' ' ;
+         p = putnumber(p, m.k[k]) ;
+      }
+      *p++ = '\n' ;
+      out.append(line, p - line) ;
+   }
+}
+/*
+ *   Format the queued lines and write them out.
+ */
+void ghashbase::writemc(std::ostream &os) {
+   if (mcbatch.empty())
+      return ;
+   mcout.resize(threads.getthreads()) ;
+   mcbase = cellcounter + 1 - mcbatch.size() ;
+   ghmcformatter formatter ;
+   formatter.gh = this ;
+   threads.runslices(mcbatch.size(), formatter) ;
+   if (mcbinary) {
+      size_t nbytes = 0 ;
+      for (size_t t=0; t<mcout.size(); t++)
+         nbytes += mcout[t].size() ;
+      std::string head ;
+      putvarint(head, mcbatch.size()) ;
+      putvarint(head, nbytes) ;
+      os.write(head.data(), head.size()) ;
+   }
+   for (size_t t=0; t<mcout.size(); t++)
+      os.write(mcout[t].data(), mcout[t].size()) ;
+   mcbatch.clear() ;
+}
 #define STRINGIFY(arg) STR2(arg)
 #define STR2(arg) #arg
+const char *ghashbase::writeNativeBinary(std::ostream &os, char *comments) {
+   mcbinary = 1 ;
+   const char *err = writeNativeFormat(os, comments) ;
+   mcbinary = 0 ;
+   return err ;
+}
 const char *ghashbase::writeNativeFormat(std::ostream &os, char *comments) {
    int depth = ghnode_depth(root) ;
-   os << "[M2] (golly " STRINGIFY(VERSION) ")\n" ;
+   if (mcbinary)
+      os << "[MB1] (golly " STRINGIFY(VERSION) ")\n" ;
+   else
+      os << "[M2] (golly " STRINGIFY(VERSION) ")\n" ;
    
    // AKT: always write out explicit rule
    os << "#R " << getrule() << '\n' ;
@@ -1675,26 +2199,48 @@ const char *ghashbase::writeNativeFormat(std::ostream &os, char *comments) {
    writecell_2p1(root, depth) ;
    writecells = cellcounter ;
    cellcounter = 0 ;
-   if (framestosave) {
+   if (framestosave)
       os << "#FRAMES"
          << ' ' << timeline.framecount
          << ' ' << timeline.start.tostring()
          << ' ' << timeline.base << '^' << timeline.expo << '\n' ;
+   if (mcbinary)
+      os << "#B\n" ;
+   if (framestosave) {
       for (int i=0; i<timeline.framecount; i++) {
          ghnode *frame = (ghnode*)timeline.frames[i] ;
          writecell_2p2(os, frame, depths[i]) ;
-         os << "#FRAME " << i << ' ' << (g_uintptr_t)frame->next << '\n' ;
+         writemc(os) ;
+         if (!mcbinary)
+            os << "#FRAME " << i << ' ' << HRAW(frame->next) << '\n' ;
       }
    }
    writecell_2p2(os, root, depth) ;
+   writemc(os) ;
+   if (mcbinary) {
+      std::string tail ;
+      putvarint(tail, 0) ;
+      if (root == zeroghnode(depth))
+         putvarint(tail, 0) ;
+      else if (depth == 0)
+         putvarint(tail, HRAW(root->nw)) ;
+      else
+         putvarint(tail, HRAW(root->next)) ;
+      putvarint(tail, framestosave) ;
+      for (int i=0; i<framestosave; i++)
+         putvarint(tail, HRAW(((ghnode *)timeline.frames[i])->next)) ;
+      os.write(tail.data(), tail.size()) ;
+   }
+   std::vector<mcline>().swap(mcbatch) ;
+   std::vector<std::string>().swap(mcout) ;
    /* end new two-pass way */
    if (framestosave) {
      for (int i=0; i<timeline.framecount; i++) {
        ghnode *frame = (ghnode*)timeline.frames[i] ;
-       aftercalcpop2(frame, depths[i], 0) ;
+       aftercalcpop2(frame, depths[i]) ;
      }
    }
-   aftercalcpop2(root, depth, 0) ;
+   aftercalcpop2(root, depth) ;
    inGC = 0 ;
    return 0 ;
 }
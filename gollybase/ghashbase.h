@@ -25,6 +25,10 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #define GHASHBASE_H
 #include "lifealgo.h"
 #include "liferules.h"
+#include "nodearena.h"
+#include "lifethreads.h"
+#include <deque>
+#include <string>
 /*
  *   This class forms the basis of all hashlife-type algorithms except
  *   the highly-optimized hlifealgo (which is most appropriate for
@@ -39,16 +43,17 @@ typedef unsigned char state ;
  *   Nodes, like the standard hlifealgo nodes.
  */
 struct ghnode {
-   ghnode *next ;              /* hash link */
-   ghnode *nw, *ne, *sw, *se ; /* constant; nw != 0 means nonjleaf */
-   ghnode *res ;               /* cache */
+   NODEREF(ghnode) next ;             /* hash link */
+   NODEREF(ghnode) nw, ne, sw, se ;   /* constant; nw != 0 means nonjleaf */
+   NODEREF(ghnode) res ;              /* cache */
 } ;
 /*
- *   Leaves, like the standard hlifealgo leaves.
+ *   Leaves, like the standard hlifealgo leaves.  (Like them, too, the
+ *   links are handles if we are using compact nodes; see nodearena.h.)
  */
 struct ghleaf {
-   ghnode *next ;              /* hash link */
-   ghnode *isghnode ;          /* must always be zero for leaves */
+   NODEREF(ghnode) next ;      /* hash link */
+   NODEREF(ghnode) isghnode ;  /* must always be zero for leaves */
    state nw, ne, sw, se ;      /* constant */
    unsigned short leafpop ;    /* how many set bits */
 } ;
@@ -56,7 +61,7 @@ struct ghleaf {
  *   If it is a struct ghnode, this returns a non-zero value, otherwise it
  *   returns a zero value.
  */
-#define is_ghnode(n) (((ghnode *)(n))->nw)
+#define is_ghnode(n) (HRAW(((ghnode *)(n))->nw))
 /**
  *   Our ghashbase class.  Note that this is an abstract class; you need
  *   to expand specific methods to specialize it for a particular multi-state
@@ -70,6 +75,13 @@ public:
    //  This should be overridden by a deriving class.
    virtual state slowcalc(state nw, state n, state ne, state w, state c,
                           state e, state sw, state s, state se) = 0 ;
+   //  The same for a whole block of cells:  in holds wd+2 by ht+2
+   //  states, rows stride apart, and we fill in the next state of each
+   //  of the wd by ht cells inside it, at out (also stride apart).
+   //  This version just calls slowcalc for each cell;  algorithms that
+   //  derive from ghashcalc (below) get one that does so non-virtually.
+   virtual void slowcalcs(const state *in, state *out, int stride,
+                          int wd, int ht) ;
    // note that for ghashbase, clearall() releases no memory; it retains
    // the full cache information but just sets the current pattern to
    // the empty pattern.
@@ -77,6 +89,10 @@ public:
    virtual int setcell(int x, int y, int newstate) ;
    virtual int getcell(int x, int y) ;
    virtual int nextcell(int x, int y, int &v) ;
+   virtual void getstrip(int x, int y, int wd, int ht, unsigned char *states) ;
+   virtual int putstrip(int x, int y, int wd, int ht,
+                        const unsigned char *states) ;
+   virtual void clearstrip(int x, int y, int wd, int ht) ;
    virtual void endofpattern() ;
    virtual void setIncrement(bigint inc) ;
    virtual void setIncrement(int inc) { setIncrement(bigint(inc)) ; }
@@ -85,6 +101,9 @@ public:
    virtual int isEmpty() ;
    virtual int hyperCapable() { return 1 ; }
    virtual void setMaxMemory(int m) ;
+   // we only use the threads for reading and writing macrocell files
+   virtual void setMaxThreads(int n) { threads.setthreads(n) ; }
+   virtual int getMaxThreads() { return threads.getthreads() ; }
    virtual int getMaxMemory() { return (int)(maxmem >> 20) ; }
    virtual const char *setrule(const char *) ;
    virtual const char *getrule() { return "" ; }
@@ -94,14 +113,17 @@ public:
    /*
     *   The contract of draw() is that it render every pixel in the
     *   viewport precisely once.  This allows us to eliminate all
-    *   flashing.  Later we'll make this be damage-specific.
+    *   flashing.  If the renderer asks for it (see damagemode), tiles
+    *   whose covering node is unchanged since the last frame are not
+    *   rebuilt, or not even reblitted.
     */
    virtual void draw(viewport &view, liferender &renderer) ;
    virtual void fit(viewport &view, int force) ;
    virtual void lowerRightPixel(bigint &x, bigint &y, int mag) ;
    virtual void findedges(bigint *t, bigint *l, bigint *b, bigint *r) ;
-   virtual const char *readmacrocell(char *line) ;
+   virtual const char *readmacrocell(patternreader &reader, char *line) ;
    virtual const char *writeNativeFormat(std::ostream &os, char *comments) ;
+   virtual const char *writeNativeBinary(std::ostream &os, char *comments) ;
    static void doInitializeAlgoInfo(staticAlgoInfo &) ;
    
 private:
@@ -138,18 +160,30 @@ private:
    g_uintptr_t totalthings ;
    ghnode *ghnodeblocks ;
    bigint population ;
+   std::deque<bigint> popcounts ;
    bigint setincrement ;
    bigint pow2step ; // greatest power of two in increment
    int nonpow2 ; // increment / pow2step
    int ngens ; // log2(pow2step)
+   int squarehits, squaremisses, squareflat ; // see dorecurs_square
    int popValid, needPop, inGC ;
+   /*
+    *   Cell counts for density drawing.  Hashed ghnodes never change, so
+    *   the counts are kept from frame to frame, in a small open-addressed
+    *   table, until a gc might free the ghnodes.
+    */
+   std::vector<std::pair<ghnode *, double> > drawpops ;
+   g_uintptr_t drawpopcount ;
+   int drawpopgc ;
    /*
     *   When rendering we store the relevant bits here rather than
     *   passing them deep into recursive subroutines.
     */
    liferender *renderer ;
+   damagecache damage ;   // tiles drawn last frame, keyed by node
    viewport *view ;
    int uviewh, uvieww, viewh, vieww, mag, pmag ;
+   int density ;          // shade zoomed-out pixels by population
    int llbits, llsize ;
    char *llxb, *llyb ;
    int hashed ;
@@ -169,6 +203,10 @@ private:
    ghnode *dorecurs(ghnode *n, ghnode *ne, ghnode *t, ghnode *e, int depth) ;
    ghnode *dorecurs_half(ghnode *n, ghnode *ne, ghnode *t, ghnode *e, int depth) ;
    ghleaf *dorecurs_ghleaf(ghleaf *n, ghleaf *ne, ghleaf *t, ghleaf *e) ;
+   ghnode *dorecurs_square(ghnode *n, int gens) ;
+   int usesquares() ;
+   void getsquare(ghnode *n, int size, state *g, int stride) ;
+   ghnode *makesquare(const state *g, int size, int stride) ;
    ghnode *newghnode() ;
    ghleaf *newghleaf() ;
    ghnode *newclearedghnode() ;
@@ -180,10 +218,17 @@ private:
    ghnode *setbit(ghnode *n, int x, int y, int newstate, int depth) ;
    int getbit(ghnode *n, int x, int y, int depth) ;
    int nextbit(ghnode *n, int x, int y, int depth, int &v) ;
+   void stripget(ghnode *n, int d, G_INT64 x, G_INT64 y, const G_INT64 *box,
+                 unsigned char *states) ;
+   ghnode *stripput(ghnode *n, int d, G_INT64 x, G_INT64 y,
+                    const G_INT64 *box, const unsigned char *states) ;
+   ghnode *stripcenter(ghnode *n, int d, const G_INT64 *box,
+                       const unsigned char *states) ;
+   void stripwrite(int x, int y, int wd, int ht, const unsigned char *states) ;
    ghnode *hashpattern(ghnode *root, int depth) ;
    ghnode *popzeros(ghnode *n) ;
    const bigint &calcpop(ghnode *root, int depth) ;
-   void aftercalcpop2(ghnode *root, int depth, int cleanbigints) ;
+   void aftercalcpop2(ghnode *root, int depth) ;
    void calcPopulation(ghnode *root) ;
    ghnode *save(ghnode *n) ;
    void pop(int n) ;
@@ -196,17 +241,71 @@ private:
    int log2(unsigned int n) ;
    ghnode *runpattern() ;
    void clearrect(int x, int y, int w, int h) ;
-   void renderbm(int x, int y) ;
+   void renderbm(int x, int y, const void *key, int keylen) ;
    void fill_ll(int d) ;
    void drawghnode(ghnode *n, int llx, int lly, int depth, ghnode *z) ;
+   double cellcount(ghnode *n, int depth) ;
+   double popfraction(ghnode *n, int depth) ;
    void ensure_hashed() ;
    g_uintptr_t writecell(std::ostream &os, ghnode *root, int depth) ;
    g_uintptr_t writecell_2p1(ghnode *root, int depth) ;
    g_uintptr_t writecell_2p2(std::ostream &os, ghnode *root, int depth) ;
+   /*
+    *   Macrocell lines go through these in batches, so the threads can
+    *   share the parsing and formatting; d is 0 for a line to skip, or
+    *   the depth as written in the file (1 for a leaf, with k holding
+    *   its four states).
+    */
+   struct mcline {
+      int d ;
+      g_uintptr_t k[4] ;
+      const char *err ;
+   } ;
+   std::vector<mcline> mcbatch ;
+   std::vector<char> mctext ;
+   std::vector<size_t> mcstart ;
+   std::vector<std::string> mcout ;
+   int mcbinary ;          // writing the binary format?
+   g_uintptr_t mcbase ;    // number of the first node in mcbatch
+   lifethreads threads ;
+   friend class ghmcparser ;
+   friend class ghmcformatter ;
+   const char *mcflush(ghnode **&ind, g_uintptr_t &i, g_uintptr_t &indlen) ;
+   const char *mchash(ghnode **&ind, g_uintptr_t &i, g_uintptr_t &indlen) ;
+   const char *readmcblocks(patternreader &reader, ghnode **&ind,
+                            g_uintptr_t &i, g_uintptr_t &indlen) ;
+   void parsemc(size_t lo, size_t hi) ;
+   void formatmc(int t, size_t lo, size_t hi) ;
+   void queuemc(std::ostream &os, int d, g_uintptr_t nw, g_uintptr_t ne,
+                g_uintptr_t sw, g_uintptr_t se) ;
+   void writemc(std::ostream &os) ;
    void drawpixel(int x, int y);
    void draw4x4_1(state sw, state se, state nw, state ne, int llx, int lly) ;
    void draw4x4_1(ghnode *n, ghnode *z, int llx, int lly) ;
    // AKT: set all pixels to background color
    void killpixels();
 } ;
+/**
+ *   Most algorithms derive from ghashcalc<themselves> rather than from
+ *   ghashbase directly.  All it adds is a slowcalcs that calls the
+ *   algorithm's own slowcalc by name, so it is not a virtual call and
+ *   the rule lookup can be inlined into the loop.  The loop is expanded
+ *   where the algorithm's constructor is (along with its vtable), which
+ *   is the source file that defines its slowcalc.
+ */
+template <class algo> class ghashcalc : public ghashbase {
+public:
+   virtual void slowcalcs(const state *in, state *out, int stride,
+                          int wd, int ht) {
+      algo *me = static_cast<algo *>(this) ;
+      for (int y=0; y<ht; y++) {
+         const state *a = in + y * stride, *b = a + stride, *c = b + stride ;
+         state *r = out + y * stride ;
+         for (int x=0; x<wd; x++)
+            r[x] = me->algo::slowcalc(a[x], a[x+1], a[x+2],
+                                      b[x], b[x+1], b[x+2],
+                                      c[x], c[x+1], c[x+2]) ;
+      }
+   }
+} ;
 #endif
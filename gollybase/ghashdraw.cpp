@@ -31,6 +31,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <cstring>
 #include <cstdio>
 #include <algorithm>
+#include <cmath>
 using namespace std ;
 
 // AKT: a 256x256 pixmap is good for OpenGL and matches the size
@@ -55,6 +56,9 @@ static unsigned char* cellblue;
 static unsigned char deada;
 static unsigned char livea;
 
+// colors for the density levels, from dead to state 1
+static unsigned char ramp[256][4] ;
+
 void ghashbase::drawpixel(int x, int y) {
    // AKT: draw all live cells using state 1 color
    // pmag == 1, so store RGBA info
@@ -65,6 +69,63 @@ void ghashbase::drawpixel(int x, int y) {
    pixbuf[i+3] = livea;
 }
 
+static void graypixel(int x, int y, double frac) {
+   int level = densitylevel(frac) ;
+   if (level)
+      memcpy(pixbuf + (pmsize-1-y) * rowoff + x*bpp, ramp[level], bpp) ;
+}
+
+/*
+ *   How many live cells in a ghnode?  Counts of ghnodes above the
+ *   leaves are looked up in (and added to) drawpops.  The table may
+ *   use up to a sixteenth of the memory limit; past that we just
+ *   count again.
+ */
+static g_uintptr_t pophome(ghnode *n, g_uintptr_t mask) {
+   return ((g_uintptr_t)n / sizeof(ghnode)) * 2654435761U & mask ;
+}
+
+double ghashbase::cellcount(ghnode *n, int depth) {
+   if (depth == 0)
+      return ((ghleaf *)n)->leafpop ;
+   if (n == zeroghnode(depth))
+      return 0 ;
+   g_uintptr_t mask = drawpops.size() - 1, h ;
+   if (drawpops.size())
+      for (h=pophome(n, mask); drawpops[h].first; h=(h+1)&mask)
+         if (drawpops[h].first == n)
+            return drawpops[h].second ;
+   depth-- ;
+   double r = cellcount(n->nw, depth) + cellcount(n->ne, depth) +
+              cellcount(n->sw, depth) + cellcount(n->se, depth) ;
+   if (2 * (drawpopcount + 1) > drawpops.size()) {
+      g_uintptr_t size = drawpops.size() ? 2 * drawpops.size() : 4096 ;
+      if (size * sizeof(drawpops[0]) > maxmem / 16)
+         return r ;
+      std::vector<std::pair<ghnode *, double> > old(size) ;
+      old.swap(drawpops) ;
+      mask = size - 1 ;
+      for (g_uintptr_t i=0; i<old.size(); i++) {
+         if (old[i].first == 0)
+            continue ;
+         for (h=pophome(old[i].first, mask); drawpops[h].first; h=(h+1)&mask)
+            ;
+         drawpops[h] = old[i] ;
+      }
+   }
+   // the counts below may have grown the table, so look for a slot now
+   mask = drawpops.size() - 1 ;
+   for (h=pophome(n, mask); drawpops[h].first; h=(h+1)&mask)
+      ;
+   drawpops[h] = std::make_pair(n, r) ;
+   drawpopcount++ ;
+   return r ;
+}
+
+double ghashbase::popfraction(ghnode *n, int depth) {
+   return ldexp(cellcount(n, depth), -2 * (depth + 1)) ;
+}
+
 /*
  *   Draw a 4x4 area yielding 1x1, 2x2, or 4x4 pixels.
  */
@@ -175,8 +236,8 @@ void ghashbase::killpixels() {
    }
 }
 
-void ghashbase::renderbm(int x, int y) {
-   // x,y is lower left corner
+void ghashbase::renderbm(int x, int y, const void *key, int keylen) {
+   // x,y is lower left corner; key says what the pixmap shows
    int rx = x ;
    int ry = y ;
    int rw = pmsize ;
@@ -188,7 +249,7 @@ void ghashbase::renderbm(int x, int y) {
       rh *= pmag ;
    }
    ry = uviewh - ry - rh ;
-   renderer->pixblit(rx, ry, rw, rh, pixbuf, pmag);
+   damage.blit(x, y, rx, ry, rw, rh, pixbuf, pmag, key, keylen) ;
    killpixels();
 }
 
@@ -209,11 +270,15 @@ void ghashbase::drawghnode(ghnode *n, int llx, int lly, int depth, ghnode *z) {
       sw >>= 1 ;
       depth-- ;
       if (sw == (pmsize >> 1)) {
+         // n fills exactly one pixmap, so if the same ghnode was here
+         // last frame the pixmap hasn't changed
+         if (damage.reuse(-llx, -lly, &n, sizeof(n)))
+            return ;
          drawghnode(n->sw, 0, 0, depth, z) ;
          drawghnode(n->se, -(pmsize/2), 0, depth, z) ;
          drawghnode(n->nw, 0, -(pmsize/2), depth, z) ;
          drawghnode(n->ne, -(pmsize/2), -(pmsize/2), depth, z) ;
-         renderbm(-llx, -lly) ;
+         renderbm(-llx, -lly, &n, sizeof(n)) ;
       } else {
          drawghnode(n->sw, llx, lly, depth, z) ;
          drawghnode(n->se, llx-sw, lly, depth, z) ;
@@ -221,9 +286,19 @@ void ghashbase::drawghnode(ghnode *n, int llx, int lly, int depth, ghnode *z) {
          drawghnode(n->ne, llx-sw, lly-sw, depth, z) ;
       }
    } else if (depth > 0 && sw == 2) {
-      draw4x4_1(n, z->nw, llx, lly) ;
+      if (density) {
+         graypixel(-llx, -lly, popfraction(n->sw, depth-1)) ;
+         graypixel(1-llx, -lly, popfraction(n->se, depth-1)) ;
+         graypixel(-llx, 1-lly, popfraction(n->nw, depth-1)) ;
+         graypixel(1-llx, 1-lly, popfraction(n->ne, depth-1)) ;
+      } else {
+         draw4x4_1(n, z->nw, llx, lly) ;
+      }
    } else if (sw == 1) {
-      drawpixel(-llx, -lly) ;
+      if (density)
+         graypixel(-llx, -lly, popfraction(n, depth)) ;
+      else
+         drawpixel(-llx, -lly) ;
    } else {
       struct ghleaf *l = (struct ghleaf *)n ;
       sw >>= 1 ;
@@ -302,6 +377,28 @@ void ghashbase::draw(viewport &viewarg, liferender &rendererarg) {
 
    // AKT: must call killpixels after setting pmag
    killpixels();
+   // density shading needs the counts, which a gc could invalidate
+   density = (mag > 0 && !inGC && renderer->wantsdensity()) ;
+   if (density) {
+      unsigned char live[] = { cellred[1], cellgreen[1], cellblue[1], livea } ;
+      unsigned char dead[] = { cellred[0], cellgreen[0], cellblue[0], deada } ;
+      densityramp(live, dead, ramp) ;
+      if (drawpopgc != gccount) {
+         drawpops.clear() ;
+         drawpopcount = 0 ;
+         drawpopgc = gccount ;
+      }
+   }
+   // the pixmaps depend on the colors of every state; ghnode pointers
+   // are only stable keys until the next gc
+   int frame[] = { uvieww, uviewh, mag, pmag, deada, livea, density } ;
+   string colors((const char *)frame, sizeof(frame)) ;
+   colors.append((const char *)cellred, maxCellStates) ;
+   colors.append((const char *)cellgreen, maxCellStates) ;
+   colors.append((const char *)cellblue, maxCellStates) ;
+   unsigned char dead[] = { cellred[0], cellgreen[0], cellblue[0], deada } ;
+   damage.beginframe(renderer, colors.data(), (int)colors.size(),
+                     gccount, dead) ;
 
    int d = depth ;
    fill_ll(d) ;
@@ -309,6 +406,7 @@ void ghashbase::draw(viewport &viewarg, liferender &rendererarg) {
    int i ;
    ghnode *z = zeroghnode(d) ;
    ghnode *sw = root, *nw = z, *ne = z, *se = z ;
+   ghnode *key[4] ;
    if (viewh > maxd)
       maxd = viewh ;
    int llx=-llxb[llbits-1], lly=-llyb[llbits-1] ;
@@ -370,19 +468,30 @@ void ghashbase::draw(viewport &viewarg, liferender &rendererarg) {
           (sw == z && se == z && nw == z && ne == z)) {
          // no live cells
       } else {
-         drawpixel(0, 0) ;
-         renderbm(-llx, -lly) ;
+         key[0] = sw ; key[1] = se ; key[2] = nw ; key[3] = ne ;
+         if (!damage.reuse(-llx, -lly, key, sizeof(key))) {
+            if (density)
+               graypixel(0, 0, ldexp(popfraction(sw, d) + popfraction(se, d) +
+                                     popfraction(nw, d) + popfraction(ne, d),
+                                     2 * (d + 1 - mag))) ;
+            else
+               drawpixel(0, 0) ;
+            renderbm(-llx, -lly, key, sizeof(key)) ;
+         }
       }
    } else {
       z = zeroghnode(d) ;
       maxd = 1 << (d - mag + 2) ;
       if (maxd <= pmsize) {
-         maxd >>= 1 ;
-         drawghnode(sw, 0, 0, d, z) ;
-         drawghnode(se, -maxd, 0, d, z) ;
-         drawghnode(nw, 0, -maxd, d, z) ;
-         drawghnode(ne, -maxd, -maxd, d, z) ;
-         renderbm(-llx, -lly) ;
+         key[0] = sw ; key[1] = se ; key[2] = nw ; key[3] = ne ;
+         if (!damage.reuse(-llx, -lly, key, sizeof(key))) {
+            maxd >>= 1 ;
+            drawghnode(sw, 0, 0, d, z) ;
+            drawghnode(se, -maxd, 0, d, z) ;
+            drawghnode(nw, 0, -maxd, d, z) ;
+            drawghnode(ne, -maxd, -maxd, d, z) ;
+            renderbm(-llx, -lly, key, sizeof(key)) ;
+         }
       } else {
          maxd >>= 1 ;
          drawghnode(sw, llx, lly, d, z) ;
@@ -392,6 +501,7 @@ void ghashbase::draw(viewport &viewarg, liferender &rendererarg) {
       }
    }
 bail:
+   damage.endframe() ;
    renderer = 0 ;
    view = 0 ;
 }
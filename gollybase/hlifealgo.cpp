@@ -37,22 +37,22 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "util.h"
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include <iostream>
+#include <chrono>
+#include <sstream>
+#include <algorithm>
 using namespace std ;
 /*
- *   Prime hash sizes tend to work best.
+ *   When the leaf kernel can handle the rule we normally let it compute
+ *   32-squares whole (see kernel_node below); on regular patterns the
+ *   memoized 16-squares are about as fast, so this can be turned off.
  */
-static g_uintptr_t nextprime(g_uintptr_t i) {
-   g_uintptr_t j ;
-   i |= 1 ;
-   for (;; i+=2) {
-      for (j=3; j*j<=i; j+=2)
-         if (i % j == 0)
-            break ;
-      if (j*j > i)
-         return i ;
-   }
-}
+#ifdef NOBIGLEAVES
+#define BIGLEAVES (0)
+#else
+#define BIGLEAVES (1)
+#endif
 /*
  *   Note that all the places we represent 4-squares by short, we use
  *   unsigned shorts; this is so we can directly index into these arrays.
@@ -92,6 +92,12 @@ static unsigned char shortpop[65536] ;
        (((t10) << 7) & 0x880) | ((t11) << 5) | (((t12) << 3) & 0x110) | \
        (((t20) >> 1) & 0x8) | ((t21) >> 3) | ((t22) >> 5)
 void hlifealgo::leafres(leaf *n) {
+   n->leafpop = shortpop[n->nw] + shortpop[n->ne] +
+                shortpop[n->sw] + shortpop[n->se] ;
+   if (kernel.usable()) {
+      kernel.leafres(n->nw, n->ne, n->sw, n->se, n->res1, n->res2) ;
+      return ;
+   }
    unsigned short
    t00 = ruletable[n->nw],
    t01 = ruletable[((n->nw << 2) & 0xcccc) | ((n->ne >> 2) & 0x3333)],
@@ -109,96 +115,214 @@ void hlifealgo::leafres(leaf *n) {
    (ruletable[(t01 << 10) | (t02 << 8) | (t11 << 2) | t12] << 8) |
    (ruletable[(t10 << 10) | (t11 << 8) | (t20 << 2) | t21] << 2) |
     ruletable[(t11 << 10) | (t12 << 8) | (t21 << 2) | t22] ;
-   n->leafpop = shortpop[n->nw] + shortpop[n->ne] +
-                shortpop[n->sw] + shortpop[n->se] ;
 }
 /*
  *   We do now support garbage collection, but there are some routines we
  *   call frequently to help us.
  */
-#define node_hash(a,b,c,d) (65537*(g_uintptr_t)(d)+257*(g_uintptr_t)(c)+17*(g_uintptr_t)(b)+5*(g_uintptr_t)(a))
+#define node_hash(a,b,c,d) (65537*(g_uintptr_t)(node *)(d)+257*(g_uintptr_t)(node *)(c)+17*(g_uintptr_t)(node *)(b)+5*(g_uintptr_t)(node *)(a))
 #define leaf_hash(a,b,c,d) (65537*(d)+257*(c)+17*(b)+5*(a))
 /*
- *   Resize the hash.
+ *   The table size is a power of two, so we stir the hash (the low bits
+ *   of node pointers are always zero) before taking the bucket from the
+ *   low bits.  The fingerprint comes from the top bits; it is never
+ *   zero, since that marks an empty slot.
+ */
+static inline g_uintptr_t hashmix(g_uintptr_t h) {
+   h *= (g_uintptr_t)0x9e3779b97f4a7c15ULL ;
+   return h ^ (h >> (4 * sizeof(g_uintptr_t))) ;
+}
+#define hashfp(h) ((unsigned char)((h) >> (8 * sizeof(g_uintptr_t) - 8)) | 1)
+/*
+ *   Free nodes are linked through nw.  We clear sw and res too, so that
+ *   a free node never looks marked to do_gc(), whether it reads it as
+ *   a node or (when nw is zero) as a leaf.
+ */
+#define nextfree(p) ((p)->nw)
+#ifdef COMPACTNODES
+#define setfree(p, link) ((p)->sw = 0, (p)->res = 0, (p)->flags = 0, \
+                          (p)->nw = (link))
+#else
+#define setfree(p, link) ((p)->sw = 0, (p)->res = 0, (p)->nw = (link))
+#endif
+/*
+ *   The collectors mark nodes with bit 1 of the cache field (bit 0 is
+ *   taken by the tree walks below) and leaves with a field of their
+ *   own.  Anything that reads or writes the cache field of a node must
+ *   use resof() and setres() so it neither sees nor loses that bit.
+ *   Compact nodes have a flags word for these bits instead, so there
+ *   the cache field is just the cache field.
+ */
+/*
+ *   While we step in parallel, getres() reads and sets the cache field
+ *   with acquire and release ordering, so another thread that finds a
+ *   result there also sees the result's fields (see nodearena.h).
+ */
+#ifdef COMPACTNODES
+#define RESMARK (2U)
+#define resof(n) ((node *)(n)->res)
+#define setres(n,r) ((n)->res = (r))
+#define resof_acquire(n) ((n)->res.load(std::memory_order_acquire))
+#define setres_release(n,r) ((n)->res.store((r), std::memory_order_release))
+#define resmarked(n) (RESMARK & (n)->flags)
+#define markres(n) ((n)->flags |= RESMARK)
+#define unmarkres(n) ((n)->flags &= ~RESMARK)
+#else
+#define RESMARK ((g_uintptr_t)2)
+#define RESRAW(n) ((n)->res.loadraw(std::memory_order_relaxed))
+#define SETRESRAW(n,v,o) ((n)->res.storeraw((v), (o)))
+#define resof(n) ((node *)(~RESMARK & RESRAW(n)))
+#define setres(n,r) SETRESRAW(n, (RESMARK & RESRAW(n)) | (g_uintptr_t)(r), \
+                              std::memory_order_relaxed)
+#define resof_acquire(n) \
+      ((node *)(~RESMARK & (n)->res.loadraw(std::memory_order_acquire)))
+#define setres_release(n,r) SETRESRAW(n, (RESMARK & RESRAW(n)) | \
+                              (g_uintptr_t)(r), std::memory_order_release)
+#define resmarked(n) (RESMARK & RESRAW(n))
+#define markres(n) SETRESRAW(n, RESMARK | RESRAW(n), std::memory_order_relaxed)
+#define unmarkres(n) ((n)->res = resof(n))
+#endif
+#define gcmarked(n) (is_node(n) ? resmarked(n) : ((leaf *)(n))->gcmark)
+/*
+ *   How much marking or sweeping (in nodes) we do at a time, and how
+ *   long (in seconds) a gc may take before we stop doing them all at
+ *   once and switch to doing them a slice at a time.  Incremental gc
+ *   costs more overall (it can't just rebuild the hash at the end), so
+ *   we only use it when the pauses would be noticed.
+ */
+static const g_uintptr_t GCSLICE = 4096 ;
+static const double GCSTALL = 0.05 ;
+/*
+ *   Make a new, empty hash table, and work out how full we let it get
+ *   before we grow it.  We always stop a little short of completely
+ *   full so lookups stay quick and always terminate.
+ */
+int hlifealgo::newhash(g_uintptr_t nbuckets) {
+   void *mem = calloc(nbuckets + 1, sizeof(hashbucket)) ;
+   if (mem == 0)
+      return 0 ;
+   hashmem = mem ;
+   hashtab = (hashbucket *)(((g_uintptr_t)hashmem + sizeof(hashbucket) - 1) &
+                            ~(g_uintptr_t)(sizeof(hashbucket) - 1)) ;
+   hashbuckets = nbuckets ;
+   hashmask = nbuckets - 1 ;
+   sethashlimits() ;
+   return 1 ;
+}
+void hlifealgo::sethashlimits() {
+   hashlimit = hashbuckets * HASHSLOTS / 4 * 3 ;
+   hashfull = hashbuckets * HASHSLOTS - hashbuckets * HASHSLOTS / 16 ;
+}
+/*
+ *   Resize the hash.  If there isn't the memory for it we let the hash
+ *   fill up more, until it is nearly full; then newnode() will try a
+ *   gc, and if that doesn't help we grow it anyway, just as we keep
+ *   allocating nodes when a gc doesn't free any.
  */
 void hlifealgo::resize() {
-   g_uintptr_t i, nhashprime = nextprime(2 * hashprime) ;
-   node *p, **nhashtab ;
-   if (alloced > maxmem ||
-       nhashprime * sizeof(node *) > (maxmem - alloced)) {
-      hashlimit = G_MAX ;
+   g_uintptr_t i, nhashbuckets = 2 * hashbuckets ;
+   hashbucket *ohashtab = hashtab ;
+   void *ohashmem = hashmem ;
+   g_uintptr_t ohashbuckets = hashbuckets ;
+   g_uintptr_t grow = sizeof(hashbucket) * (nhashbuckets - hashbuckets) ;
+   if (hashpop < hashfull && (alloced > maxmem || grow > maxmem - alloced)) {
+      hashlimit = hashfull ;
       return ;
    }
-   /*
-    *   Don't let the hash table buckets take more than 4% of the
-    *   memory.  If we're starting to strain memory, let the buckets
-    *   fill up a bit more.
-    */
-   if (nhashprime > (maxmem/(25*sizeof(int *)))) {
-      nhashprime = nextprime(maxmem/(25*sizeof(int *))) ;
-      if (nhashprime == hashprime) {
-         hashlimit = G_MAX ;
-         return ;
-      }
-   }
    if (verbose) {
      strcpy(statusline, "Resizing hash...") ;
      lifestatus(statusline) ;
    }
-   nhashtab = (node **)calloc(nhashprime, sizeof(node *)) ;
-   if (nhashtab == 0) {
+   if (gcphase == 2) // the sweep goes bucket by bucket
+      finishgc() ;
+   if (!newhash(nhashbuckets)) {
+     if (hashpop >= hashfull)
+        lifefatal("Out of memory; try reducing the hash memory limit.") ;
      lifewarning("Out of memory; running in a somewhat slower mode; "
                  "try reducing the hash memory limit after restarting.") ;
-     hashlimit = G_MAX ;
+     hashlimit = hashfull ;
      return ;
    }
-   alloced += sizeof(node *) * (nhashprime - hashprime) ;
-   for (i=0; i<hashprime; i++) {
-      for (p=hashtab[i]; p;) {
-         node *np = p->next ;
-         g_uintptr_t h ;
-         if (is_node(p)) {
-            h = node_hash(p->nw, p->ne, p->sw, p->se) ;
-         } else {
-            leaf *l = (leaf *)p ;
-            h = leaf_hash(l->nw, l->ne, l->sw, l->se) ;
-         }
-         h %= nhashprime ;
-         p->next = nhashtab[h] ;
-         nhashtab[h] = p ;
-         p = np ;
-      }
+   alloced += grow ;
+   for (i=0; i<ohashbuckets; i++) {
+      hashbucket *hb = ohashtab + i ;
+      for (int j=0; j<HASHSLOTS; j++)
+         if (hb->fp[j])
+            hashinsert(hb->slot[j], hashhome(hb->slot[j])) ;
    }
-   free(hashtab) ;
-   hashtab = nhashtab ;
-   hashprime = nhashprime ;
-   hashlimit = hashprime ;
+   free(ohashmem) ;
    if (verbose) {
      strcpy(statusline+strlen(statusline), " done.") ;
      lifestatus(statusline) ;
    }
 }
+/*
+ *   The stirred hash of a node or leaf already in the table.
+ */
+g_uintptr_t hlifealgo::hashhome(node *p) {
+   if (is_node(p))
+      return hashmix(node_hash(p->nw, p->ne, p->sw, p->se)) ;
+   leaf *l = (leaf *)p ;
+   return hashmix(leaf_hash(l->nw, l->ne, l->sw, l->se)) ;
+}
+/*
+ *   Put a node we know is not there into the first free slot along its
+ *   probe sequence, counting it in the overflow of each bucket it
+ *   passes.  Returns the bucket it went in; this does not touch hashpop.
+ */
+g_uintptr_t hlifealgo::hashinsert(node *p, g_uintptr_t h) {
+   g_uintptr_t b = h & hashmask ;
+   for (;;) {
+      hashbucket *hb = hashtab + b ;
+      for (int i=0; i<HASHSLOTS; i++)
+         if (hb->fp[i] == 0) {
+            hb->slot[i] = p ;
+            hb->fp[i] = hashfp(h) ;
+            return b ;
+         }
+      if (hb->overflow < 255)
+         hb->overflow = hb->overflow + 1 ;
+      b = (b + 1) & hashmask ;
+   }
+}
 /*
  *   These next two routines are (nearly) our only hash table access
  *   routines; we simply look up the passed in information.  If we
  *   find it in the hash table, we return it; otherwise, we build a
- *   new node and store it in the hash table, and return that.
+ *   new node and store it in the hash table, and return that.  Along
+ *   the way we note the first empty slot, so an insert usually needs
+ *   no second pass.
  */
 node *hlifealgo::find_node(node *nw, node *ne, node *sw, node *se) {
    node *p ;
-   g_uintptr_t h = node_hash(nw,ne,sw,se) ;
-   node *pred = 0 ;
-   h = h % hashprime ;
-   for (p=hashtab[h]; p; p = p->next) { /* make sure to compare nw *first* */
-      if (nw == p->nw && ne == p->ne && sw == p->sw && se == p->se) {
-         if (pred) { /* move this one to the front */
-            pred->next = p->next ;
-            p->next = hashtab[h] ;
-            hashtab[h] = p ;
+   if (inparallel)
+      return find_node_parallel(nw, ne, sw, se) ;
+   g_uintptr_t h = hashmix(node_hash(nw,ne,sw,se)) ;
+   unsigned char f = hashfp(h) ;
+   g_uintptr_t b = h & hashmask, hole = G_MAX ;
+   int holei = 0 ;
+   for (g_uintptr_t n=0; n<hashbuckets; n++) {
+      hashbucket *hb = hashtab + b ;
+      for (int i=0; i<HASHSLOTS; i++) {
+         unsigned char fi = hb->fp[i] ;
+         if (fi == f) {
+            p = hb->slot[i] ;
+            /* make sure to compare nw *first* */
+            if (nw == p->nw && ne == p->ne && sw == p->sw && se == p->se) {
+               if (gcphase == 2 && b >= sweepnext && !gcmarked(p))
+                  sweepnode(b, i) ; // it's garbage; don't bring it back
+               else
+                  return save(p) ;
+            }
+         }
+         if (fi == 0 && hole == G_MAX) {
+            hole = b ;
+            holei = i ;
          }
-         return save(p) ;
       }
-      pred = p ;
+      if (hb->overflow == 0)
+         break ;
+      b = (b + 1) & hashmask ;
    }
    p = newnode() ;
    p->nw = nw ;
@@ -206,53 +330,60 @@ node *hlifealgo::find_node(node *nw, node *ne, node *sw, node *se) {
    p->sw = sw ;
    p->se = se ;
    p->res = 0 ;
-   p->next = hashtab[h] ;
-   hashtab[h] = p ;
+   hole = hashfill(p, h, hole, holei) ;
    hashpop++ ;
+   if (gcphase == 1 || (gcphase == 2 && hole >= sweepnext))
+      gcshade(p) ;
    if (hashpop > hashlimit)
       resize() ;
    return save(p) ;
 }
-void hlifealgo::unhash_node(node *n) {
-   node *p ;
-   g_uintptr_t h = node_hash(n->nw,n->ne,n->sw,n->se) ;
-   node *pred = 0 ;
-   h = h % hashprime ;
-   for (p=hashtab[h]; p; p = p->next) {
-      if (p == n) {
-         if (pred)
-            pred->next = p->next ;
-         else
-            hashtab[h] = p->next ;
-         return ;
-      }
-      pred = p ;
-   }
-   lifefatal("Didn't find node to unhash") ;
-}
-void hlifealgo::rehash_node(node *n) {
-   g_uintptr_t h = node_hash(n->nw,n->ne,n->sw,n->se) ;
-   h = h % hashprime ;
-   n->next = hashtab[h] ;
-   hashtab[h] = n ;
+/*
+ *   Put a new node in the empty slot a lookup found for it, or if it
+ *   didn't find one (or newnode() did a gc and it's gone) anywhere.
+ */
+g_uintptr_t hlifealgo::hashfill(node *p, g_uintptr_t h, g_uintptr_t hole,
+                                int holei) {
+   if (hole == G_MAX || hashtab[hole].fp[holei] != 0)
+      return hashinsert(p, h) ;
+   for (g_uintptr_t b=h&hashmask; b!=hole; b=(b+1)&hashmask)
+      if (hashtab[b].overflow < 255)
+         hashtab[b].overflow = hashtab[b].overflow + 1 ;
+   hashtab[hole].slot[holei] = p ;
+   hashtab[hole].fp[holei] = hashfp(h) ;
+   return hole ;
 }
 leaf *hlifealgo::find_leaf(unsigned short nw, unsigned short ne,
                                   unsigned short sw, unsigned short se) {
    leaf *p ;
-   leaf *pred = 0 ;
-   g_uintptr_t h = leaf_hash(nw, ne, sw, se) ;
-   h = h % hashprime ;
-   for (p=(leaf *)hashtab[h]; p; p = (leaf *)p->next) {
-      if (nw == p->nw && ne == p->ne && sw == p->sw && se == p->se &&
-          !is_node(p)) {
-         if (pred) {
-            pred->next = p->next ;
-            p->next = hashtab[h] ;
-            hashtab[h] = (node *)p ;
+   if (inparallel)
+      return find_leaf_parallel(nw, ne, sw, se) ;
+   g_uintptr_t h = hashmix(leaf_hash(nw, ne, sw, se)) ;
+   unsigned char f = hashfp(h) ;
+   g_uintptr_t b = h & hashmask, hole = G_MAX ;
+   int holei = 0 ;
+   for (g_uintptr_t n=0; n<hashbuckets; n++) {
+      hashbucket *hb = hashtab + b ;
+      for (int i=0; i<HASHSLOTS; i++) {
+         unsigned char fi = hb->fp[i] ;
+         if (fi == f) {
+            p = (leaf *)hb->slot[i] ;
+            if (nw == p->nw && ne == p->ne && sw == p->sw && se == p->se &&
+                !is_node(p)) {
+               if (gcphase == 2 && b >= sweepnext && !p->gcmark)
+                  sweepnode(b, i) ;
+               else
+                  return (leaf *)save((node *)p) ;
+            }
+         }
+         if (fi == 0 && hole == G_MAX) {
+            hole = b ;
+            holei = i ;
          }
-         return (leaf *)save((node *)p) ;
       }
-      pred = p ;
+      if (hb->overflow == 0)
+         break ;
+      b = (b + 1) & hashmask ;
    }
    p = newleaf() ;
    p->nw = nw ;
@@ -261,13 +392,137 @@ leaf *hlifealgo::find_leaf(unsigned short nw, unsigned short ne,
    p->se = se ;
    leafres(p) ;
    p->isnode = 0 ;
-   p->next = hashtab[h] ;
-   hashtab[h] = (node *)p ;
+   p->gcmark = 0 ;
+   hole = hashfill((node *)p, h, hole, holei) ;
    hashpop++ ;
+   if (gcphase == 1 || (gcphase == 2 && hole >= sweepnext))
+      gcshade((node *)p) ;
    if (hashpop > hashlimit)
       resize() ;
    return (leaf *)save((node *)p) ;
 }
+/*
+ *   While other threads are stepping too, inserts must hold the lock
+ *   for the bucket the hash starts at, so no two threads can add the
+ *   same node.  Nothing is removed from the hash while the others are
+ *   running, so a first pass without the lock is safe.  If that misses
+ *   we get a new node first (this is where we may stop for a gc or
+ *   resize, so we must not hold a lock), then lock, look again, and
+ *   insert.  Threads adding different nodes may still want the same
+ *   empty slot, so we claim slots with a compare and swap, and we set
+ *   overflow counts to 255 rather than counting them up.  The claim
+ *   and the fingerprint are stores with release ordering, and lookups
+ *   load them with acquire ordering, so a thread that finds a node also
+ *   sees its fields.
+ */
+static const int HASHLOCKS = 4096 ;
+/*
+ *   Below this depth it is not worth handing work to other threads.
+ */
+static const int PARALLEL_CUTOFF = 9 ;
+void hlifealgo::hashclaim(node *r, g_uintptr_t h) {
+   g_uintptr_t b = h & hashmask ;
+   for (;;) {
+      hashbucket *hb = hashtab + b ;
+      for (int i=0; i<HASHSLOTS; i++)
+         if (hb->slot[i].loadraw(std::memory_order_relaxed) == 0 &&
+             hb->slot[i].claim(r)) {
+            hb->fp[i].v.store(hashfp(h), std::memory_order_release) ;
+            return ;
+         }
+      hb->overflow.v.store(255, std::memory_order_release) ;
+      b = (b + 1) & hashmask ;
+   }
+}
+node *hlifealgo::parfind_node(g_uintptr_t h, node *nw, node *ne,
+                              node *sw, node *se) {
+   node *p ;
+   unsigned char f = hashfp(h) ;
+   g_uintptr_t b = h & hashmask ;
+   for (g_uintptr_t n=0; n<hashbuckets; n++) {
+      hashbucket *hb = hashtab + b ;
+      for (int i=0; i<HASHSLOTS; i++)
+         if (hb->fp[i].v.load(std::memory_order_acquire) == f &&
+             (p = hb->slot[i].load(std::memory_order_acquire)) != 0 &&
+             nw == p->nw && ne == p->ne && sw == p->sw && se == p->se)
+            return p ;
+      if (hb->overflow.v.load(std::memory_order_acquire) == 0)
+         break ;
+      b = (b + 1) & hashmask ;
+   }
+   return 0 ;
+}
+node *hlifealgo::find_node_parallel(node *nw, node *ne, node *sw, node *se) {
+   node *p ;
+   g_uintptr_t h = hashmix(node_hash(nw,ne,sw,se)) ;
+   if ((p = parfind_node(h, nw, ne, sw, se)) != 0)
+      return save(p) ;
+   node *r = newnode() ;
+   lifelock &l = hashlocks[h & hashmask & (HASHLOCKS - 1)] ;
+   l.lock() ;
+   if ((p = parfind_node(h, nw, ne, sw, se)) != 0) {
+      l.unlock() ;
+      givebacknode(r) ;
+      return save(p) ;
+   }
+   r->nw = nw ;
+   r->ne = ne ;
+   r->sw = sw ;
+   r->se = se ;
+   r->res = 0 ;
+   hashclaim(r, h) ;
+   l.unlock() ;
+   if (hashpop + ++parinserts > hashlimit && stwrequest == 0)
+      stwrequest = 1 ;
+   return save(r) ;
+}
+leaf *hlifealgo::parfind_leaf(g_uintptr_t h, unsigned short nw,
+                              unsigned short ne, unsigned short sw,
+                              unsigned short se) {
+   leaf *p ;
+   unsigned char f = hashfp(h) ;
+   g_uintptr_t b = h & hashmask ;
+   for (g_uintptr_t n=0; n<hashbuckets; n++) {
+      hashbucket *hb = hashtab + b ;
+      for (int i=0; i<HASHSLOTS; i++)
+         if (hb->fp[i].v.load(std::memory_order_acquire) == f &&
+             (p = (leaf *)hb->slot[i].load(std::memory_order_acquire)) != 0 &&
+             nw == p->nw && ne == p->ne && sw == p->sw && se == p->se &&
+             !is_node(p))
+            return p ;
+      if (hb->overflow.v.load(std::memory_order_acquire) == 0)
+         break ;
+      b = (b + 1) & hashmask ;
+   }
+   return 0 ;
+}
+leaf *hlifealgo::find_leaf_parallel(unsigned short nw, unsigned short ne,
+                                    unsigned short sw, unsigned short se) {
+   leaf *p ;
+   g_uintptr_t h = hashmix(leaf_hash(nw, ne, sw, se)) ;
+   if ((p = parfind_leaf(h, nw, ne, sw, se)) != 0)
+      return (leaf *)save((node *)p) ;
+   leaf *r = newleaf() ;
+   lifelock &l = hashlocks[h & hashmask & (HASHLOCKS - 1)] ;
+   l.lock() ;
+   if ((p = parfind_leaf(h, nw, ne, sw, se)) != 0) {
+      l.unlock() ;
+      givebacknode((node *)r) ;
+      return (leaf *)save((node *)p) ;
+   }
+   r->nw = nw ;
+   r->ne = ne ;
+   r->sw = sw ;
+   r->se = se ;
+   leafres(r) ;
+   r->isnode = 0 ;
+   r->gcmark = 0 ;
+   hashclaim((node *)r, h) ;
+   l.unlock() ;
+   if (hashpop + ++parinserts > hashlimit && stwrequest == 0)
+      stwrequest = 1 ;
+   return (leaf *)save((node *)r) ;
+}
 /*
  *   The following routine does the same, but first it checks to see if
  *   the cached result is any good.  If it is, it directly returns that.
@@ -277,9 +532,9 @@ leaf *hlifealgo::find_leaf(unsigned short nw, unsigned short ne,
  *   stack pointer and garbage collection stuff.
  */
 node *hlifealgo::getres(node *n, int depth) {
-   if (n->res)
-     return n->res ;
-   node *res = 0 ;
+   node *res = resof_acquire(n) ;
+   if (res)
+     return res ;
    /**
     *   This routine be the only place we assign to res.  We use
     *   the fact that the poll routine is *sticky* to allow us to
@@ -291,11 +546,28 @@ node *hlifealgo::getres(node *n, int depth) {
     *   calls here, one to prevent us going deeper, and another
     *   to prevent us from destroying the cache field.
     */
-   if (poller->poll())
+   if (onworker()) {
+     // only the main thread may poll
+     if (poller->isInterrupted())
+       return zeronode(depth-1) ;
+   } else if (poller->poll())
      return zeronode(depth-1) ;
-   int sp = gsp ;
+   int sp = stackmark() ;
    depth-- ;
-   if (ngens >= depth) {
+   if (stashcount)
+     res = unstash(n, ngens < depth ? ngens : depth) ;
+   if (res) {
+     // made for an earlier step size; see stashres()
+     if (ngens < depth) {
+       if (onworker())
+         parhalves = 1 ;
+       else if (halvesdone < 1000)
+         halvesdone++ ;
+     }
+   } else if (BIGLEAVES && depth == 3 && kernel.usable()) {
+     res = kernel_node(n->nw, n->ne, n->sw, n->se,
+                       ngens >= depth ? 8 : 1 << ngens) ;
+   } else if (ngens >= depth) {
      if (is_node(n->nw)) {
        res = dorecurs(n->nw, n->ne, n->sw, n->se, depth) ;
      } else {
@@ -303,7 +575,9 @@ node *hlifealgo::getres(node *n, int depth) {
                                    (leaf *)n->sw, (leaf *)n->se) ;
      }
    } else {
-     if (halvesdone < 1000)
+     if (onworker())
+       parhalves = 1 ;
+     else if (halvesdone < 1000)
        halvesdone++ ;
      if (is_node(n->nw)) {
        res = dorecurs_half(n->nw, n->ne, n->sw, n->se, depth) ;
@@ -318,8 +592,11 @@ node *hlifealgo::getres(node *n, int depth) {
    pop(sp) ;
    if (poller->isInterrupted()) // don't assign this to the cache field!
      res = zeronode(depth) ;
-   else
-     n->res = res ;
+   else {
+     if (!inparallel && gcphase == 1 && gcmarked(n))
+       gcshade(res) ; // a marked node gained a pointer
+     setres_release(n, res) ;
+   }
    return res ;
 }
 /*
@@ -335,7 +612,9 @@ node *hlifealgo::getres(node *n, int depth) {
  *   then put these together into a new n/2-square.  Simple, eh?
  */
 node *hlifealgo::dorecurs(node *n, node *ne, node *t, node *e, int depth) {
-   int sp = gsp ;
+   if (inparallel && depth >= PARALLEL_CUTOFF)
+      return dorecurs_parallel(n, ne, t, e, depth, 0) ;
+   int sp = stackmark() ;
    node
    *t00 = getres(n, depth),
    *t01 = getres(find_node(n->ne, ne->nw, n->se, ne->sw), depth),
@@ -359,7 +638,9 @@ node *hlifealgo::dorecurs(node *n, node *ne, node *t, node *e, int depth) {
  */
 node *hlifealgo::dorecurs_half(node *n, node *ne, node *t,
                                node *e, int depth) {
-   int sp = gsp ;
+   if (inparallel && depth >= PARALLEL_CUTOFF)
+      return dorecurs_parallel(n, ne, t, e, depth, 1) ;
+   int sp = stackmark() ;
    node
    *t00 = getres(n, depth),
    *t01 = getres(find_node(n->ne, ne->nw, n->se, ne->sw), depth),
@@ -396,13 +677,132 @@ node *hlifealgo::dorecurs_half(node *n, node *ne, node *t,
    pop(sp) ;
    return save(n) ;
 }
+/*
+ *   The parallel version of the two routines above.  The nine
+ *   subresults are independent of each other, as are the four that
+ *   follow, so we hand each batch to the thread pool.  Whichever
+ *   thread picks up a task may fork again further down.  Each task's
+ *   input is on the forking thread's stack, so its result stays
+ *   reachable through the res field until we combine them.
+ */
+class getrestask : public lifetask {
+public:
+   virtual void run() {
+      if (lifethreads::threadindex() == 0) {
+         res = hl->getres(n, depth) ;
+         return ;
+      }
+      hlifealgo::threadcache &tc = hl->tcache[lifethreads::threadindex()] ;
+      if (tc.nest++ == 0) {
+         hl->busy++ ;
+         hl->safepoint() ;
+      }
+      res = hl->getres(n, depth) ;
+      if (--tc.nest == 0)
+         hl->busy-- ;
+   }
+   hlifealgo *hl ;
+   node *n, *res ;
+   int depth ;
+} ;
+class safepointtask : public lifetask {
+public:
+   virtual void run() { hl->safepoint() ; }
+   hlifealgo *hl ;
+} ;
+node *hlifealgo::dorecurs_parallel(node *n, node *ne, node *t, node *e,
+                                   int depth, int half) {
+   int sp = stackmark() ;
+   safepointtask idle ;
+   idle.hl = this ;
+   getrestask tasks[9] ;
+   lifetask *tp[9] ;
+   node *in[9] = {
+      n, find_node(n->ne, ne->nw, n->se, ne->sw), ne,
+      find_node(n->sw, n->se, t->nw, t->ne),
+      find_node(n->se, ne->sw, t->ne, e->nw),
+      find_node(ne->sw, ne->se, e->nw, e->ne),
+      t, find_node(t->ne, e->nw, t->se, e->sw), e
+   } ;
+   int i ;
+   for (i=0; i<9; i++) {
+      tasks[i].hl = this ;
+      tasks[i].n = in[i] ;
+      tasks[i].depth = depth ;
+      tp[i] = &tasks[i] ;
+   }
+   threads.runall(tp, 9, &idle) ;
+   node
+   *t00 = tasks[0].res, *t01 = tasks[1].res, *t02 = tasks[2].res,
+   *t10 = tasks[3].res, *t11 = tasks[4].res, *t12 = tasks[5].res,
+   *t20 = tasks[6].res, *t21 = tasks[7].res, *t22 = tasks[8].res ;
+   if (half) {
+      n = find_node(find_node(t00->se, t01->sw, t10->ne, t11->nw),
+                    find_node(t01->se, t02->sw, t11->ne, t12->nw),
+                    find_node(t10->se, t11->sw, t20->ne, t21->nw),
+                    find_node(t11->se, t12->sw, t21->ne, t22->nw)) ;
+   } else {
+      tasks[0].n = find_node(t00, t01, t10, t11) ;
+      tasks[1].n = find_node(t01, t02, t11, t12) ;
+      tasks[2].n = find_node(t10, t11, t20, t21) ;
+      tasks[3].n = find_node(t11, t12, t21, t22) ;
+      threads.runall(tp, 4, &idle) ;
+      n = find_node(tasks[0].res, tasks[1].res, tasks[2].res, tasks[3].res) ;
+   }
+   pop(sp) ;
+   return save(n) ;
+}
 /*
  *   If the node is a 16-node, then the constituents are leaves, so we
  *   need a very similar but still somewhat different subroutine.  Since
  *   we do not (yet) garbage collect leaves, we don't need all that
  *   save/pop mumbo-jumbo.
+ *
+ *   If the rule lets us use the bit-sliced kernel, we skip building
+ *   the intermediate leaves and just run the whole 16-square forward.
  */
+leaf *hlifealgo::kernel_leaf(leaf *n, leaf *ne, leaf *t, leaf *e, int gens) {
+   unsigned short in[16] = {
+      n->nw, n->ne, ne->nw, ne->ne, n->sw, n->se, ne->sw, ne->se,
+      t->nw, t->ne, e->nw, e->ne, t->sw, t->se, e->sw, e->se
+   } ;
+   unsigned short out[4] ;
+   kernel.center16(in, gens, out) ;
+   return find_leaf(out[0], out[1], out[2], out[3]) ;
+}
+/*
+ *   The kernel can also take a 32-square, made of four 16-nodes, all
+ *   the way to its 16-square result, so when it is usable getres never
+ *   gets down to the 16-nodes at all and we save building and hashing
+ *   the thirteen intermediate 16-nodes and their leaves.
+ */
+node *hlifealgo::kernel_node(node *n, node *ne, node *t, node *e, int gens) {
+   node *q[4] = { n, ne, t, e } ;
+   unsigned short in[64], out[16] ;
+   for (int i=0; i<4; i++) {
+      int o = (i >> 1) * 32 + (i & 1) * 4 ;
+      for (int j=0; j<4; j++) {
+         leaf *l = (leaf *)(j == 0 ? q[i]->nw : j == 1 ? q[i]->ne :
+                            j == 2 ? q[i]->sw : q[i]->se) ;
+         int p = o + (j >> 1) * 16 + (j & 1) * 2 ;
+         in[p] = l->nw ;
+         in[p+1] = l->ne ;
+         in[p+8] = l->sw ;
+         in[p+9] = l->se ;
+      }
+   }
+   kernel.center32(in, gens, out) ;
+   int sp = stackmark() ;
+   node *r = find_node((node *)find_leaf(out[0], out[1], out[4], out[5]),
+                       (node *)find_leaf(out[2], out[3], out[6], out[7]),
+                       (node *)find_leaf(out[8], out[9], out[12], out[13]),
+                       (node *)find_leaf(out[10], out[11], out[14], out[15])) ;
+   pop(sp) ;
+   return save(r) ;
+}
 leaf *hlifealgo::dorecurs_leaf(leaf *n, leaf *ne, leaf *t, leaf *e) {
+   if (kernel.usable())
+      return kernel_leaf(n, ne, t, e, 4) ;
    unsigned short
    t00 = n->res2,
    t01 = find_leaf(n->ne, ne->nw, n->se, ne->sw)->res2,
@@ -424,6 +824,8 @@ leaf *hlifealgo::dorecurs_leaf(leaf *n, leaf *ne, leaf *t, leaf *e) {
 #define combine4(t00,t01,t10,t11) (unsigned short)\
 ((((t00)<<10)&0xcc00)|(((t01)<<6)&0x3300)|(((t10)>>6)&0xcc)|(((t11)>>10)&0x33))
 leaf *hlifealgo::dorecurs_leaf_half(leaf *n, leaf *ne, leaf *t, leaf *e) {
+   if (kernel.usable())
+      return kernel_leaf(n, ne, t, e, 2) ;
    unsigned short
    t00 = n->res2,
    t01 = find_leaf(n->ne, ne->nw, n->se, ne->sw)->res2,
@@ -444,6 +846,8 @@ leaf *hlifealgo::dorecurs_leaf_half(leaf *n, leaf *ne, leaf *t, leaf *e) {
  */
 leaf *hlifealgo::dorecurs_leaf_quarter(leaf *n, leaf *ne,
                                    leaf *t, leaf *e) {
+   if (kernel.usable())
+      return kernel_leaf(n, ne, t, e, 1) ;
    unsigned short
    t00 = n->res1,
    t01 = find_leaf(n->ne, ne->nw, n->se, ne->sw)->res1,
@@ -459,34 +863,274 @@ leaf *hlifealgo::dorecurs_leaf_quarter(leaf *n, leaf *ne,
                     combine4(t10, t11, t20, t21),
                     combine4(t11, t12, t21, t22)) ;
 }
+/*
+ *   Increments that are not a power of two.  We used to run the
+ *   pattern forward by the largest power of two in the increment as
+ *   many times as it took, which for a step of 10^9 (2^9 times 1953125)
+ *   was hopeless.  Instead we follow the bits of the increment down the
+ *   tree in a single pass.
+ *
+ *   A node at depth d can go up to 2^(d-1) generations forward, and
+ *   here it goes forward by the low d-1 bits of the increment.  If they
+ *   are all zero we just take its center.  Otherwise we make the nine
+ *   subsquares just as dorecurs() does; if bit d-2 is set we run each of
+ *   them its full 2^(d-2) generations with getres() (ngens is the top
+ *   bit of the increment, so getres() goes that far), and if not we
+ *   just take their centers.  The four squares made from those then go
+ *   forward by the remaining low d-2 bits, the same way.
+ *
+ *   So every node at one depth goes forward by the same amount, and we
+ *   can remember the results in steps by node alone.  They stay good as
+ *   long as the increment does, so a run of steps by 10^9 reuses them
+ *   just as a run of steps by 2^30 reuses the res fields.
+ */
+node *hlifealgo::advance(node *n, int depth) {
+   if (depth - 1 <= inclow)
+      return centerof(n, depth) ;
+   int gens = 0 ;
+   if (depth <= 4)
+      for (int i=depth-2; i>=0; i--)
+         gens = 2 * gens + incbit(i) ;
+   if (depth == 3)
+      return (node *)advance_leaf((leaf *)n->nw, (leaf *)n->ne,
+                                  (leaf *)n->sw, (leaf *)n->se, gens) ;
+   if (BIGLEAVES && depth == 4 && kernel.usable())
+      return kernel_node(n->nw, n->ne, n->sw, n->se, gens) ;
+   NODEREF(node) cached ;
+   if (steps.find(n, cached))
+      return save(cached) ;
+   if (poller->poll())
+      return zeronode(depth-1) ;
+   int sp = stackmark() ;
+   depth-- ;
+   node *nw = n->nw, *ne = n->ne, *sw = n->sw, *se = n->se ;
+   node *t[9] = {
+      nw, find_node(nw->ne, ne->nw, nw->se, ne->sw), ne,
+      find_node(nw->sw, nw->se, sw->nw, sw->ne),
+      find_node(nw->se, ne->sw, sw->ne, se->nw),
+      find_node(ne->sw, ne->se, se->nw, se->ne),
+      sw, find_node(sw->ne, se->nw, sw->se, se->sw), se
+   } ;
+   int full = incbit(depth-1) ;
+   for (int i=0; i<9; i++)
+      t[i] = full ? getres(t[i], depth) : centerof(t[i], depth) ;
+   node *r[4] ;
+   for (int i=0; i<4; i++) {
+      int j = (i >> 1) * 3 + (i & 1) ;
+      r[i] = advance(find_node(t[j], t[j+1], t[j+3], t[j+4]), depth) ;
+   }
+   node *res = find_node(r[0], r[1], r[2], r[3]) ;
+   pop(sp) ;
+   if (poller->isInterrupted())
+      return zeronode(depth) ;
+   if (makeroom(steps)) {
+      cached = res ;
+      steps.insert(n, cached) ;
+   }
+   return save(res) ;
+}
+/*
+ *   The same for a 16-square, one to three generations:  two from the
+ *   leaves' res2 if bit 1 is set, and then one from res1 if bit 0 is.
+ */
+leaf *hlifealgo::advance_leaf(leaf *n, leaf *ne, leaf *t, leaf *e,
+                              int gens) {
+   if (kernel.usable())
+      return kernel_leaf(n, ne, t, e, gens) ;
+   leaf *l[9] = {
+      n, find_leaf(n->ne, ne->nw, n->se, ne->sw), ne,
+      find_leaf(n->sw, n->se, t->nw, t->ne),
+      find_leaf(n->se, ne->sw, t->ne, e->nw),
+      find_leaf(ne->sw, ne->se, e->nw, e->ne),
+      t, find_leaf(t->ne, e->nw, t->se, e->sw), e
+   } ;
+   unsigned short s[9], r[4] ;
+   for (int i=0; i<9; i++)
+      s[i] = (gens & 2) ? l[i]->res2 :
+                          combine4(l[i]->nw, l[i]->ne, l[i]->sw, l[i]->se) ;
+   for (int i=0; i<4; i++) {
+      int j = (i >> 1) * 3 + (i & 1) ;
+      r[i] = (gens & 1) ? find_leaf(s[j], s[j+1], s[j+3], s[j+4])->res1 :
+                          combine4(s[j], s[j+1], s[j+3], s[j+4]) ;
+   }
+   return find_leaf(r[0], r[1], r[2], r[3]) ;
+}
+/*
+ *   The center of a node, not run at all.
+ */
+node *hlifealgo::centerof(node *n, int depth) {
+   if (depth == 3)
+      return (node *)find_leaf(((leaf *)n->nw)->se, ((leaf *)n->ne)->sw,
+                               ((leaf *)n->sw)->ne, ((leaf *)n->se)->nw) ;
+   return find_node(n->nw->se, n->ne->sw, n->sw->ne, n->se->nw) ;
+}
 /*
  *   We keep free nodes in a linked list for allocation, and we allocate
  *   them 1000 at a time.
  */
+int hlifealgo::allocblock() {
+   int i ;
+   freenodes = (node *)nodearena::alloc(1001 * sizeof(node)) ;
+   if (freenodes == 0)
+      return 0 ;
+   alloced += 1001 * sizeof(node) ;
+   nextfree(freenodes) = nodeblocks ;
+   nodeblocks = freenodes++ ;
+   for (i=0; i<999; i++) {
+      nextfree(freenodes + 1) = freenodes ;
+      freenodes++ ;
+   }
+   totalthings += 1000 ;
+   freecount += 1000 ;
+   return 1 ;
+}
+/*
+ *   The node arena is shared by every universe, so it can be used up
+ *   before we reach our own limit.  Then we lower the limit to what we
+ *   have and carry on collecting at it, in a somewhat slower mode.
+ *   This returns 0 if we can't (because we can't gc now, or we already
+ *   did this), and then we really are out of memory.  The warning
+ *   waits for the main thread.
+ */
+int hlifealgo::arenafull() {
+   if (!okaytogc || alloced >= maxmem)
+      return 0 ;
+   maxmem = alloced ;
+   arenacut = 1 ;
+   return 1 ;
+}
+void hlifealgo::arenawarning() {
+   arenacut = 0 ;
+   lifewarning("Out of node memory; running in a somewhat slower mode; "
+               "try reducing the hash memory limit or closing other layers.") ;
+}
 node *hlifealgo::newnode() {
    node *r ;
-   if (freenodes == 0) {
-      int i ;
-      freenodes = (node *)calloc(1001, sizeof(node)) ;
+   if (inparallel)
+      return newnode_parallel() ;
+   if (gcphase && okaytogc && (gcdebt += gcrate) >= GCSLICE)
+      gcslice() ;
+   if (freenodes == 0 && !allocblock()) {
+      if (!arenafull())
+         lifefatal("Out of memory; try reducing the hash memory limit.") ;
+      arenawarning() ;
+      if (gcphase)
+         finishgc() ;
+      else
+         do_gc(0) ;
       if (freenodes == 0)
          lifefatal("Out of memory; try reducing the hash memory limit.") ;
-      alloced += 1001 * sizeof(node) ;
-      freenodes->next = nodeblocks ;
-      nodeblocks = freenodes++ ;
-      for (i=0; i<999; i++) {
-         freenodes[1].next = freenodes ;
-         freenodes++ ;
-      }
-      totalthings += 1000 ;
    }
-   if (freenodes->next == 0 && alloced + 1000 * sizeof(node) > maxmem &&
-       okaytogc) {
-      do_gc(0) ;
+   if (((nextfree(freenodes) == 0 && alloced + 1000 * sizeof(node) > maxmem) ||
+        hashpop >= hashfull) && okaytogc) {
+      // we ran out before an incremental gc could finish (or start)
+      if (gcphase)
+         finishgc() ;
+      else
+         do_gc(0) ;
+   } else if (gcphase == 0 && okaytogc && gclastcost > GCSTALL) {
+      /*
+       *   Start collecting once we are within a sixteenth of the memory
+       *   limit, counting what is left on the free list, so there is
+       *   room to keep going while we collect.
+       */
+      g_uintptr_t room = freecount * sizeof(node) ;
+      if (maxmem > alloced)
+         room += maxmem - alloced ;
+      if (room < (maxmem >> 4))
+         startgc() ;
    }
    r = freenodes ;
-   freenodes = freenodes->next ;
+   freenodes = nextfree(freenodes) ;
+   freecount-- ;
+   return r ;
+}
+/*
+ *   In parallel mode each thread grabs free nodes from the shared list
+ *   a few dozen at a time.  When the shared list is empty and we are
+ *   at the memory limit we ask for a gc and wait for it at our safe
+ *   point.  This is the only place (other than the start of a task and
+ *   while waiting for other threads) where a thread stops for a gc or
+ *   a resize, so nodes the caller has in hand but has not yet hashed
+ *   are never collected out from under it.
+ */
+node *hlifealgo::newnode_parallel() {
+   threadcache &tc = tcache[lifethreads::threadindex()] ;
+   int askedforgc = 0 ;
+   while (tc.freenodes == 0) {
+      safepoint() ;
+      alloclock.lock() ;
+      if (freenodes == 0) {
+         // if a gc didn't free anything, grow anyway, like newnode()
+         if (alloced + 1001 * sizeof(node) > maxmem && okaytogc &&
+             !askedforgc) {
+            alloclock.unlock() ;
+            askedforgc = 1 ;
+            stwrequest = 2 ;
+            continue ;
+         }
+         if (!allocblock()) {
+            // now we are over the (lowered) limit, so go round for a gc
+            if (askedforgc || !arenafull())
+               lifefatal("Out of memory; try reducing the hash memory limit.") ;
+            alloclock.unlock() ;
+            continue ;
+         }
+      }
+      node *last = freenodes ;
+      int i ;
+      for (i=1; i<64 && nextfree(last); i++)
+         last = nextfree(last) ;
+      freecount -= i ;
+      tc.freenodes = freenodes ;
+      freenodes = nextfree(last) ;
+      nextfree(last) = 0 ;
+      alloclock.unlock() ;
+   }
+   node *r = tc.freenodes ;
+   tc.freenodes = nextfree(r) ;
    return r ;
 }
+void hlifealgo::givebacknode(node *n) {
+   threadcache &tc = tcache[lifethreads::threadindex()] ;
+   setfree(n, tc.freenodes) ;
+   tc.freenodes = n ;
+}
+/*
+ *   Workers stop here while the main thread resizes or collects; the
+ *   main thread waits here until every busy worker has stopped, does
+ *   the work, and lets them go.  A request for a gc wins over a
+ *   request for a resize, since the gc may make the resize moot.
+ */
+void hlifealgo::safepoint() {
+   if (stwrequest == 0)
+      return ;
+   if (onworker()) {
+      parked++ ;
+      while (stwrequest)
+         std::this_thread::yield() ;
+      parked-- ;
+   } else {
+      while (parked != busy)
+         std::this_thread::yield() ;
+      stoptheworld() ;
+      stwrequest = 0 ;
+   }
+}
+void hlifealgo::stoptheworld() {
+   hashpop += parinserts ;
+   parinserts = 0 ;
+   if (arenacut)
+      arenawarning() ;
+   if (stwrequest == 2 || (hashpop >= hashfull && okaytogc)) {
+      // the gc rebuilds the free list, so drop the threads' caches
+      for (int i=0; i<threads.getthreads(); i++)
+         tcache[i].freenodes = 0 ;
+      do_gc(0) ;
+   }
+   if (hashpop > hashlimit)
+      resize() ;
+}
 /*
  *   Leaves are the same.
  */
@@ -498,7 +1142,7 @@ leaf *hlifealgo::newleaf() {
  *   for us.
  */
 node *hlifealgo::newclearednode() {
-   return (node *)memset(newnode(), 0, sizeof(node)) ;
+   return (node *)memset((void *)newnode(), 0, sizeof(node)) ;
 }
 leaf *hlifealgo::newclearedleaf() {
    return (leaf *)memset(newleaf(), 0, sizeof(leaf)) ;
@@ -514,27 +1158,25 @@ hlifealgo::hlifealgo() {
    if (shortpop[1] == 0)
       for (i=1; i<65536; i++)
          shortpop[i] = shortpop[i & (i - 1)] + 1 ;
-   hashprime = nextprime(1000) ;
-   hashlimit = hashprime ;
    hashpop = 0 ;
-   hashtab = (node **)calloc(hashprime, sizeof(node *)) ;
-   if (hashtab == 0)
+   if (!newhash(256))
      lifefatal("Out of memory (1).") ;
-   alloced += hashprime * sizeof(node *) ;
    ngens = 0 ;
    stacksize = 0 ;
    halvesdone = 0 ;
    nzeros = 0 ;
    stack = 0 ;
    gsp = 0 ;
-   alloced = 0 ;
+   alloced = (hashbuckets + 1) * sizeof(hashbucket) ;
    maxmem = 256 * 1024 * 1024 ;
    freenodes = 0 ;
+   arenacut = 0 ;
    okaytogc = 0 ;
    totalthings = 0 ;
    nodeblocks = 0 ;
    zeronodea = 0 ;
    ruletable = hliferules.rule0 ;
+   kernel.setrule(ruletable) ;
 /*
  *   We initialize our universe to be a 16-square.  We are in drawing
  *   mode at this point.
@@ -544,8 +1186,20 @@ hlifealgo::hlifealgo() {
    generation = 0 ;
    increment = 1 ;
    setincrement = 1 ;
-   nonpow2 = 1 ;
-   pow2step = 1 ;
+   incbits.push_back(1) ;
+   inclow = 0 ;
+   stash = 0 ;
+   stashmask = stashcount = 0 ;
+   stashshift = 64 ;
+   stashgens = 0 ;
+   spillfile = 0 ;
+   spillend = 0 ;
+   trimmedat = 0 ;
+   gridmasked = 0 ;
+   for (int i=0; i<4; i++)
+      gridbox[i] = 0 ;
+   bulkactive = bandj = bandx0 = 0 ;
+   mcbinary = 0 ;
    llsize = 0 ;
    depth = 3 ;
    hashed = 0 ;
@@ -555,21 +1209,52 @@ hlifealgo::hlifealgo() {
    cacheinvalid = 0 ;
    gccount = 0 ;
    gcstep = 0 ;
+   tcache = 0 ;
+   hashlocks = 0 ;
+   inparallel = 0 ;
+   stwrequest = 0 ;
+   busy = 0 ;
+   parked = 0 ;
+   parinserts = 0 ;
+   parhalves = 0 ;
+   gcphase = 0 ;
+   graystack = 0 ;
+   graysize = 0 ;
+   graysp = 0 ;
+   sweepnext = 0 ;
+   freecount = 0 ;
+   gcrate = 0 ;
+   gcdebt = 0 ;
+   gcfreed = 0 ;
+   gcmaxpause = 0 ;
+   gctotal = 0 ;
+   gclastcost = 0 ;
 }
 /**
  *   Destructor frees memory.
  */
 hlifealgo::~hlifealgo() {
-   free(hashtab) ;
+   threads.setthreads(1) ;
+   if (tcache)
+      for (int i=0; tcache[i].stacksize >= 0; i++)
+         free(tcache[i].stack) ;
+   delete [] tcache ;
+   delete [] hashlocks ;
+   free(hashmem) ;
+   free(stash) ;
+   if (spillfile)
+      fclose(spillfile) ;
    while (nodeblocks) {
       node *r = nodeblocks ;
-      nodeblocks = nodeblocks->next ;
-      free(r) ;
+      nodeblocks = nextfree(nodeblocks) ;
+      nodearena::release(r, 1001 * sizeof(node)) ;
    }
    if (zeronodea)
       free(zeronodea) ;
    if (stack)
       free(stack) ;
+   if (graystack)
+      free(graystack) ;
    if (llsize) {
       delete [] llxb ;
       delete [] llyb ;
@@ -590,17 +1275,23 @@ void hlifealgo::step() {
    // doing the hashtable sweep; if that happens, we may need to sweep
    // again.
    int cleareddownto = 1000000000 ;
-   while (increment != setincrement) {
+   int grid = (gridwd > 0 || gridht > 0) && gridCapable() ;
+   bigint times ;
+   for (;;) {
+      // a bounded grid may go by a smaller step a number of times
       bigint pendingincrement = increment ;
-      int newpow2 = 0 ;
+      times = 1 ;
+      if (grid)
+         gridincrement(pendingincrement, times) ;
+      if (pendingincrement == setincrement)
+         break ;
+      std::vector<char> bits ;
       bigint t = pendingincrement ;
-      while (t > 0 && t.even()) {
-         newpow2++ ;
+      while (t > 0) {
+         bits.push_back((char)t.odd()) ;
          t.div2() ;
       }
-      nonpow2 = t.low31() ;
-      if (t != nonpow2)
-         lifefatal("bad increment") ;
+      int newpow2 = bits.size() ? (int)bits.size() - 1 : 0 ;
       int downto = newpow2 ;
       if (ngens < newpow2)
          downto = ngens ;
@@ -611,17 +1302,20 @@ void hlifealgo::step() {
          ngens = newpow2 ;
       }
       setincrement = pendingincrement ;
-      pow2step = 1 ;
-      while (newpow2--)
-         pow2step += pow2step ;
+      incbits = bits ;
+      for (inclow=0; inclow<newpow2 && !bits[inclow]; inclow++) ;
+      steps.clear() ;
+      gridsteps.clear() ;
    }
    gcstep = 0 ;
-   for (int i=0; i<nonpow2; i++) {
-      node *newroot = runpattern() ;
-      if (newroot == 0 || poller->isInterrupted()) // we *were* interrupted
-         break ;
-      popValid = 0 ;
-      root = newroot ;
+   if (incbits.size()) {
+      for (; times > 0; times -= bigint::one) {
+         node *newroot = grid ? rungrid() : runpattern() ;
+         if (newroot == 0 || poller->isInterrupted())
+            break ;
+         popValid = 0 ;
+         root = newroot ;
+      }
    }
    depth = node_depth(root) ;
 }
@@ -632,6 +1326,197 @@ void hlifealgo::setcurrentstate(void *n) {
       popValid = 0 ;
    }
 }
+/*
+ *   What a timeline frame costs is the nodes only it holds on to; the
+ *   nodes it shares with the current pattern or another frame would
+ *   stay if it went.  We find them by giving every node an owner:  the
+ *   first frame to reach it, or COSTCURRENT if the current pattern
+ *   does, or COSTSHARED once a second frame reaches it (and then
+ *   everything under it is shared too).
+ */
+static const unsigned int COSTCURRENT = 0xffffffff ;
+static const unsigned int COSTSHARED = 0xfffffffe ;
+int hlifealgo::costwalk(nodecache<unsigned int> &owners, node *n,
+                        unsigned int f) {
+   unsigned int *owner = owners.get(n) ;
+   if (owner == 0) {
+      if (!owners.room() &&
+          !owners.grow(owners.size() ? 2 * owners.size() : 1 << 12))
+         return 0 ;
+      owners.insert(n, f) ;
+   } else if (*owner == f || *owner == COSTCURRENT || *owner == COSTSHARED) {
+      return 1 ;
+   } else {
+      *owner = f = COSTSHARED ;
+   }
+   if (is_node(n))
+      return costwalk(owners, n->nw, f) && costwalk(owners, n->ne, f) &&
+             costwalk(owners, n->sw, f) && costwalk(owners, n->se, f) ;
+   return 1 ;
+}
+int hlifealgo::framecosts(vector<g_uintptr_t> &costs) {
+   g_uintptr_t held ;
+   return framecosts(costs, held) ;
+}
+/*
+ *   Also returns (in held) all the frames hold, shared or not.
+ */
+int hlifealgo::framecosts(vector<g_uintptr_t> &costs, g_uintptr_t &held) {
+   nodecache<unsigned int> owners ;
+   costs.assign(timeline.framecount, 0) ;
+   held = 0 ;
+   if (root && !costwalk(owners, root, COSTCURRENT))
+      return 0 ;
+   for (int i=0; i<timeline.framecount; i++)
+      if (timeline.frames[i] &&
+          !costwalk(owners, (node *)timeline.frames[i], i))
+         return 0 ;
+   owners.each([&](node *n, unsigned int f) {
+      g_uintptr_t bytes = is_node(n) ? sizeof(node) : sizeof(leaf) ;
+      if (f != COSTCURRENT)
+         held += bytes ;
+      if (f < costs.size())
+         costs[f] += bytes ;
+   }) ;
+   return 1 ;
+}
+/*
+ *   Keep the timeline to its budget by spilling the frames that cost
+ *   the most to a file (never the last, which recording goes on from).
+ *   Counting is a walk of every frame, so we only do it after the
+ *   timeline has grown by an eighth or so.  We spill down to three
+ *   quarters of the budget so we aren't back here at the next frame.
+ */
+void hlifealgo::trimtimeline() {
+   int frames = timeline.framecount ;
+   if (frames >= trimmedat && frames < trimmedat + 16 + trimmedat / 8)
+      return ;
+   trimmedat = frames ;
+   vector<g_uintptr_t> costs ;
+   g_uintptr_t held = 0 ;
+   if (!framecosts(costs, held))
+      return ;
+   if (verbose) {
+      sprintf(statusline, "Timeline frames hold %g MB.", held / 1048576.0) ;
+      lifestatus(statusline) ;
+   }
+   if (held <= timeline.budget)
+      return ;
+   vector<int> order ;
+   for (int i=0; i+1<frames; i++)
+      if (timeline.frames[i])
+         order.push_back(i) ;
+   std::sort(order.begin(), order.end(),
+             [&](int a, int b) { return costs[a] > costs[b] ; }) ;
+   g_uintptr_t target = timeline.budget - timeline.budget / 4 ;
+   for (size_t k=0; k<order.size() && held > target; k++) {
+      const char *err = spillframe(order[k]) ;
+      if (err) {
+         lifewarning(err) ;
+         break ;
+      }
+      held -= costs[order[k]] ;
+   }
+}
+/*
+ *   Read a macrocell leaf line (rows of . and * ending in $, top row
+ *   first) into the nw, ne, sw and se quarters.
+ */
+static const char *readleafline(const char *line, unsigned short *q) {
+   int x=0, y=7 ;
+   q[0] = q[1] = q[2] = q[3] = 0 ;
+   for (const char *p=line; *p > ' '; p++) {
+      switch(*p) {
+case '*':   if (x > 7 || y < 0)
+               return "Illegal coordinates in readmacrocell." ;
+            q[(y < 4 ? 2 : 0) + (x < 4 ? 0 : 1)] |=
+                                    1 << (3 - (x & 3) + 4 * (y & 3)) ;
+            /* note: fall through here */
+case '.':   x++ ;
+            break ;
+case '$':   x = 0 ;
+            y-- ;
+            break ;
+default:    return "Illegal character in readmacrocell." ;
+      }
+   }
+   return 0 ;
+}
+/*
+ *   Spilled frames go to a temporary file, each as the macrocell lines
+ *   for its nodes between a #D line (its depth) and a #E line.
+ */
+const char *hlifealgo::spillframe(int i) {
+   if (spillfile == 0 && (spillfile = tmpfile()) == 0)
+      return "Cannot create a file for timeline frames." ;
+   int inuse = 0 ;
+   for (size_t j=0; j<timeline.spills.size(); j++)
+      if (timeline.frames[j] == 0 && timeline.spills[j] >= 0)
+         inuse = 1 ;
+   if (!inuse)
+      spillend = 0 ; // start the file over
+   if ((int)timeline.spills.size() < timeline.framecount)
+      timeline.spills.resize(timeline.framecount, -1) ;
+   node *frame = (node *)timeline.frames[i] ;
+   int d = node_depth(frame) ;
+   std::ostringstream os ;
+   os << "#D " << d << '\n' ;
+   inGC = 1 ;
+   cellcounter = 0 ;
+   writecell(os, frame, d) ;
+   aftercalcpop2(frame, d) ;
+   savedres.clear() ;
+   inGC = 0 ;
+   os << "#E\n" ;
+   std::string s = os.str() ;
+   if (fseek(spillfile, spillend, SEEK_SET) != 0 ||
+       fwrite(s.data(), 1, s.size(), spillfile) != s.size())
+      return "Cannot write a timeline frame to its file." ;
+   timeline.spills[i] = spillend ;
+   spillend += (long)s.size() ;
+   timeline.frames[i] = 0 ;
+   return 0 ;
+}
+void *hlifealgo::loadframe(int i) {
+   if (spillfile == 0 || i >= (int)timeline.spills.size() ||
+       timeline.spills[i] < 0 ||
+       fseek(spillfile, timeline.spills[i], SEEK_SET) != 0)
+      return 0 ;
+   char line[10000] ;
+   vector<node *> ind(1) ;
+   int d = -1 ;
+   while (fgets(line, sizeof(line), spillfile)) {
+      clearstack() ;
+      if (line[0] == '#') {
+         if (line[1] == 'E')
+            break ;
+         if (line[1] == 'D')
+            d = atoi(line + 2) ;
+      } else if (line[0] == '.' || line[0] == '*' || line[0] == '$') {
+         unsigned short q[4] ;
+         if (readleafline(line, q))
+            return 0 ;
+         ind.push_back((node *)find_leaf(q[0], q[1], q[2], q[3])) ;
+      } else {
+         int nd = 0 ;
+         g_uintptr_t c[4] ;
+         if (sscanf(line, "%d %" PRIuPTR " %" PRIuPTR " %" PRIuPTR " %" PRIuPTR,
+                    &nd, c, c+1, c+2, c+3) != 5 || nd < 4)
+            return 0 ;
+         ind[0] = zeronode(nd - 2) ;
+         for (int k=0; k<4; k++)
+            if (c[k] >= ind.size())
+               return 0 ;
+         ind.push_back(find_node(ind[c[0]], ind[c[1]], ind[c[2]], ind[c[3]])) ;
+      }
+   }
+   if (d < 2)
+      return 0 ;
+   node *frame = ind.size() > 1 ? ind.back() : zeronode(d) ;
+   timeline.frames[i] = frame ;
+   timeline.spills[i] = -1 ;
+   return frame ;
+}
 /*
  *   Set the max memory
  */
@@ -642,13 +1527,76 @@ void hlifealgo::setMaxMemory(int newmemlimit) {
    else if (newmemlimit > 4000)
      newmemlimit = 4000 ;
 #endif
+   newmemlimit = nodearena::clamplimit(newmemlimit) ;
    g_uintptr_t newlimit = ((g_uintptr_t)newmemlimit) << 20 ;
    if (alloced > newlimit) {
       lifewarning("Sorry, more memory currently used than allowed.") ;
       return ;
    }
    maxmem = newlimit ;
-   hashlimit = hashprime ;
+   sethashlimits() ;
+}
+/*
+ *   Set the number of threads to step with.
+ */
+void hlifealgo::setMaxThreads(int n) {
+   poller->bailIfCalculating() ;
+   if (n < 1)
+      n = 1 ;
+   threads.setthreads(n) ;
+   if (tcache)
+      for (int i=0; tcache[i].stacksize >= 0; i++)
+         free(tcache[i].stack) ;
+   delete [] tcache ;
+   tcache = new threadcache[n+1] ;
+   for (int i=0; i<=n; i++) {
+      tcache[i].freenodes = 0 ;
+      tcache[i].stack = 0 ;
+      tcache[i].stacksize = 0 ;
+      tcache[i].gsp = 0 ;
+      tcache[i].nest = 0 ;
+   }
+   tcache[n].stacksize = -1 ; // sentinel
+   if (hashlocks == 0 && n > 1)
+      hashlocks = new lifelock[HASHLOCKS] ;
+}
+void hlifealgo::beginparallel() {
+   if (gcphase) // the threads don't do incremental gc
+      finishgc() ;
+   parinserts = 0 ;
+   parhalves = 0 ;
+   stwrequest = 0 ;
+   busy = 0 ;
+   parked = 0 ;
+   inparallel = 1 ;
+}
+/*
+ *   Give back whatever free nodes the threads did not use, and account
+ *   for everything they hashed.
+ */
+void hlifealgo::endparallel() {
+   inparallel = 0 ;
+   for (int i=0; i<threads.getthreads(); i++) {
+      node *p = tcache[i].freenodes ;
+      if (p) {
+         freecount++ ;
+         while (nextfree(p)) {
+            p = nextfree(p) ;
+            freecount++ ;
+         }
+         nextfree(p) = freenodes ;
+         freenodes = tcache[i].freenodes ;
+         tcache[i].freenodes = 0 ;
+      }
+      tcache[i].gsp = 0 ;
+   }
+   hashpop += parinserts ;
+   parinserts = 0 ;
+   // new_ngens() only cares whether there were any halves beyond the root
+   if (parhalves && halvesdone < 2)
+      halvesdone = 2 ;
+   if (hashpop > hashlimit)
+      resize() ;
 }
 /**
  *   Clear everything.
@@ -801,7 +1749,7 @@ node *hlifealgo::setbit(node *n, int x, int y, int newstate, int depth) {
          wh = 1 << (depth - 1) ;
       }
       depth-- ;
-      node **nptr ;
+      NODEREF(node) *nptr ;
       if (x < 0) {
          if (y < 0)
             nptr = &(n->sw) ;
@@ -960,6 +1908,8 @@ int hlifealgo::nextbit(node *n, int x, int y, int depth) {
 int hlifealgo::setcell(int x, int y, int newstate) {
    if (newstate & ~1)
       return -1 ;
+   if (bulkactive)
+      bulkflush() ;
    if (hashed) {
       clearstack() ;
       save(root) ;
@@ -993,30 +1943,316 @@ int hlifealgo::setcell(int x, int y, int newstate) {
    return 0 ;
 }
 /*
- *   Our nonrecurse top-level bit getting routine.
+ *   Loading a big pattern a cell at a time walks the tree from the root
+ *   for every cell.  setrow() instead ORs each row into a band of
+ *   eight rows kept as the quarters of a row of leaves; when the rows
+ *   move on to the next band we make the leaves and build upwards:  a
+ *   row of nodes waits in bulkrows until the row it pairs with comes
+ *   along, and then the two make a row of parents one level up.  When
+ *   the pattern ends, what's left goes up until it is a single node,
+ *   which we put into the universe.  Rows are handled quickest top to
+ *   bottom (as RLE gives them); a row above the current band just
+ *   starts the whole thing over.
+ *
+ *   Everything here is in tree coordinates (y up, as in setbit()), and
+ *   a row of nodes at depth d is numbered in units of 2^(d+1), which
+ *   is just how the nodes of the tree are aligned.
  */
-int hlifealgo::getcell(int x, int y) {
+int hlifealgo::setrow(int x, int y, int wd, const unsigned char *bits) {
+   if (!hashed) {
+      root = hashpattern(root, depth) ;
+      hashed = 1 ;
+   }
    y = - y ;
-   int sx = x ;
-   int sy = y ;
-   if (depth <= 31) {
-     sx >>= depth ;
-     sy >>= depth ;
-   } else {
-     sx >>= 31 ;
-     sy >>= 31 ;
+   int j = y >> 3 ;
+   if (bulkactive && j != bandj) {
+      if (j > bandj)
+         bulkflush() ;
+      else
+         bulkband() ;
    }
-   if (sx > 0 || sx < -1 || sy > 0 || sy < -1)
+   if (wd <= 0)
       return 0 ;
-   return getbit(root, x, y, depth) ;
-}
-/*
+   int lx = x >> 3, off = x & 7, nbytes = (wd + 7) >> 3 ;
+   int lastmask = (0xff << (7 - ((wd - 1) & 7))) & 255 ;
+   /*
+    *   Grow the root just as setcell() would for the first and last
+    *   cells of the row, so the result matches cell by cell loading.
+    */
+   int first = -1, last = -1 ;
+   for (int c=0; c<nbytes; c++) {
+      int b = c + 1 < nbytes ? bits[c] : bits[c] & lastmask ;
+      if (b) {
+         if (first < 0)
+            for (first=8*c; !(b & (0x80 >> (first & 7))); first++) ;
+         for (last=8*c+7; !(b & (0x80 >> (last & 7))); last--) ;
+      }
+   }
+   if (first < 0)
+      return 0 ;
+   for (int e=0; e<2; e++) {
+      int sx = x + (e ? last : first), sy = y ;
+      if (depth <= 31) {
+         sx >>= depth ;
+         sy >>= depth ;
+      } else {
+         sx >>= 31 ;
+         sy >>= 31 ;
+      }
+      while (sx > 0 || sx < -1 || sy > 0 || sy < -1) {
+         root = pushroot(root) ;
+         depth++ ;
+         sx >>= 1 ;
+         sy >>= 1 ;
+      }
+   }
+   int ncols = (off + wd + 7) >> 3 ;
+   if (!bulkactive || bandq.empty()) {
+      bulkactive = 1 ;
+      bandj = j ;
+      bandx0 = lx ;
+   } else if (lx < bandx0) {
+      bandq.insert(bandq.begin(), 4 * (bandx0 - lx), 0) ;
+      bandx0 = lx ;
+   }
+   if (bandq.size() < (size_t)(4 * (lx - bandx0 + ncols)))
+      bandq.resize(4 * (lx - bandx0 + ncols), 0) ;
+   int r = y & 7 ;
+   unsigned short *q = &bandq[4 * (lx - bandx0)] + (r < 4 ? 2 : 0) ;
+   int shift = 4 * (r & 3) ;
+   for (int c=0; c<ncols; c++, q+=4) {
+      int b = 0 ;
+      if (c < nbytes)
+         b = (c + 1 < nbytes ? bits[c] : bits[c] & lastmask) >> off ;
+      if (off && c > 0)
+         b |= ((c < nbytes ? bits[c-1] : bits[c-1] & lastmask)
+                                                   << (8 - off)) & 255 ;
+      if (b) {
+         q[0] |= (unsigned short)((b >> 4) << shift) ;
+         q[1] |= (unsigned short)((b & 15) << shift) ;
+      }
+   }
+   return 0 ;
+}
+/*
+ *   Make the band into a row of leaves and send it up.
+ */
+void hlifealgo::bulkband() {
+   bulkrow row ;
+   row.j = bandj ;
+   row.x0 = bandx0 ;
+   row.cells.resize(bandq.size() / 4) ;
+   int live = 0 ;
+   for (size_t c=0; c<row.cells.size(); c++) {
+      unsigned short *q = &bandq[4 * c] ;
+      if (q[0] | q[1] | q[2] | q[3]) {
+         clearstack() ;
+         row.cells[c] = (node *)find_leaf(q[0], q[1], q[2], q[3]) ;
+         live = 1 ;
+      }
+   }
+   bandq.clear() ;
+   if (live)
+      bulkpush(0, row) ;
+}
+void hlifealgo::bulkpush(size_t k, bulkrow &row) {
+   if (bulkrows.size() <= k + 1)
+      bulkrows.resize(k + 2) ;
+   if (!bulkrows[k].cells.empty() && (bulkrows[k].j >> 1) != (row.j >> 1)) {
+      // the row waiting here has no partner; send it up alone
+      bulkrow none, up ;
+      bulkrow &w = bulkrows[k] ;
+      if (w.j & 1)
+         bulkpair(k, w, none, up) ;
+      else
+         bulkpair(k, none, w, up) ;
+      w.cells.clear() ;
+      bulkpush(k + 1, up) ;
+   }
+   if (bulkrows[k].cells.empty()) {
+      bulkrows[k].j = row.j ;
+      bulkrows[k].x0 = row.x0 ;
+      bulkrows[k].cells.swap(row.cells) ;
+      return ;
+   }
+   bulkrow up ;
+   bulkrow &w = bulkrows[k] ;
+   if (w.j & 1)
+      bulkpair(k, w, row, up) ;
+   else
+      bulkpair(k, row, w, up) ;
+   w.cells.clear() ;
+   bulkpush(k + 1, up) ;
+}
+/*
+ *   Make the row of parents of two rows of depth k+2 nodes (either of
+ *   which can be empty).
+ */
+void hlifealgo::bulkpair(size_t k, bulkrow &north, bulkrow &south,
+                         bulkrow &up) {
+   int lo = 0, hi = -1, first = 1 ;
+   bulkrow *rows[2] = { &north, &south } ;
+   for (int i=0; i<2; i++)
+      if (!rows[i]->cells.empty()) {
+         int rlo = rows[i]->x0, rhi = rlo + (int)rows[i]->cells.size() - 1 ;
+         if (first || rlo < lo)
+            lo = rlo ;
+         if (first || rhi > hi)
+            hi = rhi ;
+         up.j = rows[i]->j >> 1 ;
+         first = 0 ;
+      }
+   lo >>= 1 ;
+   hi >>= 1 ;
+   up.x0 = lo ;
+   up.cells.assign(hi - lo + 1, 0) ;
+   node *z = zeronode((int)k + 2) ;
+   for (int i=lo; i<=hi; i++) {
+      node *c[4] ;
+      int live = 0 ;
+      for (int q=0; q<4; q++) {
+         bulkrow *r = rows[q >> 1] ;
+         int col = 2 * i + (q & 1) - r->x0 ;
+         c[q] = col >= 0 && col < (int)r->cells.size() ? r->cells[col] : 0 ;
+         if (c[q])
+            live = 1 ;
+         else
+            c[q] = z ;
+      }
+      if (live) {
+         clearstack() ;
+         up.cells[i - lo] = find_node(c[0], c[1], c[2], c[3]) ;
+      }
+   }
+}
+/*
+ *   Finish the band and the rows, and put the result in the universe.
+ */
+void hlifealgo::bulkflush() {
+   if (!bulkactive)
+      return ;
+   if (!bandq.empty())
+      bulkband() ;
+   for (size_t k=0; k<bulkrows.size(); k++) {
+      bulkrow &w = bulkrows[k] ;
+      if (w.cells.empty())
+         continue ;
+      /*
+       *   Rows either side of y=0 (or x=0) never share a parent, so
+       *   rather than go up forever we put a row in place once it is
+       *   down to a few nodes.
+       */
+      int live = 0 ;
+      for (size_t c=0; c<w.cells.size(); c++)
+         if (w.cells[c])
+            live++ ;
+      if (live <= 4) {
+         int d = (int)k + 2 ;
+         G_INT64 size = (G_INT64)1 << (d + 1) ;
+         for (size_t c=0; c<w.cells.size(); c++)
+            if (w.cells[c])
+               bulkput(w.cells[c], d, (w.x0 + (G_INT64)c) * size,
+                       w.j * size) ;
+         w.cells.clear() ;
+         continue ;
+      }
+      bulkrow none, up ;
+      if (w.j & 1)
+         bulkpair(k, w, none, up) ;
+      else
+         bulkpair(k, none, w, up) ;
+      w.cells.clear() ;
+      bulkpush(k + 1, up) ;
+   }
+   bulkrows.clear() ;
+   bulkactive = 0 ;
+   clearstack() ;
+   popValid = 0 ;
+}
+/*
+ *   Put n (of depth d, lower left corner at x, y) into the universe.
+ *   setrow() has already grown the root to hold every live cell, so a
+ *   node as big as the root can only stick out with empty quarters.
+ */
+void hlifealgo::bulkput(node *n, int d, G_INT64 x, G_INT64 y) {
+   if (d < depth) {
+      root = bulkplace(root, depth, x, y, 0, 0, n, d) ;
+      return ;
+   }
+   G_INT64 half = (G_INT64)1 << d ;
+   node *z = zeronode(d-1) ;
+   if (n->nw != z)
+      bulkput(n->nw, d-1, x, y + half) ;
+   if (n->ne != z)
+      bulkput(n->ne, d-1, x + half, y + half) ;
+   if (n->sw != z)
+      bulkput(n->sw, d-1, x, y) ;
+   if (n->se != z)
+      bulkput(n->se, d-1, x + half, y) ;
+}
+/*
+ *   Put sub (of depth d, lower left corner at x, y) into the node n of
+ *   the given depth centered at cx, cy.
+ */
+node *hlifealgo::bulkplace(node *n, int ndepth, G_INT64 x, G_INT64 y,
+                           G_INT64 cx, G_INT64 cy, node *sub, int d) {
+   if (ndepth == d)
+      return unionof(n, sub, d) ;
+   G_INT64 half = (G_INT64)1 << (ndepth - 1) ;
+   node *c[4] = { n->nw, n->ne, n->sw, n->se } ;
+   int q = (y < cy ? 2 : 0) + (x < cx ? 0 : 1) ;
+   c[q] = bulkplace(c[q], ndepth - 1, x, y, x < cx ? cx - half : cx + half,
+                    y < cy ? cy - half : cy + half, sub, d) ;
+   clearstack() ;
+   return find_node(c[0], c[1], c[2], c[3]) ;
+}
+/*
+ *   The cells live in either of two nodes of the same depth.
+ */
+node *hlifealgo::unionof(node *a, node *b, int d) {
+   node *z = zeronode(d) ;
+   if (a == z || a == b)
+      return b ;
+   if (b == z)
+      return a ;
+   if (d == 2) {
+      leaf *la = (leaf *)a, *lb = (leaf *)b ;
+      return (node *)find_leaf(la->nw | lb->nw, la->ne | lb->ne,
+                               la->sw | lb->sw, la->se | lb->se) ;
+   }
+   node *nw = unionof(a->nw, b->nw, d-1), *ne = unionof(a->ne, b->ne, d-1) ;
+   node *sw = unionof(a->sw, b->sw, d-1), *se = unionof(a->se, b->se, d-1) ;
+   return find_node(nw, ne, sw, se) ;
+}
+/*
+ *   Our nonrecurse top-level bit getting routine.
+ */
+int hlifealgo::getcell(int x, int y) {
+   if (bulkactive)
+      bulkflush() ;
+   y = - y ;
+   int sx = x ;
+   int sy = y ;
+   if (depth <= 31) {
+     sx >>= depth ;
+     sy >>= depth ;
+   } else {
+     sx >>= 31 ;
+     sy >>= 31 ;
+   }
+   if (sx > 0 || sx < -1 || sy > 0 || sy < -1)
+      return 0 ;
+   return getbit(root, x, y, depth) ;
+}
+/*
  *   A recursive bit getting routine, but this one returns the
  *   number of pixels to the right to the next set cell in the
  *   current universe, or -1 if none set to the right, or if
  *   the next set pixel is out of range.
  */
 int hlifealgo::nextcell(int x, int y, int &v) {
+   if (bulkactive)
+      bulkflush() ;
    v = 1 ;
    y = - y ;
    int sx = x ;
@@ -1064,21 +2300,24 @@ node *hlifealgo::hashpattern(node *root, int depth) {
    } else if (depth == 2) {
       leaf *n = (leaf *)root ;
       r = (node *)find_leaf(n->nw, n->ne, n->sw, n->se) ;
-      n->next = freenodes ;
+      setfree(root, freenodes) ;
       freenodes = root ;
+      freecount++ ;
    } else {
       depth-- ;
       r = find_node(hashpattern(root->nw, depth),
                     hashpattern(root->ne, depth),
                     hashpattern(root->sw, depth),
                     hashpattern(root->se, depth)) ;
-      root->next = freenodes ;
+      setfree(root, freenodes) ;
       freenodes = root ;
+      freecount++ ;
    }
    return r ;
 }
 void hlifealgo::endofpattern() {
    poller->bailIfCalculating() ;
+   bulkflush() ;
    if (!hashed) {
       root = hashpattern(root, depth) ;
       hashed = 1 ;
@@ -1113,79 +2352,175 @@ node *hlifealgo::popzeros(node *n) {
 /*
  *   A lot of the routines from here on down traverse the universe, hanging
  *   information off the nodes.  The way they generally do so is by using
- *   (or abusing) the cache (res) field, and the least significant bit of
- *   the hash next field (as a visited bit).
+ *   (or abusing) the cache (res) field.  The gc and friends mark the
+ *   nodes they have visited with the gc mark.  The writing walks
+ *   replace the cache field with a number (stashing the real value in
+ *   savedres) and use its least significant bit as the visited bit;
+ *   compact nodes keep the number in the flags word.  You cannot do
+ *   this to leaves, though.
+ */
+#define marked(n) gcmarked(n)
+#define mark(n) (is_node(n) ? (void)(markres(n)) : \
+                              (void)(((leaf *)(n))->gcmark = 1))
+#ifdef COMPACTNODES
+#define marked2(n) (1 & (n)->flags)
+#define tempof(n) ((g_uintptr_t)(n)->flags >> 2)
+void hlifealgo::settemp(node *n, g_uintptr_t v) {
+   if (v >= (1U << 30))
+      lifefatal("Too many nodes to walk.") ;
+   n->flags = (n->flags & RESMARK) | (unsigned int)(v << 2) | 1 ;
+}
+void hlifealgo::cleartemp(node *n) {
+   n->flags &= RESMARK ;
+}
+#else
+#define marked2(n) (1 & RESRAW(n))
+#define tempof(n) (RESRAW(n) >> 2)
+void hlifealgo::settemp(node *n, g_uintptr_t v) {
+   if (savedres.size() <= v)
+      savedres.resize(v + 1) ;
+   savedres[v] = n->res ;
+   n->res = (node *)((v << 2) | 1) ;
+}
+void hlifealgo::cleartemp(node *n) {
+   n->res = savedres[tempof(n)] ;
+}
+#endif
+/*
+ *   Nodes never change once they are hashed, so neither do their
+ *   populations, and we keep every count we make until the node itself
+ *   might be freed.  Counting a new root then only walks the nodes that
+ *   are new since the last count.
+ *
+ *   A node at depth d is 2^(d+1) cells on a side, so up to POPDEPTH64
+ *   the count fits in a G_INT64 and we add up in that.  The counts that
+ *   also fit in 32 bits (nearly all) go in pops; the few that don't
+ *   are simply added up again from their children.  Deeper nodes are
+ *   rare, so we keep their counts as bigints in a map.
+ *
+ *   We don't keep the counts of nodes below POPMINDEPTH (16x16); there
+ *   are a lot of them, and they are quick to add up from their leaves.
  */
-#define marked(n) (1 & (g_uintptr_t)(n)->next)
-#define mark(n) ((n)->next = (node *)(1 | (g_uintptr_t)(n)->next))
-#define clearmark(n) ((n)->next = (node *)(~1 & (g_uintptr_t)(n)->next))
-#define clearmarkbit(p) ((node *)(~1 & (g_uintptr_t)(p)))
+static const int POPDEPTH64 = 30 ;
+static const int POPMINDEPTH = 3 ;
+static const unsigned int POPNONE = 0xffffffff ;
 /*
- *   Sometimes we want to use *res* instead of next to mark.  You cannot
- *   do this to leaves, though.
+ *   The side caches (see nodecache in hlifealgo.h) count against the
+ *   memory limit.  If memory is too tight to grow one, we just stop
+ *   adding to it; what they hold is only a help.
  */
-#define marked2(n) (1 & (g_uintptr_t)(n)->res)
-#define mark2(n) ((n)->res = (node *)(1 | (g_uintptr_t)(n)->res))
-#define clearmark2(n) ((n)->res = (node *)(~1 & (g_uintptr_t)(n)->res))
-static void sum4(bigint &dest, const bigint &a, const bigint &b,
-                 const bigint &c, const bigint &d) {
-   dest = a ;
-   dest += b ;
-   dest += c ;
-   dest += d ;
+static const g_uintptr_t CACHEFIRSTSIZE = 1 << 12 ;
+template <class V> int hlifealgo::makeroom(nodecache<V> &c) {
+   if (c.room())
+      return 1 ;
+   g_uintptr_t osize = c.size() ;
+   g_uintptr_t nsize = osize ? 2 * osize : CACHEFIRSTSIZE ;
+   g_uintptr_t grow = c.bytes(nsize - osize) ;
+   if (alloced > maxmem || grow > maxmem - alloced || !c.grow(nsize))
+      return 0 ;
+   alloced += grow ;
+   return 1 ;
 }
 /*
- *   This recursive routine calculates the population by hanging the
- *   population on marked nodes.
+ *   Called when the gc has marked everything that will survive and is
+ *   about to free the rest:  drop what we know about the nodes it will
+ *   free, since their memory will soon be other nodes.
  */
-const bigint &hlifealgo::calcpop(node *root, int depth) {
+static int keeppop(node *n, unsigned int) {
+   return gcmarked(n) ;
+}
+static int keepstep(node *n, NODEREF(node) r) {
+   return gcmarked(n) && gcmarked((node *)r) ;
+}
+template <class V> static int keepentry(node *n, const V &e) {
+   return gcmarked(n) && gcmarked((node *)e.r) ;
+}
+void hlifealgo::prunecaches() {
+   for (std::map<node *, bigint>::iterator it=bigpops.begin();
+        it != bigpops.end(); )
+      if (gcmarked(it->first))
+         ++it ;
+      else
+         bigpops.erase(it++) ;
+   g_uintptr_t size = pops.size() ;
+   if (!pops.prune(keeppop))
+      alloced -= pops.bytes(size) ;
+   size = steps.size() ;
+   if (!steps.prune(keepstep))
+      alloced -= steps.bytes(size) ;
+   size = gridsteps.size() ;
+   if (!gridsteps.prune(keepentry<gridentry>))
+      alloced -= gridsteps.bytes(size) ;
+   for (g_uintptr_t i=0; stashcount && i<=stashmask; i++) {
+      stashentry &e = stash[i] ;
+      if (HRAW(e.n) && !(gcmarked((node *)e.n) && gcmarked((node *)e.r))) {
+         e.n = 0 ;
+         stashcount-- ;
+      }
+   }
+}
+G_INT64 hlifealgo::smallpop(node *root, int depth) {
+   if (depth == 2)
+      return ((leaf *)root)->leafpop ;
+   if (root == zeronode(depth))
+      return 0 ;
+   G_INT64 r ;
+   unsigned int p ;
+   if (depth >= POPMINDEPTH && pops.find(root, p))
+      return p ;
+   r = smallpop(root->nw, depth-1) + smallpop(root->ne, depth-1) +
+       smallpop(root->sw, depth-1) + smallpop(root->se, depth-1) ;
+   if (depth >= POPMINDEPTH && r < POPNONE && makeroom(pops))
+      pops.insert(root, (unsigned int)r) ;
+   return r ;
+}
+bigint hlifealgo::calcpop(node *root, int depth) {
+   if (depth <= POPDEPTH64)
+      return bigint(smallpop(root, depth)) ;
    if (root == zeronode(depth))
       return bigint::zero ;
-   if (depth == 2) {
-      root->nw = 0 ;
-      bigint &r = *(bigint *)&(root->nw) ;
-      leaf *n = (leaf *)root ;
-      r = n->leafpop ;
-      return r ;
-   } else if (marked2(root)) {
-      return *(bigint*)&(root->next) ;
-   } else {
-      depth-- ;
-      unhash_node(root) ;
-/**
- *   We use the memory in root->next as a value bigint.  But we want to
- *   make sure the copy constructor doesn't "clean up" something that
- *   doesn't exist.  So we clear it to zero here.
+   std::map<node *, bigint>::iterator it = bigpops.find(root) ;
+   if (it != bigpops.end())
+      return it->second ;
+   depth-- ;
+   bigint sum = calcpop(root->nw, depth) ;
+   sum += calcpop(root->ne, depth) ;
+   sum += calcpop(root->sw, depth) ;
+   sum += calcpop(root->se, depth) ;
+   bigpops[root] = sum ;
+   return sum ;
+}
+/*
+ *   What fraction of the cells of a node are alive?  For density
+ *   drawing, which may ask about every node under the pixels on the
+ *   screen; it leans on the same cached counts.
  */
-      root->next = (node *)0 ; // I wish I could come up with a cleaner way
-      sum4(*(bigint *)&(root->next),
-           calcpop(root->nw, depth), calcpop(root->ne, depth),
-           calcpop(root->sw, depth), calcpop(root->se, depth)) ;
-      mark2(root) ;
-      return *(bigint *)&(root->next) ;
-   }
+double hlifealgo::popfraction(node *root, int depth) {
+   double pop ;
+   if (depth <= POPDEPTH64)
+      pop = (double)smallpop(root, depth) ;
+   else
+      pop = calcpop(root, depth).todouble() ;
+   return ldexp(pop, -2 * (depth + 1)) ;
 }
 /*
- *   Call this after doing something that unhashes nodes in order to
- *   use the next field as a temp pointer.
+ *   Call this after one of the walks that use settemp(), to put back
+ *   the cache fields.
  */
-void hlifealgo::aftercalcpop2(node *root, int depth, int cleanbigints) {
+void hlifealgo::aftercalcpop2(node *root, int depth) {
    if (root == zeronode(depth))
       return ;
    if (depth == 2) {
-      root->nw = 0 ; // all these bigints are guaranteed to be small
+      root->nw = 0 ;
       return ;
    }
    if (marked2(root)) {
-      clearmark2(root) ;
+      cleartemp(root) ;
       depth-- ;
-      aftercalcpop2(root->nw, depth, cleanbigints) ;
-      aftercalcpop2(root->ne, depth, cleanbigints) ;
-      aftercalcpop2(root->sw, depth, cleanbigints) ;
-      aftercalcpop2(root->se, depth, cleanbigints) ;
-      if (cleanbigints)
-         *(bigint *)&(root->next) = bigint::zero ; // clean up; yuck!
-      rehash_node(root) ;
+      aftercalcpop2(root->nw, depth) ;
+      aftercalcpop2(root->ne, depth) ;
+      aftercalcpop2(root->sw, depth) ;
+      aftercalcpop2(root->se, depth) ;
    }
 }
 /*
@@ -1196,7 +2531,6 @@ void hlifealgo::calcPopulation(node *root) {
    ensure_hashed() ;
    depth = node_depth(root) ;
    population = calcpop(root, depth) ;
-   aftercalcpop2(root, depth, 1) ;
 }
 /*
  *   Is the universe empty?
@@ -1209,6 +2543,18 @@ int hlifealgo::isEmpty() {
  *   This routine marks a node as needed to be saved.
  */
 node *hlifealgo::save(node *n) {
+   if (onworker()) {
+      threadcache &tc = tcache[lifethreads::threadindex()] ;
+      if (tc.gsp >= tc.stacksize) {
+         int nstacksize = tc.stacksize * 2 + 100 ;
+         tc.stack = (node **)realloc(tc.stack, nstacksize * sizeof(node *)) ;
+         if (tc.stack == 0)
+           lifefatal("Out of memory (3).") ;
+         tc.stacksize = nstacksize ;
+      }
+      tc.stack[tc.gsp++] = n ;
+      return n ;
+   }
    if (gsp >= stacksize) {
       int nstacksize = stacksize * 2 + 100 ;
       alloced += sizeof(node *)*(nstacksize-stacksize) ;
@@ -1224,7 +2570,10 @@ node *hlifealgo::save(node *n) {
  *   This routine pops the stack back to a previous depth.
  */
 void hlifealgo::pop(int n) {
-   gsp = n ;
+   if (onworker())
+      tcache[lifethreads::threadindex()].gsp = n ;
+   else
+      gsp = n ;
 }
 /*
  *   This routine clears the stack altogether.
@@ -1234,10 +2583,9 @@ void hlifealgo::clearstack() {
 }
 /*
  *   Do a gc.  Walk down from all nodes reachable on the stack, saveing
- *   them by setting the odd bit on the next link.  Then, walk the hash,
- *   eliminating the res from everything that's not saveed, and moving
- *   the nodes from the hash to the freelist as appropriate.  Finally,
- *   walk the hash again, clearing the low order bits in the next pointers.
+ *   them by setting the gc mark.  Then, walk all the nodes, putting the
+ *   saveed ones back into an emptied hash (clearing their marks as we
+ *   go) and the rest on the freelist.
  */
 void hlifealgo::gc_mark(node *root, int invalidate) {
    if (!marked(root)) {
@@ -1247,11 +2595,11 @@ void hlifealgo::gc_mark(node *root, int invalidate) {
          gc_mark(root->ne, invalidate) ;
          gc_mark(root->sw, invalidate) ;
          gc_mark(root->se, invalidate) ;
-         if (root->res) {
+         if (resof(root)) {
             if (invalidate)
-              root->res = 0 ;
+              setres(root, 0) ;
             else
-              gc_mark(root->res, invalidate) ;
+              gc_mark(resof(root), invalidate) ;
          }
       }
    }
@@ -1264,7 +2612,14 @@ void hlifealgo::do_gc(int invalidate) {
    int i ;
    g_uintptr_t freed_nodes=0 ;
    node *p, *pp ;
+   std::chrono::steady_clock::time_point start =
+                                      std::chrono::steady_clock::now() ;
    inGC = 1 ;
+   if (gcphase) { // abandon any incremental gc and clear its marks
+      gcphase = 0 ;
+      graysp = 0 ;
+      clearmarks() ;
+   }
    gccount++ ;
    gcstep++ ;
    if (verbose) {
@@ -1283,41 +2638,58 @@ void hlifealgo::do_gc(int invalidate) {
       poller->poll() ;
       gc_mark(stack[i], invalidate) ;
    }
+   if (inparallel)
+      for (int t=1; t<threads.getthreads(); t++)
+         for (i=0; i<tcache[t].gsp; i++)
+            gc_mark(tcache[t].stack[i], invalidate) ;
    for (i=0; i<timeline.framecount; i++)
-      gc_mark((node *)timeline.frames[i], invalidate) ;
+      if (timeline.frames[i])
+         gc_mark((node *)timeline.frames[i], invalidate) ;
+   if (invalidate) {
+      steps.clear() ;
+      gridsteps.clear() ;
+      if (stash)
+         memset(stash, 0, (stashmask + 1) * sizeof(stashentry)) ;
+      stashcount = 0 ;
+   }
+   keepstash() ;
+   prunecaches() ;
    hashpop = 0 ;
-   memset(hashtab, 0, sizeof(node *) * hashprime) ;
+   memset((void *)hashtab, 0, sizeof(hashbucket) * hashbuckets) ;
    freenodes = 0 ;
-   for (p=nodeblocks; p; p=p->next) {
+   for (p=nodeblocks; p; p=nextfree(p)) {
       poller->poll() ;
       for (pp=p+1, i=1; i<1001; i++, pp++) {
          if (marked(pp)) {
-            g_uintptr_t h = 0 ;
             if (pp->nw) { /* yes, it's a node */
-               h = node_hash(pp->nw, pp->ne, pp->sw, pp->se) % hashprime ;
+               unmarkres(pp) ;
             } else {
                leaf *lp = (leaf *)pp ;
+               lp->gcmark = 0 ;
                if (invalidate)
                   leafres(lp) ;
-               h = leaf_hash(lp->nw, lp->ne, lp->sw, lp->se) % hashprime ;
             }
-            pp->next = hashtab[h] ;
-            hashtab[h] = pp ;
+            hashinsert(pp, hashhome(pp)) ;
             hashpop++ ;
          } else {
-            pp->next = freenodes ;
+            setfree(pp, freenodes) ;
             freenodes = pp ;
             freed_nodes++ ;
          }
       }
    }
+   freecount = freed_nodes ;
    inGC = 0 ;
+   double pause = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - start).count() ;
    if (verbose) {
      int perc = (int)(freed_nodes / (totalthings / 100)) ;
-     sprintf(statusline+strlen(statusline), " freed %d percent (%d).",
-                                                   perc, (int)freed_nodes) ;
+     sprintf(statusline+strlen(statusline),
+             " freed %d percent (%d); paused %.1f ms.",
+             perc, (int)freed_nodes, 1000 * pause) ;
      lifestatus(statusline) ;
    }
+   gclastcost = pause ;
    if (needPop) {
       calcPopulation(root) ;
       popValid = 1 ;
@@ -1325,12 +2697,247 @@ void hlifealgo::do_gc(int invalidate) {
       poller->updatePop() ;
    }
 }
+/*
+ *   Start an incremental gc.  We mark from the roots (the gc stack, the
+ *   zero nodes, the timeline and the root) a slice at a time, and then
+ *   sweep the hash a bucket at a time, all while the calculation keeps
+ *   going.  That is safe because:
+ *
+ *   -  New nodes made while we mark are marked and queued, so anything
+ *      they point to will be marked too.
+ *   -  Once a node is marked, the only way it can gain a pointer is
+ *      through its cache field, and getres() marks any result it puts
+ *      into a marked node.
+ *   -  The roots change as we go, so when the queue runs dry we mark
+ *      from them once more (normally very little work) before we sweep.
+ *   -  While we sweep, new nodes in buckets we have not yet reached are
+ *      marked so they survive, and if a lookup in such a bucket finds
+ *      an unmarked node we free it then and there rather than hand out
+ *      a node that is about to be freed.
+ *
+ *   Slices are only done where a full gc would be allowed (okaytogc),
+ *   so the usual rules about what must be on the stack still hold.  We
+ *   pace the slices so we should be done well before memory runs out;
+ *   if it does run out anyway, newnode() just finishes the job.
+ */
+void hlifealgo::startgc() {
+   std::chrono::steady_clock::time_point start =
+                                      std::chrono::steady_clock::now() ;
+   gccount++ ;
+   gcstep++ ;
+   if (verbose) {
+     if (gcstep > 1)
+       sprintf(statusline, "GC #%d(%d) started.", gccount, gcstep) ;
+     else
+       sprintf(statusline, "GC #%d started.", gccount) ;
+     lifestatus(statusline) ;
+   }
+   gcphase = 1 ;
+   gcfreed = 0 ;
+   gcdebt = 0 ;
+   gcmaxpause = 0 ;
+   gctotal = 0 ;
+   // marking is at most hashpop nodes and sweeping visits every
+   // bucket and node; we want it all done within half the room left
+   g_uintptr_t room = freecount ;
+   if (maxmem > alloced)
+      room += (maxmem - alloced) / sizeof(node) ;
+   gcrate = (2 * hashpop + hashbuckets) / (room / 2 + 1) + 1 ;
+   gcmarkroots() ;
+   gcmaxpause = gctotal = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - start).count() ;
+}
+/*
+ *   Mark a node if it isn't already, and queue it so its children and
+ *   result get marked too.
+ */
+void hlifealgo::gcshade(node *n) {
+   if (gcmarked(n))
+      return ;
+   if (!is_node(n)) {
+      ((leaf *)n)->gcmark = 1 ;
+      return ;
+   }
+   markres(n) ;
+   if (gcphase != 1)
+      return ;
+   if (graysp >= graysize) {
+      int ngraysize = graysize * 2 + 100 ;
+      graystack = (node **)realloc(graystack, ngraysize * sizeof(node *)) ;
+      if (graystack == 0)
+        lifefatal("Out of memory (4).") ;
+      graysize = ngraysize ;
+   }
+   graystack[graysp++] = n ;
+}
+void hlifealgo::gcmarkroots() {
+   int i ;
+   for (i=nzeros-1; i>=0; i--)
+      if (zeronodea[i] != 0)
+         break ;
+   if (i >= 0)
+      gcshade(zeronodea[i]) ;
+   for (i=0; i<gsp; i++)
+      gcshade(stack[i]) ;
+   for (i=0; i<timeline.framecount; i++)
+      if (timeline.frames[i])
+         gcshade((node *)timeline.frames[i]) ;
+   if (hashed && root)
+      gcshade(root) ;
+}
+/*
+ *   Mark from the queue, doing at most about work nodes; returns true
+ *   if the queue is empty.
+ */
+int hlifealgo::gcdrain(g_uintptr_t work) {
+   while (graysp > 0 && work > 0) {
+      node *n = graystack[--graysp] ;
+      gcshade(n->nw) ;
+      gcshade(n->ne) ;
+      gcshade(n->sw) ;
+      gcshade(n->se) ;
+      if (resof(n))
+         gcshade(resof(n)) ;
+      work-- ;
+   }
+   return graysp == 0 ;
+}
+/*
+ *   Free the unmarked node in slot i of bucket b, taking it out of the
+ *   overflow counts of the buckets it went past.
+ */
+void hlifealgo::sweepnode(g_uintptr_t b, int i) {
+   hashbucket *hb = hashtab + b ;
+   node *p = hb->slot[i] ;
+   for (g_uintptr_t x=hashhome(p)&hashmask; x!=b; x=(x+1)&hashmask)
+      if (hashtab[x].overflow < 255)
+         hashtab[x].overflow = hashtab[x].overflow - 1 ;
+   hb->slot[i] = 0 ;
+   hb->fp[i] = 0 ;
+   setfree(p, freenodes) ;
+   freenodes = p ;
+   freecount++ ;
+   hashpop-- ;
+   gcfreed++ ;
+}
+/*
+ *   Sweep one hash bucket, freeing the unmarked nodes and clearing the
+ *   marks on the others.  Returns how many nodes we looked at.
+ */
+g_uintptr_t hlifealgo::sweepbucket(g_uintptr_t b) {
+   g_uintptr_t seen = 0 ;
+   hashbucket *hb = hashtab + b ;
+   for (int i=0; i<HASHSLOTS; i++) {
+      if (hb->fp[i] == 0)
+         continue ;
+      node *p = hb->slot[i] ;
+      seen++ ;
+      if (gcmarked(p)) {
+         if (is_node(p))
+            unmarkres(p) ;
+         else
+            ((leaf *)p)->gcmark = 0 ;
+      } else
+         sweepnode(b, i) ;
+   }
+   return seen ;
+}
+/*
+ *   Clear every gc mark.
+ */
+void hlifealgo::clearmarks() {
+   node *p, *pp ;
+   int i ;
+   for (p=nodeblocks; p; p=nextfree(p)) {
+      poller->poll() ;
+      for (pp=p+1, i=1; i<1001; i++, pp++)
+         if (pp->nw)
+            unmarkres(pp) ;
+         else
+            ((leaf *)pp)->gcmark = 0 ;
+   }
+}
+/*
+ *   Do one slice of the incremental gc.
+ */
+void hlifealgo::gcslice() {
+   std::chrono::steady_clock::time_point start =
+                                      std::chrono::steady_clock::now() ;
+   g_uintptr_t work = gcdebt ;
+   gcdebt = 0 ;
+   if (gcphase == 1) {
+      if (gcdrain(work)) {
+         gcmarkroots() ;
+         gcdrain(G_MAX) ;
+         keepstash() ;
+         prunecaches() ;
+         gcphase = 2 ;
+         sweepnext = 0 ;
+      }
+   } else {
+      while (work > 0 && sweepnext < hashbuckets) {
+#ifdef __GNUC__
+         // the nodes are all over memory; ask for some a bucket ahead
+         if (sweepnext + 2 < hashbuckets) {
+            hashbucket *hb = hashtab + sweepnext + 2 ;
+            for (int i=0; i<HASHSLOTS; i++)
+               if (hb->fp[i])
+                  __builtin_prefetch(hb->slot[i]) ;
+         }
+#endif
+         g_uintptr_t seen = 1 + sweepbucket(sweepnext++) ;
+         work = (seen >= work) ? 0 : work - seen ;
+      }
+   }
+   double pause = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - start).count() ;
+   gctotal += pause ;
+   if (pause > gcmaxpause)
+      gcmaxpause = pause ;
+   if (gcphase == 2 && sweepnext >= hashbuckets)
+      gcdone(0) ;
+}
+/*
+ *   Finish the current incremental gc right now.
+ */
+void hlifealgo::finishgc() {
+   std::chrono::steady_clock::time_point start =
+                                      std::chrono::steady_clock::now() ;
+   if (gcphase == 1) {
+      gcdrain(G_MAX) ;
+      gcmarkroots() ;
+      gcdrain(G_MAX) ;
+      keepstash() ;
+      prunecaches() ;
+      gcphase = 2 ;
+      sweepnext = 0 ;
+   }
+   while (sweepnext < hashbuckets)
+      sweepbucket(sweepnext++) ;
+   gcdone(std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start).count()) ;
+}
+void hlifealgo::gcdone(double pause) {
+   gcphase = 0 ;
+   gctotal += pause ;
+   gclastcost = gctotal ;
+   if (pause > gcmaxpause)
+      gcmaxpause = pause ;
+   if (verbose) {
+     int perc = (int)(gcfreed / (totalthings / 100)) ;
+     sprintf(statusline,
+             "GC #%d freed %d percent (%d); longest pause %.1f ms of %.1f.",
+             gccount, perc, (int)gcfreed, 1000 * gcmaxpause, 1000 * gctotal) ;
+     lifestatus(statusline) ;
+   }
+}
 /*
  *   Clear the cache bits down to the appropriate level, marking the
  *   nodes we've handled.
  */
 void hlifealgo::clearcache(node *n, int depth, int clearto) {
    if (!marked(n)) {
+      int full = depth - 1 ; // log2 of a full step for this node
       mark(n) ;
       if (depth > 3) {
          depth-- ;
@@ -1339,11 +2946,93 @@ void hlifealgo::clearcache(node *n, int depth, int clearto) {
          clearcache(n->ne, depth, clearto) ;
          clearcache(n->sw, depth, clearto) ;
          clearcache(n->se, depth, clearto) ;
-         if (n->res)
-            clearcache(n->res, depth, clearto) ;
+         if (resof(n))
+            clearcache(resof(n), depth, clearto) ;
+      }
+      if (depth >= clearto && resof(n)) {
+         stashres(n, stashgens < full ? stashgens : full, full, resof(n)) ;
+         setres(n, 0) ;
       }
-      if (depth >= clearto)
-         n->res = 0 ;
+   }
+}
+/*
+ *   When the step size changes, the results in the res fields that
+ *   depend on it would be lost, and scripts and the GUI change it all
+ *   the time (going back and forth between a big step and a single
+ *   generation, say).  So clearcache() moves them here instead, keyed
+ *   by node and by log2 of how many generations they go, and getres()
+ *   looks here before working a result out again.
+ *
+ *   The stash is a table of fixed size (an eighth of the memory
+ *   limit), two slots to a home; a new entry takes an empty slot or
+ *   else the one holding the shallower result, so the deepest, most
+ *   costly results are the ones we keep.  For the gc, an entry keeps
+ *   its result alive as long as its node is alive (see keepstash()).
+ */
+static const int STASHFRACTION = 8 ;
+static inline g_uintptr_t stashhome(node *n, int gens, int shift) {
+   return (g_uintptr_t)((((unsigned long long)(g_uintptr_t)n + gens) *
+                         0x9e3779b97f4a7c15ULL) >> shift) ;
+}
+void hlifealgo::stashres(node *n, int gens, int depth, node *r) {
+   if (stash == 0) {
+      g_uintptr_t size = 1 << 12 ;
+      while (2 * size * sizeof(stashentry) <= maxmem / STASHFRACTION)
+         size *= 2 ;
+      g_uintptr_t bytes = size * sizeof(stashentry) ;
+      if (alloced > maxmem || bytes > maxmem - alloced)
+         return ;
+      stash = (stashentry *)calloc(size, sizeof(stashentry)) ;
+      if (stash == 0)
+         return ;
+      alloced += bytes ;
+      stashmask = size - 1 ;
+      for (stashshift=64; size>1; size>>=1)
+         stashshift-- ;
+   }
+   stashentry *e = stash + (stashhome(n, gens, stashshift) & ~(g_uintptr_t)1) ;
+   if ((node *)e[1].n == n && e[1].gens == gens)
+      e++ ;
+   else if (((node *)e[0].n != n || e[0].gens != gens) && HRAW(e[0].n) &&
+            (HRAW(e[1].n) == 0 || e[1].depth < e[0].depth))
+      e++ ;
+   if (HRAW(e->n) == 0)
+      stashcount++ ;
+   else if (e->depth > depth)
+      return ;
+   e->n = n ;
+   e->r = r ;
+   e->gens = (unsigned char)gens ;
+   e->depth = (unsigned char)depth ;
+}
+node *hlifealgo::unstash(node *n, int gens) {
+   stashentry *e = stash + (stashhome(n, gens, stashshift) & ~(g_uintptr_t)1) ;
+   for (int i=0; i<2; i++, e++)
+      if ((node *)e->n == n && e->gens == gens)
+         return e->r ;
+   return 0 ;
+}
+/*
+ *   The gc calls this once everything else is marked:  the results of
+ *   entries whose nodes will live are marked too, and then (in
+ *   prunecaches()) we drop the entries whose node or result is not.
+ */
+void hlifealgo::keepstash() {
+   int more = 1 ;
+   while (more) { // a result kept can be the node of another entry
+      more = 0 ;
+      for (g_uintptr_t i=0; stashcount && i<=stashmask; i++) {
+         stashentry &e = stash[i] ;
+         if (HRAW(e.n) && gcmarked((node *)e.n) && !gcmarked((node *)e.r)) {
+            if (gcphase == 1)
+               gcshade(e.r) ;
+            else
+               gc_mark(e.r, 0) ;
+            more = 1 ;
+         }
+      }
+      if (gcphase == 1)
+         gcdrain(G_MAX) ;
    }
 }
 /*
@@ -1360,7 +3049,7 @@ void hlifealgo::clearcache() {
  */
 void hlifealgo::new_ngens(int newval) {
    g_uintptr_t i ;
-   node *p, *pp ;
+   int j ;
    int clearto = ngens ;
    if (newval > ngens && halvesdone == 0) {
       ngens = newval ;
@@ -1375,17 +3064,18 @@ void hlifealgo::new_ngens(int newval) {
    clearto++ ; /* clear this depth and above */
    if (clearto < 3)
       clearto = 3 ;
+   stashgens = ngens ;
    ngens = newval ;
    inGC = 1 ;
-   for (i=0; i<hashprime; i++)
-      for (p=hashtab[i]; p; p=clearmarkbit(p->next))
-         if (is_node(p) && !marked(p))
+   if (gcphase) // we use the gc marks
+      finishgc() ;
+   for (i=0; i<hashbuckets; i++)
+      for (j=0; j<HASHSLOTS; j++) {
+         node *p = hashtab[i].slot[j] ;
+         if (hashtab[i].fp[j] && is_node(p) && !marked(p))
             clearcache(p, node_depth(p), clearto) ;
-   for (p=nodeblocks; p; p=p->next) {
-      poller->poll() ;
-      for (pp=p+1, i=1; i<1001; i++, pp++)
-         clearmark(pp) ;
-   }
+      }
+   clearmarks() ;
    halvesdone = 0 ;
    inGC = 0 ;
    if (needPop) {
@@ -1454,32 +3144,642 @@ node *hlifealgo::runpattern() {
    depth++ ;
    n = pushroot(n) ;
    depth++ ;
-   while (ngens + 2 > depth) {
+   // an increment that isn't a power of two can be up to twice 2^ngens,
+   // so it needs one more level of border
+   int pow2 = (inclow == ngens) ;
+   while (ngens + 3 - pow2 > depth) {
       n = pushroot(n) ;
       depth++ ;
    }
    save(zeronode(nzeros-1)) ;
    save(n) ;
-   n2 = getres(n, depth) ;
+   if (threads.getthreads() > 1)
+      beginparallel() ;
+   if (gridmasked)
+      n2 = gridres(n, depth, -((G_INT64)1 << depth), -((G_INT64)1 << depth)) ;
+   else
+      n2 = pow2 ? getres(n, depth) : advance(n, depth) ;
+   if (threads.getthreads() > 1)
+      endparallel() ;
    okaytogc = 0 ;
    clearstack() ;
    if (halvesdone == 1) {
-      n->res = 0 ;
+      setres(n, 0) ;
       halvesdone = 0 ;
    }
    if (poller->isInterrupted())
       return 0 ; // indicate it was interrupted
    n = popzeros(n2) ;
-   generation += pow2step ;
+   generation += setincrement ;
    return n ;
 }
-const char *hlifealgo::readmacrocell(char *line) {
-   int n=0 ;
-   g_uintptr_t i=1, nw=0, ne=0, sw=0, se=0, indlen=0 ;
-   int r, d ;
-   node **ind = 0 ;
-   root = 0 ;
-   while (getline(line, 10000)) {
+/*
+ *   Bounded grids.  We used to step these a generation at a time, with
+ *   the edges copied across (or cleared) cell by cell in between; now
+ *   the hashing does the work.  Tori, tubes and shifted tori are done
+ *   by padding the grid with copies of the cells from the far side, as
+ *   far out as the step can reach, running the padded pattern as usual,
+ *   and cropping the result back to the grid.  That won't do for a
+ *   bounded plane, where what's outside has to be cleared after every
+ *   generation, so there gridres() takes the place of getres().  Klein
+ *   bottles, cross-surfaces and spheres still use the old way.
+ */
+int hlifealgo::gridCapable() {
+   return !sphere && !htwist && !vtwist ;
+}
+/*
+ *   Coordinates stay well inside 64 bits; a grid that is unbounded in
+ *   one direction is bounded far away instead.
+ */
+static const int GRIDMAXDEPTH = 60 ;
+static const G_INT64 GRIDFAR = (G_INT64)1 << 61 ;
+/*
+ *   The padding is made of whole copies of the grid, so a step can go
+ *   no further than the grid's smaller side; and a bounded plane only
+ *   steps by powers of two.  So we go by the largest power of two that
+ *   divides the increment and fits, as many times as it takes.
+ */
+void hlifealgo::gridincrement(bigint &inc, bigint &times) {
+   times = 1 ;
+   if (inc <= 0)
+      return ;
+   unsigned int side = gridwd ;
+   if (side == 0 || (gridht > 0 && gridht < side))
+      side = gridht ;
+   int k = 0 ;
+   while (k < 30 && ((unsigned int)2 << k) <= side)
+      k++ ;
+   int low = inc.lowbitset() ;
+   if (low < k)
+      k = low ;
+   times = inc ;
+   times >>= k ;
+   inc = 1 ;
+   inc <<= k ;
+}
+/*
+ *   One step (of 2^ngens generations) on a bounded grid.
+ */
+node *hlifealgo::rungrid() {
+   ensure_hashed() ;
+   gridbox[0] = gridwd ? gridleft.toint() : -GRIDFAR ;
+   gridbox[1] = gridht ? -gridbottom.toint() : -GRIDFAR ;
+   gridbox[2] = gridwd ? gridright.toint() : GRIDFAR ;
+   gridbox[3] = gridht ? -gridtop.toint() : GRIDFAR ;
+   int d = node_depth(root) ;
+   G_INT64 g = (G_INT64)1 << ngens ;
+   G_INT64 pad[4] = { gridbox[0], gridbox[1], gridbox[2], gridbox[3] } ;
+   if (!boundedplane) {
+      if (gridwd) {
+         pad[0] -= g ;
+         pad[2] += g ;
+      }
+      if (gridht) {
+         pad[1] -= g ;
+         pad[3] += g ;
+      }
+   }
+   int pd = d ;
+   while (pd <= GRIDMAXDEPTH &&
+          ((gridwd && (pad[0] < -((G_INT64)1 << pd) ||
+                       pad[2] >= ((G_INT64)1 << pd))) ||
+           (gridht && (pad[1] < -((G_INT64)1 << pd) ||
+                       pad[3] >= ((G_INT64)1 << pd)))))
+      pd++ ;
+   if (pd > GRIDMAXDEPTH) {
+      lifestatus("Pattern is beyond editing limit!") ;
+      return 0 ;
+   }
+   node *was = save(root) ;
+   /*
+    *   A bounded plane starts from the whole pattern, so cells outside
+    *   the grid take part in the first generation and are cleared after
+    *   it, just as DeleteBorderCells() does for the other algorithms.
+    *   (On a torus or tube they can't reach the grid before the copies
+    *   cover them, so cropping first changes nothing.)
+    */
+   node *c = boundedplane ? root : shifted(root, d, 0, 0, gridbox, d) ;
+   node *n = c ;
+   for (int i=d; i<pd; i++)
+      n = pushroot(n) ;
+   if (!boundedplane) {
+      /*
+       *   The copies are at the sums of (gridwd, vshift) and (hshift,
+       *   gridht) (y going up); with a shift, the next row of copies
+       *   can start up to a whole grid over, so we go two each way.
+       */
+      int ra = 0, rb = 0 ;
+      if (gridwd)
+         ra = vshift ? 2 : 1 ;
+      if (gridht)
+         rb = hshift ? 2 : 1 ;
+      for (int a=-ra; a<=ra; a++)
+         for (int b=-rb; b<=rb; b++) {
+            if (a == 0 && b == 0)
+               continue ;
+            G_INT64 dx = (G_INT64)a * gridwd + (G_INT64)b * hshift ;
+            G_INT64 dy = (G_INT64)a * vshift + (G_INT64)b * gridht ;
+            G_INT64 clip[4] = {
+               gridbox[0] > pad[0] - dx ? gridbox[0] : pad[0] - dx,
+               gridbox[1] > pad[1] - dy ? gridbox[1] : pad[1] - dy,
+               gridbox[2] < pad[2] - dx ? gridbox[2] : pad[2] - dx,
+               gridbox[3] < pad[3] - dy ? gridbox[3] : pad[3] - dy
+            } ;
+            if (clip[0] > clip[2] || clip[1] > clip[3])
+               continue ;
+            n = unionof(n, shifted(c, d, dx, dy, clip, pd), pd) ;
+         }
+   }
+   root = n ;
+   gridmasked = boundedplane ;
+   n = runpattern() ;
+   gridmasked = 0 ;
+   root = was ;
+   if (n == 0)
+      return 0 ;
+   d = node_depth(n) ;
+   n = popzeros(shifted(n, d, 0, 0, gridbox, d)) ;
+   clearstack() ;
+   return n ;
+}
+/*
+ *   The same as getres(), but every generation the cells outside the
+ *   grid are cleared; x and y are where the node's lower left corner
+ *   is.  A node wholly inside the grid never sees the outside, so
+ *   getres() does for it, and one whose center is wholly outside has
+ *   an empty result.  The rest go the way dorecurs() does, down to
+ *   16-squares, which we run a cell at a time.
+ */
+node *hlifealgo::gridres(node *n, int depth, G_INT64 x, G_INT64 y) {
+   G_INT64 size = (G_INT64)2 << depth, q = size >> 2 ;
+   if (x >= gridbox[0] && x + size - 1 <= gridbox[2] &&
+       y >= gridbox[1] && y + size - 1 <= gridbox[3])
+      return getres(n, depth) ;
+   if (n == zeronode(depth) ||
+       x + 3 * q <= gridbox[0] || x + q > gridbox[2] ||
+       y + 3 * q <= gridbox[1] || y + q > gridbox[3])
+      return zeronode(depth-1) ;
+   gridentry e ;
+   e.mask[0] = gridbox[0] > x ? gridbox[0] - x : 0 ;
+   e.mask[1] = gridbox[1] > y ? gridbox[1] - y : 0 ;
+   e.mask[2] = gridbox[2] < x + size - 1 ? gridbox[2] - x : size - 1 ;
+   e.mask[3] = gridbox[3] < y + size - 1 ? gridbox[3] - y : size - 1 ;
+   gridentry *p = gridsteps.get(n) ;
+   if (p && memcmp(p->mask, e.mask, sizeof(e.mask)) == 0)
+      return save(p->r) ;
+   if (poller->poll())
+      return zeronode(depth-1) ;
+   int sp = stackmark() ;
+   node *res ;
+   if (depth == 3) {
+      res = (node *)gridleaf(n, x, y, ngens >= 2 ? 4 : 1 << ngens) ;
+   } else {
+      int d = depth - 1 ;
+      node *nw = n->nw, *ne = n->ne, *sw = n->sw, *se = n->se ;
+      node *t[9] = {
+         nw, find_node(nw->ne, ne->nw, nw->se, ne->sw), ne,
+         find_node(nw->sw, nw->se, sw->nw, sw->ne),
+         find_node(nw->se, ne->sw, sw->ne, se->nw),
+         find_node(ne->sw, ne->se, se->nw, se->ne),
+         sw, find_node(sw->ne, se->nw, sw->se, se->sw), se
+      } ;
+      for (int i=0; i<9; i++)
+         t[i] = gridres(t[i], d, x + (i % 3) * q, y + (2 - i / 3) * q) ;
+      node *r[4] ;
+      for (int i=0; i<4; i++) {
+         int j = (i >> 1) * 3 + (i & 1) ;
+         node *m = find_node(t[j], t[j+1], t[j+3], t[j+4]) ;
+         if (ngens >= d)
+            r[i] = gridres(m, d, x + (i & 1) * q + q / 2,
+                           y + (1 - (i >> 1)) * q + q / 2) ;
+         else
+            r[i] = centerof(m, d) ;
+      }
+      res = find_node(r[0], r[1], r[2], r[3]) ;
+   }
+   pop(sp) ;
+   if (poller->isInterrupted())
+      return zeronode(depth-1) ;
+   e.r = res ;
+   if ((p = gridsteps.get(n)) != 0)
+      *p = e ;
+   else if (makeroom(gridsteps))
+      gridsteps.insert(n, e) ;
+   return save(res) ;
+}
+/*
+ *   One row (0 is the top) of a leaf, as eight bits.
+ */
+static inline unsigned int leafrow(leaf *l, int r) {
+   int s = 12 - 4 * (r & 3) ;
+   if (r < 4)
+      return (((l->nw >> s) & 15) << 4) | ((l->ne >> s) & 15) ;
+   return (((l->sw >> s) & 15) << 4) | ((l->se >> s) & 15) ;
+}
+/*
+ *   And back again.
+ */
+leaf *hlifealgo::rowsleaf(const unsigned char *row) {
+   unsigned short q[4] = { 0, 0, 0, 0 } ;
+   for (int r=0; r<8; r++) {
+      int s = 12 - 4 * (r & 3), k = (r < 4 ? 0 : 2) ;
+      q[k] |= (unsigned short)((row[r] >> 4) << s) ;
+      q[k+1] |= (unsigned short)((row[r] & 15) << s) ;
+   }
+   return find_leaf(q[0], q[1], q[2], q[3]) ;
+}
+/*
+ *   The center 8-square of a 16-square (lower left at x, y) after one,
+ *   two or four generations, clearing the cells outside the grid after
+ *   each.  Each row is sixteen bits, and we use the ruletable to make
+ *   each 2-square from the 4-square around it; the edges go bad by a
+ *   cell a generation, but the center is still good after four.
+ */
+leaf *hlifealgo::gridleaf(node *n, G_INT64 x, G_INT64 y, int gens) {
+   leaf *l[4] = { (leaf *)n->nw, (leaf *)n->ne, (leaf *)n->sw,
+                  (leaf *)n->se } ;
+   unsigned int row[16], next[16], cols = 0 ;
+   for (int r=0; r<8; r++) {
+      row[r] = (leafrow(l[0], r) << 8) | leafrow(l[1], r) ;
+      row[r+8] = (leafrow(l[2], r) << 8) | leafrow(l[3], r) ;
+   }
+   for (int i=0; i<16; i++)
+      if (gridbox[0] <= x + i && x + i <= gridbox[2])
+         cols |= 0x8000 >> i ;
+   while (gens-- > 0) {
+      for (int r=0; r<16; r++)
+         next[r] = 0 ;
+      for (int r=1; r<15; r+=2)
+         for (int c=1; c<15; c+=2) {
+            int s = 13 - c ;
+            int t = ruletable[(((row[r-1] >> s) & 15) << 12) |
+                              (((row[r] >> s) & 15) << 8) |
+                              (((row[r+1] >> s) & 15) << 4) |
+                              ((row[r+2] >> s) & 15)] ;
+            next[r] |= (((t >> 5) & 1) << (s + 2)) |
+                       (((t >> 4) & 1) << (s + 1)) ;
+            next[r+1] |= (((t >> 1) & 1) << (s + 2)) | ((t & 1) << (s + 1)) ;
+         }
+      for (int r=0; r<16; r++) {
+         G_INT64 yy = y + 15 - r ;
+         row[r] = (yy < gridbox[1] || yy > gridbox[3]) ? 0 : next[r] & cols ;
+      }
+   }
+   unsigned char out[8] ;
+   for (int r=0; r<8; r++)
+      out[r] = (unsigned char)(row[r+4] >> 4) ;
+   return rowsleaf(out) ;
+}
+/*
+ *   The node of depth d with its lower left corner at x, y from the
+ *   lower left corner of n (of depth ndepth); outside n it's empty.
+ */
+node *hlifealgo::nodeat(node *n, int ndepth, G_INT64 x, G_INT64 y, int d) {
+   if (x < 0 || y < 0 || x >= ((G_INT64)2 << ndepth) ||
+       y >= ((G_INT64)2 << ndepth))
+      return zeronode(d) ;
+   for (; ndepth > d; ndepth--) {
+      if (n == zeronode(ndepth))
+         return zeronode(d) ;
+      G_INT64 half = (G_INT64)1 << ndepth ;
+      if (y >= half) {
+         n = (x >= half ? n->ne : n->nw) ;
+         y -= half ;
+      } else {
+         n = (x >= half ? n->se : n->sw) ;
+      }
+      if (x >= half)
+         x -= half ;
+   }
+   return n ;
+}
+/*
+ *   The node of depth d with its lower left corner at x, y (each less
+ *   than its size) in the square made of c[0..3] (nw, ne, sw, se, each
+ *   of depth d), keeping only the cells in the box (left, bottom,
+ *   right, top, inclusive, from the same corner).
+ */
+node *hlifealgo::subsquare(node **c, int d, G_INT64 x, G_INT64 y,
+                           const G_INT64 *box) {
+   node *z = zeronode(d) ;
+   G_INT64 size = (G_INT64)2 << d ;
+   if ((c[0] == z && c[1] == z && c[2] == z && c[3] == z) ||
+       box[0] >= x + size || box[2] < x || box[1] >= y + size || box[3] < y)
+      return z ;
+   if (x == 0 && y == 0 && box[0] <= 0 && box[2] >= size - 1 &&
+       box[1] <= 0 && box[3] >= size - 1)
+      return c[2] ;
+   if (d == 2) {
+      unsigned int row[16], cols = 0 ;
+      for (int r=0; r<8; r++) {
+         row[r] = (leafrow((leaf *)c[0], r) << 8) | leafrow((leaf *)c[1], r) ;
+         row[r+8] = (leafrow((leaf *)c[2], r) << 8) |
+                    leafrow((leaf *)c[3], r) ;
+      }
+      for (int i=0; i<8; i++)
+         if (box[0] <= x + i && x + i <= box[2])
+            cols |= 128 >> i ;
+      unsigned char out[8] ;
+      for (int k=0; k<8; k++) {
+         G_INT64 yy = y + 7 - k ;
+         if (yy < box[1] || yy > box[3])
+            out[k] = 0 ;
+         else
+            out[k] = (unsigned char)((row[8 - y + k] >> (8 - x)) & cols) ;
+      }
+      return (node *)rowsleaf(out) ;
+   }
+   // the sixteen grandchildren, top row first
+   node *g[16] ;
+   for (int i=0; i<4; i++) {
+      int k = (i >> 1) * 8 + (i & 1) * 2 ;
+      g[k] = c[i]->nw ;
+      g[k+1] = c[i]->ne ;
+      g[k+4] = c[i]->sw ;
+      g[k+5] = c[i]->se ;
+   }
+   G_INT64 h = size >> 1 ;
+   node *r[4] ;
+   for (int i=0; i<4; i++) {
+      G_INT64 qx = x + (i & 1) * h, qy = y + (i < 2 ? h : 0) ;
+      int gi = (int)(qx / h), gj = (int)(qy / h) ;
+      node *gc[4] = { g[(2-gj)*4+gi], g[(2-gj)*4+gi+1],
+                      g[(3-gj)*4+gi], g[(3-gj)*4+gi+1] } ;
+      G_INT64 b[4] = { box[0] - gi * h, box[1] - gj * h,
+                       box[2] - gi * h, box[3] - gj * h } ;
+      r[i] = subsquare(gc, d-1, qx - gi * h, qy - gj * h, b) ;
+   }
+   return find_node(r[0], r[1], r[2], r[3]) ;
+}
+/*
+ *   A node of depth d, centered as the root is, holding the cells of n
+ *   (of depth ndepth, also centered) that are in the box (left, bottom,
+ *   right, top, inclusive, in n's coordinates), moved over by dx, dy.
+ */
+node *hlifealgo::shifted(node *n, int ndepth, G_INT64 dx, G_INT64 dy,
+                         const G_INT64 *box, int d) {
+   for (; ndepth < d; ndepth++)
+      n = pushroot(n) ;
+   G_INT64 size = (G_INT64)2 << d, half = (G_INT64)1 << ndepth ;
+   // where the new node's lower left corner falls, from n's
+   G_INT64 x = half - (size >> 1) - dx, y = half - (size >> 1) - dy ;
+   G_INT64 cx = x & -size, cy = y & -size ;
+   node *c[4] = {
+      nodeat(n, ndepth, cx, cy + size, d),
+      nodeat(n, ndepth, cx + size, cy + size, d),
+      nodeat(n, ndepth, cx, cy, d),
+      nodeat(n, ndepth, cx + size, cy, d)
+   } ;
+   G_INT64 b[4] = { box[0] + half - cx, box[1] + half - cy,
+                    box[2] + half - cx, box[3] + half - cy } ;
+   return subsquare(c, d, x - cx, y - cy, b) ;
+}
+/*
+ *   The strip routines walk just the part of the tree that covers the
+ *   rectangle, a leaf row at a time, rather than going down from the
+ *   root for every cell.  The box is left, bottom, right, top
+ *   (inclusive) in tree coordinates, and the first row of states is
+ *   its top.  Every int coordinate is inside the node of this depth
+ *   centered on the origin, so we only ever need to work on that.
+ */
+static const int STRIPDEPTH = 31 ;
+static void stripbox(int x, int y, int wd, int ht, G_INT64 *box) {
+   box[0] = x ;
+   box[1] = - (G_INT64)y - ht + 1 ;
+   box[2] = (G_INT64)x + wd - 1 ;
+   box[3] = - (G_INT64)y ;
+}
+void hlifealgo::getstrip(int x, int y, int wd, int ht,
+                         unsigned char *states) {
+   if (wd <= 0 || ht <= 0)
+      return ;
+   memset(states, 0, (size_t)wd * ht) ;
+   if (bulkactive)
+      bulkflush() ;
+   G_INT64 box[4] ;
+   stripbox(x, y, wd, ht, box) ;
+   struct node tnode = *root ;
+   int d = depth ;
+   while (d > STRIPDEPTH) {
+      tnode.nw = tnode.nw->se ;
+      tnode.ne = tnode.ne->sw ;
+      tnode.sw = tnode.sw->ne ;
+      tnode.se = tnode.se->nw ;
+      d-- ;
+   }
+   G_INT64 half = (G_INT64)1 << d ;
+   stripget(d < depth ? &tnode : root, d, -half, -half, box, states) ;
+}
+int hlifealgo::putstrip(int x, int y, int wd, int ht,
+                        const unsigned char *states) {
+   if (wd <= 0 || ht <= 0)
+      return 0 ;
+   for (size_t i=0; i<(size_t)wd * ht; i++)
+      if (states[i] & ~1)
+         return -1 ;
+   stripwrite(x, y, wd, ht, states) ;
+   return 0 ;
+}
+void hlifealgo::clearstrip(int x, int y, int wd, int ht) {
+   if (wd > 0 && ht > 0)
+      stripwrite(x, y, wd, ht, 0) ;
+}
+/*
+ *   Grow the root to hold the rectangle, just as setcell() would, and
+ *   put the states in (or clear it, if states is null).
+ */
+void hlifealgo::stripwrite(int x, int y, int wd, int ht,
+                           const unsigned char *states) {
+   ensure_hashed() ;
+   G_INT64 box[4] ;
+   stripbox(x, y, wd, ht, box) ;
+   while (states && depth < STRIPDEPTH) {
+      G_INT64 half = (G_INT64)1 << depth ;
+      if (box[0] >= -half && box[1] >= -half && box[2] < half &&
+          box[3] < half)
+         break ;
+      root = pushroot(root) ;
+      depth++ ;
+   }
+   root = stripcenter(root, depth, box, states) ;
+   clearstack() ;
+   popValid = 0 ;
+}
+/*
+ *   Copy the cells of n (of depth d, lower left corner at x, y) that
+ *   are in the box into states.
+ */
+void hlifealgo::stripget(node *n, int d, G_INT64 x, G_INT64 y,
+                         const G_INT64 *box, unsigned char *states) {
+   G_INT64 size = (G_INT64)2 << d ;
+   if (n == 0 || n == zeronode(d) || x > box[2] || x + size <= box[0] ||
+       y > box[3] || y + size <= box[1])
+      return ;
+   G_INT64 wd = box[2] - box[0] + 1 ;
+   if (d == 2) {
+      for (int r=0; r<8; r++) {
+         G_INT64 yy = y + 7 - r ;
+         unsigned int bits = leafrow((leaf *)n, r) ;
+         if (bits == 0 || yy < box[1] || yy > box[3])
+            continue ;
+         unsigned char *row = states + (box[3] - yy) * wd - box[0] ;
+         for (int i=0; i<8; i++)
+            if ((bits & (128 >> i)) && x + i >= box[0] && x + i <= box[2])
+               row[x + i] = 1 ;
+      }
+      return ;
+   }
+   G_INT64 half = size >> 1 ;
+   stripget(n->nw, d-1, x, y + half, box, states) ;
+   stripget(n->ne, d-1, x + half, y + half, box, states) ;
+   stripget(n->sw, d-1, x, y, box, states) ;
+   stripget(n->se, d-1, x + half, y, box, states) ;
+}
+/*
+ *   n (of depth d, lower left corner at x, y) with the cells in the box
+ *   set where states is nonzero, or all cleared if states is null.
+ */
+node *hlifealgo::stripput(node *n, int d, G_INT64 x, G_INT64 y,
+                          const G_INT64 *box, const unsigned char *states) {
+   G_INT64 size = (G_INT64)2 << d ;
+   if (x > box[2] || x + size <= box[0] || y > box[3] || y + size <= box[1])
+      return n ;
+   if (states == 0 && (n == zeronode(d) ||
+                       (x >= box[0] && x + size - 1 <= box[2] &&
+                        y >= box[1] && y + size - 1 <= box[3])))
+      return zeronode(d) ;
+   G_INT64 wd = box[2] - box[0] + 1 ;
+   if (d == 2) {
+      unsigned char row[8] ;
+      for (int r=0; r<8; r++) {
+         G_INT64 yy = y + 7 - r ;
+         row[r] = (unsigned char)leafrow((leaf *)n, r) ;
+         if (yy < box[1] || yy > box[3])
+            continue ;
+         for (int i=0; i<8; i++)
+            if (x + i >= box[0] && x + i <= box[2]) {
+               if (states == 0)
+                  row[r] &= ~(128 >> i) ;
+               else if (states[(box[3] - yy) * wd + x + i - box[0]])
+                  row[r] |= 128 >> i ;
+            }
+      }
+      return (node *)rowsleaf(row) ;
+   }
+   G_INT64 half = size >> 1 ;
+   node *nw = stripput(n->nw, d-1, x, y + half, box, states) ;
+   node *ne = stripput(n->ne, d-1, x + half, y + half, box, states) ;
+   node *sw = stripput(n->sw, d-1, x, y, box, states) ;
+   node *se = stripput(n->se, d-1, x + half, y, box, states) ;
+   return find_node(nw, ne, sw, se) ;
+}
+/*
+ *   A root deeper than STRIPDEPTH only changes in the middle.
+ */
+node *hlifealgo::stripcenter(node *n, int d, const G_INT64 *box,
+                             const unsigned char *states) {
+   if (d <= STRIPDEPTH) {
+      G_INT64 half = (G_INT64)1 << d ;
+      return stripput(n, d, -half, -half, box, states) ;
+   }
+   node *c = stripcenter(find_node(n->nw->se, n->ne->sw, n->sw->ne,
+                                   n->se->nw), d-1, box, states) ;
+   return find_node(find_node(n->nw->nw, n->nw->ne, n->nw->sw, c->nw),
+                    find_node(n->ne->nw, n->ne->ne, c->ne, n->ne->se),
+                    find_node(n->sw->nw, c->sw, n->sw->sw, n->sw->se),
+                    find_node(c->se, n->se->ne, n->se->sw, n->se->se)) ;
+}
+/*
+ *   Reading and writing big macrocell files spends much of its time
+ *   turning text into numbers and back.  So we collect the node lines
+ *   in batches; the threads each parse (or format) a slice of the
+ *   batch, and then the main thread hashes (or writes) them in order.
+ */
+static const size_t MCBATCH = 65536 ;
+class mcparser {
+public:
+   void operator()(int, size_t lo, size_t hi) { hl->parsemc(lo, hi) ; }
+   hlifealgo *hl ;
+} ;
+class mcformatter {
+public:
+   void operator()(int t, size_t lo, size_t hi) { hl->formatmc(t, lo, hi) ; }
+   hlifealgo *hl ;
+} ;
+/*
+ *   Scan up to max unsigned numbers separated by blanks, as sscanf
+ *   would:  we return how many we got, or -1 for a blank line.
+ */
+static int scannumbers(const char *p, g_uintptr_t *v, int max) {
+   int n ;
+   for (n=0; n<max; n++) {
+      while (*p && *p <= ' ')
+         p++ ;
+      if (*p == 0)
+         return n ? n : -1 ;
+      if (*p < '0' || *p > '9')
+         return n ;
+      g_uintptr_t x = 0 ;
+      while ('0' <= *p && *p <= '9')
+         x = 10 * x + *p++ - '0' ;
+      v[n] = x ;
+   }
+   return n ;
+}
+void hlifealgo::parsemc(size_t lo, size_t hi) {
+   for (size_t j=lo; j<hi; j++) {
+      const char *line = &mctext[mcstart[j]] ;
+      mcline &m = mcbatch[j] ;
+      m.err = 0 ;
+      if (line[0] == '.' || line[0] == '*' || line[0] == '$') {
+         unsigned short q[4] ;
+         m.d = 1 ;
+         m.err = readleafline(line, q) ;
+         for (int k=0; k<4; k++)
+            m.k[k] = q[k] ;
+         continue ;
+      }
+      g_uintptr_t v[5] ;
+      int n = scannumbers(line, v, 5) ;
+      m.d = 0 ;
+      if (n < 0) // blank line; permit
+         continue ;
+      if (n == 0)
+         m.err = "Parse error in macrocell format." ;
+      else if (n < 5)
+         // AKT: best not to use lifefatal here because user won't see any
+         // error message when reading clipboard data starting with "[..."
+         m.err = "Parse error in readmacrocell." ;
+      else if (v[0] < 4)
+         m.err = "Oops; bad depth in readmacrocell." ;
+      else {
+         m.d = (int)v[0] ;
+         for (int k=0; k<4; k++)
+            m.k[k] = v[k+1] ;
+      }
+   }
+}
+/*
+ *   Parse the lines we have gathered and build their nodes.
+ */
+const char *hlifealgo::mcflush(node **&ind, g_uintptr_t &i,
+                               g_uintptr_t &indlen) {
+   mcbatch.resize(mcstart.size()) ;
+   mcparser parser ;
+   parser.hl = this ;
+   threads.runslices(mcstart.size(), parser) ;
+   return mchash(ind, i, indlen) ;
+}
+/*
+ *   Build the nodes of a parsed batch, in order.
+ */
+const char *hlifealgo::mchash(node **&ind, g_uintptr_t &i,
+                              g_uintptr_t &indlen) {
+   const char *err = 0 ;
+   for (size_t j=0; err == 0 && j<mcbatch.size(); j++) {
+      mcline &m = mcbatch[j] ;
+      if ((err = m.err) != 0 || m.d == 0)
+         continue ;
       if (i >= indlen) {
          g_uintptr_t nlen = i + indlen + 10 ;
          ind = (node **)realloc(ind, sizeof(node*) * nlen) ;
@@ -1488,38 +3788,151 @@ const char *hlifealgo::readmacrocell(char *line) {
          while (indlen < nlen)
             ind[indlen++] = 0 ;
       }
-      if (line[0] == '.' || line[0] == '*' || line[0] == '$') {
-         int x=0, y=7 ;
-         unsigned short lnw=0, lne=0, lsw=0, lse=0 ;
-         char *p = 0 ;
-         for (p=line; *p > ' '; p++) {
-            switch(*p) {
-case '*':      if (x > 7 || y < 0)
-                  return "Illegal coordinates in readmacrocell." ;
-               if (x < 4)
-                  if (y < 4)
-                     lsw |= 1 << (3 - (x & 3) + 4 * (y & 3)) ;
-                  else
-                     lnw |= 1 << (3 - (x & 3) + 4 * (y & 3)) ;
-               else
-                  if (y < 4)
-                     lse |= 1 << (3 - (x & 3) + 4 * (y & 3)) ;
-                  else
-                     lne |= 1 << (3 - (x & 3) + 4 * (y & 3)) ;
-               /* note: fall through here */
-case '.':      x++ ;
-               break ;
-case '$':      x = 0 ;
-               y-- ;
-               break ;
-default:       return "Illegal character in readmacrocell." ;
+      clearstack() ;
+      if (m.d == 1) {
+         ind[i++] = (node *)find_leaf((unsigned short)m.k[0],
+               (unsigned short)m.k[1], (unsigned short)m.k[2],
+               (unsigned short)m.k[3]) ;
+         continue ;
+      }
+      ind[0] = zeronode(m.d-2) ; /* allow zeros to work right */
+      g_uintptr_t nw = m.k[0], ne = m.k[1], sw = m.k[2], se = m.k[3] ;
+      if (nw >= i || ind[nw] == 0 || ne >= i || ind[ne] == 0 ||
+          sw >= i || ind[sw] == 0 || se >= i || ind[se] == 0)
+         err = "Node out of range in readmacrocell." ;
+      else {
+         root = ind[i++] = find_node(ind[nw], ind[ne], ind[sw], ind[se]) ;
+         depth = m.d - 1 ;
+      }
+   }
+   mctext.clear() ;
+   mcstart.clear() ;
+   mcbatch.clear() ;
+   return err ;
+}
+/*
+ *   The binary macrocell format (.mcb) has the same text header as
+ *   .mc, up to a "#B" line; then come blocks of nodes, in the same
+ *   order the text would have them.  Each block is a varint count of
+ *   nodes and a varint count of bytes, so a reader can skip over it.
+ *   Each node is a varint depth, as in the text; a leaf (depth 1)
+ *   follows that with its four quarters as a little-endian 64-bit
+ *   word, and any other node with its four children, each as a
+ *   varint of how far back it is (zero for an empty one).  A block of
+ *   no nodes ends them, followed by the index of the root (zero if
+ *   it is empty), the number of timeline frames, and their indices.
+ */
+static void putvarint(std::string &s, g_uintptr_t v) {
+   while (v >= 128) {
+      s += (char)(128 | (v & 127)) ;
+      v >>= 7 ;
+   }
+   s += (char)v ;
+}
+static const char *getvarint(const unsigned char *&p, const unsigned char *e,
+                             g_uintptr_t &v) {
+   v = 0 ;
+   for (int sh=0; p<e && sh<64; sh += 7) {
+      v |= (g_uintptr_t)(*p & 127) << sh ;
+      if ((*p++ & 128) == 0)
+         return 0 ;
+   }
+   return "Truncated binary macrocell file." ;
+}
+static const char *readvarint(patternreader &reader, g_uintptr_t &v) {
+   unsigned char buf[10] ;
+   int n = 0 ;
+   while (n < 10 && reader.getbytes((char *)buf + n, 1) == 1)
+      if ((buf[n++] & 128) == 0)
+         break ;
+   const unsigned char *p = buf ;
+   return getvarint(p, buf + n, v) ;
+}
+const char *hlifealgo::readmcblocks(patternreader &reader, node **&ind,
+                                    g_uintptr_t &i, g_uintptr_t &indlen) {
+   const char *err = 0 ;
+   g_uintptr_t nrec, nbytes, v ;
+   for (;;) {
+      if ((err = readvarint(reader, nrec)) != 0)
+         return err ;
+      if (nrec == 0)
+         break ;
+      if ((err = readvarint(reader, nbytes)) != 0)
+         return err ;
+      if (nbytes > 64 * nrec)
+         return "Bad block in binary macrocell file." ;
+      mctext.resize(nbytes) ;
+      if (reader.getbytes(&mctext[0], (int)nbytes) != (int)nbytes)
+         return "Truncated binary macrocell file." ;
+      const unsigned char *p = (const unsigned char *)&mctext[0] ;
+      const unsigned char *e = p + nbytes ;
+      mcbatch.resize(nrec) ;
+      for (g_uintptr_t j=0; err == 0 && j<nrec; j++) {
+         mcline &m = mcbatch[j] ;
+         m.err = 0 ;
+         if ((err = getvarint(p, e, v)) != 0)
+            break ;
+         m.d = (int)v ;
+         if (v == 1) {
+            if (e - p < 8)
+               return "Truncated binary macrocell file." ;
+            for (int k=0; k<4; k++, p += 2)
+               m.k[k] = p[0] | (p[1] << 8) ;
+         } else if (v < 4) {
+            err = "Oops; bad depth in readmacrocell." ;
+         } else {
+            for (int k=0; err == 0 && k<4; k++) {
+               err = getvarint(p, e, v) ;
+               if (v > i + j)
+                  err = "Node out of range in readmacrocell." ;
+               m.k[k] = v ? i + j - v : 0 ;
             }
          }
-         clearstack() ;
-         ind[i++] = (node *)find_leaf(lnw, lne, lsw, lse) ;
-      } else if (line[0] == '#') {
+      }
+      if (err == 0)
+         err = mchash(ind, i, indlen) ;
+      if (err)
+         return err ;
+   }
+   if ((err = readvarint(reader, v)) != 0)
+      return err ;
+   if (v >= i)
+      return "Node out of range in readmacrocell." ;
+   root = v ? ind[v] : 0 ;
+   if (root)
+      depth = node_depth(root) ;
+   g_uintptr_t nframes ;
+   if ((err = readvarint(reader, nframes)) != 0)
+      return err ;
+   if (nframes > MAX_FRAME_COUNT)
+      return "Bad FRAME line" ;
+   for (g_uintptr_t f=0; f<nframes; f++) {
+      if ((err = readvarint(reader, v)) != 0)
+         return err ;
+      if (v == 0 || v >= i)
+         return "Bad FRAME line" ;
+      timeline.frames.push_back(ind[v]) ;
+      timeline.framecount++ ;
+      timeline.end = timeline.next ;
+      timeline.next += timeline.inc ;
+   }
+   return 0 ;
+}
+const char *hlifealgo::readmacrocell(patternreader &reader, char *line) {
+   int n=0 ;
+   g_uintptr_t i=1, indlen=0 ;
+   node **ind = 0 ;
+   const char *err = 0 ;
+   int binary = 0 ;
+   root = 0 ;
+   while (err == 0 && !binary && reader.getline(line, 10000)) {
+      if (line[0] != '#') {
+         mcstart.push_back(mctext.size()) ;
+         mctext.insert(mctext.end(), line, line + strlen(line) + 1) ;
+         if (mcstart.size() >= MCBATCH)
+            err = mcflush(ind, i, indlen) ;
+      } else if ((err = mcflush(ind, i, indlen)) == 0) {
          char *p, *pp ;
-         const char *err ;
          switch (line[1]) {
          case 'R':
             p = line + 2 ;
@@ -1534,7 +3947,14 @@ default:       return "Illegal character in readmacrocell." ;
                return err;
             if (hliferules.alternate_rules)
                return "B0-not-Smax rules are not allowed in HashLife.";
-            
+            kernel.setrule(ruletable) ;
+            break ;
+         case 'B':
+            if (line[2] != 0)
+               break ;
+            // the rest is binary
+            err = readmcblocks(reader, ind, i, indlen) ;
+            binary = 1 ;
             break ;
          case 'G':
             p = line + 2 ;
@@ -1604,7 +4024,7 @@ default:       return "Illegal character in readmacrocell." ;
 	       g_uintptr_t nodeind = 0 ;
 	       n = sscanf(line+7, "%d %" PRIuPTR, &frameind, &nodeind) ;
 	       if (n != 2 || frameind > MAX_FRAME_COUNT || frameind < 0 ||
-		   nodeind > i || timeline.framecount != frameind)
+		   ind == 0 || nodeind >= i || timeline.framecount != frameind)
 		  return "Bad FRAME line" ;
 	       timeline.frames.push_back(ind[nodeind]) ;
 	       timeline.framecount++ ;
@@ -1613,38 +4033,17 @@ default:       return "Illegal character in readmacrocell." ;
 	    }
 	    break ;
          }
-      } else {
-         n = sscanf(line, "%d %" PRIuPTR " %" PRIuPTR " %" PRIuPTR " %" PRIuPTR " %d", &d, &nw, &ne, &sw, &se, &r) ;
-         if (n < 0) // blank line; permit
-            continue ;
-         if (n == 0) {
-            // conversion error in first argument; we allow only if the only
-            // content on the line is whitespace.
-            char *ws = line ;
-            while (*ws && *ws <= ' ')
-               ws++ ;
-            if (*ws > 0)
-               return "Parse error in macrocell format." ;
-            continue ;
-         }
-         if (n < 5)
-            // AKT: best not to use lifefatal here because user won't see any
-            // error message when reading clipboard data starting with "[..."
-            return "Parse error in readmacrocell." ;
-         if (d < 4)
-            return "Oops; bad depth in readmacrocell." ;
-         ind[0] = zeronode(d-2) ; /* allow zeros to work right */
-         if (nw >= i || ind[nw] == 0 || ne >= i || ind[ne] == 0 ||
-             sw >= i || ind[sw] == 0 || se >= i || ind[se] == 0) {
-            return "Node out of range in readmacrocell." ;
-         }
-         clearstack() ;
-         root = ind[i++] = find_node(ind[nw], ind[ne], ind[sw], ind[se]) ;
-         depth = d - 1 ;
       }
    }
+   if (err == 0)
+      err = mcflush(ind, i, indlen) ;
+   std::vector<char>().swap(mctext) ;
+   std::vector<size_t>().swap(mcstart) ;
+   std::vector<mcline>().swap(mcbatch) ;
    if (ind)
       free(ind) ;
+   if (err)
+      return err ;
    if (root == 0) {
       // AKT: allow empty macrocell pattern; note that endofpattern()
       // will be called soon so don't set hashed here
@@ -1660,6 +4059,7 @@ const char *hlifealgo::setrule(const char *s) {
    if (err) return err;
 
    clearcache() ;
+   kernel.setrule(ruletable) ;
    
    if (hliferules.alternate_rules)
       return "B0-not-Smax rules are not allowed in HashLife.";
@@ -1693,19 +4093,17 @@ g_uintptr_t hlifealgo::writecell(std::ostream &os, node *root, int depth) {
       return 0 ;
    if (depth == 2) {
       if (root->nw != 0)
-         return (g_uintptr_t)(root->nw) ;
+         return HRAW(root->nw) ;
    } else {
       if (marked2(root))
-         return (g_uintptr_t)(root->next) ;
-      unhash_node(root) ;
-      mark2(root) ;
+         return tempof(root) ;
    }
    if (depth == 2) {
       int i, j ;
       unsigned int top, bot ;
       leaf *n = (leaf *)root ;
       thiscell = ++cellcounter ;
-      root->nw = (node *)thiscell ;
+      SETHRAW(root->nw, node, thiscell) ;
       unpack8x8(n->nw, n->ne, n->sw, n->se, &top, &bot) ;
       for (j=7; (top | bot) && j>=0; j--) {
          int bits = (top >> 24) ;
@@ -1725,7 +4123,7 @@ g_uintptr_t hlifealgo::writecell(std::ostream &os, node *root, int depth) {
       g_uintptr_t sw = writecell(os, root->sw, depth-1) ;
       g_uintptr_t se = writecell(os, root->se, depth-1) ;
       thiscell = ++cellcounter ;
-      root->next = (node *)thiscell ;
+      settemp(root, thiscell) ;
       os << depth+1 << ' ' << nw << ' ' << ne << ' ' << sw << ' ' << se << '\n';
    }
    return thiscell ;
@@ -1741,19 +4139,17 @@ g_uintptr_t hlifealgo::writecell_2p1(node *root, int depth) {
       return 0 ;
    if (depth == 2) {
       if (root->nw != 0)
-         return (g_uintptr_t)(root->nw) ;
+         return HRAW(root->nw) ;
    } else {
       if (marked2(root))
-         return (g_uintptr_t)(root->next) ;
-      unhash_node(root) ;
-      mark2(root) ;
+         return tempof(root) ;
    }
    if (depth == 2) {
       thiscell = ++cellcounter ;
       // note:  we *must* not abort this prescan
       if ((cellcounter & 4095) == 0)
          lifeabortprogress(0, "Scanning tree") ;
-      root->nw = (node *)thiscell ;
+      SETHRAW(root->nw, node, thiscell) ;
    } else {
       writecell_2p1(root->nw, depth-1) ;
       writecell_2p1(root->ne, depth-1) ;
@@ -1763,7 +4159,7 @@ g_uintptr_t hlifealgo::writecell_2p1(node *root, int depth) {
       // note:  we *must* not abort this prescan
       if ((cellcounter & 4095) == 0)
          lifeabortprogress(0, "Scanning tree") ;
-      root->next = (node *)thiscell ;
+      settemp(root, thiscell) ;
    }
    return thiscell ;
 }
@@ -1777,42 +4173,28 @@ g_uintptr_t hlifealgo::writecell_2p2(std::ostream &os, node *root, int depth) {
    if (root == zeronode(depth))
       return 0 ;
    if (depth == 2) {
-      if (cellcounter + 1 != (g_uintptr_t)(root->nw))
-         return (g_uintptr_t)(root->nw) ;
+      if (cellcounter + 1 != HRAW(root->nw))
+         return HRAW(root->nw) ;
       thiscell = ++cellcounter ;
       if ((cellcounter & 4095) == 0) {
          std::streampos siz = os.tellp();
          sprintf(progressmsg, "File size: %.2f MB", double(siz) / 1048576.0) ;
          lifeabortprogress(thiscell/(double)writecells, progressmsg) ;
       }
-      int i, j ;
-      unsigned int top, bot ;
       leaf *n = (leaf *)root ;
-      root->nw = (node *)thiscell ;
-      unpack8x8(n->nw, n->ne, n->sw, n->se, &top, &bot) ;
-      for (j=7; (top | bot) && j>=0; j--) {
-         int bits = (top >> 24) ;
-         top = (top << 8) | (bot >> 24) ;
-         bot = (bot << 8) ;
-         for (i=0; bits && i<8; i++, bits = (bits << 1) & 255)
-            if (bits & 128)
-               os << '*' ;
-            else
-               os << '.' ;
-         os << '$' ;
-      }
-      os << '\n' ;
+      SETHRAW(root->nw, node, thiscell) ;
+      queuemc(os, 1, n->nw, n->ne, n->sw, n->se) ;
    } else {
-      if (cellcounter + 1 > (g_uintptr_t)(root->next) || isaborted())
-         return (g_uintptr_t)(root->next) ;
+      if (cellcounter + 1 > tempof(root) || isaborted())
+         return tempof(root) ;
       g_uintptr_t nw = writecell_2p2(os, root->nw, depth-1) ;
       g_uintptr_t ne = writecell_2p2(os, root->ne, depth-1) ;
       g_uintptr_t sw = writecell_2p2(os, root->sw, depth-1) ;
       g_uintptr_t se = writecell_2p2(os, root->se, depth-1) ;
       if (!isaborted() &&
-          cellcounter + 1 != (g_uintptr_t)(root->next)) { // this should never happen
+          cellcounter + 1 != tempof(root)) { // this should never happen
          lifefatal("Internal in writecell_2p2") ;
-         return (g_uintptr_t)(root->next) ;
+         return tempof(root) ;
       }
       thiscell = ++cellcounter ;
       if ((cellcounter & 4095) == 0) {
@@ -1820,16 +4202,116 @@ g_uintptr_t hlifealgo::writecell_2p2(std::ostream &os, node *root, int depth) {
          sprintf(progressmsg, "File size: %.2f MB", double(siz) / 1048576.0) ;
          lifeabortprogress(thiscell/(double)writecells, progressmsg) ;
       }
-      root->next = (node *)thiscell ;
-      os << depth+1 << ' ' << nw << ' ' << ne << ' ' << sw << ' ' << se << '\n';
+      queuemc(os, depth+1, nw, ne, sw, se) ;
    }
    return thiscell ;
 }
+void hlifealgo::queuemc(std::ostream &os, int d, g_uintptr_t nw,
+                        g_uintptr_t ne, g_uintptr_t sw, g_uintptr_t se) {
+   mcline m ;
+   m.d = d ;
+   m.k[0] = nw ;
+   m.k[1] = ne ;
+   m.k[2] = sw ;
+   m.k[3] = se ;
+   mcbatch.push_back(m) ;
+   if (mcbatch.size() >= MCBATCH)
+      writemc(os) ;
+}
+static char *putnumber(char *p, g_uintptr_t v) {
+   char buf[24] ;
+   int n = 0 ;
+   do {
+      buf[n++] = (char)('0' + v % 10) ;
+      v /= 10 ;
+   } while (v) ;
+   while (n > 0)
+      *p++ = buf[--n] ;
+   return p ;
+}
+void hlifealgo::formatmc(int t, size_t lo, size_t hi) {
+   std::string &out = mcout[t] ;
+   out.clear() ;
+   char line[128] ;
+   for (size_t j=lo; j<hi; j++) {
+      mcline &m = mcbatch[j] ;
+      if (mcbinary) {
+         putvarint(out, m.d) ;
+         if (m.d == 1) {
+            for (int k=0; k<4; k++) {
+               out += (char)(m.k[k] & 255) ;
+               out += (char)(m.k[k] >> 8) ;
+            }
+         } else {
+            for (int k=0; k<4; k++)
+               putvarint(out, m.k[k] ? mcbase + j - m.k[k] : 0) ;
+         }
+         continue ;
+      }
+      char *p = line ;
+      if (m.d == 1) {
+         int i, jj ;
+         unsigned int top, bot ;
+         unpack8x8((unsigned short)m.k[0], (unsigned short)m.k[1],
+                   (unsigned short)m.k[2], (unsigned short)m.k[3],
+                   &top, &bot) ;
+         for (jj=7; (top | bot) && jj>=0; jj--) {
+            int bits = (top >> 24) ;
+            top = (top << 8) | (bot >> 24) ;
+            bot = (bot << 8) ;
+            for (i=0; bits && i<8; i++, bits = (bits << 1) & 255)
+               *p++ = (bits & 128) ? '*' : '.' ;
+            *p++ = '$' ;
+         }
+      } else {
+         p = putnumber(p, m.d) ;
+         for (int k=0; k<4; k++) {
+            *p++ = ' ' ;
+            p = putnumber(p, m.k[k]) ;
+         }
+      }
+      *p++ = '\n' ;
+      out.append(line, p - line) ;
+   }
+}
+/*
+ *   Format the queued lines and write them out.
+ */
+void hlifealgo::writemc(std::ostream &os) {
+   if (mcbatch.empty())
+      return ;
+   mcout.resize(threads.getthreads()) ;
+   mcbase = cellcounter + 1 - mcbatch.size() ;
+   mcformatter formatter ;
+   formatter.hl = this ;
+   threads.runslices(mcbatch.size(), formatter) ;
+   if (mcbinary) {
+      size_t nbytes = 0 ;
+      for (size_t t=0; t<mcout.size(); t++)
+         nbytes += mcout[t].size() ;
+      std::string head ;
+      putvarint(head, mcbatch.size()) ;
+      putvarint(head, nbytes) ;
+      os.write(head.data(), head.size()) ;
+   }
+   for (size_t t=0; t<mcout.size(); t++)
+      os.write(mcout[t].data(), mcout[t].size()) ;
+   mcbatch.clear() ;
+}
 #define STRINGIFY(arg) STR2(arg)
 #define STR2(arg) #arg
+const char *hlifealgo::writeNativeBinary(std::ostream &os, char *comments) {
+   mcbinary = 1 ;
+   const char *err = writeNativeFormat(os, comments) ;
+   mcbinary = 0 ;
+   return err ;
+}
 const char *hlifealgo::writeNativeFormat(std::ostream &os, char *comments) {
    int depth = node_depth(root) ;
-   os << "[M2] (golly " STRINGIFY(VERSION) ")\n" ;
+   if (mcbinary)
+      os << "[MB1] (golly " STRINGIFY(VERSION) ")\n" ;
+   else
+      os << "[M2] (golly " STRINGIFY(VERSION) ")\n" ;
 
    // AKT: always write out explicit rule
    os << "#R " << hliferules.getrule() << '\n' ;
@@ -1873,6 +4355,11 @@ const char *hlifealgo::writeNativeFormat(std::ostream &os, char *comments) {
    if (timeline.savetimeline == 0)
      framestosave = 0 ;
    if (framestosave) {
+     for (int i=0; i<timeline.framecount; i++)
+       if (timeline.frames[i] == 0 && loadframe(i) == 0) {
+         inGC = 0 ;
+         return "Cannot reload a timeline frame." ;
+       }
      for (int i=0; i<timeline.framecount; i++) {
        node *frame = (node*)timeline.frames[i] ;
        depths[i] = node_depth(frame) ;
@@ -1885,29 +4372,263 @@ const char *hlifealgo::writeNativeFormat(std::ostream &os, char *comments) {
    writecell_2p1(root, depth) ;
    writecells = cellcounter ;
    cellcounter = 0 ;
-   if (framestosave) {
+   if (framestosave)
       os << "#FRAMES"
          << ' ' << timeline.framecount
          << ' ' << timeline.start.tostring()
          << ' ' << timeline.base << '^' << timeline.expo << '\n' ;
+   if (mcbinary)
+      os << "#B\n" ;
+   if (framestosave) {
      for (int i=0; i<timeline.framecount; i++) {
        node *frame = (node*)timeline.frames[i] ;
        writecell_2p2(os, frame, depths[i]) ;
-       os << "#FRAME " << i << ' ' << (g_uintptr_t)frame->next << '\n' ;
+       writemc(os) ;
+       if (!mcbinary)
+          os << "#FRAME " << i << ' ' << tempof(frame) << '\n' ;
      }
    }
    writecell_2p2(os, root, depth) ;
+   writemc(os) ;
+   if (mcbinary) {
+      std::string tail ;
+      putvarint(tail, 0) ;
+      putvarint(tail, root == zeronode(depth) ? 0 : tempof(root)) ;
+      putvarint(tail, framestosave) ;
+      for (int i=0; i<framestosave; i++)
+         putvarint(tail, tempof((node *)timeline.frames[i])) ;
+      os.write(tail.data(), tail.size()) ;
+   }
+   std::vector<mcline>().swap(mcbatch) ;
+   std::vector<std::string>().swap(mcout) ;
    /* end new two-pass way */
    if (framestosave) {
      for (int i=0; i<timeline.framecount; i++) {
        node *frame = (node*)timeline.frames[i] ;
-       aftercalcpop2(frame, depths[i], 0) ;
+       aftercalcpop2(frame, depths[i]) ;
      }
    }
-   aftercalcpop2(root, depth, 0) ;
+   aftercalcpop2(root, depth) ;
+   savedres.clear() ;
+   savedres.shrink_to_fit() ;
    inGC = 0 ;
    return 0 ;
 }
+/*
+ *   The results file holds the whole hash (not just what the pattern
+ *   uses) with the res links, so a later run of the same sort of thing
+ *   can start with a warm cache.  Everything is little-endian 32-bit
+ *   words, laid out so the file could be mapped and read in place:
+ *
+ *      "HLMEMO1\n"
+ *      ngens, rule length, the rule padded to a multiple of 4 bytes
+ *      the number of levels, then how many things there are at each
+ *      the leaves:  nw ne sw se, two 16-bit halves to a word
+ *      the nodes, a level at a time:  nw ne sw se res
+ *
+ *   Things are numbered from 1 in the order they appear (0 is no
+ *   result).  A node's children and result are one level down, so
+ *   they always come before it.
+ */
+static const char MEMOMAGIC[] = "HLMEMO1\n" ;
+static void putword(std::vector<unsigned char> &buf, g_uintptr_t v) {
+   for (int i=0; i<4; i++, v >>= 8)
+      buf.push_back((unsigned char)v) ;
+}
+static g_uintptr_t getword(const unsigned char *p) {
+   return p[0] | (p[1] << 8) | (p[2] << 16) | ((g_uintptr_t)p[3] << 24) ;
+}
+const char *hlifealgo::writememo(const char *filename) {
+   FILE *f = fopen(filename, "wb") ;
+   if (f == 0)
+      return "Cannot create results file." ;
+   if (gcphase)
+      finishgc() ;
+   inGC = 1 ;
+   vector<vector<node *> > levels ;
+   g_uintptr_t total = 0 ;
+   for (g_uintptr_t i=0; i<hashbuckets; i++)
+      for (int j=0; j<HASHSLOTS; j++)
+         if (hashtab[i].fp[j]) {
+            node *p = hashtab[i].slot[j] ;
+            int d = node_depth(p) - 2 ;
+            if ((int)levels.size() <= d)
+               levels.resize(d + 1) ;
+            levels[d].push_back(p) ;
+            total++ ;
+         }
+   const char *err = 0 ;
+   if (total >= 0xffffffff)
+      err = "Too many nodes for a results file." ;
+   /*
+    *   Number everything with the same fields the writing walks use:
+    *   the leaves in their (otherwise zero) first word, the nodes with
+    *   settemp().
+    */
+   g_uintptr_t num = 0 ;
+   for (size_t d=0; err == 0 && d<levels.size(); d++)
+      for (size_t i=0; i<levels[d].size(); i++) {
+         node *p = levels[d][i] ;
+         if (d == 0)
+            SETHRAW(p->nw, node, ++num) ;
+         else
+            settemp(p, ++num) ;
+      }
+   std::vector<unsigned char> buf ;
+   const char *rule = hliferules.getrule() ;
+   g_uintptr_t rulelen = strlen(rule) ;
+   buf.insert(buf.end(), MEMOMAGIC, MEMOMAGIC + 8) ;
+   putword(buf, ngens) ;
+   putword(buf, rulelen) ;
+   buf.insert(buf.end(), rule, rule + rulelen) ;
+   while (buf.size() & 3)
+      buf.push_back(0) ;
+   putword(buf, levels.size()) ;
+   for (size_t d=0; d<levels.size(); d++)
+      putword(buf, levels[d].size()) ;
+   for (size_t d=0; err == 0 && d<levels.size(); d++)
+      for (size_t i=0; i<levels[d].size(); i++) {
+         node *p = levels[d][i] ;
+         if (d == 0) {
+            leaf *l = (leaf *)p ;
+            putword(buf, l->nw | (l->ne << 16)) ;
+            putword(buf, l->sw | (l->se << 16)) ;
+         } else {
+            node *c[5] = { p->nw, p->ne, p->sw, p->se, 0 } ;
+#ifdef COMPACTNODES
+            c[4] = resof(p) ;
+#else
+            c[4] = (node *)(~RESMARK & (g_uintptr_t)savedres[tempof(p)]) ;
+#endif
+            for (int k=0; k<5; k++)
+               if (c[k] == 0)
+                  putword(buf, 0) ;
+               else
+                  putword(buf, d == 1 ? HRAW(c[k]->nw) : tempof(c[k])) ;
+         }
+         if (buf.size() >= (1 << 20)) {
+            if (fwrite(&buf[0], 1, buf.size(), f) != buf.size())
+               err = "Error writing results file." ;
+            buf.clear() ;
+         }
+      }
+   if (err == 0 && buf.size() &&
+       fwrite(&buf[0], 1, buf.size(), f) != buf.size())
+      err = "Error writing results file." ;
+   if (fclose(f) != 0 && err == 0)
+      err = "Error writing results file." ;
+   for (size_t d=0; num && d<levels.size(); d++)
+      for (size_t i=0; i<levels[d].size(); i++) {
+         node *p = levels[d][i] ;
+         if (d == 0)
+            SETHRAW(p->nw, node, 0) ;
+         else
+            cleartemp(p) ;
+      }
+   savedres.clear() ;
+   savedres.shrink_to_fit() ;
+   inGC = 0 ;
+   return err ;
+}
+/*
+ *   Read back a results file into the hash, stopping quietly if we run
+ *   out of memory (what we have by then is still good).  The results
+ *   are only any use for the same rule.  They were made for the
+ *   file's step size; we switch to that first so they can go straight
+ *   into the res fields, and if the step size then changes they go to
+ *   the stash like any others.  Nodes the pattern doesn't use stay
+ *   until the first gc that finds it needs the room.
+ */
+const char *hlifealgo::readmemo(const char *filename) {
+   FILE *f = fopen(filename, "rb") ;
+   if (f == 0)
+      return "Cannot open results file." ;
+   const char *err = "Not a results file." ;
+   unsigned char hdr[16] ;
+   vector<node *> ind ;
+   vector<unsigned char> depths ;
+   std::string rule ;
+   g_uintptr_t levels = 0 ;
+   if (fread(hdr, 1, 16, f) == 16 && memcmp(hdr, MEMOMAGIC, 8) == 0) {
+      g_uintptr_t len = getword(hdr + 12) ;
+      rule.resize((len + 3) & ~(g_uintptr_t)3) ;
+      if (len < 1000 && fread(&rule[0], 1, rule.size(), f) == rule.size() &&
+          fread(hdr, 1, 4, f) == 4 && (levels = getword(hdr)) < 1000) {
+         rule.resize(len) ;
+         err = 0 ;
+         if (rule != hliferules.getrule())
+            err = "Results file is for a different rule." ;
+         else if (!hashed)
+            err = "Cannot load results into this universe." ;
+      }
+   }
+   vector<g_uintptr_t> counts(levels) ;
+   for (g_uintptr_t d=0; err == 0 && d<levels; d++)
+      if (fread(hdr + 4, 1, 4, f) != 4)
+         err = "Truncated results file." ;
+      else
+         counts[d] = getword(hdr + 4) ;
+   if (err == 0) {
+      // a new rule throws out the old results at the next step; do that
+      // now or it would throw out the ones we are about to load
+      if (cacheinvalid) {
+         save(root) ;
+         do_gc(1) ;
+         clearstack() ;
+         cacheinvalid = 0 ;
+      }
+      int filengens = (int)getword(hdr + 8) ;
+      if (filengens != ngens && filengens < 64)
+         new_ngens(filengens) ;
+      ind.push_back(0) ;
+      depths.push_back(0) ;
+   }
+   unsigned char rec[20] ;
+   for (g_uintptr_t d=0; err == 0 && d<levels; d++) {
+      int recsize = d == 0 ? 8 : 20 ;
+      for (g_uintptr_t i=0; err == 0 && i<counts[d]; i++) {
+         if (alloced > maxmem) {
+            counts.clear() ;
+            break ;
+         }
+         if (fread(rec, 1, recsize, f) != (size_t)recsize) {
+            err = "Truncated results file." ;
+            break ;
+         }
+         node *n ;
+         clearstack() ;
+         if (d == 0) {
+            g_uintptr_t top = getword(rec), bot = getword(rec + 4) ;
+            n = (node *)find_leaf((unsigned short)top,
+                                  (unsigned short)(top >> 16),
+                                  (unsigned short)bot,
+                                  (unsigned short)(bot >> 16)) ;
+         } else {
+            g_uintptr_t c[5] ;
+            for (int k=0; k<5; k++) {
+               c[k] = getword(rec + 4 * k) ;
+               if (c[k] >= ind.size() || (k < 4 && c[k] == 0) ||
+                   (c[k] != 0 && depths[c[k]] != d))
+                  err = "Bad node in results file." ;
+            }
+            if (err)
+               break ;
+            n = find_node(ind[c[0]], ind[c[1]], ind[c[2]], ind[c[3]]) ;
+            if (c[4] && resof(n) == 0) {
+               setres(n, ind[c[4]]) ;
+               if (ngens < (int)d + 1)
+                  halvesdone = 1000 ;
+            }
+         }
+         ind.push_back(n) ;
+         depths.push_back((unsigned char)(d + 1)) ;
+      }
+      if (counts.empty())
+         break ;
+   }
+   fclose(f) ;
+   return err ;
+}
 char hlifealgo::statusline[120] ;
 static lifealgo *creator() { return new hlifealgo() ; }
 void hlifealgo::doInitializeAlgoInfo(staticAlgoInfo &ai) {
@@ -25,6 +25,13 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #define HLIFEALGO_H
 #include "lifealgo.h"
 #include "liferules.h"
+#include "lifethreads.h"
+#include "leafkernel.h"
+#include "nodearena.h"
+#include <map>
+#include <string>
+#include <stdlib.h>
+#include <string.h>
 /*
  *   Into instances of this node structure is where almost all of the
  *   memory allocated by this program goes.  Thus, it is imperative we
@@ -106,15 +113,17 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  *
  *   Where do we cache the results?  Well, we cache the results in the
  *   same node structure we are using to store the pointers to the
- *   smaller squares themselves.  And since we're hashing them all
- *   together, we want a next pointer for the hash chain.  Put all of
- *   this together, and you get the following structure for the 16-squares
- *   and larger:
+ *   smaller squares themselves.  (We used to keep a hash chain link
+ *   in each node too; the hash table below is open addressed, so now
+ *   we don't.)  Put all of this together, and you get the following
+ *   structure for the 16-squares and larger:
  */
 struct node {
-   node *next ;              /* hash link */
-   node *nw, *ne, *sw, *se ; /* constant; nw != 0 means nonleaf */
-   node *res ;               /* cache */
+   NODEREF(node) nw, ne, sw, se ; /* constant; nw != 0 means nonleaf */
+   ATOMICNODEREF(node) res ;      /* cache */
+#ifdef COMPACTNODES
+   unsigned int flags ;           /* gc and tree walk marks */
+#endif
 } ;
 /*
  *   For the 8-squares, we do not have `children', we have actual data
@@ -134,23 +143,165 @@ struct node {
  *   that the struct leaf contains a zero where the first (nw) pointer
  *   field would be in a struct node.
  *
+ *   (The pointers are really handles if we are using compact nodes;
+ *   see nodearena.h.)
+ *
  *   Each short represents a 4-square in normal, left-to-right then top-down
  *   order from the most significant bit.  So bit 0x8000 is the upper
  *   left (or northwest) bit, and bit 0x1000 is the upper right bit, and
  *   so on.
  */
 struct leaf {
-   node *next ;              /* hash link */
-   node *isnode ;            /* must always be zero for leaves */
+   NODEREF(node) isnode ;            /* must always be zero for leaves */
    unsigned short nw, ne, sw, se ;  /* constant */
    unsigned short res1, res2 ;      /* constant */
    unsigned short leafpop ;         /* how many set bits */
+   unsigned short gcmark ;          /* incremental gc mark */
 } ;
 /*
  *   If it is a struct node, this returns a non-zero value, otherwise it
  *   returns a zero value.
  */
-#define is_node(n) (((node *)(n))->nw)
+#define is_node(n) (HRAW(((node *)(n))->nw))
+/*
+ *   The hash table is open addressed, with buckets the size of a cache
+ *   line.  Each bucket holds a few node pointers and, for each, a one
+ *   byte fingerprint taken from other bits of the hash, so most of the
+ *   entries that don't match are passed over without touching the
+ *   node itself.  A full bucket sends new entries on to the next one;
+ *   its overflow count says how many entries that want to be here (or
+ *   earlier) went on past it, so a lookup knows whether to keep going.
+ *   An empty slot has a zero fingerprint.
+ */
+/*
+ *   The slots, fingerprints and overflow counts are atomic, since
+ *   threads stepping in parallel share the table (see nodearena.h);
+ *   plain use of them is relaxed.
+ */
+struct atomicbyte {
+   std::atomic<unsigned char> v ;
+   operator unsigned char() const { return v.load(std::memory_order_relaxed) ; }
+   atomicbyte &operator=(unsigned char c) {
+      v.store(c, std::memory_order_relaxed) ;
+      return *this ;
+   }
+} ;
+static const int HASHSLOTS = 64 / (sizeof(ATOMICNODEREF(node)) + 1) ;
+struct hashbucket {
+   ATOMICNODEREF(node) slot[HASHSLOTS] ;
+   atomicbyte fp[HASHSLOTS] ;
+   atomicbyte overflow ;     /* 255 means it may be more; never cleared */
+} ;
+/*
+ *   A side table from nodes to values, for the things we remember
+ *   about nodes that don't fit in the node itself.  It is open
+ *   addressed, kept at most half full, and keyed by the node's address.
+ *   Nothing here keeps the nodes alive; the owner calls prune() when
+ *   the gc has marked what it will keep.  The owner also decides when
+ *   it may grow (see room() and grow()), so the memory is counted.
+ */
+template <class V> class nodecache {
+public:
+   nodecache() : tab(0), mask(0), count(0), shift(64) {}
+   ~nodecache() { free(tab) ; }
+   int find(node *n, V &v) const {
+      if (tab == 0)
+         return 0 ;
+      for (g_uintptr_t i=home(n); ; i=(i+1)&mask) {
+         if (HRAW(tab[i].n) == 0)
+            return 0 ;
+         if ((node *)tab[i].n == n) {
+            v = tab[i].v ;
+            return 1 ;
+         }
+      }
+   }
+   //  Where the value for a node is kept, or 0 if it isn't here.
+   V *get(node *n) {
+      if (tab == 0)
+         return 0 ;
+      for (g_uintptr_t i=home(n); ; i=(i+1)&mask) {
+         if (HRAW(tab[i].n) == 0)
+            return 0 ;
+         if ((node *)tab[i].n == n)
+            return &tab[i].v ;
+      }
+   }
+   //  Call f(n, v) for every entry.
+   template <class F> void each(F f) const {
+      for (g_uintptr_t i=0; i<size(); i++)
+         if (HRAW(tab[i].n))
+            f((node *)tab[i].n, tab[i].v) ;
+   }
+   //  Is there room for one more without growing?
+   int room() const { return tab != 0 && 2 * (count + 1) <= mask + 1 ; }
+   g_uintptr_t size() const { return tab ? mask + 1 : 0 ; }
+   g_uintptr_t bytes(g_uintptr_t size) const { return size * sizeof(entry) ; }
+   //  Rehash into a table of the given size (a power of two); returns 0
+   //  (and leaves things as they were) if there's no memory for it.
+   int grow(g_uintptr_t size) {
+      entry *o = tab ;
+      g_uintptr_t osize = this->size() ;
+      entry *t = (entry *)calloc(size, sizeof(entry)) ;
+      if (t == 0)
+         return 0 ;
+      tab = t ;
+      mask = size - 1 ;
+      count = 0 ;
+      for (shift=64; size>1; size>>=1)
+         shift-- ;
+      for (g_uintptr_t i=0; i<osize; i++)
+         if (HRAW(o[i].n))
+            insert((node *)o[i].n, o[i].v) ;
+      free(o) ;
+      return 1 ;
+   }
+   //  Add a node that isn't there; there must be room().
+   void insert(node *n, V v) {
+      g_uintptr_t i = home(n) ;
+      while (HRAW(tab[i].n))
+         i = (i + 1) & mask ;
+      tab[i].n = n ;
+      tab[i].v = v ;
+      count++ ;
+   }
+   //  Keep only the entries keep(n, v) likes.  Returns 0 if there was
+   //  no memory to do it, in which case everything is dropped.
+   template <class K> int prune(K keep) {
+      entry *o = tab ;
+      g_uintptr_t osize = size() ;
+      if (o == 0)
+         return 1 ;
+      tab = 0 ;
+      if (!grow(osize)) {
+         free(o) ;
+         mask = count = 0 ;
+         return 0 ;
+      }
+      for (g_uintptr_t i=0; i<osize; i++)
+         if (HRAW(o[i].n) && keep((node *)o[i].n, o[i].v))
+            insert((node *)o[i].n, o[i].v) ;
+      free(o) ;
+      return 1 ;
+   }
+   void clear() {
+      if (tab)
+         memset(tab, 0, size() * sizeof(entry)) ;
+      count = 0 ;
+   }
+private:
+   struct entry {
+      NODEREF(node) n ;
+      V v ;
+   } ;
+   g_uintptr_t home(node *n) const {
+      return (g_uintptr_t)(((unsigned long long)(g_uintptr_t)n *
+                            0x9e3779b97f4a7c15ULL) >> shift) ;
+   }
+   entry *tab ;
+   g_uintptr_t mask, count ;
+   int shift ;
+} ;
 /**
  *   Our hlifealgo class.
  */
@@ -165,6 +316,11 @@ public:
    virtual int setcell(int x, int y, int newstate) ;
    virtual int getcell(int x, int y) ;
    virtual int nextcell(int x, int y, int &state) ;
+   virtual int setrow(int x, int y, int wd, const unsigned char *bits) ;
+   virtual void getstrip(int x, int y, int wd, int ht, unsigned char *states) ;
+   virtual int putstrip(int x, int y, int wd, int ht,
+                        const unsigned char *states) ;
+   virtual void clearstrip(int x, int y, int wd, int ht) ;
    virtual void endofpattern() ;
    virtual void setIncrement(bigint inc) ;
    virtual void setIncrement(int inc) { setIncrement(bigint(inc)) ; }
@@ -172,24 +328,35 @@ public:
    virtual const bigint &getPopulation() ;
    virtual int isEmpty() ;
    virtual int hyperCapable() { return 1 ; }
+   virtual int gridCapable() ;
    virtual void setMaxMemory(int m) ;
    virtual int getMaxMemory() { return (int)(maxmem >> 20) ; }
+   virtual void setMaxThreads(int n) ;
+   virtual int getMaxThreads() { return threads.getthreads() ; }
    virtual const char *setrule(const char *s) ;
    virtual const char *getrule() { return hliferules.getrule() ; }
    virtual void step() ;
    virtual void* getcurrentstate() { return root ; }
    virtual void setcurrentstate(void *n) ;
+   virtual int framecosts(vector<g_uintptr_t> &costs) ;
+   virtual void trimtimeline() ;
+   virtual void *loadframe(int i) ;
    /*
     *   The contract of draw() is that it render every pixel in the
     *   viewport precisely once.  This allows us to eliminate all
-    *   flashing.  Later we'll make this be damage-specific.
+    *   flashing.  If the renderer asks for it (see damagemode), tiles
+    *   whose covering node is unchanged since the last frame are not
+    *   rebuilt, or not even reblitted.
     */
    virtual void draw(viewport &view, liferender &renderer) ;
    virtual void fit(viewport &view, int force) ;
    virtual void lowerRightPixel(bigint &x, bigint &y, int mag) ;
    virtual void findedges(bigint *t, bigint *l, bigint *b, bigint *r) ;
-   virtual const char *readmacrocell(char *line) ;
+   virtual const char *readmacrocell(patternreader &reader, char *line) ;
    virtual const char *writeNativeFormat(std::ostream &os, char *comments) ;
+   virtual const char *writeNativeBinary(std::ostream &os, char *comments) ;
+   virtual const char *writememo(const char *filename) ;
+   virtual const char *readmemo(const char *filename) ;
    static void doInitializeAlgoInfo(staticAlgoInfo &) ;
 private:
 /*
@@ -215,52 +382,160 @@ private:
  */
    node **stack ;
    int stacksize ;
-   g_uintptr_t hashpop, hashlimit, hashprime ;
-   node **hashtab ;
+   g_uintptr_t hashpop, hashlimit, hashfull, hashbuckets, hashmask ;
+   hashbucket *hashtab ;
+   void *hashmem ; // what we allocated for hashtab, before aligning it
    int halvesdone ;
    int gsp ;
    g_uintptr_t alloced, maxmem ;
+   int arenacut ;          // lowered maxmem to fit the node arena?
    node *freenodes ;
    int okaytogc ;
    g_uintptr_t totalthings ;
    node *nodeblocks ;
    char *ruletable ;
+   leafkernel kernel ; // bit-sliced leaf evaluation, if the rule allows
    bigint population ;
    bigint setincrement ;
-   bigint pow2step ; // greatest power of two in increment
-   int nonpow2 ; // increment / pow2step
-   int ngens ; // log2(pow2step)
+   int ngens ; // the top bit of the increment
+   /*
+    *   Increments that aren't a power of two are done by advance(), in
+    *   one pass; it needs the bits of the increment (low first) and
+    *   remembers its results in steps until the increment changes.
+    */
+   std::vector<char> incbits ;
+   int inclow ; // the lowest set bit of the increment
+   nodecache<NODEREF(node)> steps ;
+   /*
+    *   Results for other step sizes (see stashres()), by node and by
+    *   log2 of how many generations they go.
+    */
+   struct stashentry {
+      NODEREF(node) n, r ;
+      unsigned char gens, depth ;
+   } ;
+   stashentry *stash ;
+   g_uintptr_t stashmask, stashcount ;
+   int stashshift ;
+   int stashgens ; // the ngens the res fields being cleared were made for
+   FILE *spillfile ; // where timeline frames go over the budget
+   /*
+    *   Bounded grids (see rungrid()).  The grid is kept here in our own
+    *   coordinates (y goes up) as left, bottom, right, top, inclusive.
+    *   The results of the masked steps of a bounded plane depend on
+    *   where the node is, but only as far as what part of it is in the
+    *   grid, so we remember them in gridsteps by node along with that.
+    */
+   G_INT64 gridbox[4] ;
+   int gridmasked ; // stepping a bounded plane?
+   struct gridentry {
+      G_INT64 mask[4] ; // the part in the grid, from the lower left
+      NODEREF(node) r ;
+   } ;
+   nodecache<gridentry> gridsteps ;
+   long spillend ;
+   int trimmedat ; // the frame count when we last checked the budget
+   /*
+    *   The bulk loader (see setrow()) fills a band of eight rows as
+    *   the quarters of a row of leaves, then builds the tree upwards a
+    *   row of nodes at a time; bulkrows[k] is the row at depth k+2
+    *   waiting for its partner.
+    */
+   struct bulkrow {
+      int j, x0 ; // row and first column, in units of the node size
+      std::vector<node *> cells ; // 0 for empty
+   } ;
+   std::vector<bulkrow> bulkrows ;
+   std::vector<unsigned short> bandq ; // nw, ne, sw, se for each leaf
+   int bulkactive, bandj, bandx0 ;
    int popValid, needPop, inGC ;
    /*
     *   When rendering we store the relevant bits here rather than
     *   passing them deep into recursive subroutines.
     */
    liferender *renderer ;
+   damagecache damage ;   // tiles drawn last frame, keyed by node
    viewport *view ;
    int uviewh, uvieww, viewh, vieww, mag, pmag ;
+   int density ;          // shade zoomed-out pixels by population
    int llbits, llsize ;
    char *llxb, *llyb ;
    int hashed ;
    int cacheinvalid ;
+   /*
+    *   The writing walks hang a number on each node they visit.  They
+    *   put it in the cache field, so they keep the real cache values
+    *   here until they are done.
+    */
+   std::vector<node *> savedres ;
+   /*
+    *   Populations we have counted, kept from one count to the next
+    *   (see calcpop):  an open-addressed table keyed by node for the
+    *   counts that fit in 32 bits, and a map for the deepest nodes.
+    */
+   nodecache<unsigned int> pops ;
+   std::map<node *, bigint> bigpops ;
    g_uintptr_t cellcounter ; // used when writing
    g_uintptr_t writecells ; // how many to write
    int gccount ; // how many gcs total this pattern
    int gcstep ; // how many gcs this step
+   /*
+    *   The incremental collector.  Rather than stopping for a full gc
+    *   when memory runs out, we start a collection a bit earlier and
+    *   do a slice of marking or sweeping every so many allocations.
+    *   See the comments at startgc() for how this stays safe while
+    *   the calculation carries on.
+    */
+   int gcphase ; // 0 = idle, 1 = marking, 2 = sweeping
+   node **graystack ;
+   int graysize, graysp ;
+   g_uintptr_t sweepnext ; // sweeping: first hash bucket not yet swept
+   g_uintptr_t freecount ; // nodes on the free list (approximately)
+   g_uintptr_t gcrate, gcdebt, gcfreed ;
+   double gcmaxpause ; // longest single pause in the last gc, in seconds
+   double gctotal ; // time spent so far in this gc
+   double gclastcost ; // total time the last gc took
    static char statusline[] ;
 //
    void leafres(leaf *n) ;
    void resize() ;
+   int newhash(g_uintptr_t nbuckets) ;
+   void sethashlimits() ;
+   g_uintptr_t hashinsert(node *p, g_uintptr_t h) ;
+   g_uintptr_t hashfill(node *p, g_uintptr_t h, g_uintptr_t hole, int holei) ;
+   g_uintptr_t hashhome(node *p) ;
    node *find_node(node *nw, node *ne, node *sw, node *se) ;
-   void unhash_node(node *n) ;
-   void rehash_node(node *n) ;
    leaf *find_leaf(unsigned short nw, unsigned short ne,
                    unsigned short sw, unsigned short se) ;
    node *getres(node *n, int depth) ;
    node *dorecurs(node *n, node *ne, node *t, node *e, int depth) ;
    node *dorecurs_half(node *n, node *ne, node *t, node *e, int depth) ;
    leaf *dorecurs_leaf(leaf *n, leaf *ne, leaf *t, leaf *e) ;
+   leaf *kernel_leaf(leaf *n, leaf *ne, leaf *t, leaf *e, int gens) ;
+   node *kernel_node(node *n, node *ne, node *t, node *e, int gens) ;
    leaf *dorecurs_leaf_half(leaf *n, leaf *ne, leaf *t, leaf *e) ;
    leaf *dorecurs_leaf_quarter(leaf *n, leaf *ne, leaf *t, leaf *e) ;
+   node *advance(node *n, int depth) ;
+   leaf *advance_leaf(leaf *n, leaf *ne, leaf *t, leaf *e, int gens) ;
+   node *centerof(node *n, int depth) ;
+   void gridincrement(bigint &inc, bigint &times) ;
+   node *rungrid() ;
+   node *gridres(node *n, int depth, G_INT64 x, G_INT64 y) ;
+   leaf *gridleaf(node *n, G_INT64 x, G_INT64 y, int gens) ;
+   node *nodeat(node *n, int ndepth, G_INT64 x, G_INT64 y, int d) ;
+   node *subsquare(node **c, int d, G_INT64 x, G_INT64 y,
+                   const G_INT64 *box) ;
+   node *shifted(node *n, int ndepth, G_INT64 dx, G_INT64 dy,
+                 const G_INT64 *box, int d) ;
+   leaf *rowsleaf(const unsigned char *row) ;
+   void stripget(node *n, int d, G_INT64 x, G_INT64 y, const G_INT64 *box,
+                 unsigned char *states) ;
+   node *stripput(node *n, int d, G_INT64 x, G_INT64 y, const G_INT64 *box,
+                  const unsigned char *states) ;
+   node *stripcenter(node *n, int d, const G_INT64 *box,
+                     const unsigned char *states) ;
+   void stripwrite(int x, int y, int wd, int ht, const unsigned char *states) ;
+   int incbit(int i) { return i < (int)incbits.size() ? incbits[i] : 0 ; }
    node *newnode() ;
    leaf *newleaf() ;
    node *newclearednode() ;
@@ -274,8 +549,25 @@ private:
    int nextbit(node *n, int x, int y, int depth) ;
    node *hashpattern(node *root, int depth) ;
    node *popzeros(node *n) ;
-   const bigint &calcpop(node *root, int depth) ;
-   void aftercalcpop2(node *root, int depth, int cleanbigints) ;
+   bigint calcpop(node *root, int depth) ;
+   G_INT64 smallpop(node *root, int depth) ;
+   double popfraction(node *root, int depth) ;
+   template <class V> int makeroom(nodecache<V> &c) ;
+   void prunecaches() ;
+   void aftercalcpop2(node *root, int depth) ;
+   int costwalk(nodecache<unsigned int> &owners, node *n, unsigned int f) ;
+   void bulkband() ;
+   void bulkpush(size_t k, bulkrow &row) ;
+   void bulkpair(size_t k, bulkrow &north, bulkrow &south, bulkrow &up) ;
+   void bulkflush() ;
+   node *bulkplace(node *n, int ndepth, G_INT64 x, G_INT64 y, G_INT64 cx,
+                   G_INT64 cy, node *sub, int depth) ;
+   node *unionof(node *a, node *b, int depth) ;
+   void bulkput(node *n, int d, G_INT64 x, G_INT64 y) ;
+   int framecosts(vector<g_uintptr_t> &costs, g_uintptr_t &held) ;
+   const char *spillframe(int i) ;
+   void settemp(node *n, g_uintptr_t v) ;
+   void cleartemp(node *n) ;
    void calcPopulation(node *root) ;
    node *save(node *n) ;
    void pop(int n) ;
@@ -284,11 +576,24 @@ private:
    void gc_mark(node *root, int invalidate) ;
    void do_gc(int invalidate) ;
    void clearcache(node *n, int depth, int clearto) ;
+   void stashres(node *n, int gens, int depth, node *r) ;
+   node *unstash(node *n, int gens) ;
+   void keepstash() ;
    void new_ngens(int newval) ;
+   void startgc() ;
+   void gcslice() ;
+   void finishgc() ;
+   void gcshade(node *n) ;
+   void gcmarkroots() ;
+   int gcdrain(g_uintptr_t work) ;
+   void sweepnode(g_uintptr_t b, int i) ;
+   g_uintptr_t sweepbucket(g_uintptr_t b) ;
+   void clearmarks() ;
+   void gcdone(double pause) ;
    int log2(unsigned int n) ;
    node *runpattern() ;
    void clearrect(int x, int y, int w, int h) ;
-   void renderbm(int x, int y) ;
+   void renderbm(int x, int y, const void *key, int keylen) ;
    void fill_ll(int d) ;
    void drawnode(node *n, int llx, int lly, int depth, node *z) ;
    void ensure_hashed() ;
@@ -298,6 +603,81 @@ private:
    void unpack8x8(unsigned short nw, unsigned short ne,
                   unsigned short sw, unsigned short se,
                   unsigned int *top, unsigned int *bot) ;
+   /*
+    *   Macrocell lines go through these in batches, so the threads can
+    *   share the parsing and formatting; d is 0 for a line to skip, 1
+    *   for a leaf (k holds its four quarters), or the node's depth as
+    *   written in the file.
+    */
+   struct mcline {
+      int d ;
+      g_uintptr_t k[4] ;
+      const char *err ;
+   } ;
+   std::vector<mcline> mcbatch ;
+   std::vector<char> mctext ;
+   std::vector<size_t> mcstart ;
+   std::vector<std::string> mcout ;
+   int mcbinary ;          // writing the binary format?
+   g_uintptr_t mcbase ;    // number of the first node in mcbatch
+   friend class mcparser ;
+   friend class mcformatter ;
+   const char *mcflush(node **&ind, g_uintptr_t &i, g_uintptr_t &indlen) ;
+   const char *mchash(node **&ind, g_uintptr_t &i, g_uintptr_t &indlen) ;
+   const char *readmcblocks(patternreader &reader, node **&ind,
+                            g_uintptr_t &i, g_uintptr_t &indlen) ;
+   void parsemc(size_t lo, size_t hi) ;
+   void formatmc(int t, size_t lo, size_t hi) ;
+   void queuemc(std::ostream &os, int d, g_uintptr_t nw, g_uintptr_t ne,
+                g_uintptr_t sw, g_uintptr_t se) ;
+   void writemc(std::ostream &os) ;
    liferules hliferules ;
+/*
+ *   Parallel stepping.  While inparallel is set, worker threads are
+ *   running getres() on independent subresults alongside us, so the
+ *   hash and the free list are shared.  Each worker keeps its own gc
+ *   stack and a small private cache of free nodes.  When the hash
+ *   needs to grow or memory runs short, a thread raises stwrequest
+ *   and the main thread, once every busy worker has parked at a safe
+ *   point, does the resize or the gc itself.
+ */
+   struct threadcache {
+      node *freenodes ;
+      node **stack ;
+      int stacksize, gsp ;
+      int nest ;
+      char pad[64-2*sizeof(node *)-3*sizeof(int)] ;
+   } ;
+   lifethreads threads ;
+   threadcache *tcache ;
+   lifelock *hashlocks ;
+   lifelock alloclock ;
+   int inparallel ;
+   std::atomic<int> stwrequest, busy, parked, parhalves ;
+   std::atomic<g_uintptr_t> parinserts ;
+   friend class getrestask ;
+   friend class safepointtask ;
+   void hashclaim(node *r, g_uintptr_t h) ;
+   node *parfind_node(g_uintptr_t h, node *nw, node *ne, node *sw, node *se) ;
+   leaf *parfind_leaf(g_uintptr_t h, unsigned short nw, unsigned short ne,
+                      unsigned short sw, unsigned short se) ;
+   node *find_node_parallel(node *nw, node *ne, node *sw, node *se) ;
+   leaf *find_leaf_parallel(unsigned short nw, unsigned short ne,
+                            unsigned short sw, unsigned short se) ;
+   node *dorecurs_parallel(node *n, node *ne, node *t, node *e, int depth,
+                           int half) ;
+   int allocblock() ;
+   int arenafull() ;
+   void arenawarning() ;
+   node *newnode_parallel() ;
+   void givebacknode(node *n) ;
+   void beginparallel() ;
+   void endparallel() ;
+   void safepoint() ;
+   void stoptheworld() ;
+   int onworker() { return inparallel && lifethreads::threadindex() != 0 ; }
+   int stackmark() {
+      return onworker() ? tcache[lifethreads::threadindex()].gsp : gsp ;
+   }
 } ;
 #endif
@@ -29,6 +29,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <vector>
 #include <cstring>
 #include <cstdio>
+#include <cmath>
 #include <algorithm>
 using namespace std ;
 
@@ -46,10 +47,49 @@ static unsigned char pixbuf[bmsize*bmsize*4];
 static unsigned char deadr, deadg, deadb, deada;
 static unsigned char liver, liveg, liveb, livea;
 
+// density drawing fills a level per pixel instead of bigbuf bits,
+// and colors the levels from a ramp
+static unsigned char graybuf[bmsize*bmsize] ;
+static unsigned char ramp[256][4] ;
+
 static void drawpixel(int x, int y) {
   bigbuf[(((bmsize-1)-y) << (logbmsize-3)) + (x >> 3)] |= (128 >> (x & 7)) ;
 }
 
+static void graypixel(int x, int y, double frac) {
+   graybuf[((bmsize-1)-y) * bmsize + x] = (unsigned char)densitylevel(frac) ;
+}
+
+static int bitcount(unsigned int v) {
+   int r = 0 ;
+   for (; v; v &= v - 1)
+      r++ ;
+   return r ;
+}
+
+/*
+ *   Shade a leaf at 2x2 cells per pixel (sw == 4) or 4x4 (sw == 2).
+ *   Each short is a 4x4 square with its top row in the high nibble.
+ */
+static void grayleaf(leaf *l, int llx, int lly, int sw) {
+   unsigned short q[4] = { l->sw, l->se, l->nw, l->ne } ;
+   int half = sw >> 1 ;
+   for (int k=0; k<4; k++) {
+      int x = -llx + (k & 1) * half ;
+      int y = -lly + (k >> 1) * half ;
+      if (q[k] == 0)
+         continue ;
+      if (half == 1) {
+         graypixel(x, y, bitcount(q[k]) / 16.0) ;
+      } else {
+         for (int by=0; by<2; by++)
+            for (int bx=0; bx<2; bx++)
+               graypixel(x + bx, y + 1 - by,
+                         bitcount(q[k] & (0xcc00 >> (8 * by + 2 * bx))) / 4.0) ;
+      }
+   }
+}
+
 /*
  *   Draw a 4x4 area yielding 1x1, 2x2, or 4x4 pixels.
  */
@@ -94,8 +134,8 @@ void draw4x4_4(unsigned short bits1, unsigned short bits2, int llx, int lly) {
    p[-3*byteoff] = (unsigned char)(((bits1 >> 8) & 0xf0) + ((bits2 >> 12) & 0xf)) ;
 }
 
-void hlifealgo::renderbm(int x, int y) {
-   // x,y is lower left corner
+void hlifealgo::renderbm(int x, int y, const void *key, int keylen) {
+   // x,y is lower left corner; key says what the bitmap shows
    int rx = x ;
    int ry = y ;
    int rw = bmsize ;
@@ -108,36 +148,23 @@ void hlifealgo::renderbm(int x, int y) {
    }
    ry = uviewh - ry - rh ;
    
-   if (pmag > 1) {
-      // convert each bigbuf byte into 8 bytes of state data
-      int j = 0;
-      for (int i = 0; i < ibufsize * 4; i++) {
-         int byte = bigbuf[i];
-         for (int bit = 128; bit > 0; bit >>= 1) {
-            pixbuf[j++] = (byte & bit) ? 1 : 0;
-         }
-      }
+   if (density) {
+      for (int i = 0; i < bmsize * bmsize; i++)
+         memcpy(pixbuf + 4 * i, ramp[graybuf[i]], 4) ;
+      damage.blit(x, y, rx, ry, rw, rh, pixbuf, pmag, key, keylen) ;
+      memset(graybuf, 0, sizeof(graybuf)) ;
+      return ;
+   }
+   if (renderer->takesbits()) {
+      damage.bitblit(x, y, rx, ry, rw, rh, bigbuf, pmag, key, keylen) ;
    } else {
-      // convert each bigbuf byte into 32 bytes of pixel data (8 * RGBA)
-      int j = 0;
-      for (int i = 0; i < ibufsize * 4; i++) {
-         int byte = bigbuf[i];
-         for (int bit = 128; bit > 0; bit >>= 1) {
-            if (byte & bit) {
-               pixbuf[j++] = liver;
-               pixbuf[j++] = liveg;
-               pixbuf[j++] = liveb;
-               pixbuf[j++] = livea;
-            } else {
-               pixbuf[j++] = deadr;
-               pixbuf[j++] = deadg;
-               pixbuf[j++] = deadb;
-               pixbuf[j++] = deada;
-            }
-         }
-      }
+      // convert each bigbuf byte into 8 bytes of state data (pmag > 1)
+      // or 32 bytes of pixel data (8 * RGBA)
+      unsigned char live[] = { liver, liveg, liveb, livea } ;
+      unsigned char dead[] = { deadr, deadg, deadb, deada } ;
+      expandbits(bigbuf, sizeof(ibigbuf), pixbuf, pmag, live, dead) ;
+      damage.blit(x, y, rx, ry, rw, rh, pixbuf, pmag, key, keylen) ;
    }
-   renderer->pixblit(rx, ry, rw, rh, pixbuf, pmag);
    
    memset(bigbuf, 0, sizeof(ibigbuf)) ;
 }
@@ -159,11 +186,15 @@ void hlifealgo::drawnode(node *n, int llx, int lly, int depth, node *z) {
       sw >>= 1 ;
       depth-- ;
       if (sw == (bmsize >> 1)) {
+         // n fills exactly one bitmap, so if the same node was here
+         // last frame the bitmap hasn't changed
+         if (damage.reuse(-llx, -lly, &n, sizeof(n)))
+            return ;
          drawnode(n->sw, 0, 0, depth, z) ;
          drawnode(n->se, -(bmsize/2), 0, depth, z) ;
          drawnode(n->nw, 0, -(bmsize/2), depth, z) ;
          drawnode(n->ne, -(bmsize/2), -(bmsize/2), depth, z) ;
-         renderbm(-llx, -lly) ;
+         renderbm(-llx, -lly, &n, sizeof(n)) ;
       } else {
          drawnode(n->sw, llx, lly, depth, z) ;
          drawnode(n->se, llx-sw, lly, depth, z) ;
@@ -171,9 +202,21 @@ void hlifealgo::drawnode(node *n, int llx, int lly, int depth, node *z) {
          drawnode(n->ne, llx-sw, lly-sw, depth, z) ;
       }
    } else if (depth > 2 && sw == 2) {
-      draw4x4_1(n, z->nw, llx, lly) ;
+      if (density) {
+         graypixel(-llx, -lly, popfraction(n->sw, depth-1)) ;
+         graypixel(1-llx, -lly, popfraction(n->se, depth-1)) ;
+         graypixel(-llx, 1-lly, popfraction(n->nw, depth-1)) ;
+         graypixel(1-llx, 1-lly, popfraction(n->ne, depth-1)) ;
+      } else {
+         draw4x4_1(n, z->nw, llx, lly) ;
+      }
    } else if (sw == 1) {
-      drawpixel(-llx, -lly) ;
+      if (density)
+         graypixel(-llx, -lly, popfraction(n, depth)) ;
+      else
+         drawpixel(-llx, -lly) ;
+   } else if (density) {
+      grayleaf((struct leaf *)n, llx, lly, sw) ;
    } else {
       struct leaf *l = (struct leaf *)n ;
       sw >>= 1 ;
@@ -272,12 +315,24 @@ void hlifealgo::draw(viewport &viewarg, liferender &rendererarg) {
       viewh = uviewh ;
       vieww = uvieww ;
    }
+   // density shading needs populations, which we can't count in a gc
+   density = (mag > 0 && !inGC && renderer->wantsdensity()) ;
+   unsigned char live[] = { liver, liveg, liveb, livea } ;
+   unsigned char dead[] = { deadr, deadg, deadb, deada } ;
+   if (density)
+      densityramp(live, dead, ramp) ;
+   // node pointers are only stable keys while no gc can free them
+   int frame[] = { uvieww, uviewh, mag, pmag, deadr, deadg, deadb, deada,
+                   liver, liveg, liveb, livea, density } ;
+   damage.beginframe(renderer, frame, sizeof(frame),
+                     gcphase ? -1 : gccount, dead) ;
    int d = depth ;
    fill_ll(d) ;
    int maxd = vieww ;
    int i ;
    node *z = zeronode(d) ;
    node *sw = root, *nw = z, *ne = z, *se = z ;
+   node *key[4] ;
    if (viewh > maxd)
       maxd = viewh ;
    int llx=-llxb[llbits-1], lly=-llyb[llbits-1] ;
@@ -339,19 +394,30 @@ void hlifealgo::draw(viewport &viewarg, liferender &rendererarg) {
           (sw == z && se == z && nw == z && ne == z)) {
          // no live cells
       } else {
-         drawpixel(0, 0) ;
-         renderbm(-llx, -lly) ;
+         key[0] = sw ; key[1] = se ; key[2] = nw ; key[3] = ne ;
+         if (!damage.reuse(-llx, -lly, key, sizeof(key))) {
+            if (density)
+               graypixel(0, 0, ldexp(popfraction(sw, d) + popfraction(se, d) +
+                                     popfraction(nw, d) + popfraction(ne, d),
+                                     2 * (d + 1 - mag))) ;
+            else
+               drawpixel(0, 0) ;
+            renderbm(-llx, -lly, key, sizeof(key)) ;
+         }
       }
    } else {
       z = zeronode(d) ;
       maxd = 1 << (d - mag + 2) ;
       if (maxd <= bmsize) {
-         maxd >>= 1 ;
-         drawnode(sw, 0, 0, d, z) ;
-         drawnode(se, -maxd, 0, d, z) ;
-         drawnode(nw, 0, -maxd, d, z) ;
-         drawnode(ne, -maxd, -maxd, d, z) ;
-         renderbm(-llx, -lly) ;
+         key[0] = sw ; key[1] = se ; key[2] = nw ; key[3] = ne ;
+         if (!damage.reuse(-llx, -lly, key, sizeof(key))) {
+            maxd >>= 1 ;
+            drawnode(sw, 0, 0, d, z) ;
+            drawnode(se, -maxd, 0, d, z) ;
+            drawnode(nw, 0, -maxd, d, z) ;
+            drawnode(ne, -maxd, -maxd, d, z) ;
+            renderbm(-llx, -lly, key, sizeof(key)) ;
+         }
       } else {
          maxd >>= 1 ;
          drawnode(sw, llx, lly, d, z) ;
@@ -361,6 +427,7 @@ void hlifealgo::draw(viewport &viewarg, liferender &rendererarg) {
       }
    }
 bail:
+   damage.endframe() ;
    renderer = 0 ;
    view = 0 ;
 }
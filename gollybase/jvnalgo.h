@@ -27,7 +27,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 /**
  *   Our JvN algo class.
  */
-class jvnalgo : public ghashbase {
+class jvnalgo : public ghashcalc<jvnalgo> {
 public:
    jvnalgo() ;
    virtual ~jvnalgo() ;
@@ -0,0 +1,469 @@
+                        /*** /
+
+This file is part of Golly, a Game of Life Simulator.
+Copyright (C) 2013 Andrew Trevorrow and Tomas Rokicki.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ Web site:  http://sourceforge.net/projects/golly
+ Authors:   rokicki@gmail.com  andrew@trevorrow.com
+
+                        / ***/
+#include "leafkernel.h"
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define LEAFAVX2 (1)
+#include <immintrin.h>
+#endif
+/*
+ *   Within a word, each row of a square takes 8, 16 or 32 bits with the
+ *   top row in the low bits, and each row has its westmost cell in
+ *   the high bit.  So the west neighbors of a row are the row shifted
+ *   right one, the east neighbors the row shifted left one, and the
+ *   row above is the square shifted left one row.  The masks keep
+ *   the horizontal shifts from spilling into the next row.
+ */
+static const leafbits WEST8 = 0x7f7f7f7f7f7f7f7fULL ;
+static const leafbits EAST8 = 0xfefefefefefefefeULL ;
+static const leafbits WEST16 = 0x7fff7fff7fff7fffULL ;
+static const leafbits EAST16 = 0xfffefffefffefffeULL ;
+static const leafbits WEST32 = 0x7fffffff7fffffffULL ;
+static const leafbits EAST32 = 0xfffffffefffffffeULL ;
+leafkernel::leafkernel() {
+   ok = 0 ;
+   life = 0 ;
+   nterms = 0 ;
+   avx2 = 0 ;
+#ifdef LEAFAVX2
+   __builtin_cpu_init() ;
+   avx2 = __builtin_cpu_supports("avx2") ;
+#endif
+}
+/*
+ *   Try each 3x3 neighborhood on the center cell of the northwest
+ *   2x2 result of the table, and see if the answer only depends on
+ *   the center and the number of neighbors.
+ */
+int leafkernel::setrule(const char *ruletable) {
+   int seen[2][9] ;
+   int i, j ;
+   ok = 0 ;
+   for (i=0; i<2; i++)
+      for (j=0; j<9; j++)
+         seen[i][j] = -1 ;
+   for (i=0; i<512; i++) {
+      int alive = (i >> 4) & 1 ;
+      int count = 0 ;
+      for (j=0; j<9; j++)
+         if (j != 4 && ((i >> j) & 1))
+            count++ ;
+      int next = (ruletable[(((i >> 6) & 7) << 13) | (((i >> 3) & 7) << 9) |
+                            ((i & 7) << 5)] >> 5) & 1 ;
+      if (seen[alive][count] < 0)
+         seen[alive][count] = next ;
+      else if (seen[alive][count] != next)
+         return 0 ;
+   }
+   life = 1 ;
+   nterms = 0 ;
+   for (i=0; i<9; i++) {
+      if (seen[0][i] != (i == 3) || seen[1][i] != (i == 2 || i == 3))
+         life = 0 ;
+      if (seen[0][i] == 0 && seen[1][i] == 0)
+         continue ;
+      x0[nterms] = (i & 1) ? 0 : ~0ULL ;
+      x1[nterms] = (i & 2) ? 0 : ~0ULL ;
+      x2[nterms] = (i & 4) ? 0 : ~0ULL ;
+      a3[nterms] = (i == 0 || i == 8) ? ~0ULL : 0 ;
+      x3[nterms] = (i == 8) ? 0 : ~0ULL ;
+      dead[nterms] = seen[0][i] ? ~0ULL : 0 ;
+      live[nterms] = seen[1][i] ? ~0ULL : 0 ;
+      nterms++ ;
+   }
+   ok = 1 ;
+   return ok ;
+}
+/*
+ *   Given the neighbor counts in bits c0 (ones) through c3 (eights),
+ *   and which cells are on now, which cells are on next time?
+ */
+inline leafbits leafkernel::rule(leafbits c0, leafbits c1, leafbits c2,
+                                 leafbits c3, leafbits alive) const {
+   if (life)
+      return c1 & ~c2 & (c0 | alive) ;
+   leafbits r = 0 ;
+   for (int i=0; i<nterms; i++)
+      r |= (c0 ^ x0[i]) & (c1 ^ x1[i]) & (c2 ^ x2[i]) &
+           ((c3 & a3[i]) ^ x3[i]) & ((alive & live[i]) | (~alive & dead[i])) ;
+   return r ;
+}
+/*
+ *   The adder.  For each row we have the two-bit sum of the west and
+ *   east neighbors (m1, m2) and the two-bit sum of the row above and
+ *   the row below counting the cell itself (n1, n2 and s1, s2); add
+ *   them up into the four count bits, and apply the rule.
+ */
+#define ADDUP(n1, n2, m1, m2, s1, s2, alive, result) {                   \
+   leafbits ones = n1 ^ m1 ^ s1 ;                                       \
+   leafbits carry = (n1 & m1) | (s1 & (n1 ^ m1)) ;                      \
+   leafbits twos = n2 ^ m2 ^ s2 ;                                       \
+   leafbits fours = (n2 & m2) | (s2 & (n2 ^ m2)) ;                      \
+   leafbits morefours = twos & carry ;                                  \
+   result = rule(ones, twos ^ carry, fours ^ morefours,                 \
+                 fours & morefours, alive) ;                            \
+}
+leafbits leafkernel::step8(leafbits g) const {
+   leafbits w = (g >> 1) & WEST8, e = (g << 1) & EAST8 ;
+   leafbits m1 = w ^ e, m2 = w & e ;
+   leafbits h1 = m1 ^ g, h2 = m2 | (m1 & g) ;
+   leafbits r ;
+   ADDUP(h1 << 8, h2 << 8, m1, m2, h1 >> 8, h2 >> 8, g, r) ;
+   return r ;
+}
+void leafkernel::step16(leafbits *g) const {
+   leafbits h1[4], h2[4], m1[4], m2[4] ;
+   int k ;
+   for (k=0; k<4; k++) {
+      leafbits w = (g[k] >> 1) & WEST16, e = (g[k] << 1) & EAST16 ;
+      m1[k] = w ^ e ;
+      m2[k] = w & e ;
+      h1[k] = m1[k] ^ g[k] ;
+      h2[k] = m2[k] | (m1[k] & g[k]) ;
+   }
+   for (k=0; k<4; k++) {
+      leafbits n1 = h1[k] << 16, n2 = h2[k] << 16 ;
+      leafbits s1 = h1[k] >> 16, s2 = h2[k] >> 16 ;
+      if (k > 0) {
+         n1 |= h1[k-1] >> 48 ;
+         n2 |= h2[k-1] >> 48 ;
+      }
+      if (k < 3) {
+         s1 |= h1[k+1] << 48 ;
+         s2 |= h2[k+1] << 48 ;
+      }
+      ADDUP(n1, n2, m1[k], m2[k], s1, s2, g[k], g[k]) ;
+   }
+}
+void leafkernel::step32(leafbits *g) const {
+   leafbits h1[16], h2[16], m1[16], m2[16] ;
+   int k ;
+   for (k=0; k<16; k++) {
+      leafbits w = (g[k] >> 1) & WEST32, e = (g[k] << 1) & EAST32 ;
+      m1[k] = w ^ e ;
+      m2[k] = w & e ;
+      h1[k] = m1[k] ^ g[k] ;
+      h2[k] = m2[k] | (m1[k] & g[k]) ;
+   }
+   for (k=0; k<16; k++) {
+      leafbits n1 = h1[k] << 32, n2 = h2[k] << 32 ;
+      leafbits s1 = h1[k] >> 32, s2 = h2[k] >> 32 ;
+      if (k > 0) {
+         n1 |= h1[k-1] >> 32 ;
+         n2 |= h2[k-1] >> 32 ;
+      }
+      if (k < 15) {
+         s1 |= h1[k+1] << 32 ;
+         s2 |= h2[k+1] << 32 ;
+      }
+      ADDUP(n1, n2, m1[k], m2[k], s1, s2, g[k], g[k]) ;
+   }
+}
+/*
+ *   Spread the four rows of a 4x4 into the low nibbles of the bytes
+ *   of a word (for an 8x8) or of the shorts of a long word (for a
+ *   16x16), and gather them back.
+ */
+static inline unsigned int spread8(unsigned short s) {
+   return ((s >> 12) & 0xf) | (s & 0xf00) |
+          ((unsigned int)(s & 0xf0) << 12) | ((unsigned int)(s & 0xf) << 24) ;
+}
+static inline leafbits spread16(unsigned short s) {
+   return ((s >> 12) & 0xf) | ((leafbits)((s >> 8) & 0xf) << 16) |
+          ((leafbits)((s >> 4) & 0xf) << 32) | ((leafbits)(s & 0xf) << 48) ;
+}
+static inline unsigned short gather8(leafbits x) {
+   return (unsigned short)(((x & 0xf) << 12) | (x & 0xf00) |
+                           ((x >> 12) & 0xf0) | ((x >> 24) & 0xf)) ;
+}
+static inline unsigned short gather16(leafbits x) {
+   return (unsigned short)(((x & 0xf) << 12) | ((x >> 8) & 0xf00) |
+                           ((x >> 28) & 0xf0) | ((x >> 48) & 0xf)) ;
+}
+void leafkernel::leafres(unsigned short nw, unsigned short ne,
+                         unsigned short sw, unsigned short se,
+                         unsigned short &res1, unsigned short &res2) const {
+   leafbits g = ((spread8(nw) << 4) | spread8(ne)) |
+                ((leafbits)((spread8(sw) << 4) | spread8(se)) << 32) ;
+   g = step8(g) ;
+   res1 = gather8(g >> 18) ;
+   g = step8(g) ;
+   res2 = gather8(g >> 18) ;
+}
+void leafkernel::center16(const unsigned short *in, int gens,
+                          unsigned short *out) const {
+   leafbits g[4] ;
+   int k ;
+   for (k=0; k<4; k++)
+      g[k] = (spread16(in[4*k]) << 12) | (spread16(in[4*k+1]) << 8) |
+             (spread16(in[4*k+2]) << 4) | spread16(in[4*k+3]) ;
+#ifdef LEAFAVX2
+   if (avx2)
+      step16avx2(g, gens) ;
+   else
+#endif
+   for (k=0; k<gens; k++)
+      step16(g) ;
+   out[0] = gather16(g[1] >> 8) ;
+   out[1] = gather16(g[1] >> 4) ;
+   out[2] = gather16(g[2] >> 8) ;
+   out[3] = gather16(g[2] >> 4) ;
+}
+/*
+ *   For the 32x32, two rows to a word; we just assemble the rows a
+ *   nibble at a time.
+ */
+static void build32(const unsigned short *in, leafbits *g) {
+   for (int k=0; k<16; k++) {
+      leafbits w = 0 ;
+      for (int h=0; h<2; h++) {
+         int r = 2 * k + h ;
+         const unsigned short *p = in + 8 * (r >> 2) ;
+         int sh = 12 - 4 * (r & 3) ;
+         unsigned int row = 0 ;
+         for (int j=0; j<8; j++)
+            row = (row << 4) | ((p[j] >> sh) & 0xf) ;
+         w |= (leafbits)row << (32 * h) ;
+      }
+      g[k] = w ;
+   }
+}
+static void gather32(const leafbits *g, unsigned short *out) {
+   for (int i=0; i<16; i++)
+      out[i] = 0 ;
+   for (int r=8; r<24; r++) {
+      unsigned int row = (unsigned int)(g[r >> 1] >> (32 * (r & 1))) ;
+      int b = (r - 8) >> 2, sh = 12 - 4 * ((r - 8) & 3) ;
+      for (int j=0; j<4; j++)
+         out[4*b+j] |= ((row >> (20 - 4 * j)) & 0xf) << sh ;
+   }
+}
+void leafkernel::center32(const unsigned short *in, int gens,
+                          unsigned short *out) const {
+   leafbits g[16] ;
+   build32(in, g) ;
+#ifdef LEAFAVX2
+   if (avx2) {
+      step32avx2(g, gens) ;
+      gather32(g, out) ;
+      return ;
+   }
+#endif
+   for (int k=0; k<gens; k++)
+      step32(g) ;
+   gather32(g, out) ;
+}
+void leafkernel::brick01(const unsigned int *cur, const unsigned int *below,
+                         unsigned int *out) const {
+#ifdef LEAFAVX2
+   brick01avx2(cur, below, out) ;
+#endif
+}
+void leafkernel::brick10(const unsigned int *cur, const unsigned int *above,
+                         unsigned int *out) const {
+#ifdef LEAFAVX2
+   brick10avx2(cur, above, out) ;
+#endif
+}
+#ifdef LEAFAVX2
+/*
+ *   The same using AVX2, with the rows in 16-bit (for a 16x16) or
+ *   32-bit (for a 32x32) lanes.  AVXADDUP is ADDUP and rule() in one.
+ */
+#define AVXADDUP(n1, n2, m1, m2, s1, s2, x, result) {                    \
+   __m256i c0 = _mm256_xor_si256(_mm256_xor_si256(n1, m1), s1) ;         \
+   __m256i carry = _mm256_or_si256(_mm256_and_si256(n1, m1),             \
+                       _mm256_and_si256(s1, _mm256_xor_si256(n1, m1))) ; \
+   __m256i twos = _mm256_xor_si256(_mm256_xor_si256(n2, m2), s2) ;       \
+   __m256i fours = _mm256_or_si256(_mm256_and_si256(n2, m2),             \
+                       _mm256_and_si256(s2, _mm256_xor_si256(n2, m2))) ; \
+   __m256i morefours = _mm256_and_si256(twos, carry) ;                   \
+   __m256i c1 = _mm256_xor_si256(twos, carry) ;                          \
+   __m256i c2 = _mm256_xor_si256(fours, morefours) ;                     \
+   if (life) {                                                           \
+      result = _mm256_andnot_si256(c2, _mm256_and_si256(c1,              \
+                                           _mm256_or_si256(c0, x))) ;    \
+   } else {                                                              \
+      __m256i c3 = _mm256_and_si256(fours, morefours) ;                  \
+      __m256i r = _mm256_setzero_si256() ;                               \
+      for (int i=0; i<nterms; i++) {                                     \
+         __m256i t = _mm256_and_si256(                                   \
+            _mm256_xor_si256(c0, _mm256_set1_epi64x((long long)x0[i])),  \
+            _mm256_xor_si256(c1, _mm256_set1_epi64x((long long)x1[i]))) ;\
+         t = _mm256_and_si256(t,                                         \
+            _mm256_xor_si256(c2, _mm256_set1_epi64x((long long)x2[i]))) ;\
+         t = _mm256_and_si256(t, _mm256_xor_si256(                       \
+            _mm256_and_si256(c3, _mm256_set1_epi64x((long long)a3[i])),  \
+            _mm256_set1_epi64x((long long)x3[i]))) ;                     \
+         t = _mm256_and_si256(t, _mm256_or_si256(                        \
+            _mm256_and_si256(x, _mm256_set1_epi64x((long long)live[i])), \
+            _mm256_andnot_si256(x,                                       \
+                                _mm256_set1_epi64x((long long)dead[i])))) ; \
+         r = _mm256_or_si256(r, t) ;                                     \
+      }                                                                  \
+      result = r ;                                                       \
+   }                                                                     \
+}
+/*
+ *   Rows move up or down a lane, and between the two halves of a
+ *   register, with a permute and an align; for the 32x32 the rows
+ *   coming in at the edge are from the registers above and below.
+ */
+#define NORTH16(v) \
+   _mm256_alignr_epi8(v, _mm256_permute2x128_si256(v, v, 0x08), 14)
+#define SOUTH16(v) \
+   _mm256_alignr_epi8(_mm256_permute2x128_si256(v, v, 0x81), v, 2)
+#define NORTH32(v, above) \
+   _mm256_alignr_epi8(v, _mm256_permute2x128_si256(v, above, 0x03), 12)
+#define SOUTH32(v, below) \
+   _mm256_alignr_epi8(_mm256_permute2x128_si256(v, below, 0x21), v, 4)
+__attribute__((target("avx2")))
+void leafkernel::step16avx2(leafbits *g, int gens) const {
+   __m256i x = _mm256_loadu_si256((const __m256i *)g) ;
+   for (int k=0; k<gens; k++) {
+      __m256i w = _mm256_srli_epi16(x, 1), e = _mm256_slli_epi16(x, 1) ;
+      __m256i m1 = _mm256_xor_si256(w, e), m2 = _mm256_and_si256(w, e) ;
+      __m256i h1 = _mm256_xor_si256(m1, x) ;
+      __m256i h2 = _mm256_or_si256(m2, _mm256_and_si256(m1, x)) ;
+      __m256i n1 = NORTH16(h1), n2 = NORTH16(h2) ;
+      __m256i s1 = SOUTH16(h1), s2 = SOUTH16(h2) ;
+      AVXADDUP(n1, n2, m1, m2, s1, s2, x, x) ;
+   }
+   _mm256_storeu_si256((__m256i *)g, x) ;
+}
+__attribute__((target("avx2")))
+void leafkernel::step32avx2(leafbits *g, int gens) const {
+   __m256i x[4], h1[6], h2[6], m1[4], m2[4] ;
+   int j, k ;
+   for (j=0; j<4; j++)
+      x[j] = _mm256_loadu_si256((const __m256i *)(g + 4 * j)) ;
+   h1[0] = h2[0] = h1[5] = h2[5] = _mm256_setzero_si256() ;
+   for (k=0; k<gens; k++) {
+      for (j=0; j<4; j++) {
+         __m256i w = _mm256_srli_epi32(x[j], 1) ;
+         __m256i e = _mm256_slli_epi32(x[j], 1) ;
+         m1[j] = _mm256_xor_si256(w, e) ;
+         m2[j] = _mm256_and_si256(w, e) ;
+         h1[j+1] = _mm256_xor_si256(m1[j], x[j]) ;
+         h2[j+1] = _mm256_or_si256(m2[j], _mm256_and_si256(m1[j], x[j])) ;
+      }
+      for (j=0; j<4; j++) {
+         __m256i n1 = NORTH32(h1[j+1], h1[j]), n2 = NORTH32(h2[j+1], h2[j]) ;
+         __m256i s1 = SOUTH32(h1[j+1], h1[j+2]) ;
+         __m256i s2 = SOUTH32(h2[j+1], h2[j+2]) ;
+         AVXADDUP(n1, n2, m1[j], m2[j], s1, s2, x[j], x[j]) ;
+      }
+   }
+   for (j=0; j<4; j++)
+      _mm256_storeu_si256((__m256i *)(g + 4 * j), x[j]) ;
+}
+/*
+ *   A QuickLife slice has its top row in the high nibble and its west
+ *   cell in the high bit of each nibble, and a brick is eight slices
+ *   side by side, so one per 32-bit lane.  For 0->1 each new cell is
+ *   centered one cell down and to the right of its own position, so
+ *   we need the rows one and two down (from the brick below at the
+ *   bottom) and the columns one and two to the right (from the next
+ *   slice, the last lane getting the next brick's first slice).  For
+ *   1->0 it is all up and to the left.  Each row contributes the usual
+ *   two-bit sums before AVXADDUP.
+ */
+#define BRICKROW(w, g, e, h1, h2) {                                     \
+   __m256i b1 = _mm256_xor_si256(w, e), b2 = _mm256_and_si256(w, e) ;   \
+   h1 = _mm256_xor_si256(b1, g) ;                                       \
+   h2 = _mm256_or_si256(b2, _mm256_and_si256(b1, g)) ;                  \
+}
+#define NEXTCOLS(v, vn, g, e) {                                         \
+   g = _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi32(v, 1), m1110), \
+                       _mm256_and_si256(_mm256_srli_epi32(vn, 3), m0001)) ; \
+   e = _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi32(v, 2), m1100), \
+                       _mm256_and_si256(_mm256_srli_epi32(vn, 2), m0011)) ; \
+}
+#define PREVCOLS(v, vp, g, w) {                                         \
+   g = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(v, 1), m0111), \
+                       _mm256_and_si256(_mm256_slli_epi32(vp, 3), m1000)) ; \
+   w = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(v, 2), m0011), \
+                       _mm256_and_si256(_mm256_slli_epi32(vp, 2), m1100)) ; \
+}
+__attribute__((target("avx2")))
+void leafkernel::brick01avx2(const unsigned int *cur, const unsigned int *below,
+                             unsigned int *out) const {
+   const __m256i m1110 = _mm256_set1_epi32((int)0xeeeeeeee) ;
+   const __m256i m1100 = _mm256_set1_epi32((int)0xcccccccc) ;
+   const __m256i m0011 = _mm256_set1_epi32(0x33333333) ;
+   const __m256i m0001 = _mm256_set1_epi32(0x11111111) ;
+   __m256i v = _mm256_loadu_si256((const __m256i *)cur) ;
+   __m256i vn = _mm256_loadu_si256((const __m256i *)(cur + 1)) ;
+   __m256i b = _mm256_loadu_si256((const __m256i *)below) ;
+   __m256i bn = _mm256_loadu_si256((const __m256i *)(below + 1)) ;
+   __m256i r[3], rn[3], g, e, n1, n2, m1, m2, s1, s2, x ;
+   r[0] = v ;
+   rn[0] = vn ;
+   for (int k=1; k<3; k++) {
+      r[k] = _mm256_or_si256(_mm256_slli_epi32(v, 4 * k),
+                             _mm256_srli_epi32(b, 32 - 4 * k)) ;
+      rn[k] = _mm256_or_si256(_mm256_slli_epi32(vn, 4 * k),
+                              _mm256_srli_epi32(bn, 32 - 4 * k)) ;
+   }
+   NEXTCOLS(r[0], rn[0], g, e) ;
+   BRICKROW(r[0], g, e, n1, n2) ;
+   NEXTCOLS(r[1], rn[1], x, e) ;
+   m1 = _mm256_xor_si256(r[1], e) ;
+   m2 = _mm256_and_si256(r[1], e) ;
+   NEXTCOLS(r[2], rn[2], g, e) ;
+   BRICKROW(r[2], g, e, s1, s2) ;
+   AVXADDUP(n1, n2, m1, m2, s1, s2, x, x) ;
+   _mm256_storeu_si256((__m256i *)out, x) ;
+}
+__attribute__((target("avx2")))
+void leafkernel::brick10avx2(const unsigned int *cur, const unsigned int *above,
+                             unsigned int *out) const {
+   const __m256i m1100 = _mm256_set1_epi32((int)0xcccccccc) ;
+   const __m256i m1000 = _mm256_set1_epi32((int)0x88888888) ;
+   const __m256i m0111 = _mm256_set1_epi32(0x77777777) ;
+   const __m256i m0011 = _mm256_set1_epi32(0x33333333) ;
+   __m256i v = _mm256_loadu_si256((const __m256i *)(cur + 1)) ;
+   __m256i vp = _mm256_loadu_si256((const __m256i *)cur) ;
+   __m256i a = _mm256_loadu_si256((const __m256i *)(above + 1)) ;
+   __m256i ap = _mm256_loadu_si256((const __m256i *)above) ;
+   __m256i r[3], rp[3], g, w, n1, n2, m1, m2, s1, s2, x ;
+   r[0] = v ;
+   rp[0] = vp ;
+   for (int k=1; k<3; k++) {
+      r[k] = _mm256_or_si256(_mm256_srli_epi32(v, 4 * k),
+                             _mm256_slli_epi32(a, 32 - 4 * k)) ;
+      rp[k] = _mm256_or_si256(_mm256_srli_epi32(vp, 4 * k),
+                              _mm256_slli_epi32(ap, 32 - 4 * k)) ;
+   }
+   PREVCOLS(r[0], rp[0], g, w) ;
+   BRICKROW(w, g, r[0], s1, s2) ;
+   PREVCOLS(r[1], rp[1], x, w) ;
+   m1 = _mm256_xor_si256(r[1], w) ;
+   m2 = _mm256_and_si256(r[1], w) ;
+   PREVCOLS(r[2], rp[2], g, w) ;
+   BRICKROW(w, g, r[2], n1, n2) ;
+   AVXADDUP(n1, n2, m1, m2, s1, s2, x, x) ;
+   _mm256_storeu_si256((__m256i *)out, x) ;
+}
+#endif
@@ -0,0 +1,113 @@
+                        /*** /
+
+This file is part of Golly, a Game of Life Simulator.
+Copyright (C) 2013 Andrew Trevorrow and Tomas Rokicki.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ Web site:  http://sourceforge.net/projects/golly
+ Authors:   rokicki@gmail.com  andrew@trevorrow.com
+
+                        / ***/
+/**
+ *   Bit-sliced evaluation of small squares for hlifealgo.  Instead of
+ *   looking up 4x4 squares in the rule table one at a time, we keep a
+ *   whole 8x8 or 16x16 square in 64-bit words, one bit per cell, and
+ *   add up the neighbors of every cell at once with logic operations.
+ *   This only works for rules where the new state depends on just the
+ *   cell and the number of its eight neighbors that are on, so
+ *   setrule() looks at the rule table to see if that is the case;
+ *   for anything else (hexagonal, von Neumann, Wolfram and isotropic
+ *   non-totalistic rules) usable() is false and the caller should stay
+ *   with the table.
+ *
+ *   On x86 processors with AVX2 (checked at run time) we use vector
+ *   registers, which hold a 16x16 square in one and a 32x32 in four;
+ *   there we can also step QuickLife's bricks, which are eight 4x8
+ *   slices, so one register.
+ */
+#ifndef LEAFKERNEL_H
+#define LEAFKERNEL_H
+typedef unsigned long long leafbits ;
+class leafkernel {
+public:
+   leafkernel() ;
+   /**
+    *   Set up from a 4x4 to 2x2 rule table as built by liferules;
+    *   returns usable().
+    */
+   int setrule(const char *ruletable) ;
+   int usable() const { return ok ; }
+   /**
+    *   The center 4x4 of an 8x8 square after one and after two
+    *   generations, just like hlifealgo::leafres() computes from the
+    *   table.  Squares are given as 4x4 shorts in the usual order.
+    */
+   void leafres(unsigned short nw, unsigned short ne, unsigned short sw,
+                unsigned short se, unsigned short &res1,
+                unsigned short &res2) const ;
+   /**
+    *   The center 8x8 of a 16x16 square after 1, 2 or 4 generations.
+    *   The square comes in as sixteen 4x4 shorts, a row of four at a
+    *   time from the top, and the result goes out as four.
+    */
+   void center16(const unsigned short *in, int gens,
+                 unsigned short *out) const ;
+   /**
+    *   The center 16x16 of a 32x32 square after 1, 2, 4 or 8
+    *   generations, in sixty-four 4x4 shorts (eight to a row) in and
+    *   sixteen out.
+    */
+   void center32(const unsigned short *in, int gens,
+                 unsigned short *out) const ;
+   /**
+    *   A whole QuickLife brick (see qlifealgo.h) of eight slices at
+    *   once.  For phase 0->1, cur is the brick's eight slices followed
+    *   by the first slice of the brick to the right, and below the same
+    *   for the bricks below; for 1->0, the extra slice (the last of the
+    *   brick to the left) comes first and the second row is from the
+    *   bricks above.  We only do this with AVX2; the caller should use
+    *   its table when brickable() is false.
+    */
+   int brickable() const { return ok && avx2 ; }
+   void brick01(const unsigned int *cur, const unsigned int *below,
+                unsigned int *out) const ;
+   void brick10(const unsigned int *cur, const unsigned int *above,
+                unsigned int *out) const ;
+private:
+   leafbits rule(leafbits c0, leafbits c1, leafbits c2, leafbits c3,
+                 leafbits alive) const ;
+   leafbits step8(leafbits g) const ;
+   void step16(leafbits *g) const ;
+   void step32(leafbits *g) const ;
+   void step16avx2(leafbits *g, int gens) const ;
+   void step32avx2(leafbits *g, int gens) const ;
+   void brick01avx2(const unsigned int *cur, const unsigned int *below,
+                    unsigned int *out) const ;
+   void brick10avx2(const unsigned int *cur, const unsigned int *above,
+                    unsigned int *out) const ;
+   int ok, life, avx2 ;
+/*
+ *   For a rule other than Life, each neighbor count that does
+ *   anything becomes a term:  a cell is on next time if its count
+ *   matches (the count bits exclusive-ored with x0..x2 are all ones,
+ *   and the eights bit c3 anded with a3 and exclusive-ored with x3 is
+ *   one) and it is off and the count gives birth (dead is all ones)
+ *   or on and the count lets it survive (live is all ones).
+ */
+   int nterms ;
+   leafbits x0[9], x1[9], x2[9], a3[9], x3[9], dead[9], live[9] ;
+} ;
+#endif
@@ -30,6 +30,60 @@ lifealgo::~lifealgo() {
    maxCellStates = 2 ;
 }
 int lifealgo::verbose ;
+/*
+ *   Algorithms that can build a pattern faster than a cell at a time
+ *   override this.
+ */
+int lifealgo::setrow(int x, int y, int wd, const unsigned char *bits) {
+   for (int i=0; i<wd; i++) {
+      if (bits[i >> 3] == 0) {
+         i |= 7 ;
+         continue ;
+      }
+      if ((bits[i >> 3] & (128 >> (i & 7))) && setcell(x + i, y, 1) < 0)
+         return -1 ;
+   }
+   return 0 ;
+}
+/*
+ *   The strip routines go a cell at a time here (skipping the empty
+ *   cells with nextcell()); the tree algorithms walk the tree once for
+ *   the whole rectangle instead.
+ */
+void lifealgo::getstrip(int x, int y, int wd, int ht, unsigned char *states) {
+   for (int r=0; r<ht; r++) {
+      unsigned char *row = states + (size_t)r * wd ;
+      memset(row, 0, wd) ;
+      for (int i=0; i<wd; i++) {
+         int v ;
+         int skip = nextcell(x + i, y + r, v) ;
+         if (skip < 0 || skip >= wd - i)
+            break ;
+         i += skip ;
+         row[i] = (unsigned char)v ;
+      }
+   }
+}
+int lifealgo::putstrip(int x, int y, int wd, int ht,
+                       const unsigned char *states) {
+   for (int r=0; r<ht; r++)
+      for (int i=0; i<wd; i++)
+         if (states[(size_t)r * wd + i] &&
+             setcell(x + i, y + r, states[(size_t)r * wd + i]) < 0)
+            return -1 ;
+   return 0 ;
+}
+void lifealgo::clearstrip(int x, int y, int wd, int ht) {
+   for (int r=0; r<ht; r++)
+      for (int i=0; i<wd; i++) {
+         int v ;
+         int skip = nextcell(x + i, y + r, v) ;
+         if (skip < 0 || skip >= wd - i)
+            break ;
+         i += skip ;
+         setcell(x + i, y + r, 0) ;
+      }
+}
 /*
  *   Right now, the base/expo should match the current increment.
  *   We do not check this.
@@ -68,6 +122,8 @@ void lifealgo::extendtimeline() {
       timeline.framecount++ ;
       timeline.end = timeline.next ;
       timeline.next += timeline.inc ;
+      if (timeline.budget)
+        trimtimeline() ;
     }
   }
 }
@@ -81,10 +137,16 @@ void lifealgo::extendtimeline() {
  */
 void lifealgo::pruneframes() {
    if (timeline.framecount > 1) {
-      for (int i=2; i<timeline.framecount; i += 2)
+      int spilled = (int)timeline.spills.size() ;
+      for (int i=2; i<timeline.framecount; i += 2) {
          timeline.frames[i >> 1]  = timeline.frames[i] ;
+         if ((i >> 1) < spilled)
+            timeline.spills[i >> 1] = i < spilled ? timeline.spills[i] : -1 ;
+      }
       timeline.framecount = (timeline.framecount + 1) >> 1 ;
       timeline.frames.resize(timeline.framecount) ;
+      if (spilled > timeline.framecount)
+         timeline.spills.resize(timeline.framecount) ;
       timeline.inc += timeline.inc ;
       timeline.end = timeline.inc ;
       timeline.end.mul_smallint(timeline.framecount-1) ;
@@ -98,7 +160,10 @@ void lifealgo::pruneframes() {
 int lifealgo::gotoframe(int i) {
   if (i < 0 || i >= timeline.framecount)
     return 0 ;
-  setcurrentstate(timeline.frames[i]) ;
+  void *state = timeline.frames[i] ;
+  if (state == 0 && (state = loadframe(i)) == 0)
+    return 0 ;
+  setcurrentstate(state) ;
   // AKT: avoid mul_smallint(i) crashing with divide-by-zero if i is 0
   if (i > 0) {
     generation = timeline.inc ;
@@ -111,6 +176,7 @@ int lifealgo::gotoframe(int i) {
 }
 void lifealgo::destroytimeline() {
   timeline.frames.clear() ;
+  timeline.spills.clear() ;
   timeline.recording = 0 ;
   timeline.framecount = 0 ;
   timeline.end = 0 ;
@@ -323,6 +389,46 @@ const char* lifealgo::canonicalsuffix() {
    }
 }
 
+// the longest run of cells CopyEdge() moves at once
+static const int EDGECHUNK = 4096;
+
+void lifealgo::CopyEdge(int sx, int sy, bool srow, int dx, int dy, bool drow,
+                        int len, bool twist, int shift)
+{
+    // copy the live cells of an edge (a row if srow, else a column) of len
+    // cells starting at sx,sy to the border line starting at dx,dy, so that
+    // cell i of the border gets cell i of the edge, or cell len-1-i if twist,
+    // moved on by shift (wrapping round the edge)
+    unsigned char buf[EDGECHUNK], out[EDGECHUNK];
+    for (int i = 0; i < len; ) {
+        int j = twist ? len - 1 - i : i;
+        j = (int)((((G_INT64)j + shift) % len + len) % len);
+        // a run ends when the source wraps, or it's as long as the buffer
+        int n = len - i;
+        if (n > EDGECHUNK) n = EDGECHUNK;
+        if (twist) {
+            if (n > j + 1) n = j + 1;
+            j -= n - 1;
+        } else {
+            if (n > len - j) n = len - j;
+        }
+        if (srow)
+            getstrip(sx + j, sy, n, 1, buf);
+        else
+            getstrip(sx, sy + j, 1, n, buf);
+        const unsigned char *p = buf;
+        if (twist) {
+            for (int k = 0; k < n; k++) out[k] = buf[n - 1 - k];
+            p = out;
+        }
+        if (drow)
+            putstrip(dx + i, dy, n, 1, p);
+        else
+            putstrip(dx, dy + i, 1, n, p);
+        i += n;
+    }
+}
+
 void lifealgo::JoinTwistedEdges()
 {
     // set grid edges
@@ -346,21 +452,11 @@ void lifealgo::JoinTwistedEdges()
         //  d I J K L a
         //  i d c b a l
         
-        for (int x = gl; x <= gr; x++) {
-            int twistedx = gr - x + gl;
-            int state = getcell(twistedx, gt);
-            if (state > 0) setcell(x, bb, state);
-            state = getcell(twistedx, gb);
-            if (state > 0) setcell(x, bt, state);
-        }
+        CopyEdge(gl, gt, true, gl, bb, true, gridwd, true, 0);
+        CopyEdge(gl, gb, true, gl, bt, true, gridwd, true, 0);
         
-        for (int y = gt; y <= gb; y++) {
-            int twistedy = gb - y + gt;
-            int state = getcell(gl, twistedy);
-            if (state > 0) setcell(br, y, state);
-            state = getcell(gr, twistedy);
-            if (state > 0) setcell(bl, y, state);
-        }
+        CopyEdge(gl, gt, false, br, gt, false, gridht, true, 0);
+        CopyEdge(gr, gt, false, bl, gt, false, gridht, true, 0);
         
         // copy grid's corner cells to SAME corners in border
         // (these cells are topologically different to non-corner cells)
@@ -378,21 +474,12 @@ void lifealgo::JoinTwistedEdges()
         //  l I J K L i
         //  a d c b a d
         
-        for (int x = gl; x <= gr; x++) {
-            int twistedx = gr - x + gl;
-            int state = getcell(twistedx, gt);
-            if (state > 0) setcell(x, bb, state);
-            state = getcell(twistedx, gb);
-            if (state > 0) setcell(x, bt, state);
-        }
+        CopyEdge(gl, gt, true, gl, bb, true, gridwd, true, 0);
+        CopyEdge(gl, gb, true, gl, bt, true, gridwd, true, 0);
         
-        for (int y = gt; y <= gb; y++) {
-            // join left and right edges with no twist
-            int state = getcell(gl, y);
-            if (state > 0) setcell(br, y, state);
-            state = getcell(gr, y);
-            if (state > 0) setcell(bl, y, state);
-        }
+        // join left and right edges with no twist
+        CopyEdge(gl, gt, false, br, gt, false, gridht, false, 0);
+        CopyEdge(gr, gt, false, bl, gt, false, gridht, false, 0);
         
         // do corner cells
         setcell(bl, bt, getcell(gl, gb));
@@ -409,21 +496,12 @@ void lifealgo::JoinTwistedEdges()
         //  d I J K L a
         //  l a b c d i
         
-        for (int x = gl; x <= gr; x++) {
-            // join top and bottom edges with no twist
-            int state = getcell(x, gt);
-            if (state > 0) setcell(x, bb, state);
-            state = getcell(x, gb);
-            if (state > 0) setcell(x, bt, state);
-        }
+        // join top and bottom edges with no twist
+        CopyEdge(gl, gt, true, gl, bb, true, gridwd, false, 0);
+        CopyEdge(gl, gb, true, gl, bt, true, gridwd, false, 0);
         
-        for (int y = gt; y <= gb; y++) {
-            int twistedy = gb - y + gt;
-            int state = getcell(gl, twistedy);
-            if (state > 0) setcell(br, y, state);
-            state = getcell(gr, twistedy);
-            if (state > 0) setcell(bl, y, state);
-        }
+        CopyEdge(gl, gt, false, br, gt, false, gridht, true, 0);
+        CopyEdge(gr, gt, false, bl, gt, false, gridht, true, 0);
         
         // do corner cells
         setcell(bl, bt, getcell(gr, gt));
@@ -456,29 +534,16 @@ void lifealgo::JoinTwistedAndShiftedEdges()
         //  l I J K L i
         //  b a d c b a
         
-        int state, twistedx, shiftedx;
+        // join top and bottom edges with a twist and then shift by 1
+        CopyEdge(gl, gb, true, gl, bt, true, gridwd, true, -1);
+        CopyEdge(gl, gt, true, gl, bb, true, gridwd, true, -1);
         
-        for (int x = gl; x <= gr; x++) {
-            // join top and bottom edges with a twist and then shift by 1
-            twistedx = gr - x + gl;
-            shiftedx = twistedx - 1; if (shiftedx < gl) shiftedx = gr;
-            state = getcell(shiftedx, gb);
-            if (state > 0) setcell(x, bt, state);
-            
-            state = getcell(shiftedx, gt);
-            if (state > 0) setcell(x, bb, state);
-        }
-        
-        for (int y = gt; y <= gb; y++) {
-            // join left and right edges with no twist or shift
-            state = getcell(gl, y);
-            if (state > 0) setcell(br, y, state);
-            state = getcell(gr, y);
-            if (state > 0) setcell(bl, y, state);
-        }
+        // join left and right edges with no twist or shift
+        CopyEdge(gl, gt, false, br, gt, false, gridht, false, 0);
+        CopyEdge(gr, gt, false, bl, gt, false, gridht, false, 0);
         
         // do corner cells
-        shiftedx = gl - 1; if (shiftedx < gl) shiftedx = gr;
+        int shiftedx = gl - 1; if (shiftedx < gl) shiftedx = gr;
         setcell(bl, bt, getcell(shiftedx, gb));
         setcell(bl, bb, getcell(shiftedx, gt));
         shiftedx = gr - 1; if (shiftedx < gl) shiftedx = gr;
@@ -495,29 +560,16 @@ void lifealgo::JoinTwistedAndShiftedEdges()
         //  f J K L d
         //  c a b c a
         
-        int state, twistedy, shiftedy;
-        
-        for (int x = gl; x <= gr; x++) {
-            // join top and bottom edges with no twist or shift
-            state = getcell(x, gt);
-            if (state > 0) setcell(x, bb, state);
-            state = getcell(x, gb);
-            if (state > 0) setcell(x, bt, state);
-        }
+        // join top and bottom edges with no twist or shift
+        CopyEdge(gl, gt, true, gl, bb, true, gridwd, false, 0);
+        CopyEdge(gl, gb, true, gl, bt, true, gridwd, false, 0);
         
-        for (int y = gt; y <= gb; y++) {
-            // join left and right edges with a twist and then shift by 1
-            twistedy = gb - y + gt;
-            shiftedy = twistedy - 1; if (shiftedy < gt) shiftedy = gb;
-            state = getcell(gr, shiftedy);
-            if (state > 0) setcell(bl, y, state);
-            
-            state = getcell(gl, shiftedy);
-            if (state > 0) setcell(br, y, state);
-        }
+        // join left and right edges with a twist and then shift by 1
+        CopyEdge(gr, gt, false, bl, gt, false, gridht, true, -1);
+        CopyEdge(gl, gt, false, br, gt, false, gridht, true, -1);
         
         // do corner cells
-        shiftedy = gt - 1; if (shiftedy < gt) shiftedy = gb;
+        int shiftedy = gt - 1; if (shiftedy < gt) shiftedy = gb;
         setcell(bl, bt, getcell(gr, shiftedy));
         setcell(br, bt, getcell(gl, shiftedy));
         shiftedy = gb - 1; if (shiftedy < gt) shiftedy = gb;
@@ -549,32 +601,16 @@ void lifealgo::JoinShiftedEdges(int hshift, int vshift)  // horizontal and verti
         //  l I J K L i
         //  a b c d a b
         
-        int state, shiftedx;
+        // join top and bottom edges with a horizontal shift
+        CopyEdge(gl, gb, true, gl, bt, true, gridwd, false, -hshift);
+        CopyEdge(gl, gt, true, gl, bb, true, gridwd, false, hshift);
         
-        for (int x = gl; x <= gr; x++) {
-            // join top and bottom edges with a horizontal shift
-            shiftedx = x - hshift;
-            if (shiftedx < gl) shiftedx += gridwd; else if (shiftedx > gr) shiftedx -= gridwd;
-            state = getcell(shiftedx, gb);
-            if (state > 0) setcell(x, bt, state);
-            
-            shiftedx = x + hshift;
-            if (shiftedx < gl) shiftedx += gridwd; else if (shiftedx > gr) shiftedx -= gridwd;
-            state = getcell(shiftedx, gt);
-            if (state > 0) setcell(x, bb, state);
-        }
-        
-        for (int y = gt; y <= gb; y++) {
-            // join left and right edges with no shift
-            state = getcell(gl, y);
-            if (state > 0) setcell(br, y, state);
-            
-            state = getcell(gr, y);
-            if (state > 0) setcell(bl, y, state);
-        }
+        // join left and right edges with no shift
+        CopyEdge(gl, gt, false, br, gt, false, gridht, false, 0);
+        CopyEdge(gr, gt, false, bl, gt, false, gridht, false, 0);
         
         // do corner cells
-        shiftedx = gr - hshift;
+        int shiftedx = gr - hshift;
         if (shiftedx < gl) shiftedx += gridwd; else if (shiftedx > gr) shiftedx -= gridwd;
         setcell(bl, bt, getcell(shiftedx, gb));
         shiftedx = gl - hshift;
@@ -596,32 +632,16 @@ void lifealgo::JoinShiftedEdges(int hshift, int vshift)  // horizontal and verti
         //  h I J K L a
         //  l a b c d e
         
-        int state, shiftedy;
+        // join top and bottom edges with no shift
+        CopyEdge(gl, gt, true, gl, bb, true, gridwd, false, 0);
+        CopyEdge(gl, gb, true, gl, bt, true, gridwd, false, 0);
         
-        for (int x = gl; x <= gr; x++) {
-            // join top and bottom edges with no shift
-            state = getcell(x, gt);
-            if (state > 0) setcell(x, bb, state);
-            
-            state = getcell(x, gb);
-            if (state > 0) setcell(x, bt, state);
-        }
-        
-        for (int y = gt; y <= gb; y++) {
-            // join left and right edges with a vertical shift
-            shiftedy = y - vshift;
-            if (shiftedy < gt) shiftedy += gridht; else if (shiftedy > gb) shiftedy -= gridht;
-            state = getcell(gr, shiftedy);
-            if (state > 0) setcell(bl, y, state);
-            
-            shiftedy = y + vshift;
-            if (shiftedy < gt) shiftedy += gridht; else if (shiftedy > gb) shiftedy -= gridht;
-            state = getcell(gl, shiftedy);
-            if (state > 0) setcell(br, y, state);
-        }
+        // join left and right edges with a vertical shift
+        CopyEdge(gr, gt, false, bl, gt, false, gridht, false, -vshift);
+        CopyEdge(gl, gt, false, br, gt, false, gridht, false, vshift);
         
         // do corner cells
-        shiftedy = gb - vshift;
+        int shiftedy = gb - vshift;
         if (shiftedy < gt) shiftedy += gridht; else if (shiftedy > gb) shiftedy -= gridht;
         setcell(bl, bt, getcell(gr, shiftedy));
         shiftedy = gb + vshift;
@@ -659,36 +679,16 @@ void lifealgo::JoinAdjacentEdges(int pt, int pl, int pb, int pr)    // pattern e
     //  g c f i i
     
     // copy live cells in top edge to left border
-    for (int x = pl; x <= pr; x++) {
-        int state;
-        int skip = nextcell(x, gt, state);
-        if (skip < 0) break;
-        x += skip;
-        if (state > 0) setcell(bl, gt + (x - gl), state);
-    }
+    CopyEdge(pl, gt, true, bl, gt + (pl - gl), false, pr - pl + 1, false, 0);
     
     // copy live cells in left edge to top border
-    for (int y = pt; y <= pb; y++) {
-        // no point using nextcell() here -- edge is only 1 cell wide
-        int state = getcell(gl, y);
-        if (state > 0) setcell(gl + (y - gt), bt, state);
-    }
+    CopyEdge(gl, pt, false, gl + (pt - gt), bt, true, pb - pt + 1, false, 0);
     
     // copy live cells in bottom edge to right border
-    for (int x = pl; x <= pr; x++) {
-        int state;
-        int skip = nextcell(x, gb, state);
-        if (skip < 0) break;
-        x += skip;
-        if (state > 0) setcell(br, gt + (x - gl), state);
-    }
+    CopyEdge(pl, gb, true, br, gt + (pl - gl), false, pr - pl + 1, false, 0);
     
     // copy live cells in right edge to bottom border
-    for (int y = pt; y <= pb; y++) {
-        // no point using nextcell() here -- edge is only 1 cell wide
-        int state = getcell(gr, y);
-        if (state > 0) setcell(gl + (y - gt), bb, state);
-    }
+    CopyEdge(gr, pt, false, gl + (pt - gt), bb, true, pb - pt + 1, false, 0);
     
     // copy grid's corner cells to SAME corners in border
     setcell(bl, bt, getcell(gl, gt));
@@ -713,36 +713,16 @@ void lifealgo::JoinEdges(int pt, int pl, int pb, int pr)    // pattern edges
     
     if (gridht > 0) {
         // copy live cells in top edge to bottom border
-        for (int x = pl; x <= pr; x++) {
-            int state;
-            int skip = nextcell(x, gt, state);
-            if (skip < 0) break;
-            x += skip;
-            if (state > 0) setcell(x, bb, state);
-        }
+        CopyEdge(pl, gt, true, pl, bb, true, pr - pl + 1, false, 0);
         // copy live cells in bottom edge to top border
-        for (int x = pl; x <= pr; x++) {
-            int state;
-            int skip = nextcell(x, gb, state);
-            if (skip < 0) break;
-            x += skip;
-            if (state > 0) setcell(x, bt, state);
-        }
+        CopyEdge(pl, gb, true, pl, bt, true, pr - pl + 1, false, 0);
     }
     
     if (gridwd > 0) {
         // copy live cells in left edge to right border
-        for (int y = pt; y <= pb; y++) {
-            // no point using nextcell() here -- edge is only 1 cell wide
-            int state = getcell(gl, y);
-            if (state > 0) setcell(br, y, state);
-        }
+        CopyEdge(gl, pt, false, br, pt, false, pb - pt + 1, false, 0);
         // copy live cells in right edge to left border
-        for (int y = pt; y <= pb; y++) {
-            // no point using nextcell() here -- edge is only 1 cell wide
-            int state = getcell(gr, y);
-            if (state > 0) setcell(bl, y, state);
-        }
+        CopyEdge(gr, pt, false, bl, pt, false, pb - pt + 1, false, 0);
     }
     
     if (gridwd > 0 && gridht > 0) {
@@ -756,8 +736,9 @@ void lifealgo::JoinEdges(int pt, int pl, int pb, int pr)    // pattern edges
 
 bool lifealgo::CreateBorderCells()
 {
-    // no need to do anything if there is no pattern or if the grid is a bounded plane
-    if (isEmpty() || boundedplane) return true;
+    // no need to do anything if there is no pattern or if the grid is a bounded plane,
+    // or if step() handles the grid itself
+    if (gridCapable() || isEmpty() || boundedplane) return true;
     
     bigint top, left, bottom, right;
     findedges(&top, &left, &bottom, &right);
@@ -777,6 +758,16 @@ bool lifealgo::CreateBorderCells()
         return false;
     }
     
+    // cells outside a wrapped grid are dropped before its edges are joined
+    // (as HashLife does when it steps the grid itself); only a bounded plane
+    // lets them take part in the next generation
+    if ( (gridwd > 0 && (left < gridleft || right > gridright)) ||
+         (gridht > 0 && (top < gridtop || bottom > gridbottom)) ) {
+        ClearOutsideGrid(top, left, bottom, right);
+        if (isEmpty()) return true;
+        findedges(&top, &left, &bottom, &right);
+    }
+    
     if (sphere) {
         // to get a sphere we join top edge with left edge, and right edge with bottom edge;
         // note that grid must be square (gridwd == gridht)
@@ -814,29 +805,10 @@ bool lifealgo::CreateBorderCells()
     return true;
 }
 
-void lifealgo::ClearRect(int top, int left, int bottom, int right)
-{
-    int cx, cy, v;
-    for ( cy = top; cy <= bottom; cy++ ) {
-        for ( cx = left; cx <= right; cx++ ) {
-            int skip = nextcell(cx, cy, v);
-            if (skip + cx > right)
-                skip = -1;           // pretend we found no more live cells
-            if (skip >= 0) {
-                // found next live cell so delete it
-                cx += skip;
-                setcell(cx, cy, 0);
-            } else {
-                cx = right + 1;     // done this row
-            }
-        }
-    }
-}
-
 bool lifealgo::DeleteBorderCells()
 {
-    // no need to do anything if there is no pattern
-    if (isEmpty()) return true;
+    // no need to do anything if there is no pattern or if step() handles the grid
+    if (gridCapable() || isEmpty()) return true;
     
     // need to find pattern edges because pattern may have expanded beyond grid
     // (typically by 2 cells, but could be more if rule allows births in empty space)
@@ -849,6 +821,22 @@ bool lifealgo::DeleteBorderCells()
         return true;
     }
     
+    ClearOutsideGrid(top, left, bottom, right);
+    
+    // do this test AFTER clearing border
+    if ( top < bigint::min_coord || left < bigint::min_coord ||
+         bottom > bigint::max_coord || right > bigint::max_coord ) {
+        lifestatus("Pattern exceeded editing limit!");
+        // return false so caller can exit step() loop
+        return false;
+    }
+
+    return true;
+}
+
+void lifealgo::ClearOutsideGrid(const bigint &top, const bigint &left,
+                                const bigint &bottom, const bigint &right)
+{
     // set pattern edges
     int pl = left.toint();
     int pt = top.toint();
@@ -863,37 +851,27 @@ bool lifealgo::DeleteBorderCells()
     
     if (gridht > 0 && pt < gt) {
         // delete live cells above grid
-        ClearRect(pt, pl, gt-1, pr);
+        clearstrip(pl, pt, pr - pl + 1, gt - pt);
         pt = gt; // reduce size of rect below
     }
     
     if (gridht > 0 && pb > gb) {
         // delete live cells below grid
-        ClearRect(gb+1, pl, pb, pr);
+        clearstrip(pl, gb + 1, pr - pl + 1, pb - gb);
         pb = gb; // reduce size of rect below
     }
     
     if (gridwd > 0 && pl < gl) {
         // delete live cells left of grid
-        ClearRect(pt, pl, pb, gl-1);
+        clearstrip(pl, pt, gl - pl, pb - pt + 1);
     }
     
     if (gridwd > 0 && pr > gr) {
         // delete live cells right of grid
-        ClearRect(pt, gr+1, pb, pr);
+        clearstrip(gr + 1, pt, pr - gr, pb - pt + 1);
     }
     
     endofpattern();
-    
-    // do this test AFTER clearing border
-    if ( top < bigint::min_coord || left < bigint::min_coord ||
-         bottom > bigint::max_coord || right > bigint::max_coord ) {
-        lifestatus("Pattern exceeded editing limit!");
-        // return false so caller can exit step() loop
-        return false;
-    }
-
-    return true;
 }
 
 // -----------------------------------------------------------------------------
@@ -51,15 +51,21 @@ using std::vector;
 const int MAX_FRAME_COUNT = 32000 ;
 
 /**
- *   Timeline support is pretty generic.
+ *   Timeline support is pretty generic.  An algo that can tell how much
+ *   memory the frames hold may keep them to a budget by moving some out
+ *   of memory; such a frame is 0 in frames, and spills says where it
+ *   went (spills may be shorter than frames; -1 means not spilled).
  */
 class timeline_t {
 public:
    timeline_t() : recording(0), framecount(0), savetimeline(1),
-                  start(0), inc(0), next(0), end(0), frames() {}
+                  start(0), inc(0), next(0), end(0), frames(),
+                  budget(0), spills() {}
    int recording, framecount, base, expo, savetimeline ;
    bigint start, inc, next, end ;
    vector<void *> frames ;
+   g_uintptr_t budget ; // bytes the frames may hold; 0 for no limit
+   vector<long> spills ;
 } ;
 
 class lifealgo {
@@ -74,7 +80,20 @@ public:
    virtual int setcell(int x, int y, int newstate) = 0 ;
    virtual int getcell(int x, int y) = 0 ;
    virtual int nextcell(int x, int y, int &v) = 0 ;
-   // call after setcell/clearcell calls
+   // set the live cells of one row from a bitmap, wd bits, most
+   // significant bit first; rows can come in any order, but top to
+   // bottom is quickest; returns -1 on error, like setcell
+   virtual int setrow(int x, int y, int wd, const unsigned char *bits) ;
+   // copy the wd by ht rectangle of cells whose top left corner is x, y
+   // into states, a byte per cell, a row at a time from the top
+   virtual void getstrip(int x, int y, int wd, int ht, unsigned char *states) ;
+   // and back:  set the cells whose byte is nonzero to that state and
+   // leave the rest alone; returns -1 on error, like setcell
+   virtual int putstrip(int x, int y, int wd, int ht,
+                        const unsigned char *states) ;
+   // kill every cell in the rectangle
+   virtual void clearstrip(int x, int y, int wd, int ht) ;
+   // call after setcell/clearcell/setrow/putstrip/clearstrip calls
    virtual void endofpattern() = 0 ;
    virtual void setIncrement(bigint inc) = 0 ;
    virtual void setIncrement(int inc) = 0 ;
@@ -87,6 +106,9 @@ public:
    virtual int hyperCapable() = 0 ;
    virtual void setMaxMemory(int m) = 0 ;          // never alloc more than this
    virtual int getMaxMemory() = 0 ;
+   // how many threads step() may use; most algos only ever use one
+   virtual void setMaxThreads(int) {}
+   virtual int getMaxThreads() { return 1 ; }
    virtual const char *setrule(const char *) = 0 ; // new rules; returns err msg
    virtual const char *getrule() = 0 ;             // get current rule set
    virtual void step() = 0 ;                       // do inc gens
@@ -95,8 +117,17 @@ public:
    virtual void findedges(bigint *t, bigint *l, bigint *b, bigint *r) = 0 ;
    virtual void lowerRightPixel(bigint &x, bigint &y, int mag) = 0 ;
    virtual const char *writeNativeFormat(std::ostream &os, char *comments) = 0 ;
+   // the binary macrocell format; readmacrocell reads both
+   virtual const char *writeNativeBinary(std::ostream &, char *) {
+      return "Cannot write binary macrocell format." ;
+   }
    void setpoll(lifepoll *pollerarg) { poller = pollerarg ; }
-   virtual const char *readmacrocell(char *) { return "Cannot read macrocell format." ; }
+   virtual const char *readmacrocell(patternreader &, char *) {
+      return "Cannot read macrocell format." ;
+   }
+   // save and reload what the algo has worked out (only hashlife)
+   virtual const char *writememo(const char *) { return "Cannot save results." ; }
+   virtual const char *readmemo(const char *) { return "Cannot load results." ; }
    
    // Verbosity crosses algorithms.  We need to embed this sort of option
    // into some global shared thing or something rather than use static.
@@ -124,6 +155,15 @@ public:
    int gotoframe(int i) ;
    void destroytimeline() ;
    void savetimelinewithframe(int yesno) { timeline.savetimeline = yesno ; }
+   void settimelinebudget(g_uintptr_t bytes) { timeline.budget = bytes ; }
+   g_uintptr_t gettimelinebudget() { return timeline.budget ; }
+   // what each frame alone holds in memory (nothing shared with another
+   // frame or the current pattern); returns 0 if the algo can't tell
+   virtual int framecosts(vector<g_uintptr_t> &) { return 0 ; }
+   // keep the frames to the budget (called as the timeline grows)
+   virtual void trimtimeline() {}
+   // bring back a spilled frame; returns 0 if it can't
+   virtual void *loadframe(int) { return 0 ; }
 
    // support for a bounded universe with various topologies:
    // plane, cylinder, torus, Klein bottle, cross-surface, sphere
@@ -146,6 +186,9 @@ public:
    // the above routines can be called around step() to create the
    // illusion of a bounded universe (note that increment must be 1);
    // they return false if the pattern exceeds the editing limits
+   virtual int gridCapable() { return 0 ; }
+   // can step() keep to the current grid itself, at any increment?
+   // if so the above routines do nothing
    
    enum TGridType { SQUARE_GRID, TRI_GRID, HEX_GRID, VN_GRID } ;
    TGridType getgridtype() const { return grid_type ; }
@@ -166,8 +209,12 @@ private:
    void JoinShiftedEdges(int hshift, int vshift) ;
    void JoinAdjacentEdges(int pt, int pl, int pb, int pr) ;
    void JoinEdges(int pt, int pl, int pb, int pr) ;
-   // following is called by DeleteBorderCells()
-   void ClearRect(int top, int left, int bottom, int right) ;
+   // all of which copy an edge a strip at a time with this
+   void CopyEdge(int sx, int sy, bool srow, int dx, int dy, bool drow,
+                 int len, bool twist, int shift) ;
+   // remove live cells outside the grid, given the pattern edges
+   void ClearOutsideGrid(const bigint &top, const bigint &left,
+                         const bigint &bottom, const bigint &right) ;
 } ;
 
 /**
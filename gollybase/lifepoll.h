@@ -30,6 +30,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 #ifndef LIFEPOLL_H
 #define LIFEPOLL_H
+#include <atomic>
 /**
  *   How frequently to invoke the heavyweight event checker, as a
  *   count of inner-loop polls.
@@ -45,9 +46,12 @@ public:
     */
    virtual int checkevents() ;
    /**
-    *   Was an interrupt requested?
+    *   Was an interrupt requested?  (Threads helping with a step may
+    *   ask this while the main thread polls, so the flag is atomic.)
     */
-   int isInterrupted() { return interrupted ; }
+   int isInterrupted() {
+      return interrupted.load(std::memory_order_relaxed) ;
+   }
    /**
     *   Before a calculation begins, call this to reset the
     *   interrupted flag.
@@ -74,7 +78,7 @@ public:
     *   millions of times a second.
     */
    inline int poll() {
-      return (countdown-- > 0) ? interrupted : inner_poll() ;
+      return (countdown-- > 0) ? isInterrupted() : inner_poll() ;
    }
    int inner_poll() ;
    /**
@@ -100,7 +104,7 @@ public:
     */
    virtual void updatePop() ;
 private:
-   int interrupted ;
+   std::atomic<int> interrupted ;
    int calculating ;
    int countdown ;
 } ;
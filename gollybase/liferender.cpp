@@ -22,4 +22,212 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
                         / ***/
 #include "liferender.h"
+#include <cstring>
 liferender::~liferender() {}
+
+void expandbits(const unsigned char *bm, int nbytes, unsigned char *pm,
+                int pmscale, const unsigned char *live,
+                const unsigned char *dead) {
+   if (pmscale == 1) {
+      // each nibble becomes four RGBA pixels, copied from a table of all
+      // sixteen patterns; this runs at close to memset speed
+      unsigned char quad[16][16] ;
+      for (int n=0; n<16; n++)
+         for (int k=0; k<4; k++)
+            memcpy(quad[n] + 4 * k, ((n << k) & 8) ? live : dead, 4) ;
+      for (int i=0; i<nbytes; i++, pm += 32) {
+         memcpy(pm, quad[bm[i] >> 4], 16) ;
+         memcpy(pm + 16, quad[bm[i] & 15], 16) ;
+      }
+      return ;
+   }
+   // eight state bytes per bitmap byte, also from a table
+   static unsigned char states[256][8] ;
+   static bool inited = false ;
+   if (!inited) {
+      for (int b=0; b<256; b++)
+         for (int k=0; k<8; k++)
+            states[b][k] = (b >> (7 - k)) & 1 ;
+      inited = true ;
+   }
+   for (int i=0; i<nbytes; i++, pm += 8)
+      memcpy(pm, states[bm[i]], 8) ;
+}
+
+int densitylevel(double frac) {
+   if (frac <= 0)
+      return 0 ;
+   int level = 32 + (int)(223 * frac + 0.5) ;
+   return level > 255 ? 255 : level ;
+}
+
+void densityramp(const unsigned char *live, const unsigned char *dead,
+                 unsigned char ramp[256][4]) {
+   for (int level=0; level<256; level++)
+      for (int k=0; k<4; k++)
+         ramp[level][k] = (unsigned char)
+               ((dead[k] * (255 - level) + live[k] * level + 127) / 255) ;
+}
+
+damagecache::damagecache() {
+   lastepoch = 0 ;
+   renderer = lastrenderer = 0 ;
+   mode = lastmode = liferender::DAMAGE_NONE ;
+   lastbits = false ;
+   memset(dead, 0, sizeof(dead)) ;
+}
+
+void damagecache::beginframe(liferender *r, const void *frame, int framelen,
+                             long epoch, const unsigned char *deadrgba) {
+   renderer = r ;
+   mode = r->damagemode() ;
+   if (mode == liferender::DAMAGE_NONE) {
+      tiles.clear() ;
+      stale.clear() ;
+      lastrenderer = 0 ;
+      return ;
+   }
+   memcpy(dead, deadrgba, sizeof(dead)) ;
+   std::string f((const char *)frame, framelen) ;
+   bool bits = r->takesbits() ;
+   if (r != lastrenderer || mode != lastmode || bits != lastbits) {
+      // a different image; we can't blank what it never showed
+      tiles.clear() ;
+      stale.clear() ;
+   } else if (epoch < 0 || epoch != lastepoch || f != lastframe) {
+      // nothing can be reused, but a retaining renderer still needs the
+      // old rectangles so tiles that are now empty get blanked
+      if (mode == liferender::DAMAGE_RETAINED) {
+         std::map<std::pair<int, int>, tileinfo>::iterator it ;
+         for (it = tiles.begin(); it != tiles.end(); it++)
+            it->second.key.clear() ;
+      } else {
+         tiles.clear() ;
+      }
+   }
+   lastrenderer = r ;
+   lastmode = mode ;
+   lastbits = bits ;
+   lastepoch = epoch ;
+   lastframe.swap(f) ;
+   std::map<std::pair<int, int>, tileinfo>::iterator it ;
+   for (it = tiles.begin(); it != tiles.end(); it++) {
+      it->second.age++ ;
+      it->second.changed = false ;
+   }
+}
+
+int damagecache::reuse(int x, int y, const void *key, int keylen) {
+   if (mode == liferender::DAMAGE_NONE)
+      return 0 ;
+   std::map<std::pair<int, int>, tileinfo>::iterator it =
+                                          tiles.find(std::make_pair(x, y)) ;
+   if (it == tiles.end())
+      return 0 ;
+   tileinfo &t = it->second ;
+   if ((int)t.key.size() != keylen || keylen == 0 ||
+       memcmp(t.key.data(), key, keylen) != 0)
+      return 0 ;
+   t.age = 0 ;
+   if (mode == liferender::DAMAGE_CACHE)
+      show(t) ;
+   return 1 ;
+}
+
+void damagecache::blit(int x, int y, int rx, int ry, int rw, int rh,
+                       unsigned char *pm, int pmscale,
+                       const void *key, int keylen) {
+   if (mode == liferender::DAMAGE_NONE)
+      renderer->pixblit(rx, ry, rw, rh, pm, pmscale) ;
+   else
+      store(x, y, rx, ry, rw, rh, pm, pmscale, false, key, keylen) ;
+}
+
+void damagecache::bitblit(int x, int y, int rx, int ry, int rw, int rh,
+                          unsigned char *bm, int pmscale,
+                          const void *key, int keylen) {
+   if (mode == liferender::DAMAGE_NONE)
+      renderer->bitblit(rx, ry, rw, rh, bm, pmscale) ;
+   else
+      store(x, y, rx, ry, rw, rh, bm, pmscale, true, key, keylen) ;
+}
+
+void damagecache::store(int x, int y, int rx, int ry, int rw, int rh,
+                        unsigned char *pm, int pmscale, bool bits,
+                        const void *key, int keylen) {
+   std::pair<std::map<std::pair<int, int>, tileinfo>::iterator, bool> ins =
+                     tiles.insert(std::make_pair(std::make_pair(x, y),
+                                                 tileinfo())) ;
+   tileinfo &t = ins.first->second ;
+   if (!ins.second && mode == liferender::DAMAGE_RETAINED &&
+       (t.rx != rx || t.ry != ry || t.rw != rw || t.rh != rh ||
+        t.pmscale != pmscale))
+      stale.push_back(t) ;
+   int len = (rw / pmscale) * (rh / pmscale) ;
+   if (bits)
+      len = (len + 7) >> 3 ;
+   else if (pmscale == 1)
+      len *= 4 ;
+   t.rx = rx ;
+   t.ry = ry ;
+   t.rw = rw ;
+   t.rh = rh ;
+   t.pmscale = pmscale ;
+   t.bits = bits ;
+   t.age = 0 ;
+   t.key.assign((const char *)key, keylen) ;
+   t.pixels.assign(pm, pm + len) ;
+   if (mode == liferender::DAMAGE_RETAINED)
+      t.changed = true ;        // wait until the blanks are done
+   else
+      show(t) ;
+}
+
+void damagecache::show(const tileinfo &t) {
+   unsigned char *pm = (unsigned char *)&t.pixels[0] ;
+   if (t.bits)
+      renderer->bitblit(t.rx, t.ry, t.rw, t.rh, pm, t.pmscale) ;
+   else
+      renderer->pixblit(t.rx, t.ry, t.rw, t.rh, pm, t.pmscale) ;
+}
+
+void damagecache::blank(const tileinfo &t) {
+   tileinfo b = t ;
+   if (t.bits || t.pmscale > 1) {
+      b.pixels.assign(t.pixels.size(), 0) ;
+   } else {
+      for (size_t i = 0; i < b.pixels.size(); i += 4)
+         memcpy(&b.pixels[i], dead, 4) ;
+   }
+   show(b) ;
+}
+
+void damagecache::endframe() {
+   if (mode == liferender::DAMAGE_NONE) {
+      renderer = 0 ;
+      return ;
+   }
+   bool retained = (mode == liferender::DAMAGE_RETAINED) ;
+   if (retained)
+      for (size_t i = 0; i < stale.size(); i++)
+         blank(stale[i]) ;
+   stale.clear() ;
+   // a cached tile survives one frame unseen because qlife alternates
+   // between two bitmap grids on odd and even generations; what a
+   // retaining renderer shows must match this frame exactly
+   std::map<std::pair<int, int>, tileinfo>::iterator it = tiles.begin() ;
+   while (it != tiles.end()) {
+      if (it->second.age == 0 || (!retained && it->second.age == 1)) {
+         it++ ;
+      } else {
+         if (retained)
+            blank(it->second) ;
+         tiles.erase(it++) ;
+      }
+   }
+   if (retained)
+      for (it = tiles.begin(); it != tiles.end(); it++)
+         if (it->second.changed)
+            show(it->second) ;
+   renderer = 0 ;
+}
@@ -42,6 +42,9 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 #ifndef LIFERENDER_H
 #define LIFERENDER_H
+#include <map>
+#include <string>
+#include <vector>
 class liferender {
 public:
    liferender() {}
@@ -59,5 +62,98 @@ public:
    // and to the transparency values for dead pixels and live pixels
    virtual void getcolors(unsigned char** r, unsigned char** g, unsigned char** b,
                           unsigned char* dead_alpha, unsigned char* live_alpha) = 0;
+
+   // damagemode tells the drawing code how much of the previous frame it
+   // can rely on.  With DAMAGE_NONE every visible tile is built and blitted
+   // from scratch.  With DAMAGE_CACHE the algorithms remember each tile
+   // they blitted and reblit the saved pixmap when the nodes under it have
+   // not changed, skipping the tree walk and the pixel expansion.  A
+   // renderer that keeps its image between frames (and whose pixblit
+   // replaces every pixel in its rectangle) can return DAMAGE_RETAINED;
+   // then unchanged tiles are not blitted at all, and tiles that became
+   // empty are blitted once more in the dead color.
+   enum { DAMAGE_NONE, DAMAGE_CACHE, DAMAGE_RETAINED } ;
+   virtual int damagemode() { return DAMAGE_NONE ; }
+
+   // a renderer that can color a two-state bitmap itself (say with a
+   // texture lookup) can return true from takesbits; then the two-state
+   // algos pass their packed bitmap to bitblit instead of expanding it.
+   // Each row holds w/pmscale cells, leftmost cell in the high bit of
+   // the first byte, top row first; a set bit is a live cell.
+   virtual bool takesbits() { return false ; }
+   virtual void bitblit(int x, int y, int w, int h, unsigned char* bm,
+                        int pmscale) {}
+
+   // when zoomed out, hlife and the ghash algos normally light a pixel
+   // if any cell under it is alive; a renderer that returns true from
+   // wantsdensity instead gets each pixel shaded from the dead color to
+   // the live color by the fraction of its cells that are alive (any
+   // live cell still shows a little), using cached node populations
+   virtual bool wantsdensity() { return false ; }
+} ;
+
+/**
+ *   Expand nbytes of such a packed bitmap into the pixblit format:
+ *   one state byte (0 or 1) per cell if pmscale > 1, else the live or
+ *   dead RGBA quadruplet per pixel.
+ */
+void expandbits(const unsigned char *bm, int nbytes, unsigned char *pm,
+                int pmscale, const unsigned char *live,
+                const unsigned char *dead) ;
+
+/**
+ *   For density shading:  the level (0 for an empty pixel, else 32 to
+ *   255) of a pixel with the given fraction of its cells alive, and the
+ *   RGBA color of each level, from dead (0) to live (255).
+ */
+int densitylevel(double frac) ;
+void densityramp(const unsigned char *live, const unsigned char *dead,
+                 unsigned char ramp[256][4]) ;
+
+/**
+ *   The per-algorithm memory of what was drawn last frame.  Tiles are
+ *   identified by their bitmap position and carry a key that determines
+ *   their contents (the covering node for the hashed algorithms, the
+ *   bitmap itself for qlife).  The frame bytes hold everything else the
+ *   pixels depend on (view size, magnification, colors); the epoch must
+ *   change whenever a node used as a key may have been freed, and is
+ *   negative when that can happen at any time.  A change to either
+ *   discards all keys.
+ */
+class damagecache {
+public:
+   damagecache() ;
+   void beginframe(liferender *r, const void *frame, int framelen,
+                   long epoch, const unsigned char *deadrgba) ;
+   // if the tile at x, y had the same key last frame, show it again
+   // and return 1; otherwise the caller must draw it and call blit
+   int reuse(int x, int y, const void *key, int keylen) ;
+   void blit(int x, int y, int rx, int ry, int rw, int rh,
+             unsigned char *pm, int pmscale, const void *key, int keylen) ;
+   // the same for a packed bitmap, for renderers that take bits
+   void bitblit(int x, int y, int rx, int ry, int rw, int rh,
+                unsigned char *bm, int pmscale, const void *key, int keylen) ;
+   void endframe() ;
+private:
+   struct tileinfo {
+      int rx, ry, rw, rh, pmscale ;
+      int age ;                 // frames since the tile was last shown
+      bool changed, bits ;
+      std::string key ;
+      std::vector<unsigned char> pixels ;
+   } ;
+   void store(int x, int y, int rx, int ry, int rw, int rh,
+              unsigned char *pm, int pmscale, bool bits,
+              const void *key, int keylen) ;
+   void show(const tileinfo &t) ;
+   void blank(const tileinfo &t) ;
+   std::map<std::pair<int, int>, tileinfo> tiles ;
+   std::vector<tileinfo> stale ;   // replaced tiles that still need blanking
+   std::string lastframe ;
+   long lastepoch ;
+   liferender *renderer, *lastrenderer ;
+   int mode, lastmode ;
+   bool lastbits ;
+   unsigned char dead[4] ;
 } ;
 #endif
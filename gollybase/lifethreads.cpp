@@ -0,0 +1,122 @@
+                        /*** /
+
+This file is part of Golly, a Game of Life Simulator.
+Copyright (C) 2013 Andrew Trevorrow and Tomas Rokicki.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ Web site:  http://sourceforge.net/projects/golly
+ Authors:   rokicki@gmail.com  andrew@trevorrow.com
+
+                        / ***/
+#include "lifethreads.h"
+thread_local int lifethreads::myindex = 0 ;
+lifethreads::lifethreads() {
+   nthreads = 1 ;
+   shutdown = 0 ;
+}
+lifethreads::~lifethreads() {
+   setthreads(1) ;
+}
+int lifethreads::hardwarethreads() {
+   int r = (int)std::thread::hardware_concurrency() ;
+   return r < 1 ? 1 : r ;
+}
+void lifethreads::setthreads(int n) {
+   if (n < 1)
+      n = 1 ;
+   if (n == nthreads)
+      return ;
+   if (!workers.empty()) {
+      {
+         std::lock_guard<std::mutex> g(qlock) ;
+         shutdown = 1 ;
+      }
+      qwake.notify_all() ;
+      for (unsigned int i=0; i<workers.size(); i++)
+         workers[i].join() ;
+      workers.clear() ;
+      shutdown = 0 ;
+   }
+   nthreads = n ;
+   for (int i=1; i<nthreads; i++)
+      workers.push_back(std::thread(&lifethreads::worker, this, i)) ;
+}
+void lifethreads::runone(lifetask *t) {
+   std::atomic<int> *pending = t->pending ;
+   t->run() ;
+   pending->fetch_sub(1, std::memory_order_release) ;
+}
+/*
+ *   Workers take the oldest task; those tend to be the biggest.
+ */
+void lifethreads::worker(int index) {
+   myindex = index ;
+   for (;;) {
+      lifetask *t = 0 ;
+      {
+         std::unique_lock<std::mutex> g(qlock) ;
+         while (queue.empty() && !shutdown)
+            qwake.wait(g) ;
+         if (shutdown)
+            return ;
+         t = queue.front() ;
+         queue.pop_front() ;
+      }
+      runone(t) ;
+   }
+}
+/*
+ *   We run the first task ourselves and queue the rest.  While we wait
+ *   we take the newest task on the queue, which is most likely one of
+ *   our own (or at least a small one), and run it.
+ */
+void lifethreads::runall(lifetask **tasks, int n, lifetask *idle) {
+   if (nthreads < 2 || n < 2) {
+      for (int i=0; i<n; i++)
+         tasks[i]->run() ;
+      return ;
+   }
+   std::atomic<int> pending(n) ;
+   for (int i=0; i<n; i++)
+      tasks[i]->pending = &pending ;
+   {
+      std::lock_guard<std::mutex> g(qlock) ;
+      for (int i=n-1; i>0; i--)
+         queue.push_back(tasks[i]) ;
+   }
+   if (n > 2)
+      qwake.notify_all() ;
+   else
+      qwake.notify_one() ;
+   runone(tasks[0]) ;
+   while (pending.load(std::memory_order_acquire) > 0) {
+      lifetask *t = 0 ;
+      {
+         std::lock_guard<std::mutex> g(qlock) ;
+         if (!queue.empty()) {
+            t = queue.back() ;
+            queue.pop_back() ;
+         }
+      }
+      if (t)
+         runone(t) ;
+      else {
+         if (idle)
+            idle->run() ;
+         std::this_thread::yield() ;
+      }
+   }
+}
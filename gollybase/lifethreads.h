@@ -0,0 +1,136 @@
+                        /*** /
+
+This file is part of Golly, a Game of Life Simulator.
+Copyright (C) 2013 Andrew Trevorrow and Tomas Rokicki.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ Web site:  http://sourceforge.net/projects/golly
+ Authors:   rokicki@gmail.com  andrew@trevorrow.com
+
+                        / ***/
+/**
+ *   A very small fork/join thread pool shared by the algorithms that
+ *   can split a calculation into independent pieces.  A caller hands
+ *   runall() an array of tasks; the tasks may be run by any of the
+ *   worker threads and by the caller itself, and runall() returns only
+ *   when every one of them has finished.  Tasks may themselves call
+ *   runall(); a thread waiting on its own tasks helps out by running
+ *   whatever is pending so we never deadlock and never idle while there
+ *   is work to do.
+ *
+ *   With only one thread (the default) no threads are ever created and
+ *   runall() simply runs the tasks in order.
+ */
+#ifndef LIFETHREADS_H
+#define LIFETHREADS_H
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+/**
+ *   Anything to be run on the pool derives from this.
+ */
+class lifetask {
+public:
+   lifetask() : pending(0) {}
+   virtual ~lifetask() {}
+   virtual void run() = 0 ;
+   std::atomic<int> *pending ; // owned by runall(); do not touch
+} ;
+/**
+ *   A tiny spin lock; we use arrays of these to stripe shared tables,
+ *   where a std::mutex per stripe would be far too large.
+ */
+class lifelock {
+public:
+   lifelock() { flag.clear() ; }
+   void lock() {
+      while (flag.test_and_set(std::memory_order_acquire))
+         std::this_thread::yield() ;
+   }
+   void unlock() { flag.clear(std::memory_order_release) ; }
+private:
+   std::atomic_flag flag ;
+} ;
+class lifethreads {
+public:
+   lifethreads() ;
+   ~lifethreads() ;
+   /**
+    *   Set the total number of threads to use, including the calling
+    *   thread; values less than 2 shut down all the workers.
+    */
+   void setthreads(int n) ;
+   int getthreads() const { return nthreads ; }
+   /**
+    *   Run all n tasks, in parallel if we can, and wait for them.  If
+    *   we have to wait with nothing to do, we call idle (if given) over
+    *   and over; callers can use that to cooperate with each other.
+    */
+   void runall(lifetask **tasks, int n, lifetask *idle = 0) ;
+   /**
+    *   Split [0, n) into getthreads() contiguous slices and call
+    *   f(i, lo, hi) for slice i of them, in parallel.  Handy for
+    *   chewing through a big array where each element stands alone.
+    */
+   template <class F> void runslices(size_t n, F &f) ;
+   /**
+    *   Which thread of its pool is this?  The thread that owns the
+    *   pool (the one that calls runall() from outside any task) is
+    *   always zero; workers are numbered from 1.
+    */
+   static int threadindex() { return myindex ; }
+   /**
+    *   How many threads does this machine have?
+    */
+   static int hardwarethreads() ;
+private:
+   void worker(int index) ;
+   void runone(lifetask *t) ;
+   int nthreads ;
+   int shutdown ;
+   std::vector<std::thread> workers ;
+   std::deque<lifetask *> queue ;
+   std::mutex qlock ;
+   std::condition_variable qwake ;
+   static thread_local int myindex ;
+} ;
+template <class F> class lifeslicetask : public lifetask {
+public:
+   virtual void run() { (*f)(i, lo, hi) ; }
+   F *f ;
+   int i ;
+   size_t lo, hi ;
+} ;
+template <class F> void lifethreads::runslices(size_t n, F &f) {
+   if (nthreads < 2) {
+      f(0, 0, n) ;
+      return ;
+   }
+   std::vector<lifeslicetask<F> > tasks(nthreads) ;
+   std::vector<lifetask *> tp(nthreads) ;
+   for (int i=0; i<nthreads; i++) {
+      tasks[i].f = &f ;
+      tasks[i].i = i ;
+      tasks[i].lo = n * i / nthreads ;
+      tasks[i].hi = n * (i + 1) / nthreads ;
+      tp[i] = &tasks[i] ;
+   }
+   runall(&tp[0], nthreads) ;
+}
+#endif
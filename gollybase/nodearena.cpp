@@ -0,0 +1,148 @@
+                        /*** /
+
+This file is part of Golly, a Game of Life Simulator.
+Copyright (C) 2013 Andrew Trevorrow and Tomas Rokicki.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ Web site:  http://sourceforge.net/projects/golly
+ Authors:   rokicki@gmail.com  andrew@trevorrow.com
+
+                        / ***/
+#include "nodearena.h"
+#include "util.h"
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <vector>
+#include <mutex>
+#ifdef COMPACTNODES
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#endif
+char *nodearena::base = 0 ;
+int nodearena::clamplimit(int megabytes) {
+   static int lastwarned = 0 ;
+   int most = maxmegabytes() ;
+   if (megabytes <= most)
+      return megabytes ;
+   if (megabytes != lastwarned) {
+      lastwarned = megabytes ;
+      char msg[200] ;
+      sprintf(msg, "Memory limit cut from %d MB to %d MB, all the node memory "
+                   "there is.", megabytes, most) ;
+      lifewarning(msg) ;
+   }
+   return most ;
+}
+#ifndef COMPACTNODES
+void *nodearena::alloc(size_t bytes) {
+   return calloc(1, bytes) ;
+}
+void nodearena::release(void *p, size_t) {
+   free(p) ;
+}
+int nodearena::maxmegabytes() {
+   return INT_MAX ;
+}
+#else
+/*
+ *   We reserve the whole 16GB of address space up front (that costs
+ *   nothing but page table entries) and commit it a few megabytes at a
+ *   time as it is handed out.  The first few bytes are never handed
+ *   out, so a zero handle can mean a null pointer.  The arena is shared
+ *   by every universe, so it can be used up before any one of them
+ *   reaches its own limit; the algorithms then keep to what they have.
+ */
+static const g_uintptr_t ARENASIZE = (g_uintptr_t)4 << 32 ;
+static const g_uintptr_t COMMITSTEP = 4 << 20 ;
+static g_uintptr_t arenatop, arenacommitted ;
+static std::map<size_t, std::vector<char *> > arenafree ;
+static std::mutex arenalock ;
+static int reservearena() {
+#ifdef _WIN32
+   nodearena::base = (char *)VirtualAlloc(0, ARENASIZE, MEM_RESERVE,
+                                          PAGE_NOACCESS) ;
+#else
+   void *p = mmap(0, ARENASIZE, PROT_NONE,
+                  MAP_PRIVATE | MAP_ANON | MAP_NORESERVE, -1, 0) ;
+   nodearena::base = (p == MAP_FAILED) ? 0 : (char *)p ;
+#endif
+   arenatop = 64 ;
+   arenacommitted = 0 ;
+   return nodearena::base != 0 ;
+}
+static int commitarena(g_uintptr_t upto) {
+   g_uintptr_t n = (upto - arenacommitted + COMMITSTEP - 1) / COMMITSTEP *
+                   COMMITSTEP ;
+   if (arenacommitted + n > ARENASIZE)
+      n = ARENASIZE - arenacommitted ;
+#ifdef _WIN32
+   if (VirtualAlloc(nodearena::base + arenacommitted, n, MEM_COMMIT,
+                    PAGE_READWRITE) == 0)
+      return 0 ;
+#else
+   if (mprotect(nodearena::base + arenacommitted, n,
+                PROT_READ | PROT_WRITE) != 0)
+      return 0 ;
+#endif
+   arenacommitted += n ;
+   return 1 ;
+}
+void *nodearena::alloc(size_t bytes) {
+   std::lock_guard<std::mutex> g(arenalock) ;
+   bytes = (bytes + 7) & ~(size_t)7 ;
+   std::vector<char *> &fl = arenafree[bytes] ;
+   if (!fl.empty()) {
+      char *r = fl.back() ;
+      fl.pop_back() ;
+      return memset(r, 0, bytes) ;
+   }
+   if (base == 0 && !reservearena())
+      return 0 ;
+   if (arenatop + bytes > ARENASIZE)
+      return 0 ;
+   if (arenatop + bytes > arenacommitted && !commitarena(arenatop + bytes))
+      return 0 ;
+   char *r = base + arenatop ;
+   arenatop += bytes ;
+   return r ; // fresh pages are already zero
+}
+/*
+ *   We keep released blocks for reuse, but tell the system it can have
+ *   the pages back in the meantime.
+ */
+void nodearena::release(void *p, size_t bytes) {
+   std::lock_guard<std::mutex> g(arenalock) ;
+   bytes = (bytes + 7) & ~(size_t)7 ;
+   const g_uintptr_t pagesize = 4096 ;
+   g_uintptr_t lo = ((g_uintptr_t)p + pagesize - 1) & ~(pagesize - 1) ;
+   g_uintptr_t hi = ((g_uintptr_t)p + bytes) & ~(pagesize - 1) ;
+   if (hi > lo) {
+#ifdef _WIN32
+      VirtualAlloc((void *)lo, hi - lo, MEM_RESET, PAGE_READWRITE) ;
+#else
+      madvise((void *)lo, hi - lo, MADV_DONTNEED) ;
+#endif
+   }
+   arenafree[bytes].push_back((char *)p) ;
+}
+int nodearena::maxmegabytes() {
+   return (int)(ARENASIZE >> 20) - 64 ;
+}
+#endif
@@ -0,0 +1,148 @@
+                        /*** /
+
+This file is part of Golly, a Game of Life Simulator.
+Copyright (C) 2013 Andrew Trevorrow and Tomas Rokicki.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ Web site:  http://sourceforge.net/projects/golly
+ Authors:   rokicki@gmail.com  andrew@trevorrow.com
+
+                        / ***/
+/**
+ *   Compact node handles.  On 64-bit platforms a pointer takes eight
+ *   bytes, and the hashlife nodes are little but pointers.  So (unless
+ *   NOCOMPACTNODES is defined) we allocate all the node blocks from one
+ *   big reserved stretch of address space, the node arena, and nodes
+ *   refer to each other with 32-bit handles:  the offset into the
+ *   arena in units of four bytes.  That nearly halves a node and lets
+ *   the arena span 16GB.  Blocks are at least eight-byte aligned, so
+ *   the low bit of a handle to a node is always zero and can be used
+ *   as a mark, just like the low bit of a pointer.
+ *
+ *   A handle converts to and from a pointer by itself, so most code
+ *   need not know which kind of link it has.  Code that plays with the
+ *   bits uses HRAW() and SETHRAW(), which work on an integer either way.
+ */
+#ifndef NODEARENA_H
+#define NODEARENA_H
+#include "platform.h"
+#include <stddef.h>
+#include <atomic>
+#if defined(GOLLY64BIT) && !defined(NOCOMPACTNODES)
+#define COMPACTNODES (1)
+#endif
+class nodearena {
+public:
+   /**
+    *   Get a zeroed block of memory for nodes, from the arena if we use
+    *   compact nodes and from the heap if not; returns 0 if there's no
+    *   room.  Blocks given back with release() are reused by later
+    *   calls asking for the same size.
+    */
+   static void *alloc(size_t bytes) ;
+   static void release(void *p, size_t bytes) ;
+   /**
+    *   The most memory (in megabytes) an algorithm can have in nodes;
+    *   memory limits should be kept below this.  clamplimit() cuts a
+    *   limit to it, telling the user (once for each limit asked for)
+    *   when it has to.
+    */
+   static int maxmegabytes() ;
+   static int clamplimit(int megabytes) ;
+   static char *base ;
+} ;
+#ifdef COMPACTNODES
+template <class T> struct nodehandle {
+   unsigned int raw ;
+   operator T *() const {
+      return raw ? (T *)(nodearena::base + ((g_uintptr_t)raw << 2)) : 0 ;
+   }
+   template <class U> explicit operator U *() const {
+      return (U *)(T *)*this ;
+   }
+   T *operator->() const {
+      return (T *)(nodearena::base + ((g_uintptr_t)raw << 2)) ;
+   }
+   nodehandle &operator=(T *p) {
+      raw = p ? (unsigned int)(((char *)p - nodearena::base) >> 2) : 0 ;
+      return *this ;
+   }
+} ;
+#define NODEREF(T) nodehandle<T>
+#define HRAW(h) ((g_uintptr_t)(h).raw)
+#define SETHRAW(h, T, v) ((h).raw = (unsigned int)(v))
+#else
+template <class T> using nodeptr = T * ;
+#define NODEREF(T) nodeptr<T>
+#define HRAW(h) ((g_uintptr_t)(h))
+#define SETHRAW(h, T, v) ((h) = (T *)(g_uintptr_t)(v))
+#endif
+/**
+ *   Links that threads read and write while others are using them (the
+ *   hash slots and cache fields when hashlife steps in parallel) are
+ *   atomic.  Using one like a plain link is a relaxed load or store,
+ *   which costs no more than an ordinary one; a thread handing a node
+ *   to others stores it with release ordering (or claims an empty link
+ *   with claim()), and a thread picking one up loads it with acquire
+ *   ordering, so it sees the node's fields as they were written.
+ *   loadraw() and storeraw() work on the integer, like HRAW().
+ */
+template <class T> struct atomicnoderef {
+#ifdef COMPACTNODES
+   std::atomic<unsigned int> raw ;
+   static T *topointer(g_uintptr_t r) {
+      return r ? (T *)(nodearena::base + (r << 2)) : 0 ;
+   }
+   static unsigned int frompointer(T *p) {
+      return p ? (unsigned int)(((char *)p - nodearena::base) >> 2) : 0 ;
+   }
+#else
+   std::atomic<g_uintptr_t> raw ;
+   static T *topointer(g_uintptr_t r) { return (T *)r ; }
+   static g_uintptr_t frompointer(T *p) { return (g_uintptr_t)p ; }
+#endif
+   atomicnoderef() = default ;
+   atomicnoderef(const atomicnoderef &h) :
+      raw(h.raw.load(std::memory_order_relaxed)) {}
+   atomicnoderef &operator=(const atomicnoderef &h) {
+      raw.store(h.raw.load(std::memory_order_relaxed),
+                std::memory_order_relaxed) ;
+      return *this ;
+   }
+   g_uintptr_t loadraw(std::memory_order o) const { return raw.load(o) ; }
+   void storeraw(g_uintptr_t v, std::memory_order o) {
+      raw.store(v, o) ;
+   }
+   T *load(std::memory_order o) const { return topointer(raw.load(o)) ; }
+   void store(T *p, std::memory_order o) { raw.store(frompointer(p), o) ; }
+   int claim(T *p) {
+      decltype(raw.load()) expected = 0 ;
+      return raw.compare_exchange_strong(expected, frompointer(p),
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed) ;
+   }
+   operator T *() const { return load(std::memory_order_relaxed) ; }
+   template <class U> explicit operator U *() const {
+      return (U *)load(std::memory_order_relaxed) ;
+   }
+   T *operator->() const { return load(std::memory_order_relaxed) ; }
+   atomicnoderef &operator=(T *p) {
+      store(p, std::memory_order_relaxed) ;
+      return *this ;
+   }
+} ;
+#define ATOMICNODEREF(T) atomicnoderef<T>
+#endif
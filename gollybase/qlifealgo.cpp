@@ -94,10 +94,14 @@ static int bricks, tiles, supertiles, rcc, dq, ds, rccs, dqs, dss ;
  */
 brick *qlifealgo::newbrick() {
    brick *r ;
+   if (inparallel)
+      alloclock.lock() ;
    if (bricklist == 0)
       bricklist = filllist(sizeof(brick)) ;
    r = (brick *)(bricklist) ;
    bricklist = bricklist->next ;
+   if (inparallel)
+      alloclock.unlock() ;
    memset(r, 0, sizeof(brick)) ;
    STAT(bricks++) ;
    return r ;
@@ -108,10 +112,14 @@ brick *qlifealgo::newbrick() {
  */
 tile *qlifealgo::newtile() {
    tile *r ;
+   if (inparallel)
+      alloclock.lock() ;
    if (tilelist == 0)
       tilelist = filllist(sizeof(tile)) ;
    r = (tile *)(tilelist) ;
    tilelist = tilelist->next ;
+   if (inparallel)
+      alloclock.unlock() ;
    r->b[0] = r->b[1] = r->b[2] = r->b[3] = emptybrick ;
    r->flags = -1 ;
    STAT(tiles++) ;
@@ -123,10 +131,14 @@ tile *qlifealgo::newtile() {
  */
 supertile *qlifealgo::newsupertile(int lev) {
    supertile *r ;
+   if (inparallel)
+      alloclock.lock() ;
    if (supertilelist == 0)
       supertilelist = filllist(sizeof(supertile)) ;
    r = (supertile *)supertilelist ;
    supertilelist = supertilelist->next ;
+   if (inparallel)
+      alloclock.unlock() ;
    r->d[0] = r->d[1] = r->d[2] = r->d[3] = r->d[4] = r->d[5] =
                                  r->d[6] = r->d[7] = nullroots[lev-1] ;
    STAT(supertiles++) ;
@@ -218,6 +230,8 @@ qlifealgo::qlifealgo() {
       lifefatal("bad platform for this program") ;
    memused = 0 ;
    maxmemory = 0 ;
+   inparallel = 0 ;
+   kernel = &kernels[0] ;
    clearall() ;
 }
 /*
@@ -290,6 +304,24 @@ void qlifealgo::setMaxMemory(int newmemlimit) {
    }
    maxmemory = newlimit ;
 }
+/*
+ *   Set the number of threads to step with.
+ */
+void qlifealgo::setMaxThreads(int n) {
+   poller->bailIfCalculating() ;
+   threads.setthreads(n < 1 ? 1 : n) ;
+}
+/*
+ *   Supertiles at this level and above are split up among the threads
+ *   when stepping in parallel; their grandchildren are then at least
+ *   256x256.
+ */
+static const int PARALLEL_LEVEL = 4 ;
+/*
+ *   When at least this many of a brick's eight slices need recomputing,
+ *   we let the vector kernel do the whole brick.
+ */
+static const int BRICKSLICES = 3 ;
 /*
  *   Finally, our first generation subroutine!  This one handles supertiles
  *   for even to odd generation (0->1).  What is passed in is the universe
@@ -323,7 +355,10 @@ int qlifealgo::doquad01(supertile *zis, supertile *edge,
  *   Note that the parallel and corner have already been recomputed so
  *   their changing bits are shifted up 10 positions in c.
  */
-   poller->poll() ;
+   if (inparallel && lev >= PARALLEL_LEVEL)
+      return doquadpar(zis, edge, par, cor, lev, 0) ;
+   if (!onworker())
+      poller->poll() ;
    int changing = (zis->flags | (par->flags >> 19) |
                    (((edge->flags >> 18) | (cor->flags >> 27)) & 1)) & 0xff ;
    int x, b, nchanging = (zis->flags & 0x3ff00) << 10 ;
@@ -388,7 +423,10 @@ int qlifealgo::doquad01(supertile *zis, supertile *edge,
  */
 int qlifealgo::doquad10(supertile *zis, supertile *edge,
                         supertile *par, supertile *cor, int lev) {
-   poller->poll() ;
+   if (inparallel && lev >= PARALLEL_LEVEL)
+      return doquadpar(zis, edge, par, cor, lev, 1) ;
+   if (!onworker())
+      poller->poll() ;
    int changing = (zis->flags | (par->flags >> 19) |
                    (((edge->flags >> 18) | (cor->flags >> 27)) & 1)) & 0xff ;
    int x, b, nchanging = (zis->flags & 0x3ff00) << 10 ;
@@ -426,6 +464,107 @@ int qlifealgo::doquad10(supertile *zis, supertile *edge,
    zis->flags = nchanging | 0xf0000000 ;
    return upchanging(nchanging) ;
 }
+/*
+ *   The parallel version of the two routines above.  Every subtile
+ *   looks only at the neighbors it follows in the walk (those to the
+ *   right and below for 0->1, to the left and above for 1->0), and
+ *   those have always been finished first.  Splitting a supertile into
+ *   its 8x8 grandchildren, each depends only on the three before it,
+ *   so we can run each diagonal of grandchildren in parallel and get
+ *   exactly what the serial walk gets.
+ *
+ *   The one thing a grandchild cannot do is find its own parent's
+ *   changing bits, since those depend on the flags the previous child
+ *   is left with.  But those bits are just the ones that child started
+ *   with, shifted up, so we work them all out before we start.  Here k
+ *   counts the subtiles in the order the serial walk visits them.
+ */
+class quadtask : public lifetask {
+public:
+   virtual void run() {
+      if (lev == 0)
+         res = odd ? ql->p10((tile *)pfu, (tile *)pu, (tile *)pf, (tile *)p) :
+                     ql->p01((tile *)p, (tile *)pf, (tile *)pu, (tile *)pfu) ;
+      else
+         res = odd ? ql->doquad10(p, pu, pf, pfu, lev) :
+                     ql->doquad01(p, pu, pf, pfu, lev) ;
+   }
+   qlifealgo *ql ;
+   supertile *p, *pu, *pf, *pfu ;
+   int lev, odd, res ;
+} ;
+int qlifealgo::doquadpar(supertile *zis, supertile *edge,
+                         supertile *par, supertile *cor, int lev, int odd) {
+   if (!onworker())
+      poller->poll() ;
+   int changing = (zis->flags | (par->flags >> 19) |
+                   (((edge->flags >> 18) | (cor->flags >> 27)) & 1)) & 0xff ;
+   int nchanging = (zis->flags & 0x3ff00) << 10 ;
+   supertile *c[8], *u[8], *f[8], *fu[8] ;
+   int cchanging[8], cnchanging[8] ;
+   int k, m, x, y ;
+   for (k=0; k<8; k++) {
+      x = odd ? k : 7 - k ;
+      if (((changing >> k) & 1) && zis->d[x] == nullroots[lev-1])
+         zis->d[x] = newsupertile(lev-1) ;
+      c[k] = zis->d[x] ;
+      u[k] = par->d[x] ;
+      f[k] = k ? c[k-1] : edge->d[7-x] ;
+      fu[k] = k ? u[k-1] : cor->d[7-x] ;
+   }
+   for (k=0; k<8; k++) {
+      cchanging[k] = cnchanging[k] = 0 ;
+      if ((changing >> k) & 1) {
+         int fflags = f[k]->flags ;
+         if (k > 0 && ((changing >> (k - 1)) & 1))
+            fflags = (fflags & 0x3ff00) << 10 ;
+         cchanging[k] = (c[k]->flags | (fflags >> 19) |
+                   (((u[k]->flags >> 18) | (fu[k]->flags >> 27)) & 1)) & 0xff ;
+         cnchanging[k] = (c[k]->flags & 0x3ff00) << 10 ;
+         for (m=0; m<8; m++) {
+            y = odd ? m : 7 - m ;
+            if (((cchanging[k] >> m) & 1) &&
+                c[k]->d[y] == nullroots[lev-2])
+               c[k]->d[y] = (lev == 2 ? (supertile *)newtile() :
+                                                      newsupertile(lev-2)) ;
+         }
+      }
+   }
+   quadtask tasks[64] ;
+   lifetask *tp[8] ;
+   for (int diag=0; diag<15; diag++) {
+      int n = 0 ;
+      for (k=0; k<8; k++) {
+         m = diag - k ;
+         if (m < 0 || m > 7 || ((cchanging[k] >> m) & 1) == 0)
+            continue ;
+         x = odd ? k : 7 - k ;
+         y = odd ? m : 7 - m ;
+         quadtask &t = tasks[8*k+m] ;
+         t.ql = this ;
+         t.lev = lev - 2 ;
+         t.odd = odd ;
+         t.p = c[k]->d[y] ;
+         t.pu = f[k]->d[y] ;
+         t.pf = m ? c[k]->d[odd ? y-1 : y+1] : u[k]->d[7-y] ;
+         t.pfu = m ? f[k]->d[odd ? y-1 : y+1] : fu[k]->d[7-y] ;
+         tp[n++] = &t ;
+      }
+      if (n)
+         threads.runall(tp, n) ;
+   }
+   for (k=0; k<8; k++) {
+      if (((changing >> k) & 1) == 0)
+         continue ;
+      for (m=0; m<8; m++)
+         if ((cchanging[k] >> m) & 1)
+            cnchanging[k] |= tasks[8*k+m].res << (7 - m) ;
+      c[k]->flags = cnchanging[k] | 0xf0000000 ;
+      nchanging |= upchanging(cnchanging[k]) << (7 - k) ;
+   }
+   zis->flags = nchanging | 0xf0000000 ;
+   return upchanging(nchanging) ;
+}
 /*
  *   This is our monster subroutine that, with its mirror below, accounts for
  *   about 90% of the runtime.  It handles recomputation for a 32x32 tile.
@@ -461,6 +600,21 @@ int qlifealgo::p01(tile *p, tile *pr, tile *pd, tile *prd) {
          p->flags |= 1 << i ;
          if (b == emptybrick)
             p->b[i] = b = newbrick() ;
+/*
+ *   If most of the brick needs recomputing and the rule allows it, do
+ *   all eight slices at once with the vector kernel up front; the loop
+ *   below then just picks up its results.
+ */
+         unsigned int newd[8] ;
+         int vec = (kernel->brickable() && bc[recomp] >= BRICKSLICES) ;
+         if (vec) {
+            unsigned int cur[9], below[9] ;
+            memcpy(cur, b->d, 8 * sizeof(int)) ;
+            cur[8] = rb->d[0] ;
+            memcpy(below, db->d, 8 * sizeof(int)) ;
+            below[8] = rdb->d[0] ;
+            kernel->brick01(cur, below, newd) ;
+         }
 /*
  *   If we need to recompute the end slice, now is a good time to get the
  *   right neighbor's data.
@@ -499,7 +653,8 @@ int qlifealgo::p01(tile *p, tile *pr, tile *pd, tile *prd) {
                                         ((traildata >> 2) & 0x33333333) ;
                unsigned int otherunderdata = ((underdata << 2) & 0xcccccccc) +
                                     ((trailunderdata >> 2) & 0x33333333) ;
-               int newv = (ruletable[zisdata >> 16] << 26) +
+               int newv = vec ? (int)newd[j] :
+                          (ruletable[zisdata >> 16] << 26) +
                           (ruletable[underdata >> 16] << 18) +
                           (ruletable[zisdata & 0xffff] << 10) +
                           (ruletable[underdata & 0xffff] << 2) +
@@ -586,6 +741,16 @@ int qlifealgo::p10(tile *plu, tile *pu, tile *pl, tile *p) {
          p->flags |= 1 << i ;
          if (b == emptybrick)
             p->b[i] = b = newbrick() ;
+         unsigned int newd[8] ;
+         int vec = (kernel->brickable() && bc[recomp] >= BRICKSLICES) ;
+         if (vec) {
+            unsigned int cur[9], above[9] ;
+            cur[0] = lb->d[15] ;
+            memcpy(cur + 1, b->d + 8, 8 * sizeof(int)) ;
+            above[0] = lub->d[15] ;
+            memcpy(above + 1, ub->d + 8, 8 * sizeof(int)) ;
+            kernel->brick10(cur, above, newd) ;
+         }
          if (recomp & 1) {
             j = 0 ;
             traildata = lb->d[15] ;
@@ -605,7 +770,8 @@ int qlifealgo::p10(tile *plu, tile *pu, tile *pl, tile *p) {
                                         ((traildata << 2) & 0xcccccccc) ;
                unsigned int otheroverdata = ((overdata >> 2) & 0x33333333) +
                                     ((trailoverdata << 2) & 0xcccccccc) ;
-               int newv = (ruletable[otheroverdata >> 16] << 26) +
+               int newv = vec ? (int)newd[j] :
+                          (ruletable[otheroverdata >> 16] << 26) +
                           (ruletable[otherdata >> 16] << 18) +
                           (ruletable[otheroverdata & 0xffff] << 10) +
                           (ruletable[otherdata & 0xffff] << 2) +
@@ -838,6 +1004,68 @@ int qlifealgo::getcell(int x, int y) {
          return 0 ;
    }
 }
+/*
+ *   The tile holding x, y (flipped and shifted as in getcell()), or the
+ *   empty tile if there isn't one.
+ */
+tile *qlifealgo::findtile(int x, int y) {
+   if (x < min || x > max || y < min || y > max || root == nullroot)
+      return emptytile ;
+   int xdel = (x >> 5) - minlow32 ;
+   int ydel = (y >> 5) - minlow32 ;
+   supertile *b = root ;
+   int lev = rootlev ;
+   while (lev > 0) {
+      int i ;
+      if (lev & 1) {
+         int s = (lev >> 1) + lev - 1 ;
+         i = (xdel >> s) & 7 ;
+      } else {
+         int s = (lev >> 1) + lev - 3 ;
+         i = (ydel >> s) & 7 ;
+      }
+      if (b->d[i] == nullroots[lev-1])
+         return emptytile ;
+      lev -= 1 ;
+      b = b->d[i] ;
+   }
+   return (tile *)b ;
+}
+/*
+ *   Read a rectangle a tile at a time, so a border row or column walks
+ *   down the tree once for every 32 cells rather than for each one.
+ */
+void qlifealgo::getstrip(int x, int y, int wd, int ht,
+                         unsigned char *states) {
+   if (wd <= 0 || ht <= 0)
+      return ;
+   memset(states, 0, (size_t)wd * ht) ;
+   int odd = generation.odd() ;
+   int add = (odd ? 8 : 0) ;
+   // the rectangle as getcell() sees it (y going up), inclusive
+   G_INT64 x0 = (G_INT64)x - odd, x1 = x0 + wd - 1 ;
+   G_INT64 y1 = - (G_INT64)y - odd, y0 = y1 - ht + 1 ;
+   for (G_INT64 by = y0 & ~31; by <= y1; by += 32)
+      for (G_INT64 bx = x0 & ~31; bx <= x1; bx += 32) {
+         if (bx < min || bx > max || by < min || by > max)
+            continue ;
+         tile *p = findtile((int)bx, (int)by) ;
+         if (p == emptytile)
+            continue ;
+         G_INT64 ylo = by < y0 ? y0 : by, yhi = by + 31 > y1 ? y1 : by + 31 ;
+         G_INT64 xlo = bx < x0 ? x0 : bx, xhi = bx + 31 > x1 ? x1 : bx + 31 ;
+         for (G_INT64 yy = ylo; yy <= yhi; yy++) {
+            brick *br = p->b[(yy >> 3) & 3] ;
+            if (br == emptybrick)
+               continue ;
+            unsigned char *row = states + (size_t)(y1 - yy) * wd ;
+            int sh = 31 - (int)(yy & 7) * 4 ;
+            for (G_INT64 xx = xlo; xx <= xhi; xx++)
+               if ((br->d[add + ((xx >> 2) & 7)] >> (sh - (xx & 3))) & 1)
+                  row[xx - x0] = 1 ;
+         }
+      }
+}
 /**
  *   Similar but returns the distance to the next set cell horizontally.
  */
@@ -912,6 +1140,19 @@ int qlifealgo::nextcell(int x, int y, supertile *n, int lev) {
    }
    return -1 ;
 }
+/*
+ *   Counting the population of a big supertile is also split among the
+ *   threads, a subtile to a task; each keeps its own cached counts and
+ *   we add up the results in order.
+ */
+class poptask : public lifetask {
+public:
+   virtual void run() { pop = ql->find_set_bits(p, lev, gm1) ; }
+   qlifealgo *ql ;
+   supertile *p ;
+   int lev, gm1 ;
+   G_INT64 pop ;
+} ;
 /*
  *   This subroutine calculates the population count of the universe.  It
  *   uses dirty bits number 1 and 2 of supertiles.
@@ -939,9 +1180,26 @@ G_INT64 qlifealgo::find_set_bits(supertile *p, int lev, int gm1) {
       }
    } else {
       if (p->flags & (0x20000000 << gm1)) {
-         for (i=0; i<8; i++)
-            if (p->d[i] != nullroots[lev-1])
-               pop += find_set_bits(p->d[i], lev-1, gm1) ;
+         if (lev >= PARALLEL_LEVEL && threads.getthreads() > 1) {
+            poptask tasks[8] ;
+            lifetask *tp[8] ;
+            int n = 0 ;
+            for (i=0; i<8; i++)
+               if (p->d[i] != nullroots[lev-1]) {
+                  tasks[n].ql = this ;
+                  tasks[n].p = p->d[i] ;
+                  tasks[n].lev = lev - 1 ;
+                  tasks[n].gm1 = gm1 ;
+                  tp[n] = &tasks[n] ;
+                  n++ ;
+               }
+            threads.runall(tp, n) ;
+            for (i=0; i<n; i++)
+               pop += tasks[i].pop ;
+         } else
+            for (i=0; i<8; i++)
+               if (p->d[i] != nullroots[lev-1])
+                  pop += find_set_bits(p->d[i], lev-1, gm1) ;
          if (pop < 500000000) {
             p->pop[gm1] = (long)pop ;
             p->flags &= ~(0x20000000 << gm1) ;
@@ -1107,10 +1365,12 @@ void qlifealgo::dogen() {
       while (uproot_needed())
          uproot() ;
    }
+   inparallel = (threads.getthreads() > 1) ;
    if (generation.odd())
       doquad10(root, nullroot, nullroot, nullroot, rootlev) ;
    else
       doquad01(root, nullroot, nullroot, nullroot, rootlev) ;
+   inparallel = 0 ;
    deltaforward = 0 ;
    generation += bigint::one ;
    popValid = 0 ;
@@ -1131,12 +1391,16 @@ void qlifealgo::step() {
    while (t != 0) {
       if (qliferules.alternate_rules) {
          // emulate B0-not-Smax rule by changing rule table depending on gen parity
-         if (generation.odd())
+         if (generation.odd()) {
             ruletable = qliferules.rule1 ;
-         else
+            kernel = &kernels[1] ;
+         } else {
             ruletable = qliferules.rule0 ;
+            kernel = &kernels[0] ;
+         }
       } else {
          ruletable = qliferules.rule0 ;
+         kernel = &kernels[0] ;
       }
       dogen() ;
       if (poller->isInterrupted())
@@ -1189,6 +1453,10 @@ const char *qlifealgo::setrule(const char *s) {
    
    // ruletable is set in step(), but play safe
    ruletable = qliferules.rule0 ;
+   kernels[0].setrule(qliferules.rule0) ;
+   if (qliferules.alternate_rules)
+      kernels[1].setrule(qliferules.rule1) ;
+   kernel = &kernels[0] ;
    
    if (qliferules.isHexagonal())
       grid_type = HEX_GRID;
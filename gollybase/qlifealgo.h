@@ -28,6 +28,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #define QLIFEALGO_H
 #include "lifealgo.h"
 #include "liferules.h"
+#include "lifethreads.h"
+#include "leafkernel.h"
 #include <vector>
 /*
  *   The smallest unit of the universe is the `slice', which is a
@@ -214,6 +216,7 @@ public:
    virtual int setcell(int x, int y, int newstate) ;
    virtual int getcell(int x, int y) ;
    virtual int nextcell(int x, int y, int &v) ;
+   virtual void getstrip(int x, int y, int wd, int ht, unsigned char *states) ;
    // call after setcell/clearcell calls
    virtual void endofpattern() {
      // AKT: unnecessary (and prevents shrinking selection while generating)
@@ -229,6 +232,8 @@ public:
    virtual int hyperCapable() { return 0 ; }
    virtual void setMaxMemory(int m) ;
    virtual int getMaxMemory() { return (int)(maxmemory >> 20) ; }
+   virtual void setMaxThreads(int n) ;
+   virtual int getMaxThreads() { return threads.getthreads() ; }
    virtual const char *setrule(const char *s) ;
    virtual const char *getrule() { return qliferules.getrule() ; }
    virtual void step() ;
@@ -252,6 +257,8 @@ private:
                 supertile *par, supertile *cor, int lev) ;
    int doquad10(supertile *zis, supertile *edge,
                 supertile *par, supertile *cor, int lev) ;
+   int doquadpar(supertile *zis, supertile *edge,
+                 supertile *par, supertile *cor, int lev, int odd) ;
    int p01(tile *p, tile *pr, tile *pd, tile *prd) ;
    int p10(tile *plu, tile *pu, tile *pl, tile *p) ;
    G_INT64 find_set_bits(supertile *p, int lev, int gm1) ;
@@ -266,6 +273,7 @@ private:
    void ShrinkCells(supertile *p, int xoff, int yoff, int wd, int ht, int lev) ;
    void clearrect(int minx, int miny, int w, int h) ;
    int nextcell(int x, int y, supertile *n, int lev) ;
+   tile *findtile(int x, int y) ;
    void drawshpixel(int x, int y) ;
    void fill_ll(int d) ;
    int lowsub(vector<supertile*> &src, vector<supertile*> &dst, int lev) ;
@@ -289,8 +297,10 @@ private:
    int cleandowncounter ;
    g_uintptr_t maxmemory, usedmemory ;
    char *ruletable ;
+   leafkernel kernels[2], *kernel ; // bit-sliced bricks for rule0, rule1
    // when drawing, these are used
    liferender *renderer ;
+   damagecache damage ;   // tiles drawn last frame, keyed by bitmap
    viewport *view ;
    int uviewh, uvieww, viewh, vieww, mag, pmag, kadd ;
    int oddgen ;
@@ -299,5 +309,17 @@ private:
    int llbits, llsize ;
    char *llxb, *llyb ;
    liferules qliferules ;
+/*
+ *   Parallel stepping.  While inparallel is set, the big supertiles
+ *   are split into their grandchildren, which are handed to the thread
+ *   pool a diagonal at a time (see doquadpar); the free lists are then
+ *   shared and guarded by alloclock.
+ */
+   lifethreads threads ;
+   lifelock alloclock ;
+   int inparallel ;
+   friend class quadtask ;
+   friend class poptask ;
+   int onworker() { return inparallel && lifethreads::threadindex() != 0 ; }
 } ;
 #endif
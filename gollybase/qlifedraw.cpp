@@ -57,36 +57,26 @@ void qlifealgo::renderbm(int x, int y, int xsize, int ysize) {
    }
    ry = uviewh - ry - rh ;
 
-   if (pmag > 1) {
-      // convert each bigbuf byte into 8 bytes of state data
-      int j = 0;
-      for (int i = 0; i < ibufsize * 4; i++) {
-         int byte = bigbuf[i];
-         for (int bit = 128; bit > 0; bit >>= 1) {
-            pixbuf[j++] = (byte & bit) ? 1 : 0;
-         }
-      }
+   // qlife tiles are rebuilt in place, so the bitmap itself is the key;
+   // comparing 8K bytes is still far cheaper than expanding them
+   if (damage.reuse(x, y, bigbuf, sizeof(ibigbuf))) {
+      memset(bigbuf, 0, sizeof(ibigbuf)) ;
+      return ;
+   }
+
+   if (renderer->takesbits()) {
+      damage.bitblit(x, y, rx, ry, rw, rh, bigbuf, pmag, bigbuf,
+                     sizeof(ibigbuf)) ;
    } else {
-      // convert each bigbuf byte into 32 bytes of pixel data (8 * RGBA)
-      int j = 0;
-      for (int i = 0; i < ibufsize * 4; i++) {
-         int byte = bigbuf[i];
-         for (int bit = 128; bit > 0; bit >>= 1) {
-            if (byte & bit) {
-               pixbuf[j++] = liver;
-               pixbuf[j++] = liveg;
-               pixbuf[j++] = liveb;
-               pixbuf[j++] = livea;
-            } else {
-               pixbuf[j++] = deadr;
-               pixbuf[j++] = deadg;
-               pixbuf[j++] = deadb;
-               pixbuf[j++] = deada;
-            }
-         }
-      }
+      // convert each bigbuf byte into 8 bytes of state data (pmag > 1)
+      // or 32 bytes of pixel data (8 * RGBA); a shrunken bitmap only
+      // uses the start of bigbuf
+      unsigned char live[] = { liver, liveg, liveb, livea } ;
+      unsigned char dead[] = { deadr, deadg, deadb, deada } ;
+      expandbits(bigbuf, xsize * ysize / 8, pixbuf, pmag, live, dead) ;
+      damage.blit(x, y, rx, ry, rw, rh, pixbuf, pmag, bigbuf,
+                  sizeof(ibigbuf)) ;
    }
-   renderer->pixblit(rx, ry, rw, rh, pixbuf, pmag);
 
    memset(bigbuf, 0, sizeof(ibigbuf)) ;
 }
@@ -490,7 +480,12 @@ void qlifealgo::draw(viewport &viewarg, liferender &renderarg) {
       viewh = uviewh ;
       vieww = uvieww ;
    }
+   int frame[] = { uvieww, uviewh, mag, pmag, deadr, deadg, deadb, deada,
+                   liver, liveg, liveb, livea } ;
+   unsigned char dead[] = { deadr, deadg, deadb, deada } ;
+   damage.beginframe(renderer, frame, sizeof(frame), 0, dead) ;
    if (root == nullroots[rootlev]) {
+      damage.endframe() ;
       renderer = 0 ;
       view = 0 ;
       return ;
@@ -509,6 +504,7 @@ void qlifealgo::draw(viewport &viewarg, liferender &renderarg) {
       llx = (llx << 1) + llxb[i] ;
       lly = (lly << 1) + llyb[i] ;
       if (llx > 2*maxd || lly > 2*maxd || llx < -2*maxd || lly < -2*maxd) {
+         damage.endframe() ;
          renderer = 0 ;
          view = 0 ;
          return ;
@@ -559,6 +555,7 @@ void qlifealgo::draw(viewport &viewarg, liferender &renderarg) {
       llx -= xp ;
       lly -= yp ;
       if (llx > 2*maxd || lly > 2*maxd || llx < -2*maxd || lly < -2*maxd) {
+         damage.endframe() ;
          renderer = 0 ;
          view = 0 ;
          return ;
@@ -588,6 +585,7 @@ void qlifealgo::draw(viewport &viewarg, liferender &renderarg) {
    int yoffuht = yoff + wd ;
    int xoffuwd = xoff + wd ;
    if (yoff >= viewh || xoff >= vieww || yoffuht < 0 || xoffuwd < 0) {
+      damage.endframe() ;
       renderer = 0 ;
       view = 0 ;
       return ;
@@ -623,6 +621,7 @@ void qlifealgo::draw(viewport &viewarg, liferender &renderarg) {
       BlitCells(nw, xoff, yoff+levsize, levsize, levsize, curlev);
       BlitCells(ne, xoff+levsize, yoff+levsize, levsize, levsize, curlev);
    }
+   damage.endframe() ;
    renderer = 0 ;
    view = 0 ;
 }
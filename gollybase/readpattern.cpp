@@ -36,9 +36,6 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #define CR 13
 #define LF 10
 
-bool getedges = false;              // find pattern edges?
-bigint top, left, bottom, right;    // the pattern edges
-
 #ifdef __APPLE__
 #define BUFFSIZE 4096      // 4K is best for Mac OS X
 #else
@@ -46,34 +43,86 @@ bigint top, left, bottom, right;    // the pattern edges
 #endif
 
 #ifdef ZLIB
-gzFile zinstream ;
+#define ZIN ((gzFile)instream)
 #else
-FILE *pattfile ;
+#define PATTFILE ((FILE *)instream)
 #endif
 
-char filebuff[BUFFSIZE];
-int buffpos, bytesread, prevchar;
+patternreader::patternreader() {
+   instream = 0 ;
+   filebuff = 0 ;
+   buffpos = bytesread = prevchar = 0 ;
+   filesize = 0 ;
+   getedges = false ;
+   rowend = 0 ;
+}
+
+patternreader::~patternreader() {
+   close() ;
+}
+
+long getfilesize(const char *filename) {
+   long flen = 0;
+   FILE *f = fopen(filename, "rb");
+   if (f != 0) {
+      fseek(f, 0L, SEEK_END);
+      flen = ftell(f);
+      fclose(f);
+   }
+   return flen;
+}
 
-long filesize;             // length of file in bytes
+bool patternreader::open(const char *filename) {
+   close() ;
+   filesize = getfilesize(filename);
+#ifdef ZLIB
+   instream = gzopen(filename, "rb") ;       // rb needed on Windows
+#else
+   instream = fopen(filename, "rb") ;        // .mcb data is binary
+#endif
+   if (instream == 0)
+      return false ;
+   if (filebuff == 0)
+      filebuff = (char *)malloc(BUFFSIZE) ;
+   buffpos = BUFFSIZE;                       // for 1st getchar call
+   bytesread = 0;
+   prevchar = 0;                             // for 1st getline call
+   return true ;
+}
+
+void patternreader::close() {
+   if (instream) {
+#ifdef ZLIB
+      gzclose(ZIN) ;
+#else
+      fclose(PATTFILE) ;
+#endif
+      instream = 0 ;
+   }
+   if (filebuff) {
+      free(filebuff) ;
+      filebuff = 0 ;
+   }
+}
 
 // use buffered getchar instead of slow fgetc
 // don't override the "getchar" name which is likely to be a macro
-int mgetchar() {
+int patternreader::mgetchar() {
    if (buffpos == BUFFSIZE) {
       double filepos;
       #ifdef ZLIB
-         bytesread = gzread(zinstream, filebuff, BUFFSIZE);
+         bytesread = gzread(ZIN, filebuff, BUFFSIZE);
          #if ZLIB_VERNUM >= 0x1240
             // gzoffset is only available in zlib 1.2.4 or later
-            filepos = gzoffset(zinstream);
+            filepos = gzoffset(ZIN);
          #else
             // use an approximation of file position if file is compressed
-            filepos = gztell(zinstream);
-            if (filepos > 0 && gzdirect(zinstream) == 0) filepos /= 4;
+            filepos = gztell(ZIN);
+            if (filepos > 0 && gzdirect(ZIN) == 0) filepos /= 4;
          #endif
       #else
-         bytesread = fread(filebuff, 1, BUFFSIZE, pattfile);
-         filepos = ftell(pattfile);
+         bytesread = fread(filebuff, 1, BUFFSIZE, PATTFILE);
+         filepos = ftell(PATTFILE);
       #endif
       buffpos = 0;
       lifeabortprogress(filepos / filesize, "");
@@ -83,7 +132,7 @@ int mgetchar() {
 }
 
 // use getline instead of fgets so we can handle DOS/Mac/Unix line endings
-char *getline(char *line, int maxlinelen) {
+char *patternreader::getline(char *line, int maxlinelen) {
    int i = 0;
    while (i < maxlinelen) {
       int ch = mgetchar();
@@ -115,12 +164,34 @@ char *getline(char *line, int maxlinelen) {
    return line;
 }
 
+int patternreader::getbytes(char *buf, int n) {
+   int i = 0;
+   while (i < n) {
+      if (buffpos < bytesread && buffpos < BUFFSIZE) {
+         int k = bytesread - buffpos;
+         if (k > n - i) k = n - i;
+         memcpy(buf + i, filebuff + buffpos, k);
+         buffpos += k;
+         i += k;
+      } else {
+         // let mgetchar refill the buffer, but take the byte from the
+         // buffer ourselves since a 0xff byte would look like EOF
+         int was = buffpos;
+         mgetchar();
+         if (isaborted() || buffpos == 0 || buffpos == was ||
+             buffpos > bytesread) break;
+         buf[i++] = filebuff[buffpos - 1];
+      }
+   }
+   return i;
+}
+
 const char *SETCELLERROR = "Impossible; set cell error for state 1" ;
 
 // Read a text pattern like "...ooo$$$ooo" where '.', ',' and chars <= ' '
 // represent dead cells, '$' represents 10 dead cells, and all other chars
 // represent live cells.
-const char *readtextpattern(lifealgo &imp, char *line) {
+const char *readtextpattern(patternreader &reader, lifealgo &imp, char *line) {
    int x=0, y=0;
    char *p;
 
@@ -138,11 +209,12 @@ const char *readtextpattern(lifealgo &imp, char *line) {
          }
       }
       y++ ;
-      if (getedges && right.toint() < x - 1) right = x - 1;
+      if (reader.getedges && reader.right.toint() < x - 1)
+         reader.right = x - 1;
       x = 0;
-   } while (getline(line, LINESIZE));
+   } while (reader.getline(line, LINESIZE));
 
-   if (getedges) bottom = y - 1;
+   if (reader.getedges) reader.bottom = y - 1;
    return 0 ;
 }
 
@@ -183,11 +255,47 @@ void ParseXRLELine(char *line, int *xoff, int *yoff, bool *sawpos, bigint &gen)
    }
 }
 
+/*
+ *   For two-state rules readrle() collects each row as a bitmap and
+ *   hands it over with setrow(), which lets the algorithm build the
+ *   pattern in bulk rather than a cell at a time.
+ */
+static void addrun(patternreader &reader, int x, int n) {
+   std::vector<unsigned char> &rowbits = reader.rowbits ;
+   if (x + n > reader.rowend) {
+      reader.rowend = x + n ;
+      if ((int)rowbits.size() < (reader.rowend + 7) >> 3)
+         rowbits.resize(2 * ((reader.rowend + 7) >> 3), 0) ;
+   }
+   for (; n > 0 && (x & 7); x++, n--)
+      rowbits[x >> 3] |= 0x80 >> (x & 7) ;
+   if (n >= 8) {
+      memset(&rowbits[x >> 3], 255, n >> 3) ;
+      x += n & ~7 ;
+      n &= 7 ;
+   }
+   for (; n > 0; x++, n--)
+      rowbits[x >> 3] |= 0x80 >> (x & 7) ;
+}
+
+static int flushrow(patternreader &reader, lifealgo &imp, int x, int y) {
+   std::vector<unsigned char> &rowbits = reader.rowbits ;
+   if (reader.rowend == 0)
+      return 0 ;
+   int r = imp.setrow(x, y, reader.rowend, &rowbits[0]) ;
+   memset(&rowbits[0], 0, (reader.rowend + 7) >> 3) ;
+   reader.rowend = 0 ;
+   return r ;
+}
+
 /*
  *   Read an RLE pattern into given life algorithm implementation.
  */
-const char *readrle(lifealgo &imp, char *line) {
+const char *readrle(patternreader &reader, lifealgo &imp, char *line) {
    int n=0, x=0, y=0 ;
+   bool bulk = imp.NumCellStates() == 2 ;
+   reader.rowbits.clear() ;
+   reader.rowend = 0 ;
    char *p ;
    char *ruleptr;
    const char *errmsg;
@@ -200,7 +308,7 @@ const char *readrle(lifealgo &imp, char *line) {
    while (strncmp(line, "#CXRLE", 6) == 0) {
       ParseXRLELine(line, &xoff, &yoff, &sawpos, gen);
       imp.setGeneration(gen);
-      if (getline(line, LINESIZE) == NULL) return 0;
+      if (reader.getline(line, LINESIZE) == NULL) return 0;
    }
 
    do {
@@ -256,11 +364,11 @@ const char *readrle(lifealgo &imp, char *line) {
             yoff = -int(imp.gridht / 2);
          }
 
-         if (getedges) {
-            top = yoff;
-            left = xoff;
-            bottom = yoff + ht - 1;
-            right = xoff + wd - 1;
+         if (reader.getedges) {
+            reader.top = yoff;
+            reader.left = xoff;
+            reader.bottom = yoff + ht - 1;
+            reader.right = xoff + wd - 1;
          }
       } else {
          n = 0 ;
@@ -274,10 +382,17 @@ const char *readrle(lifealgo &imp, char *line) {
                if (c == 'b' || c == '.') {
                   x += n ;
                } else if (c == '$') {
+                  if (flushrow(reader, imp, xoff, yoff + y) < 0)
+                     return "Cell state out of range for this algorithm" ;
                   x = 0 ;
                   y += n ;
                } else if (c == '!') {
+                  if (flushrow(reader, imp, xoff, yoff + y) < 0)
+                     return "Cell state out of range for this algorithm" ;
                   return 0;
+               } else if (bulk && c == 'o') {
+                  addrun(reader, x, n) ;
+                  x += n ;
                } else if (('o' <= c && c <= 'y') || ('A' <= c && c <= 'X')) {
                   int state = -1 ;
                   if (c == 'o')
@@ -307,8 +422,10 @@ const char *readrle(lifealgo &imp, char *line) {
             }
          }
       }
-   } while (getline(line, LINESIZE));
+   } while (reader.getline(line, LINESIZE));
 
+   if (flushrow(reader, imp, xoff, yoff + y) < 0)
+      return "Cell state out of range for this algorithm" ;
    return 0;
 }
 
@@ -316,7 +433,7 @@ const char *readrle(lifealgo &imp, char *line) {
  *   This ugly bit of code will go undocumented.  It reads Alan Hensel's
  *   PC Life format, either 1.05 or 1.06.
  */
-const char *readpclife(lifealgo &imp, char *line) {
+const char *readpclife(patternreader &reader, lifealgo &imp, char *line) {
    int x=0, y=0 ;
    int leftx = x ;
    char *p ;
@@ -366,7 +483,7 @@ const char *readpclife(lifealgo &imp, char *line) {
          x = leftx ;
          y++ ;
       }
-   } while (getline(line, LINESIZE));
+   } while (reader.getline(line, LINESIZE));
 
    return 0;
 }
@@ -374,11 +491,11 @@ const char *readpclife(lifealgo &imp, char *line) {
 /*
  *   This routine reads David Bell's dblife format.
  */
-const char *readdblife(lifealgo &imp, char *line) {
+const char *readdblife(patternreader &reader, lifealgo &imp, char *line) {
    int n=0, x=0, y=0;
    char *p;
 
-   while (getline(line, LINESIZE)) {
+   while (reader.getline(line, LINESIZE)) {
       if (line[0] != '!') {
          // parse line like "23.O15.3O15.3O15.O4.4O"
          n = x = 0;
@@ -409,7 +526,7 @@ const char *readdblife(lifealgo &imp, char *line) {
 // Read Mirek Wojtowicz's MCell format.
 // See http://psoup.math.wisc.edu/mcell/ca_files_formats.html for details.
 //
-const char *readmcell(lifealgo &imp, char *line) {
+const char *readmcell(patternreader &reader, lifealgo &imp, char *line) {
    int x = 0, y = 0;
    int wd = 0, ht = 0;              // bounded if > 0
    int wrapped = 0;                 // plane if 0, torus if 1
@@ -418,7 +535,7 @@ const char *readmcell(lifealgo &imp, char *line) {
    bool sawrule = false;            // saw explicit rule?
    bool extendedHL = false;         // special-case rule translation for extended HistoricalLife rules
 
-   while (getline(line, LINESIZE)) {
+   while (reader.getline(line, LINESIZE)) {
       if (line[0] == '#') {
          if (line[1] == 'L' && line[2] == ' ') {
             if (!sawrule) {
@@ -532,6 +649,7 @@ const char *readmcell(lifealgo &imp, char *line) {
       // shift pattern to middle of bounded grid
       imp.endofpattern();
       if (!imp.isEmpty()) {
+         bigint top, left, bottom, right;
          imp.findedges(&top, &left, &bottom, &right);
          // pattern is currently in top left corner so shift down and right
          // (note that we add 1 to wd and ht to get same position as MCell)
@@ -554,17 +672,6 @@ const char *readmcell(lifealgo &imp, char *line) {
    return 0;
 }
 
-long getfilesize(const char *filename) {
-   long flen = 0;
-   FILE *f = fopen(filename, "r");
-   if (f != 0) {
-      fseek(f, 0L, SEEK_END);
-      flen = ftell(f);
-      fclose(f);
-   }
-   return flen;
-}
-
 // This function guesses whether `line' is the start of a headerless Life RLE
 // pattern.  It is used to distinguish headerless RLE from plain text patterns.
 static bool isplainrle(const char *line) {
@@ -603,7 +710,7 @@ static bool isplainrle(const char *line) {
    return have_digit || *end == '!';
 }
 
-const char *loadpattern(lifealgo &imp) {
+const char *loadpattern(patternreader &reader, lifealgo &imp) {
    char line[LINESIZE + 1] ;
    const char *errmsg = 0;
 
@@ -621,94 +728,100 @@ const char *loadpattern(lifealgo &imp) {
       }
    }
 
-   if (getedges)
+   if (reader.getedges)
       lifebeginprogress("Reading from clipboard");
    else
       lifebeginprogress("Reading pattern file");
 
    // skip any blank lines at start to avoid problem when copying pattern
    // from Internet Explorer
-   while (getline(line, LINESIZE) && line[0] == 0) ;
+   while (reader.getline(line, LINESIZE) && line[0] == 0) ;
 
    // test for 'i' to cater for #LLAB comment in LifeLab file
    if (line[0] == '#' && line[1] == 'L' && line[2] == 'i') {
-      errmsg = readpclife(imp, line) ;
+      errmsg = readpclife(reader, imp, line) ;
       if (errmsg == 0) {
          imp.endofpattern() ;
-         if (getedges && !imp.isEmpty()) {
-            imp.findedges(&top, &left, &bottom, &right) ;
+         if (reader.getedges && !imp.isEmpty()) {
+            imp.findedges(&reader.top, &reader.left,
+                          &reader.bottom, &reader.right) ;
          }
       }
 
    } else if (line[0] == '#' && line[1] == 'P' && line[2] == ' ') {
       // WinLifeSearch creates clipboard patterns similar to
       // Life 1.05 format but without the header line
-      errmsg = readpclife(imp, line) ;
+      errmsg = readpclife(reader, imp, line) ;
       if (errmsg == 0) {
          imp.endofpattern() ;
-         if (getedges && !imp.isEmpty()) {
-            imp.findedges(&top, &left, &bottom, &right) ;
+         if (reader.getedges && !imp.isEmpty()) {
+            imp.findedges(&reader.top, &reader.left,
+                          &reader.bottom, &reader.right) ;
          }
       }
 
    } else if (line[0] == '#' && line[1] == 'M' && line[2] == 'C' &&
               line[3] == 'e' && line[4] == 'l' && line[5] == 'l' ) {
-      errmsg = readmcell(imp, line) ;
+      errmsg = readmcell(reader, imp, line) ;
       if (errmsg == 0) {
          imp.endofpattern() ;
-         if (getedges && !imp.isEmpty()) {
-            imp.findedges(&top, &left, &bottom, &right) ;
+         if (reader.getedges && !imp.isEmpty()) {
+            imp.findedges(&reader.top, &reader.left,
+                          &reader.bottom, &reader.right) ;
          }
       }
 
    } else if (line[0] == '#' || line[0] == 'x') {
-      errmsg = readrle(imp, line) ;
+      errmsg = readrle(reader, imp, line) ;
       if (errmsg == 0) {
          imp.endofpattern() ;
-         if (getedges && !imp.isEmpty()) {
+         if (reader.getedges && !imp.isEmpty()) {
             // readrle has set top,left,bottom,right based on the info given in
             // the header line and possibly a "#CXRLE Pos=..." line, but in case
             // that info is incorrect we find the true pattern edges and expand
             // top/left/bottom/right if necessary to avoid truncating the pattern
             bigint t, l, b, r ;
             imp.findedges(&t, &l, &b, &r) ;
-            if (t < top) top = t ;
-            if (l < left) left = l ;
-            if (b > bottom) bottom = b ;
-            if (r > right) right = r ;
+            if (t < reader.top) reader.top = t ;
+            if (l < reader.left) reader.left = l ;
+            if (b > reader.bottom) reader.bottom = b ;
+            if (r > reader.right) reader.right = r ;
          }
       }
 
    } else if (line[0] == '!') {
-      errmsg = readdblife(imp, line) ;
+      errmsg = readdblife(reader, imp, line) ;
       if (errmsg == 0) {
          imp.endofpattern() ;
-         if (getedges && !imp.isEmpty()) {
-            imp.findedges(&top, &left, &bottom, &right) ;
+         if (reader.getedges && !imp.isEmpty()) {
+            imp.findedges(&reader.top, &reader.left,
+                          &reader.bottom, &reader.right) ;
          }
       }
 
    } else if (line[0] == '[') {
-      errmsg = imp.readmacrocell(line) ;
+      errmsg = imp.readmacrocell(reader, line) ;
       if (errmsg == 0) {
          imp.endofpattern() ;
-         if (getedges && !imp.isEmpty()) {
-            imp.findedges(&top, &left, &bottom, &right) ;
+         if (reader.getedges && !imp.isEmpty()) {
+            imp.findedges(&reader.top, &reader.left,
+                          &reader.bottom, &reader.right) ;
          }
       }
 
    } else if (isplainrle(line)) {
-      errmsg = readrle(imp, line) ;
+      errmsg = readrle(reader, imp, line) ;
       if (errmsg == 0) {
          imp.endofpattern() ;
-         if (getedges && !imp.isEmpty()) {
-            imp.findedges(&top, &left, &bottom, &right) ;
+         if (reader.getedges && !imp.isEmpty()) {
+            imp.findedges(&reader.top, &reader.left,
+                          &reader.bottom, &reader.right) ;
          }
       }
 
    } else {
       // read a text pattern like "...ooo$$$ooo"
-      errmsg = readtextpattern(imp, line) ;
+      errmsg = readtextpattern(reader, imp, line) ;
       if (errmsg == 0) {
          imp.endofpattern() ;
          // if getedges is true then readtextpattern has set top,left,bottom,right
@@ -726,62 +839,31 @@ const char *build_err_str(const char *filename) {
 }
 
 const char *readpattern(const char *filename, lifealgo &imp) {
-   filesize = getfilesize(filename);
-#ifdef ZLIB
-   zinstream = gzopen(filename, "rb") ;      // rb needed on Windows
-   if (zinstream == 0)
-      return build_err_str(filename) ;
-#else
-   pattfile = fopen(filename, "r") ;
-   if (pattfile == 0)
+   patternreader reader ;
+   if (!reader.open(filename))
       return build_err_str(filename) ;
-#endif
-   buffpos = BUFFSIZE;                       // for 1st getchar call
-   prevchar = 0;                             // for 1st getline call
-   const char *errmsg = loadpattern(imp) ;
-#ifdef ZLIB
-   gzclose(zinstream) ;
-#else
-   fclose(pattfile) ;
-#endif
-   return errmsg ;
+   return loadpattern(reader, imp) ;
 }
 
 const char *readclipboard(const char *filename, lifealgo &imp,
                           bigint *t, bigint *l, bigint *b, bigint *r) {
-   filesize = getfilesize(filename);
-#ifdef ZLIB
-   zinstream = gzopen(filename, "rb") ;      // rb needed on Windows
-   if (zinstream == 0)
-      return "Can't open clipboard file!" ;
-#else
-   pattfile = fopen(filename, "r") ;
-   if (pattfile == 0)
+   patternreader reader ;
+   if (!reader.open(filename))
       return "Can't open clipboard file!" ;
-#endif
-   buffpos = BUFFSIZE;                       // for 1st getchar call
-   prevchar = 0;                             // for 1st getline call
 
-   top = 0;
-   left = 0;
-   bottom = 0;
-   right = 0;
-   getedges = true;
-   const char *errmsg = loadpattern(imp);
-   getedges = false;
-   *t = top;
-   *l = left;
-   *b = bottom;
-   *r = right;
+   reader.top = 0;
+   reader.left = 0;
+   reader.bottom = 0;
+   reader.right = 0;
+   reader.getedges = true;
+   const char *errmsg = loadpattern(reader, imp);
+   *t = reader.top;
+   *l = reader.left;
+   *b = reader.bottom;
+   *r = reader.right;
    // make sure we return a valid rect
-   if (bottom < top) *b = top;
-   if (right < left) *r = left;
-
-#ifdef ZLIB
-   gzclose(zinstream) ;
-#else
-   fclose(pattfile) ;
-#endif
+   if (reader.bottom < reader.top) *b = reader.top;
+   if (reader.right < reader.left) *r = reader.left;
    return errmsg ;
 }
 
@@ -797,19 +879,10 @@ const char *readcomments(const char *filename, char **commptr)
    char *cptr = *commptr;
    cptr[0] = 0;                              // safer to init to empty string
 
-   filesize = getfilesize(filename);
-#ifdef ZLIB
-   zinstream = gzopen(filename, "rb") ;      // rb needed on Windows
-   if (zinstream == 0)
-      return build_err_str(filename) ;
-#else
-   pattfile = fopen(filename, "r") ;
-   if (pattfile == 0)
+   patternreader reader ;
+   if (!reader.open(filename))
       return build_err_str(filename) ;
-#endif
    char line[LINESIZE + 1] ;
-   buffpos = BUFFSIZE;                       // for 1st getchar call
-   prevchar = 0;                             // for 1st getline call
    int commlen = 0;
 
    // loading comments is likely to be quite fast so no real need to
@@ -819,7 +892,7 @@ const char *readcomments(const char *filename, char **commptr)
 
    // skip any blank lines at start to avoid problem when copying pattern
    // from Internet Explorer
-   while (getline(line, LINESIZE) && line[0] == 0) ;
+   while (reader.getline(line, LINESIZE) && line[0] == 0) ;
 
    // test for 'i' to cater for #LLAB comment in LifeLab file
    if (line[0] == '#' && line[1] == 'L' && line[2] == 'i') {
@@ -837,13 +910,13 @@ const char *readcomments(const char *filename, char **commptr)
             cptr[commlen] = '\n';      // getline strips off eol char(s)
             commlen++;
          }
-         if (getline(line, LINESIZE) == NULL) break;
+         if (reader.getline(line, LINESIZE) == NULL) break;
       }
 
    } else if (line[0] == '#' && line[1] == 'M' && line[2] == 'C' &&
               line[3] == 'e' && line[4] == 'l' && line[5] == 'l' ) {
       // extract "#D ..." lines from MCell file
-      while (getline(line, LINESIZE)) {
+      while (reader.getline(line, LINESIZE)) {
          if (line[0] != '#') break;
          if (line[1] == 'L' && line[2] == ' ') break;
          if (line[1] == 'D' && (line[2] == ' ' || line[2] == 0)) {
@@ -865,17 +938,17 @@ const char *readcomments(const char *filename, char **commptr)
          commlen += linelen;
          cptr[commlen] = '\n';         // getline strips off eol char(s)
          commlen++;
-         if (getline(line, LINESIZE) == NULL) break;
+         if (reader.getline(line, LINESIZE) == NULL) break;
       }
       // also look for any lines after "!" but only if file is < 1MB
       // (ZLIB doesn't seem to provide a fast way to go to eof)
-      if (filesize < 1024*1024) {
+      if (reader.length() < 1024*1024) {
          bool foundexcl = false;
-         while (getline(line, LINESIZE)) {
+         while (reader.getline(line, LINESIZE)) {
             if (strrchr(line, '!')) { foundexcl = true; break; }
          }
          if (foundexcl) {
-            while (getline(line, LINESIZE)) {
+            while (reader.getline(line, LINESIZE)) {
                int linelen = (int)strlen(line);
                if (commlen + linelen + 1 > maxcommlen) break;
                strncpy(cptr + commlen, line, linelen);
@@ -895,13 +968,14 @@ const char *readcomments(const char *filename, char **commptr)
          commlen += linelen;
          cptr[commlen] = '\n';            // getline strips off eol char(s)
          commlen++;
-         if (getline(line, LINESIZE) == NULL) break;
+         if (reader.getline(line, LINESIZE) == NULL) break;
       }
 
    } else if (line[0] == '[') {
       // extract "#C..." lines from macrocell file
-      while (getline(line, LINESIZE)) {
+      while (reader.getline(line, LINESIZE)) {
          if (line[0] != '#') break;
+         if (line[1] == 'B' && line[2] == 0) break;   // binary nodes follow
          if (line[1] == 'C') {
             int linelen = (int)strlen(line);
             if (commlen + linelen + 1 > maxcommlen) break;
@@ -919,11 +993,5 @@ const char *readcomments(const char *filename, char **commptr)
    lifeendprogress();
    if (commlen == maxcommlen) commlen--;
    cptr[commlen] = 0;
-
-#ifdef ZLIB
-   gzclose(zinstream) ;
-#else
-   fclose(pattfile) ;
-#endif
    return 0 ;
 }
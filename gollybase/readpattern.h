@@ -24,17 +24,54 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #ifndef READPATTERN_H
 #define READPATTERN_H
 #include "bigint.h"
+#include <vector>
 class lifealgo ;
 
 /*
- *   Read pattern file into given life algorithm implementation.
+ *   Everything needed to read one pattern file:  the open file, its
+ *   buffer and line state, plus what the individual format readers
+ *   collect as they go.  readpattern, readclipboard and readcomments
+ *   each use their own reader, so several patterns can be loaded at
+ *   once (into different algos) from different threads.
  */
-const char *readpattern(const char *filename, lifealgo &imp) ;
+class patternreader {
+public:
+   patternreader() ;
+   ~patternreader() ;
+   /*
+    *   Open the given file; returns false if it can't be opened.
+    */
+   bool open(const char *filename) ;
+   void close() ;
+   /*
+    *   Get next line from the pattern file.
+    */
+   char *getline(char *line, int maxlinelen) ;
+   /*
+    *   Get the next n raw bytes from the pattern file, for binary
+    *   data after a text header; returns how many we got.
+    */
+   int getbytes(char *buf, int n) ;
+   long length() const { return filesize ; }
+
+   bool getedges ;                  // find pattern edges?
+   bigint top, left, bottom, right ;   // the pattern edges
+   std::vector<unsigned char> rowbits ;   // row being read by readrle
+   int rowend ;                     // bits in use in rowbits
+private:
+   int mgetchar() ;
+   void *instream ;                 // gzFile or FILE *
+   char *filebuff ;
+   int buffpos, bytesread, prevchar ;
+   long filesize ;                  // length of file in bytes
+   patternreader(const patternreader &) ;
+   patternreader &operator=(const patternreader &) ;
+} ;
 
 /*
- *   Get next line from current pattern file.
+ *   Read pattern file into given life algorithm implementation.
  */
-char *getline(char *line, int maxlinelen) ;
+const char *readpattern(const char *filename, lifealgo &imp) ;
 
 /*
  *   Similar to readpattern but we return the pattern edges
@@ -228,6 +228,18 @@ state ruleloaderalgo::slowcalc(state nw, state n, state ne, state w, state c,
         return LocalRuleTree->slowcalc(nw, n, ne, w, c, e, sw, s, se);
 }
 
+void ruleloaderalgo::slowcalcs(const state* in, state* out, int stride,
+                               int wd, int ht)
+{
+    // pick the local algo once per block, and call its slowcalcs
+    // directly so its own rule lookup is inlined in the cell loop
+    if (rule_type == TABLE)
+        LocalRuleTable->ruletable_algo::slowcalcs(in, out, stride, wd, ht);
+    else // rule_type == TREE
+        LocalRuleTree->ghashcalc<ruletreealgo>::slowcalcs(in, out, stride,
+                                                          wd, ht);
+}
+
 static lifealgo* creator()
 {
     return new ruleloaderalgo();
@@ -750,6 +750,84 @@ state ruletable_algo::slowcalc(state nw, state n, state ne, state w, state c, st
    return c; // default: no change
 }
 
+// --- the same for a block of cells ---
+// The neighborhood switch is taken once per block rather than once per cell
+// and rule group, and for each cell we pick up the bit vectors for its
+// inputs once, so the loop over the rule groups is just a row of ANDs.
+void ruletable_algo::slowcalcs(const state *in, state *out, int stride,
+                               int wd, int ht)
+{
+   switch(this->neighborhood)
+   {
+      case vonNeumann: lookups<vonNeumann>(in, out, stride, wd, ht); break;
+      case Moore: lookups<Moore>(in, out, stride, wd, ht); break;
+      case hexagonal: lookups<hexagonal>(in, out, stride, wd, ht); break;
+      case oneDimensional: lookups<oneDimensional>(in, out, stride, wd, ht); break;
+   }
+}
+
+template <int nbhd> void ruletable_algo::lookups(const state *in, state *out,
+                                                 int stride, int wd, int ht)
+{
+   const int n_inputs = nbhd == vonNeumann ? 5 : nbhd == Moore ? 9 :
+                        nbhd == hexagonal ? 7 : 3;
+   state inputs[9];
+   const TBits *bits[9];
+   for(int y=0;y<ht;y++)
+   {
+      for(int x=0;x<wd;x++)
+      {
+         const state *r0 = in + y*stride + x, *r1 = r0 + stride, *r2 = r1 + stride;
+         // the inputs in the same order as slowcalc uses them
+         inputs[0] = r1[1];
+         switch(nbhd)
+         {
+            case vonNeumann: // c,n,e,s,w
+               inputs[1] = r0[1]; inputs[2] = r1[2]; inputs[3] = r2[1];
+               inputs[4] = r1[0];
+               break;
+            case Moore: // c,n,ne,e,se,s,sw,w,nw
+               inputs[1] = r0[1]; inputs[2] = r0[2]; inputs[3] = r1[2];
+               inputs[4] = r2[2]; inputs[5] = r2[1]; inputs[6] = r2[0];
+               inputs[7] = r1[0]; inputs[8] = r0[0];
+               break;
+            case hexagonal: // c,n,e,se,s,w,nw
+               inputs[1] = r0[1]; inputs[2] = r1[2]; inputs[3] = r2[2];
+               inputs[4] = r2[1]; inputs[5] = r1[0]; inputs[6] = r0[0];
+               break;
+            case oneDimensional: // c,w,e
+               inputs[1] = r1[0]; inputs[2] = r1[2];
+               break;
+         }
+         state result = inputs[0]; // default: no change
+         if(this->n_compressed_rules)
+         {
+            for(int i=0;i<n_inputs;i++)
+               bits[i] = &this->lut[i][inputs[i]][0];
+            for(unsigned int iRuleC=0;iRuleC<this->n_compressed_rules;iRuleC++)
+            {
+               TBits is_match = bits[0][iRuleC];
+               for(int i=1;i<n_inputs;i++)
+                  is_match &= bits[i][iRuleC];
+               if(is_match)
+               {
+                  unsigned int iBit=0;
+                  TBits mask=1;
+                  while(!(is_match&mask))
+                  {
+                     ++iBit;
+                     mask <<= 1;
+                  }
+                  result = this->output[ iRuleC*sizeof(TBits)*8 + iBit ];
+                  break;
+               }
+            }
+         }
+         out[y*stride + x] = result;
+      }
+   }
+}
+
 static lifealgo *creator() { return new ruletable_algo(); }
 
 void ruletable_algo::doInitializeAlgoInfo(staticAlgoInfo &ai) 
@@ -38,6 +38,8 @@ public:
    virtual ~ruletable_algo() ;
    virtual state slowcalc(state nw, state n, state ne, state w, state c,
                           state e, state sw, state s, state se) ;
+   virtual void slowcalcs(const state *in, state *out, int stride,
+                          int wd, int ht) ;
    virtual const char* setrule(const char* s) ;
    virtual const char* getrule() ;
    virtual const char* DefaultRule() ;
@@ -54,6 +56,8 @@ protected:
    void PackTransitions(const std::string& symmetries, int n_inputs, 
                         const std::vector< std::pair< std::vector< std::vector<state> >, state> > & transition_table);
    void PackTransition(const std::vector< std::vector<state> > & inputs, state output);
+   template <int nbhd> void lookups(const state *in, state *out, int stride,
+                                    int wd, int ht);
                         
 protected:
 
@@ -255,7 +255,7 @@ const char* ruletreealgo::DefaultRule() {
    return "B3/S23" ;
 }
 
-ruletreealgo::ruletreealgo() : ghashbase(), a(0), base(0), b(0),
+ruletreealgo::ruletreealgo() : ghashcalc<ruletreealgo>(), a(0), base(0), b(0),
                                num_neighbors(0),
                                num_states(0), num_nodes(0) {
    rule[0] = 0 ;
@@ -272,14 +272,6 @@ ruletreealgo::~ruletreealgo() {
    }
 }
 
-state ruletreealgo::slowcalc(state nw, state n, state ne, state w, state c, state e,
-                        state sw, state s, state se) {
-   if (num_neighbors == 4)
-     return b[a[a[a[a[base+n]+w]+e]+s]+c] ;
-   else
-     return b[a[a[a[a[a[a[a[a[base+nw]+ne]+sw]+se]+n]+w]+e]+s]+c] ;
-}
-
 static lifealgo *creator() { return new ruletreealgo() ; }
 
 void ruletreealgo::doInitializeAlgoInfo(staticAlgoInfo &ai) {
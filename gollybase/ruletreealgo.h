@@ -27,12 +27,18 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 /**
  *   An algorithm that uses an n-dary decision diagram.
  */
-class ruletreealgo : public ghashbase {
+class ruletreealgo : public ghashcalc<ruletreealgo> {
 public:
    ruletreealgo() ;
    virtual ~ruletreealgo() ;
+   // defined here so that ghashcalc's slowcalcs can inline it
    virtual state slowcalc(state nw, state n, state ne, state w, state c,
-                          state e, state sw, state s, state se) ;
+                          state e, state sw, state s, state se) {
+      if (num_neighbors == 4)
+        return b[a[a[a[a[base+n]+w]+e]+s]+c] ;
+      else
+        return b[a[a[a[a[a[a[a[a[base+nw]+ne]+sw]+se]+n]+w]+e]+s]+c] ;
+   }
    virtual const char* setrule(const char* s) ;
    virtual const char* getrule() ;
    virtual const char* DefaultRule() ;
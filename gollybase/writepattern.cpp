@@ -249,6 +249,14 @@ const char *writemacrocell(std::ostream &os, char *comments, lifealgo &imp)
       return "Not yet implemented.";
 }
 
+const char *writebinarycell(std::ostream &os, char *comments, lifealgo &imp)
+{
+   if (imp.hyperCapable())
+      return imp.writeNativeBinary(os, comments);
+   else
+      return "Not yet implemented.";
+}
+
 #ifdef ZLIB
 class gzbuf : public std::streambuf
 {
@@ -347,7 +355,11 @@ const char *writepattern(const char *filename, lifealgo &imp,
    switch (compression)
    {
    default:  /* no output compression */
-      streambuf = filebuf.open(filename, std::ios_base::out);
+      if (format == MCB_format)
+         streambuf = filebuf.open(filename,
+                                  std::ios_base::out | std::ios_base::binary);
+      else
+         streambuf = filebuf.open(filename, std::ios_base::out);
       break;
 
    case gzip_compression:
@@ -382,6 +394,10 @@ const char *writepattern(const char *filename, lifealgo &imp,
          errmsg = writemacrocell(os, comments, imp);
          break;
 
+      case MCB_format:
+         errmsg = writebinarycell(os, comments, imp);
+         break;
+
       default:
          errmsg = "Unsupported pattern format!";
    }
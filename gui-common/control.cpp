@@ -482,7 +482,9 @@ void StopGenerating()
 void NextGeneration(bool useinc)
 {
     lifealgo* curralgo = currlayer->algo;
-    bool boundedgrid = (curralgo->gridwd > 0 || curralgo->gridht > 0);
+    // is this a bounded grid the algorithm can't step itself?
+    bool boundedgrid = (curralgo->gridwd > 0 || curralgo->gridht > 0) &&
+                       !curralgo->gridCapable();
 
     if (generating) {
         // we were called via timer so StartGenerating has already checked
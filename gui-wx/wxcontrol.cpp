@@ -569,9 +569,10 @@ void MainFrame::DisplayPattern()
 bool MainFrame::StepPattern()
 {
     lifealgo* curralgo = currlayer->algo;
-    if (curralgo->gridwd > 0 || curralgo->gridht > 0) {
-        // bounded grid, so temporarily set the increment to 1 so we can call
-        // CreateBorderCells() and DeleteBorderCells() around each step()
+    if ((curralgo->gridwd > 0 || curralgo->gridht > 0) && !curralgo->gridCapable()) {
+        // bounded grid the algorithm can't step itself, so temporarily set the
+        // increment to 1 so we can call CreateBorderCells() and DeleteBorderCells()
+        // around each step()
         int savebase = currlayer->currbase;
         int saveexpo = currlayer->currexpo;
         bigint inc = curralgo->getIncrement();
@@ -1033,7 +1034,9 @@ void MainFrame::NextGeneration(bool useinc)
         viewptr->CheckCursor(infront);
     }
     
-    bool boundedgrid = (curralgo->gridwd > 0 || curralgo->gridht > 0);
+    // is this a bounded grid the algorithm can't step itself?
+    bool boundedgrid = (curralgo->gridwd > 0 || curralgo->gridht > 0) &&
+                       !curralgo->gridCapable();
     
     if (useinc) {
         // step by current increment
@@ -1273,9 +1273,10 @@ XS(pl_evolve)
     
     // advance pattern by ngens
     mainptr->generating = true;
-    if (tempalgo->gridwd > 0 || tempalgo->gridht > 0) {
-        // a bounded grid must use an increment of 1 so we can call
-        // CreateBorderCells and DeleteBorderCells around each step()
+    if ((tempalgo->gridwd > 0 || tempalgo->gridht > 0) && !tempalgo->gridCapable()) {
+        // a bounded grid the algorithm can't step itself must use an increment
+        // of 1 so we can call CreateBorderCells and DeleteBorderCells around
+        // each step()
         tempalgo->setIncrement(1);
         while (ngens > 0) {
             if (PerlScriptAborted()) {
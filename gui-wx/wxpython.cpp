@@ -1125,9 +1125,10 @@ static PyObject* py_evolve(PyObject* self, PyObject* args)
     
     // advance pattern by ngens
     mainptr->generating = true;
-    if (tempalgo->gridwd > 0 || tempalgo->gridht > 0) {
-        // a bounded grid must use an increment of 1 so we can call
-        // CreateBorderCells and DeleteBorderCells around each step()
+    if ((tempalgo->gridwd > 0 || tempalgo->gridht > 0) && !tempalgo->gridCapable()) {
+        // a bounded grid the algorithm can't step itself must use an increment
+        // of 1 so we can call CreateBorderCells and DeleteBorderCells around
+        // each step()
         tempalgo->setIncrement(1);
         while (ngens > 0) {
             if (PythonScriptAborted()) {
@@ -649,6 +649,9 @@ public:
     virtual void pixblit(int x, int y, int w, int h, unsigned char* pm, int pmscale);
     virtual void getcolors(unsigned char** r, unsigned char** g, unsigned char** b,
                            unsigned char* deada, unsigned char* livea);
+    // the viewport is cleared before every frame so unchanged tiles must still
+    // be blitted, but the algos can reuse the pixmaps they built last time
+    virtual int damagemode() { return DAMAGE_CACHE; }
 };
 
 golly_render renderer;     // create instance